@@ -0,0 +1,118 @@
+// Executor dispatch latency and throughput
+// Usage: executor_bench [threads]
+
+#include <marlin/asyncio/core/Executor.hpp>
+#include <marlin/asyncio/core/EventLoop.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+#define LATENCY_ROUNDS 100000
+#define THROUGHPUT_JOBS 2000000
+#define THROUGHPUT_WINDOW 4096
+
+struct Bench {
+	Executor& executor;
+
+	// Latency, one job in flight at a time
+	std::vector<uint64_t> latencies;
+	uint64_t post_time = 0;
+
+	// Throughput, a window of jobs in flight
+	uint64_t posted = 0;
+	uint64_t completed = 0;
+	uint64_t checksum = 0;
+	uint64_t start_time = 0;
+
+	Bench(Executor& executor) : executor(executor) {
+		latencies.reserve(LATENCY_ROUNDS);
+	}
+
+	void post_latency() {
+		post_time = uv_hrtime();
+		executor.post(
+			[]() { return uv_hrtime(); },
+			[this](uint64_t) {
+				latencies.push_back(uv_hrtime() - post_time);
+				if(latencies.size() < LATENCY_ROUNDS) {
+					post_latency();
+				} else {
+					report_latency();
+					start_throughput();
+				}
+			}
+		);
+	}
+
+	void report_latency() {
+		std::sort(latencies.begin(), latencies.end());
+		SPDLOG_INFO(
+			"Round trip: p50 {} ns, p99 {} ns, max {} ns",
+			latencies[latencies.size() / 2],
+			latencies[latencies.size() * 99 / 100],
+			latencies.back()
+		);
+	}
+
+	void start_throughput() {
+		start_time = uv_hrtime();
+		for(size_t i = 0; i < THROUGHPUT_WINDOW; i++) {
+			post_throughput();
+		}
+	}
+
+	void post_throughput() {
+		uint64_t idx = posted++;
+		executor.post(
+			[idx]() { return idx * 0x9e3779b97f4a7c15; },
+			[this](uint64_t res) {
+				checksum ^= res;
+				completed++;
+				if(posted < THROUGHPUT_JOBS) {
+					post_throughput();
+				} else if(completed == THROUGHPUT_JOBS) {
+					auto elapsed = uv_hrtime() - start_time;
+					SPDLOG_INFO(
+						"Throughput: {} jobs in {} ms, {} jobs/s, checksum {:x}",
+						completed,
+						elapsed / 1000000,
+						completed * 1000000000 / elapsed,
+						checksum
+					);
+				}
+			}
+		);
+	}
+};
+
+int main(int argc, char** argv) {
+	size_t threads = argc > 1 ? std::atoi(argv[1]) : 1;
+	SPDLOG_INFO("Threads: {}", threads);
+
+	// Raw pool throughput without the trip back to the loop
+	{
+		std::atomic<uint64_t> done = 0;
+		auto start = uv_hrtime();
+		{
+			ThreadPool pool(threads);
+			for(size_t i = 0; i < THROUGHPUT_JOBS; i++) {
+				pool.submit([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+			}
+		}
+		auto elapsed = uv_hrtime() - start;
+		SPDLOG_INFO("Pool only: {} tasks in {} ms, {} tasks/s", done.load(), elapsed / 1000000, done.load() * 1000000000 / elapsed);
+	}
+
+	ThreadPool pool(threads);
+	Executor executor(pool);
+	Bench bench(executor);
+
+	bench.post_latency();
+
+	return EventLoop::run();
+}
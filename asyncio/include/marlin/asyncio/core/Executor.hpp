@@ -0,0 +1,170 @@
+/*! \file Executor.hpp
+	\brief Offload CPU heavy jobs to a thread pool and get results back on the event loop
+*/
+
+#ifndef MARLIN_ASYNCIO_CORE_EXECUTOR_HPP
+#define MARLIN_ASYNCIO_CORE_EXECUTOR_HPP
+
+#include <uv.h>
+#include <marlin/core/MpscQueue.hpp>
+#include <marlin/core/ThreadPool.hpp>
+#include <marlin/simulator/core/Simulator.hpp>
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+
+namespace marlin {
+namespace asyncio {
+
+#ifdef MARLIN_ASYNCIO_SIMULATOR
+
+/// Simulated executor, jobs run inline in post order and results are delivered
+/// as simulator events after a fixed latency so runs stay deterministic
+class Executor {
+private:
+	template<typename F>
+	class CompletionEvent : public simulator::Event<simulator::Simulator> {
+	private:
+		F f;
+
+	public:
+		CompletionEvent(uint64_t tick, F&& f) : simulator::Event<simulator::Simulator>(tick), f(std::move(f)) {}
+
+		void run(simulator::Simulator&) override {
+			f();
+		}
+	};
+
+	uint64_t latency;
+
+public:
+	Executor(core::ThreadPool& = core::ThreadPool::default_instance(), uint64_t latency = 0) : latency(latency) {}
+
+	static Executor& default_instance() {
+		static Executor executor;
+		return executor;
+	}
+
+	/// Run job and call done with its result, done runs at least latency ticks later
+	template<typename Job, typename Done>
+	void post(Job&& job, Done&& done) {
+		auto tick = simulator::Simulator::default_instance.current_tick() + latency;
+
+		if constexpr (std::is_void_v<std::invoke_result_t<Job&>>) {
+			job();
+			auto f = [done = std::forward<Done>(done)]() mutable { done(); };
+			simulator::Simulator::default_instance.add_event(new CompletionEvent<decltype(f)>(tick, std::move(f)));
+		} else {
+			auto f = [done = std::forward<Done>(done), result = job()]() mutable { done(std::move(result)); };
+			simulator::Simulator::default_instance.add_event(new CompletionEvent<decltype(f)>(tick, std::move(f)));
+		}
+	}
+};
+
+#else
+
+/// @brief Runs jobs on a thread pool and delivers their results on the event loop
+///
+/// Workers push completions onto a lock-free queue and wake the loop through a uv_async_t,
+/// which drains every completion available in one callback. Completions run in the order
+/// jobs finished, with a pool of zero threads that is the order jobs were posted in.
+///
+/// post() has to be called from the event loop thread. The async handle only keeps the loop
+/// alive while jobs are outstanding. Destroying the executor waits for running jobs to
+/// finish and drops their completions.
+class Executor {
+private:
+	core::ThreadPool& pool;
+	core::MpscQueue<core::Task> completions;
+	uv_async_t* async;
+
+	// Jobs posted whose completions have not run yet, loop thread only
+	size_t outstanding = 0;
+	// Jobs still running on the pool
+	std::atomic<size_t> in_flight = 0;
+
+	static void async_close_cb(uv_handle_t* handle) {
+		delete (uv_async_t*)handle;
+	}
+
+	static void async_cb(uv_async_t* handle) {
+		auto& executor = *(Executor*)handle->data;
+
+		while(true) {
+			auto completion = executor.completions.pop();
+			if(!completion.has_value()) {
+				break;
+			}
+
+			executor.outstanding--;
+			(*completion)();
+		}
+
+		if(executor.outstanding == 0) {
+			uv_unref((uv_handle_t*)handle);
+		}
+	}
+
+	void complete(core::Task&& completion) {
+		completions.push(std::move(completion));
+		uv_async_send(async);
+		in_flight.fetch_sub(1, std::memory_order_release);
+	}
+
+public:
+	Executor(core::ThreadPool& pool = core::ThreadPool::default_instance()) : pool(pool) {
+		async = new uv_async_t();
+		async->data = this;
+		uv_async_init(uv_default_loop(), async, async_cb);
+		uv_unref((uv_handle_t*)async);
+	}
+
+	Executor(Executor const&) = delete;
+
+	~Executor() {
+		while(in_flight.load(std::memory_order_acquire) > 0) {
+			std::this_thread::yield();
+		}
+
+		uv_close((uv_handle_t*)async, async_close_cb);
+	}
+
+	/// Executor on the default thread pool
+	static Executor& default_instance() {
+		static Executor executor;
+		return executor;
+	}
+
+	/// Run job on the pool and call done with its result on the event loop
+	template<typename Job, typename Done>
+	void post(Job&& job, Done&& done) {
+		if(outstanding++ == 0) {
+			uv_ref((uv_handle_t*)async);
+		}
+		in_flight.fetch_add(1, std::memory_order_relaxed);
+
+		pool.submit([this, job = std::forward<Job>(job), done = std::forward<Done>(done)]() mutable {
+			if constexpr (std::is_void_v<std::invoke_result_t<Job&>>) {
+				job();
+				complete([done = std::move(done)]() mutable { done(); });
+			} else {
+				complete([done = std::move(done), result = job()]() mutable { done(std::move(result)); });
+			}
+		});
+	}
+
+	/// Number of jobs whose completions have not run yet
+	size_t pending() const {
+		return outstanding;
+	}
+};
+
+#endif
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_CORE_EXECUTOR_HPP
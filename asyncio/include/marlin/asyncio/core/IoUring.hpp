@@ -0,0 +1,561 @@
+/*! \file IoUring.hpp
+	\brief io_uring reactor used as an alternative socket backend to libuv
+
+	Enabled by building with MARLIN_ASYNCIO_IO_URING (cmake -DASYNCIO_IO_URING=ON).
+	The reactor is driven by the default libuv loop so timers and connection
+	setup keep working unchanged:
+	\li submissions are queued and flushed once per loop iteration from a uv_prepare_t
+	\li completions are drained in batches when the ring's eventfd becomes readable
+	\li receives use multishot ops over kernel registered (provided) buffer rings
+*/
+
+#ifndef MARLIN_ASYNCIO_CORE_IOURING_HPP
+#define MARLIN_ASYNCIO_CORE_IOURING_HPP
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+
+#include <marlin/core/BufferPool.hpp>
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <deque>
+#include <vector>
+
+namespace marlin {
+namespace asyncio {
+
+/// Base of every in-flight io_uring operation, stored as sqe user data
+struct IoUringOp {
+	using Callback = void (*)(IoUringOp& op, int res, uint32_t flags);
+
+	Callback cb = nullptr;
+	void* data = nullptr;
+};
+
+/// @brief Ring of kernel registered buffers used by multishot receives
+///
+/// Slots are filled with blocks of a core::BufferPool. Blocks are handed over to
+/// core::Buffer on completion, so received data is never copied, and go back to the
+/// pool once that Buffer is destroyed, so refilling the slot does not allocate.
+class IoUringBufferRing {
+private:
+	io_uring_buf_ring* ring = nullptr;
+	core::BufferPool pool;
+	std::vector<uint8_t*> bufs;
+	uint32_t buf_size;
+	uint16_t bgid;
+
+public:
+	IoUringBufferRing(io_uring* uring, uint16_t bgid, uint16_t count, uint32_t buf_size) :
+		pool(buf_size, count), bufs(count, nullptr), buf_size(buf_size), bgid(bgid) {
+		int res = 0;
+		ring = io_uring_setup_buf_ring(uring, count, bgid, 0, &res);
+		if(ring == nullptr) {
+			SPDLOG_ERROR("IoUring: Buffer ring setup error: {}", res);
+			return;
+		}
+
+		for(uint16_t i = 0; i < count; i++) {
+			bufs[i] = pool.acquire_raw();
+			io_uring_buf_ring_add(ring, bufs[i], buf_size, i, io_uring_buf_ring_mask(count), i);
+		}
+		io_uring_buf_ring_advance(ring, count);
+	}
+
+	IoUringBufferRing(IoUringBufferRing const&) = delete;
+
+	~IoUringBufferRing() {
+		for(auto* buf : bufs) {
+			pool.release_raw(buf);
+		}
+	}
+
+	uint16_t group() const {
+		return bgid;
+	}
+
+	/// Take ownership of the buffer with the given id and replenish its slot from the pool
+	core::Buffer take(uint16_t bid, size_t size) {
+		auto* buf = bufs[bid];
+		bufs[bid] = pool.acquire_raw();
+		io_uring_buf_ring_add(ring, bufs[bid], buf_size, bid, io_uring_buf_ring_mask(bufs.size()), 0);
+		io_uring_buf_ring_advance(ring, 1);
+
+		return pool.adopt(buf, size);
+	}
+
+	/// Return the buffer with the given id to the kernel without consuming it
+	void recycle(uint16_t bid) {
+		io_uring_buf_ring_add(ring, bufs[bid], buf_size, bid, io_uring_buf_ring_mask(bufs.size()), 0);
+		io_uring_buf_ring_advance(ring, 1);
+	}
+};
+
+/// @brief io_uring instance integrated with the default libuv loop
+/// @headerfile IoUring.hpp <marlin/asyncio/core/IoUring.hpp>
+class IoUring {
+public:
+	/// Buffer group for datagram receives
+	static constexpr uint16_t DGRAM_BGID = 0;
+	/// Buffer group for stream receives
+	static constexpr uint16_t STREAM_BGID = 1;
+
+private:
+	io_uring ring;
+	int efd = -1;
+	uv_poll_t* poll = nullptr;
+	uv_prepare_t* prepare = nullptr;
+
+	/// Number of sqes prepared but not yet submitted
+	uint32_t unsubmitted = 0;
+	/// Number of ops holding the loop alive
+	uint64_t active = 0;
+
+	static void poll_cb(uv_poll_t* handle, int status, int) {
+		auto& uring = *(IoUring*)handle->data;
+		if(status < 0) {
+			SPDLOG_ERROR("IoUring: Poll error: {}", status);
+			return;
+		}
+
+		eventfd_t val;
+		eventfd_read(uring.efd, &val);
+
+		uring.drain();
+	}
+
+	static void prepare_cb(uv_prepare_t* handle) {
+		auto& uring = *(IoUring*)handle->data;
+		uring.submit();
+	}
+
+	IoUring(unsigned entries = 4096) {
+		io_uring_params params = {};
+		params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+		int res = io_uring_queue_init_params(entries, &ring, &params);
+		if(res < 0) {
+			SPDLOG_CRITICAL("IoUring: Init error: {}", res);
+			std::abort();
+		}
+
+		efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		io_uring_register_eventfd(&ring, efd);
+
+		poll = new uv_poll_t();
+		poll->data = this;
+		uv_poll_init(uv_default_loop(), poll, efd);
+		uv_poll_start(poll, UV_READABLE, poll_cb);
+		// Only keep the loop alive while ops are outstanding
+		uv_unref((uv_handle_t*)poll);
+
+		prepare = new uv_prepare_t();
+		prepare->data = this;
+		uv_prepare_init(uv_default_loop(), prepare);
+		uv_prepare_start(prepare, prepare_cb);
+		uv_unref((uv_handle_t*)prepare);
+
+		dgram_bufs = new IoUringBufferRing(&ring, DGRAM_BGID, 512, 65536);
+		stream_bufs = new IoUringBufferRing(&ring, STREAM_BGID, 256, 65536);
+	}
+
+public:
+	IoUringBufferRing* dgram_bufs = nullptr;
+	IoUringBufferRing* stream_bufs = nullptr;
+
+	IoUring(IoUring const&) = delete;
+
+	/// Singleton ring, intended to be used similar to uv_default_loop()
+	static IoUring& default_instance() {
+		static IoUring instance;
+		return instance;
+	}
+
+	/// Get a sqe, flushing the submission queue if it is full
+	io_uring_sqe* get_sqe() {
+		auto* sqe = io_uring_get_sqe(&ring);
+		if(sqe == nullptr) {
+			submit();
+			sqe = io_uring_get_sqe(&ring);
+		}
+		unsubmitted++;
+		return sqe;
+	}
+
+	/// Make room for n sqes prepared back to back, e.g. a linked chain that must not be split across submits
+	void reserve(unsigned n) {
+		if(io_uring_sq_space_left(&ring) < n) {
+			submit();
+		}
+	}
+
+	/// Flush all queued sqes with a single syscall
+	void submit() {
+		if(unsubmitted == 0) {
+			return;
+		}
+		unsubmitted = 0;
+
+		int res = io_uring_submit(&ring);
+		if(res < 0) {
+			SPDLOG_ERROR("IoUring: Submit error: {}", res);
+		}
+	}
+
+	/// Reap all available completions in one pass
+	void drain() {
+		constexpr unsigned batch_size = 256;
+		io_uring_cqe* cqes[batch_size];
+
+		unsigned count = 0;
+		while((count = io_uring_peek_batch_cqe(&ring, cqes, batch_size)) > 0) {
+			for(unsigned i = 0; i < count; i++) {
+				auto* op = (IoUringOp*)io_uring_cqe_get_data(cqes[i]);
+				op->cb(*op, cqes[i]->res, cqes[i]->flags);
+			}
+			io_uring_cq_advance(&ring, count);
+		}
+
+		// Submit anything queued by the callbacks
+		submit();
+	}
+
+	/// Mark an op as outstanding, keeps the event loop alive
+	void ref() {
+		if(active++ == 0) {
+			uv_ref((uv_handle_t*)poll);
+		}
+	}
+
+	/// Mark an op as done
+	void unref() {
+		if(--active == 0) {
+			uv_unref((uv_handle_t*)poll);
+		}
+	}
+
+	/// @brief Cancel all ops on the given fd and wait for the kernel to let go of it
+	///
+	/// Queued sqes are submitted first so none of them reach the kernel after the fd is closed.
+	/// Once this returns the fd can be closed right away, the final completions of the cancelled
+	/// ops are still delivered through drain() and release their state there.
+	void cancel_fd(int fd) {
+		submit();
+
+		io_uring_sync_cancel_reg reg = {};
+		reg.fd = fd;
+		reg.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		reg.timeout.tv_sec = -1;
+		reg.timeout.tv_nsec = -1;
+
+		int res = io_uring_register_sync_cancel(&ring, &reg);
+		if(res < 0 && res != -ENOENT) {
+			SPDLOG_ERROR("IoUring: Cancel error: {}", res);
+		}
+	}
+
+	/// Cancel the given op and wait for the kernel to let go of it, other ops on its fd keep running
+	void cancel_op(IoUringOp& op) {
+		submit();
+
+		io_uring_sync_cancel_reg reg = {};
+		reg.addr = (uint64_t)&op;
+		reg.timeout.tv_sec = -1;
+		reg.timeout.tv_nsec = -1;
+
+		int res = io_uring_register_sync_cancel(&ring, &reg);
+		if(res < 0 && res != -ENOENT && res != -EALREADY) {
+			SPDLOG_ERROR("IoUring: Cancel error: {}", res);
+		}
+	}
+};
+
+/// @brief Byte stream (tcp socket, pipe) driven through io_uring
+///
+/// Owns a multishot receive and a write queue with at most one writev in flight,
+/// which preserves ordering and gathers everything queued meanwhile into the next writev.
+/// Delegate is notified through
+/// \li did_recv(IoUringStream&, core::Buffer&&)
+/// \li did_write(IoUringStream&, core::Buffer&&, int status) - once per sent buffer, status is negative if it was dropped
+/// \li did_disconnect(IoUringStream&, int status) - EOF if status is 0
+///
+/// Op state is heap allocated and outlives the stream, so the owner can be destroyed at any time.
+/// Like a lingering close, buffers still queued when the stream stops are written out from a
+/// duplicate of the fd before it is closed, the delegate is no longer notified about them.
+template<typename DelegateType>
+class IoUringStream {
+private:
+	static constexpr size_t max_iovs = 64;
+	/// Time each write may take once the stream has stopped
+	static constexpr int64_t linger_timeout_ms = 5000;
+
+	// Completions of linked timeouts, they can arrive after the state is gone
+	static inline IoUringOp linger_timeout_op = {[](IoUringOp&, int, uint32_t) {}, nullptr};
+
+	struct State {
+		IoUringOp recv_op;
+		IoUringOp write_op;
+		IoUringStream* stream;
+		int fd;
+		/// Set once fd is a duplicate owned by the state for the lingering writes
+		bool owns_fd = false;
+		bool recv_pending = false;
+		bool write_pending = false;
+		__kernel_timespec linger_timeout = {linger_timeout_ms / 1000, (linger_timeout_ms % 1000) * 1000000};
+
+		std::deque<core::Buffer> queue;
+		/// Bytes of the front buffer written by a partial writev
+		size_t front_written = 0;
+		size_t inflight = 0;
+		iovec iovs[max_iovs];
+
+		void maybe_delete() {
+			if(stream == nullptr && !recv_pending && !write_pending) {
+				if(owns_fd) {
+					::close(fd);
+				}
+				delete this;
+			}
+		}
+	};
+
+	State* state = nullptr;
+	bool stopped = false;
+
+	static void arm_recv(State& state) {
+		auto& uring = IoUring::default_instance();
+		auto* sqe = uring.get_sqe();
+		io_uring_prep_recv_multishot(sqe, state.fd, nullptr, 0, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = IoUring::STREAM_BGID;
+		io_uring_sqe_set_data(sqe, &state.recv_op);
+
+		state.recv_pending = true;
+		uring.ref();
+	}
+
+	static void recv_cb(IoUringOp& op, int res, uint32_t flags) {
+		auto& state = *(State*)op.data;
+		auto& uring = IoUring::default_instance();
+
+		// recv_pending stays set until the delegate returns so that
+		// a stop() from inside the callback can not free the state
+		bool more = flags & IORING_CQE_F_MORE;
+		bool has_buf = flags & IORING_CQE_F_BUFFER;
+		uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+		if(state.stream == nullptr || res <= 0) {
+			if(has_buf) {
+				uring.stream_bufs->recycle(bid);
+			}
+		} else {
+			auto bytes = uring.stream_bufs->take(bid, res);
+			state.stream->delegate->did_recv(*state.stream, std::move(bytes));
+		}
+
+		// EOF or error, ENOBUFS just means the buffer ring ran dry
+		if(state.stream != nullptr && res <= 0 && res != -ENOBUFS) {
+			state.stream->delegate->did_disconnect(*state.stream, res);
+		}
+
+		if(more) {
+			return;
+		}
+
+		state.recv_pending = false;
+		uring.unref();
+
+		if(state.stream == nullptr) {
+			state.maybe_delete();
+		} else if(res > 0 || res == -ENOBUFS) {
+			// Multishot terminated, rearm
+			arm_recv(state);
+		}
+	}
+
+	static void flush(State& state) {
+		if(state.write_pending || state.queue.empty()) {
+			return;
+		}
+
+		state.inflight = std::min(state.queue.size(), max_iovs);
+		for(size_t i = 0; i < state.inflight; i++) {
+			state.iovs[i].iov_base = state.queue[i].data();
+			state.iovs[i].iov_len = state.queue[i].size();
+		}
+
+		auto& uring = IoUring::default_instance();
+		bool is_lingering = state.stream == nullptr;
+		uring.reserve(is_lingering ? 2 : 1);
+
+		auto* sqe = uring.get_sqe();
+		io_uring_prep_writev(sqe, state.fd, state.iovs, state.inflight, -1);
+		io_uring_sqe_set_data(sqe, &state.write_op);
+
+		if(is_lingering) {
+			// Nobody is waiting on the stream anymore, do not let a peer that stopped reading hold it open
+			sqe->flags |= IOSQE_IO_LINK;
+			auto* timeout_sqe = uring.get_sqe();
+			io_uring_prep_link_timeout(timeout_sqe, &state.linger_timeout, 0);
+			io_uring_sqe_set_data(timeout_sqe, &linger_timeout_op);
+		}
+
+		state.write_pending = true;
+		uring.ref();
+	}
+
+	// Report every queued buffer as dropped, the queue is detached first so the delegate can stop the stream
+	static void fail_all(State& state, int status) {
+		auto failed = std::move(state.queue);
+		state.queue.clear();
+		if(!failed.empty() && state.front_written > 0) {
+			failed.front().uncover_unsafe(state.front_written);
+		}
+		state.front_written = 0;
+
+		for(auto& bytes : failed) {
+			if(state.stream == nullptr) {
+				break;
+			}
+			state.stream->delegate->did_write(*state.stream, std::move(bytes), status);
+		}
+	}
+
+	static void write_cb(IoUringOp& op, int res, uint32_t) {
+		auto& state = *(State*)op.data;
+
+		if(res < 0) {
+			if(state.stream != nullptr) {
+				SPDLOG_ERROR("IoUringStream: Send callback error: {}", res);
+			} else {
+				SPDLOG_ERROR("IoUringStream: Lingering send error: {}, dropped {} buffers", res, state.queue.size());
+			}
+			// write_pending stays set so that a stop() from the delegate can not free the state
+			fail_all(state, res);
+		}
+
+		// Retire fully written buffers, keep partial ones at the front
+		size_t written = res < 0 ? 0 : res;
+		while(written > 0 && !state.queue.empty()) {
+			auto& front = state.queue.front();
+			if(written < front.size()) {
+				front.cover_unsafe(written);
+				state.front_written += written;
+				break;
+			}
+
+			written -= front.size();
+			auto bytes = std::move(front);
+			state.queue.pop_front();
+			// Restore original bounds for the delegate
+			bytes.uncover_unsafe(state.front_written);
+			state.front_written = 0;
+
+			if(state.stream != nullptr) {
+				state.stream->delegate->did_write(*state.stream, std::move(bytes), 0);
+			}
+		}
+
+		state.write_pending = false;
+		IoUring::default_instance().unref();
+
+		if(res >= 0) {
+			// Also keeps a stopped stream writing until its queue is empty
+			flush(state);
+		}
+		if(state.stream == nullptr) {
+			state.maybe_delete();
+		}
+	}
+
+public:
+	DelegateType* delegate = nullptr;
+
+	IoUringStream() = default;
+	IoUringStream(IoUringStream const&) = delete;
+
+	~IoUringStream() {
+		stop();
+	}
+
+	/// Start receiving on the given fd
+	void start(int fd, DelegateType* delegate) {
+		this->delegate = delegate;
+
+		state = new State();
+		state->recv_op.cb = recv_cb;
+		state->recv_op.data = state;
+		state->write_op.cb = write_cb;
+		state->write_op.data = state;
+		state->stream = this;
+		state->fd = fd;
+
+		arm_recv(*state);
+	}
+
+	/// Queue bytes for writing, flushed with the next writev
+	int send(core::Buffer&& bytes) {
+		if(state == nullptr) {
+			return -1;
+		}
+
+		state->queue.push_back(std::move(bytes));
+		flush(*state);
+
+		return 0;
+	}
+
+	/// @brief Detach from the fd, the owner can close it once this returns
+	///
+	/// The receive is cancelled before this returns. Buffers still queued behind a write in flight
+	/// keep going out through a duplicate of the fd, the state is cleaned up once the last
+	/// completion is drained. Buffers that can not be written anymore are reported through did_write.
+	void stop() {
+		stopped = true;
+		if(state == nullptr) {
+			return;
+		}
+
+		auto& uring = IoUring::default_instance();
+		// Also submits the queued writev, so it reaches the kernel while the fd is still open
+		uring.cancel_op(state->recv_op);
+
+		if(state->write_pending && !state->queue.empty()) {
+			int fd = ::dup(state->fd);
+			if(fd >= 0) {
+				state->fd = fd;
+				state->owns_fd = true;
+			} else {
+				int err = -errno;
+				SPDLOG_ERROR("IoUringStream: Dup error: {}", err);
+				uring.cancel_fd(state->fd);
+				fail_all(*state, err);
+			}
+		} else {
+			// Nothing left to go out, either on a normal close with no write in flight, where
+			// the queue is empty, or after a failed write, which reported its buffers already.
+			// Anything still queued is reported as cancelled
+			fail_all(*state, -ECANCELED);
+		}
+
+		state->stream = nullptr;
+		state->maybe_delete();
+		state = nullptr;
+	}
+
+	/// Whether stop() was called
+	bool is_stopped() const {
+		return stopped;
+	}
+};
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_IO_URING
+
+#endif // MARLIN_ASYNCIO_CORE_IOURING_HPP
@@ -0,0 +1,324 @@
+/*! \file WriteQueue.hpp
+	\brief Per-connection output queue for libuv streams
+
+	Sends made during a loop iteration are gathered and flushed together right before the loop polls for IO:
+	\li first with uv_try_write when nothing is in flight, completing synchronously in the common case
+	\li whatever remains goes out in a single uv_write with one uv_buf_t per queued buffer
+	\li write requests are pooled per connection
+*/
+
+#ifndef MARLIN_ASYNCIO_CORE_WRITEQUEUE_HPP
+#define MARLIN_ASYNCIO_CORE_WRITEQUEUE_HPP
+
+#include <marlin/uvpp/Tcp.hpp>
+
+#include <uv.h>
+
+#include <algorithm>
+#include <vector>
+
+
+namespace marlin {
+namespace asyncio {
+
+//! Flushes every dirty WriteQueue once per loop iteration from a prepare handle
+class WriteScheduler {
+public:
+	struct Entry {
+		void (*flush_fn)(Entry&) = nullptr;
+		bool scheduled = false;
+	};
+
+private:
+	uv_prepare_t* prepare = nullptr;
+	std::vector<Entry*> dirty;
+	std::vector<Entry*> flushing;
+
+	static void prepare_cb(uv_prepare_t* handle) {
+		auto& scheduler = *(WriteScheduler*)handle->data;
+		scheduler.flush_all();
+	}
+
+	WriteScheduler() {
+		prepare = new uv_prepare_t();
+		prepare->data = this;
+		uv_prepare_init(uv_default_loop(), prepare);
+	}
+
+public:
+	static WriteScheduler& default_instance() {
+		static WriteScheduler scheduler;
+		return scheduler;
+	}
+
+	WriteScheduler(WriteScheduler const&) = delete;
+
+	void schedule(Entry& entry) {
+		if(entry.scheduled) {
+			return;
+		}
+
+		entry.scheduled = true;
+		if(dirty.empty()) {
+			uv_prepare_start(prepare, prepare_cb);
+		}
+		dirty.push_back(&entry);
+	}
+
+	void unschedule(Entry& entry) {
+		if(!entry.scheduled) {
+			return;
+		}
+
+		entry.scheduled = false;
+		std::replace(dirty.begin(), dirty.end(), &entry, (Entry*)nullptr);
+		std::replace(flushing.begin(), flushing.end(), &entry, (Entry*)nullptr);
+	}
+
+	void flush_all() {
+		// Completions can queue more sends, keep going until nothing is dirty
+		// so the loop never blocks in poll with unsent data
+		while(!dirty.empty()) {
+			std::swap(dirty, flushing);
+			for(size_t i = 0; i < flushing.size(); i++) {
+				auto* entry = flushing[i];
+				if(entry == nullptr) {
+					continue;
+				}
+
+				entry->scheduled = false;
+				entry->flush_fn(*entry);
+			}
+			flushing.clear();
+		}
+
+		uv_prepare_stop(prepare);
+	}
+};
+
+//! Gathers buffers sent on a stream and writes them out in batches
+/*!
+	DelegateType must implement `did_write(WriteQueue&, BufferType&&, int status)`,
+	called exactly once per buffer accepted by send. Once closed, the queue refuses further
+	sends. Writes still in flight when the queue is destroyed complete silently. The queue can
+	be destroyed from inside did_write, the rest of that batch is then dropped.
+*/
+template<typename BufferType, typename DelegateType>
+class WriteQueue : private WriteScheduler::Entry {
+private:
+	struct Batch {
+		std::vector<BufferType> bufs;
+		WriteQueue* queue = nullptr;
+	};
+	using WriteReqType = uvpp::WriteReq<Batch>;
+
+	static constexpr size_t max_pooled_reqs = 4;
+
+	uv_stream_t* stream = nullptr;
+	DelegateType* delegate = nullptr;
+
+	std::vector<BufferType> pending;
+	std::vector<uv_buf_t> uv_bufs;
+	std::vector<WriteReqType*> free_reqs;
+	std::vector<WriteReqType*> inflight_reqs;
+	/// Points to a flag of the innermost notify in progress, cleared if the queue is destroyed
+	bool* alive = nullptr;
+	bool closed = false;
+
+	static void flush_entry(WriteScheduler::Entry& entry) {
+		static_cast<WriteQueue&>(entry).flush();
+	}
+
+	static void write_cb(uv_write_t* req, int status) {
+		auto* write_req = (WriteReqType*)req;
+		if(write_req->extra_data.queue == nullptr) {
+			// Queue destroyed with the write in flight
+			delete write_req;
+			return;
+		}
+
+		auto& queue = *write_req->extra_data.queue;
+		auto iter = std::find(queue.inflight_reqs.begin(), queue.inflight_reqs.end(), write_req);
+		*iter = queue.inflight_reqs.back();
+		queue.inflight_reqs.pop_back();
+
+		auto bufs = std::move(write_req->extra_data.bufs);
+		write_req->extra_data.bufs.clear();
+		// Before notifying, the delegate might destroy the queue
+		queue.release_req(write_req);
+
+		queue.notify(bufs, status);
+	}
+
+	/// Hand finished buffers to the delegate, returns false if a callback destroyed the queue
+	bool notify(std::vector<BufferType>& bufs, int status) {
+		bool is_alive = true;
+		auto* outer = alive;
+		alive = &is_alive;
+
+		for(auto& bytes : bufs) {
+			delegate->did_write(*this, std::move(bytes), status);
+			if(!is_alive) {
+				// Let enclosing notifies know as well
+				if(outer != nullptr) {
+					*outer = false;
+				}
+				return false;
+			}
+		}
+
+		alive = outer;
+		return true;
+	}
+
+	WriteReqType* acquire_req() {
+		if(free_reqs.empty()) {
+			auto* req = new WriteReqType();
+			req->extra_data.queue = this;
+			return req;
+		}
+
+		auto* req = free_reqs.back();
+		free_reqs.pop_back();
+		return req;
+	}
+
+	void release_req(WriteReqType* req) {
+		if(free_reqs.size() < max_pooled_reqs) {
+			free_reqs.push_back(req);
+		} else {
+			delete req;
+		}
+	}
+
+	void fail_all(int status) {
+		auto failed = std::move(pending);
+		pending.clear();
+		notify(failed, status);
+	}
+
+public:
+	WriteQueue() {
+		flush_fn = flush_entry;
+	}
+
+	WriteQueue(WriteQueue const&) = delete;
+
+	~WriteQueue() {
+		if(alive != nullptr) {
+			*alive = false;
+		}
+		WriteScheduler::default_instance().unschedule(*this);
+		for(auto* req : free_reqs) {
+			delete req;
+		}
+		for(auto* req : inflight_reqs) {
+			req->extra_data.queue = nullptr;
+		}
+	}
+
+	void setup(uv_stream_t* stream, DelegateType* delegate) {
+		this->stream = stream;
+		this->delegate = delegate;
+	}
+
+	/// Queue bytes for writing at the end of the current loop iteration, fails with UV_EPIPE once closed
+	int send(BufferType&& bytes) {
+		if(closed) {
+			return UV_EPIPE;
+		}
+
+		pending.push_back(std::move(bytes));
+		WriteScheduler::default_instance().schedule(*this);
+		return 0;
+	}
+
+	/// Write out queued buffers right away and refuse further sends, used before closing the stream
+	void close() {
+		closed = true;
+		WriteScheduler::default_instance().unschedule(*this);
+		flush();
+	}
+
+	bool is_closed() const {
+		return closed;
+	}
+
+	/// Write out all queued buffers now
+	void flush() {
+		if(pending.empty()) {
+			return;
+		}
+
+		auto count = pending.size();
+		uv_bufs.resize(count);
+		for(size_t i = 0; i < count; i++) {
+			uv_bufs[i] = uv_buf_init((char*)pending[i].data(), pending[i].size());
+		}
+
+		std::vector<BufferType> completed;
+		size_t done = 0;
+		if(inflight_reqs.empty()) {
+			// Fast path, avoids a request and a callback round trip when the socket has room
+			int res = uv_try_write(stream, uv_bufs.data(), count);
+			if(res >= 0) {
+				size_t written = res;
+				while(done < count && written >= uv_bufs[done].len) {
+					written -= uv_bufs[done].len;
+					done++;
+				}
+				if(done < count) {
+					uv_bufs[done].base += written;
+					uv_bufs[done].len -= written;
+				}
+			} else if(res != UV_EAGAIN && res != UV_ENOSYS) {
+				fail_all(res);
+				return;
+			}
+		}
+
+		for(size_t i = 0; i < done; i++) {
+			completed.push_back(std::move(pending[i]));
+		}
+
+		if(done < count) {
+			auto* req = acquire_req();
+			req->extra_data.bufs.reserve(count - done);
+			for(size_t i = done; i < count; i++) {
+				req->extra_data.bufs.push_back(std::move(pending[i]));
+			}
+			pending.clear();
+
+			int res = uv_write(
+				req,
+				stream,
+				uv_bufs.data() + done,
+				count - done,
+				write_cb
+			);
+
+			if(res < 0) {
+				auto failed = std::move(req->extra_data.bufs);
+				req->extra_data.bufs.clear();
+				release_req(req);
+
+				if(notify(completed, 0)) {
+					notify(failed, res);
+				}
+				return;
+			}
+
+			inflight_reqs.push_back(req);
+		} else {
+			pending.clear();
+		}
+
+		// Delegate might queue more, pending is already empty at this point
+		notify(completed, 0);
+	}
+};
+
+}  // namespace asyncio
+}  // namespace marlin
+
+#endif  // MARLIN_ASYNCIO_CORE_WRITEQUEUE_HPP
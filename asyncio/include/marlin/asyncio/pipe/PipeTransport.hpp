@@ -3,7 +3,10 @@
 
 #include <uv.h>
 #include <marlin/core/Buffer.hpp>
+#include <marlin/core/BufferPool.hpp>
 #include "marlin/asyncio/core/Timer.hpp"
+#include "marlin/asyncio/core/IoUring.hpp"
+#include "marlin/asyncio/core/WriteQueue.hpp"
 #include <spdlog/spdlog.h>
 
 namespace marlin {
@@ -23,6 +26,12 @@ private:
 	);
 
 	static void connect_cb(uv_connect_t* req, int status);
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	IoUringStream<SelfType> stream;
+#else
+	WriteQueue<core::Buffer, SelfType> write_queue;
+#endif
 public:
 	DelegateType* delegate;
 
@@ -33,6 +42,15 @@ public:
 	void connect(std::string path);
 	void send(core::WeakBuffer bytes);
 	void close();
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	// IoUringStream delegate
+	void did_recv(IoUringStream<SelfType>& stream, core::Buffer&& bytes);
+	void did_disconnect(IoUringStream<SelfType>& stream, int reason);
+#endif
+	// WriteQueue or IoUringStream delegate
+	template<typename QueueType>
+	void did_write(QueueType& queue, core::Buffer&& bytes, int status);
 };
 
 }  // namespace asyncio
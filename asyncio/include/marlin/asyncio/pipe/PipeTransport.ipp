@@ -15,10 +15,16 @@ template<PIPETRANSPORT_TEMPLATE>
 PIPETRANSPORT::PipeTransport() {
 	pipe = new uv_pipe_t();
 	pipe->data = this;
+#ifndef MARLIN_ASYNCIO_IO_URING
+	write_queue.setup((uv_stream_t*)pipe, this);
+#endif
 }
 
 template<PIPETRANSPORT_TEMPLATE>
 PIPETRANSPORT::~PipeTransport() {
+#ifdef MARLIN_ASYNCIO_IO_URING
+	stream.stop();
+#endif
 	uv_close((uv_handle_t*)pipe, [](uv_handle_t* handle) {
 		delete handle;
 	});
@@ -35,7 +41,7 @@ void PIPETRANSPORT::recv_cb(
 	// EOF
 	if(nread == -4095) {
 		transport->delegate->did_disconnect(*transport, 0);
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
@@ -47,18 +53,18 @@ void PIPETRANSPORT::recv_cb(
 		);
 
 		transport->close();
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
 	if(nread == 0) {
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
 	transport->delegate->did_recv(
 		*transport,
-		core::Buffer((uint8_t*)buf->base, nread)
+		core::BufferPool::default_instance().adopt((uint8_t*)buf->base, nread)
 	);
 }
 
@@ -73,18 +79,26 @@ void PIPETRANSPORT::connect_cb(uv_connect_t* req, int status) {
 		return;
 	}
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+	int fd;
+	auto res = uv_fileno((uv_handle_t*)transport->pipe, &fd);
+	if (res == 0) {
+		transport->stream.start(fd, transport);
+	}
+#else
 	auto res = uv_read_start(
 		(uv_stream_t*)transport->pipe,
 		[](
 			uv_handle_t*,
-			size_t suggested_size,
+			size_t,
 			uv_buf_t* buf
 		) {
-			buf->base = new char[suggested_size];
-			buf->len = suggested_size;
+			buf->base = (char*)core::BufferPool::default_instance().acquire_raw();
+			buf->len = core::BufferPool::default_instance().get_block_size();
 		},
 		recv_cb
 	);
+#endif
 
 	if (res < 0) {
 		SPDLOG_ERROR(
@@ -113,25 +127,16 @@ void PIPETRANSPORT::connect(std::string path) {
 
 template<PIPETRANSPORT_TEMPLATE>
 void PIPETRANSPORT::send(core::WeakBuffer bytes) {
-	auto* req = new uv_write_t();
-	req->data = this;
+	// Callers pass short lived buffers, take a copy that lives until the write completes
+	core::Buffer owned(bytes.size());
+	owned.write_unsafe(0, bytes.data(), bytes.size());
 
-	auto buf = uv_buf_init((char*)bytes.data(), bytes.size());
-	int res = uv_write(
-		req,
-		(uv_stream_t*)pipe,
-		&buf,
-		1,
-		[](uv_write_t *req, int status) {
-			delete req;
-			if(status < 0) {
-				SPDLOG_ERROR(
-					"Abci: Send callback error: {}",
-					status
-				);
-			}
-		}
-	);
+#ifdef MARLIN_ASYNCIO_IO_URING
+	int res = stream.send(std::move(owned));
+#else
+	// Coalesced with other sends from this loop iteration
+	int res = write_queue.send(std::move(owned));
+#endif
 
 	if (res < 0) {
 		SPDLOG_ERROR(
@@ -144,12 +149,63 @@ void PIPETRANSPORT::send(core::WeakBuffer bytes) {
 
 template<PIPETRANSPORT_TEMPLATE>
 void PIPETRANSPORT::close() {
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(stream.is_stopped()) {
+		// Already closing, e.g. called again from a failed write below
+		return;
+	}
+	// Cancels the receive before libuv closes the fd, queued sends linger on a duplicate of it
+	stream.stop();
+#else
+	if(write_queue.is_closed()) {
+		// Already closing, e.g. called again from a failed write below
+		return;
+	}
+	// Sends queued earlier in this loop iteration go out before the pipe closes
+	write_queue.close();
+#endif
 	uv_close((uv_handle_t*)pipe, [](uv_handle_t* handle) {
 		delete handle;
 	});
 	delegate->did_close(*this);
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+
+template<PIPETRANSPORT_TEMPLATE>
+void PIPETRANSPORT::did_recv(IoUringStream<SelfType>&, core::Buffer&& bytes) {
+	delegate->did_recv(*this, std::move(bytes));
+}
+
+template<PIPETRANSPORT_TEMPLATE>
+void PIPETRANSPORT::did_disconnect(IoUringStream<SelfType>&, int reason) {
+	if(reason < 0) {
+		SPDLOG_ERROR(
+			"PipeTransport: Recv callback error: {}",
+			reason
+		);
+
+		this->close();
+		return;
+	}
+
+	delegate->did_disconnect(*this, 0);
+}
+
+#endif
+
+template<PIPETRANSPORT_TEMPLATE>
+template<typename QueueType>
+void PIPETRANSPORT::did_write(QueueType&, core::Buffer&&, int status) {
+	if(status < 0) {
+		SPDLOG_ERROR(
+			"Abci: Send callback error: {}",
+			status
+		);
+		this->close();
+	}
+}
+
 //---------------- Helper macros undef begin ----------------//
 
 #undef PIPETRANSPORT_TEMPLATE
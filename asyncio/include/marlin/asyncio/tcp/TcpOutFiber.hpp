@@ -2,11 +2,13 @@
 #define MARLIN_ASYNCIO_TCP_TCPOUTFIBER_HPP
 
 #include <marlin/core/Buffer.hpp>
+#include <marlin/core/BufferPool.hpp>
 #include <marlin/core/fibers/FiberScaffold.hpp>
 #include <marlin/core/fabric/Fabric.hpp>
 #include <marlin/core/fibers/VersioningFiber.hpp>
 
 #include <marlin/uvpp/Tcp.hpp>
+#include <marlin/asyncio/core/WriteQueue.hpp>
 
 #include <uv.h>
 #include <spdlog/spdlog.h>
@@ -37,12 +39,14 @@ public:
 private:
 	uv_tcp_t* tcp_handle = nullptr;
 	core::SocketAddress dst;
+	WriteQueue<InnerMessageType, SelfType> write_queue;
 
 public:
 	TcpOutFiber(auto&&... args) :
 		FiberScaffoldType(std::forward<decltype(args)>(args)...) {
 		tcp_handle = new uv_tcp_t();
 		tcp_handle->data = this;
+		write_queue.setup((uv_stream_t*)tcp_handle, this);
 
 		uv_tcp_init(uv_default_loop(), tcp_handle);
 	}
@@ -60,7 +64,7 @@ public:
 		// EOF
 		if(nread == -4095) {
 			fiber.close();
-			delete[] buf->base;
+			core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 			return;
 		}
 
@@ -72,18 +76,18 @@ public:
 			);
 
 			fiber.close();
-			delete[] buf->base;
+			core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 			return;
 		}
 
 		if(nread == 0) {
-			delete[] buf->base;
+			core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 			return;
 		}
 
 		fiber.did_recv(
 			fiber,
-			core::Buffer((uint8_t*)buf->base, nread),
+			core::BufferPool::default_instance().adopt((uint8_t*)buf->base, nread),
 			fiber.dst
 		);
 	}
@@ -102,11 +106,11 @@ public:
 			(uv_stream_t*)fiber.tcp_handle,
 			[](
 				uv_handle_t*,
-				size_t suggested_size,
+				size_t,
 				uv_buf_t* buf
 			) {
-				buf->base = new char[suggested_size];
-				buf->len = suggested_size;
+				buf->base = (char*)core::BufferPool::default_instance().acquire_raw();
+				buf->len = core::BufferPool::default_instance().get_block_size();
 			},
 			recv_cb
 		);
@@ -142,40 +146,42 @@ public:
 	}
 
 	[[nodiscard]] int send(auto&&, InnerMessageType&& bytes) {
-		using WriteReqType = uvpp::WriteReq<InnerMessageType>;
-
-		auto* req = new WriteReqType(std::move(bytes));
-		req->data = this;
-
-		auto buf = uv_buf_init((char*)req->extra_data.data(), req->extra_data.size());
-		int res = uv_write(
-			req,
-			(uv_stream_t*)tcp_handle,
-			&buf,
-			1,
-			[](uv_write_t* req, int status) {
-				delete (WriteReqType*)req;
-				if(status < 0) {
-					SPDLOG_ERROR(
-						"Abci: Send callback error: {}",
-						status
-					);
-				}
-			}
-		);
+		// Coalesced with other sends from this loop iteration
+		int res = write_queue.send(std::move(bytes));
 
 		if (res < 0) {
 			SPDLOG_ERROR(
-				"Abci: Send error: {}",
+				"TcpOutFiber: Send error: {}",
 				res
 			);
 			this->close();
+			return res;
 		}
 
 		return 0;
 	}
 
+	void did_write(
+		WriteQueue<InnerMessageType, SelfType>&,
+		InnerMessageType&&,
+		int status
+	) {
+		if(status < 0) {
+			SPDLOG_ERROR(
+				"TcpOutFiber: Send callback error: {}",
+				status
+			);
+			this->close();
+		}
+	}
+
 	void close() {
+		if(write_queue.is_closed()) {
+			// Already closing, e.g. called again from a failed write below
+			return;
+		}
+		// Sends queued earlier in this loop iteration go out before the socket closes
+		write_queue.close();
 		uv_close((uv_handle_t*)tcp_handle, [](uv_handle_t* handle) {
 			auto& fiber = *(SelfType*)handle->data;
 			fiber.did_close(fiber);
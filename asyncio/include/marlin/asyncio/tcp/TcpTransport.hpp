@@ -7,8 +7,11 @@
 #define MARLIN_ASYNCIO_TCPTRANSPORT_HPP
 
 #include <marlin/core/SocketAddress.hpp>
-#include <marlin/core/CidrBlock.hpp>
+#include <marlin/core/BufferPool.hpp>
+#include <marlin/core/AddressClassifier.hpp>
 #include <marlin/core/TransportManager.hpp>
+#include <marlin/asyncio/core/IoUring.hpp>
+#include <marlin/asyncio/core/WriteQueue.hpp>
 #include <uv.h>
 #include <spdlog/spdlog.h>
 
@@ -34,17 +37,13 @@ private:
 		uv_buf_t const *buf
 	);
 
-	static void send_cb(
-		uv_write_t *req,
-		int status
-	);
-
 	static void close_cb(uv_handle_t *handle);
 
-	struct SendPayload {
-		core::Buffer bytes;
-		TcpTransport<DelegateType> &transport;
-	};
+#ifdef MARLIN_ASYNCIO_IO_URING
+	IoUringStream<TcpTransport<DelegateType>> stream;
+#else
+	WriteQueue<core::Buffer, TcpTransport<DelegateType>> write_queue;
+#endif
 public:
 	core::SocketAddress src_addr;
 	core::SocketAddress dst_addr;
@@ -69,6 +68,19 @@ public:
 	void close(uint16_t reason = 0);
 
 	bool is_internal();
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	// IoUringStream delegate
+	void did_recv(IoUringStream<TcpTransport<DelegateType>> &stream, core::Buffer &&bytes);
+	void did_disconnect(IoUringStream<TcpTransport<DelegateType>> &stream, int reason);
+#endif
+	// WriteQueue or IoUringStream delegate
+	template<typename QueueType>
+	void did_write(
+		QueueType &queue,
+		core::Buffer &&bytes,
+		int status
+	);
 };
 
 
@@ -82,12 +94,10 @@ TcpTransport<DelegateType>::TcpTransport(
 	core::TransportManager<TcpTransport<DelegateType>> &transport_manager
 ) : socket(socket), transport_manager(transport_manager),
 	src_addr(src_addr), dst_addr(dst_addr) {
-	if(
-		core::CidrBlock::from_string("10.0.0.0/8").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("172.16.0.0/12").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("192.168.0.0/16").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("127.0.0.0/8").does_contain_address(dst_addr)
-	) {
+#ifndef MARLIN_ASYNCIO_IO_URING
+	write_queue.setup((uv_stream_t *)socket, this);
+#endif
+	if(core::AddressClassifier::default_instance().classify(dst_addr) == core::AddressClass::Internal) {
 		internal = true;
 	}
 }
@@ -95,11 +105,11 @@ TcpTransport<DelegateType>::TcpTransport(
 template<typename DelegateType>
 void TcpTransport<DelegateType>::naive_alloc_cb(
 	uv_handle_t *,
-	size_t suggested_size,
+	size_t,
 	uv_buf_t *buf
 ) {
-	buf->base = new char[suggested_size];
-	buf->len = suggested_size;
+	buf->base = (char*)core::BufferPool::default_instance().acquire_raw();
+	buf->len = core::BufferPool::default_instance().get_block_size();
 }
 
 //! callback function on receipt of any message on this TCP connection instance
@@ -114,7 +124,7 @@ void TcpTransport<DelegateType>::recv_cb(
 	// EOF
 	if(nread == -4095) {
 		transport->close();
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
@@ -131,17 +141,17 @@ void TcpTransport<DelegateType>::recv_cb(
 			nread
 		);
 
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
 	if(nread == 0) {
-		delete[] buf->base;
+		core::BufferPool::default_instance().release_raw((uint8_t*)buf->base);
 		return;
 	}
 
 	transport->did_recv(
-		core::Buffer((uint8_t*)buf->base, nread)
+		core::BufferPool::default_instance().adopt((uint8_t*)buf->base, nread)
 	);
 }
 
@@ -154,7 +164,15 @@ void TcpTransport<DelegateType>::setup(DelegateType *delegate) {
 	this->delegate = delegate;
 
 	socket->data = this;
+#ifdef MARLIN_ASYNCIO_IO_URING
+	int fd;
+	auto res = uv_fileno((uv_handle_t *)socket, &fd);
+	if (res == 0) {
+		stream.start(fd, this);
+	}
+#else
 	auto res = uv_read_start((uv_stream_t *)socket, naive_alloc_cb, recv_cb);
+#endif
 
 	if (res < 0) {
 		SPDLOG_ERROR(
@@ -171,28 +189,55 @@ void TcpTransport<DelegateType>::did_recv(core::Buffer &&bytes) {
 	delegate->did_recv(*this, std::move(bytes));
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+
 template<typename DelegateType>
-void TcpTransport<DelegateType>::send_cb(
-	uv_write_t *req,
-	int status
+void TcpTransport<DelegateType>::did_recv(
+	IoUringStream<TcpTransport<DelegateType>> &,
+	core::Buffer &&bytes
 ) {
-	auto *data = (SendPayload *)req->data;
+	did_recv(std::move(bytes));
+}
+
+//! EOF or socket error on the ring, mirrors the EOF handling in recv_cb
+template<typename DelegateType>
+void TcpTransport<DelegateType>::did_disconnect(
+	IoUringStream<TcpTransport<DelegateType>> &,
+	int reason
+) {
+	if(reason < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Stream error: {}",
+			dst_addr.to_string(),
+			reason
+		);
+	}
+	close();
+}
+
+#endif
 
+template<typename DelegateType>
+template<typename QueueType>
+void TcpTransport<DelegateType>::did_write(
+	QueueType &,
+	core::Buffer &&bytes,
+	int status
+) {
 	if(status < 0) {
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Send callback error: {}",
-			data->transport.dst_addr.to_string(),
+			dst_addr.to_string(),
 			status
 		);
+		// Stream is unusable after a failed write, let the delegate see it through did_close
+		close();
 	} else {
-		data->transport.delegate->did_send(
-			data->transport,
-			std::move(data->bytes)
+		delegate->did_send(
+			*this,
+			std::move(bytes)
 		);
 	}
-
-	delete data;
-	delete req;
 }
 
 template<typename DelegateType>
@@ -210,18 +255,11 @@ void TcpTransport<DelegateType>::close_cb(uv_handle_t *handle) {
 */
 template<typename DelegateType>
 int TcpTransport<DelegateType>::send(core::Buffer &&bytes) {
-	auto *req = new uv_write_t();
-	auto req_data = new SendPayload { std::move(bytes), *this };
-	req->data = req_data;
-
-	auto buf = uv_buf_init((char*)req_data->bytes.data(), req_data->bytes.size());
-	int res = uv_write(
-		req,
-		(uv_stream_t *)socket,
-		&buf,
-		1,
-		send_cb
-	);
+#ifdef MARLIN_ASYNCIO_IO_URING
+	return stream.send(std::move(bytes));
+#else
+	// Coalesced with other sends from this loop iteration
+	int res = write_queue.send(std::move(bytes));
 
 	if (res < 0) {
 		SPDLOG_ERROR(
@@ -233,12 +271,29 @@ int TcpTransport<DelegateType>::send(core::Buffer &&bytes) {
 		return res;
 	}
 	return 0;
+#endif
 }
 
 //! closes the underlying tcp socket. calls the close callback which erases self entry from the transport manager, which in turn destroys this instance
 template<typename DelegateType>
 void TcpTransport<DelegateType>::close(uint16_t reason) {
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(stream.is_stopped()) {
+		// Already closing, e.g. called again from a failed write below
+		return;
+	}
+	close_reason = reason;
+	// Cancels the receive before libuv closes the fd, queued sends linger on a duplicate of it
+	stream.stop();
+#else
+	if(write_queue.is_closed()) {
+		// Already closing, e.g. called again from a failed write below
+		return;
+	}
 	close_reason = reason;
+	// Sends queued earlier in this loop iteration go out before the socket closes
+	write_queue.close();
+#endif
 	uv_close((uv_handle_t *)socket, close_cb);
 }
 
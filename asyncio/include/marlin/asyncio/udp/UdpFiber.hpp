@@ -7,6 +7,14 @@
 
 #include <spdlog/spdlog.h>
 
+#include <cstring>
+#include <span>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
 namespace marlin {
 namespace asyncio {
 
@@ -32,6 +40,22 @@ public:
 private:
 	uvpp::UdpE* udp_handle = nullptr;
 
+	// Datagrams are copied out of the recv block before the callback returns,
+	// so one block serves every read
+	static constexpr size_t recv_block_size = 16 * 65536;
+	char* recv_block = nullptr;
+	std::vector<core::BatchEntry<core::Buffer>> recv_batch;
+
+	// Delivers everything read by one recvmmsg call in a single batch
+	void flush_recv_batch() {
+		if(recv_batch.empty()) {
+			return;
+		}
+
+		this->did_recv_batch(*this, std::span(recv_batch));
+		recv_batch.clear();
+	}
+
 public:
 	UdpFiber(auto&&... args) :
 		FiberScaffoldType(std::forward<decltype(args)>(args)...) {
@@ -42,8 +66,17 @@ public:
 	UdpFiber(UdpFiber const&) = delete;
 	UdpFiber(UdpFiber&&) = delete;
 
+	~UdpFiber() {
+		delete[] recv_block;
+	}
+
 	[[nodiscard]] int bind(core::SocketAddress const& addr) {
+#if UV_VERSION_HEX >= 0x012800
+		// Let libuv read up to 16 datagrams per syscall with recvmmsg
+		int res = uv_udp_init_ex(uv_default_loop(), udp_handle, AF_UNSPEC | UV_UDP_RECVMMSG);
+#else
 		int res = uv_udp_init(uv_default_loop(), udp_handle);
+#endif
 		if (res < 0) {
 			SPDLOG_ERROR(
 				"Asyncio: Socket {}: Init error: {}",
@@ -70,13 +103,18 @@ public:
 		return 0;
 	}
 
-	static void naive_alloc_cb(
-		uv_handle_t*,
-		size_t suggested_size,
+	static void alloc_cb(
+		uv_handle_t* handle,
+		size_t,
 		uv_buf_t* buf
 	) {
-		buf->base = new char[suggested_size];
-		buf->len = suggested_size;
+		auto& fiber = *(SelfType*)(handle->data);
+		if(fiber.recv_block == nullptr) {
+			fiber.recv_block = new char[recv_block_size];
+		}
+
+		buf->base = fiber.recv_block;
+		buf->len = recv_block_size;
 	}
 
 	static void recv_cb(
@@ -84,8 +122,10 @@ public:
 		ssize_t nread,
 		uv_buf_t const* buf,
 		sockaddr const* _addr,
-		unsigned
+		unsigned flags
 	) {
+		auto& fiber = *(SelfType*)(handle->data);
+
 		// Error
 		if(nread < 0) {
 			sockaddr saddr;
@@ -99,29 +139,43 @@ public:
 				nread
 			);
 
-			delete[] buf->base;
+			fiber.flush_recv_batch();
 			return;
 		}
 
-		if(nread == 0) {
-			delete[] buf->base;
+		// Nothing more to read, also marks the end of a recvmmsg batch
+		if(_addr == nullptr) {
+			fiber.flush_recv_batch();
 			return;
 		}
 
-		auto& addr = *reinterpret_cast<core::SocketAddress const*>(_addr);
-		auto& fiber = *(SelfType*)(handle->data);
+		if(nread == 0) {
+			return;
+		}
 
-		fiber.did_recv(
-			fiber,
-			core::Buffer((uint8_t*)buf->base, nread),
-			addr
-		);
+		// A right-sized copy, a slow consumer can not pin the whole block
+		core::Buffer bytes(nread);
+		std::memcpy(bytes.data(), buf->base, nread);
+		fiber.recv_batch.push_back({
+			std::move(bytes),
+			*reinterpret_cast<core::SocketAddress const*>(_addr)
+		});
+
+#if UV_VERSION_HEX >= 0x012800
+		// More datagrams of the same recvmmsg batch follow
+		if(flags & UV_UDP_MMSG_CHUNK) {
+			return;
+		}
+#else
+		(void)flags;
+#endif
+		fiber.flush_recv_batch();
 	}
 
 	[[nodiscard]] int listen() {
 		int res = uv_udp_recv_start(
 			udp_handle,
-			naive_alloc_cb,
+			alloc_cb,
 			recv_cb
 		);
 		if (res < 0) {
@@ -201,6 +255,61 @@ public:
 
 		return 0;
 	}
+
+	/// Send a batch of datagrams, with a single sendmmsg call per 64 datagrams where available
+	[[nodiscard]] int send_batch(auto&& src, std::span<core::BatchEntry<core::Buffer>> batch) {
+		size_t done = 0;
+
+#ifdef __linux__
+		uv_os_fd_t fd;
+		// Bypassing libuv is only safe when it has nothing queued, datagrams would get reordered otherwise
+		if(udp_handle->send_queue_count == 0 && uv_fileno((uv_handle_t*)udp_handle, &fd) == 0) {
+			constexpr size_t max_msgs = 64;
+			mmsghdr msgs[max_msgs];
+			iovec iovs[max_msgs];
+
+			while(done < batch.size()) {
+				size_t count = std::min(max_msgs, batch.size() - done);
+				for(size_t i = 0; i < count; i++) {
+					auto& entry = batch[done + i];
+					iovs[i].iov_base = entry.msg.data();
+					iovs[i].iov_len = entry.msg.size();
+
+					std::memset(&msgs[i], 0, sizeof(mmsghdr));
+					msgs[i].msg_hdr.msg_name = (void*)&entry.addr;
+					msgs[i].msg_hdr.msg_namelen = entry.addr.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+					msgs[i].msg_hdr.msg_iov = &iovs[i];
+					msgs[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				int res = sendmmsg(fd, msgs, count, MSG_DONTWAIT);
+				if(res <= 0) {
+					// Let libuv queue the rest and report errors
+					break;
+				}
+
+				done += res;
+				if((size_t)res < count) {
+					break;
+				}
+			}
+		}
+#endif
+
+		int ret = 0;
+		for(size_t i = done; i < batch.size(); i++) {
+			auto res = send(src, std::move(batch[i].msg), batch[i].addr);
+			if(res < 0 && ret == 0) {
+				ret = res;
+			}
+		}
+
+		for(size_t i = 0; i < done; i++) {
+			this->did_send(*this, std::move(batch[i].msg));
+		}
+
+		return ret;
+	}
 };
 
 }  // namespace asyncio
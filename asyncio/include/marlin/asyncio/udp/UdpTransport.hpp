@@ -9,11 +9,13 @@
 #ifndef MARLIN_ASYNCIO_UDPTRANSPORT_HPP
 #define MARLIN_ASYNCIO_UDPTRANSPORT_HPP
 
-#include <marlin/core/CidrBlock.hpp>
+#include <marlin/core/AddressClassifier.hpp>
 #include <marlin/core/transports/TransportScaffold.hpp>
+#include <marlin/asyncio/core/IoUring.hpp>
 #include <uv.h>
 #include <spdlog/spdlog.h>
 
+#include <cerrno>
 #include <list>
 
 namespace marlin {
@@ -39,9 +41,30 @@ private:
 	struct SendPayload {
 		core::Buffer packet;
 		UdpTransport<DelegateType> *transport;
+		// Spliced into packet by gather sends, empty otherwise
+		core::Buffer payload = core::Buffer(nullptr, 0);
 	};
 
 	std::list<uv_udp_send_t *> pending_req;
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	struct UringSendPayload {
+		IoUringOp op;
+		msghdr msg;
+		iovec iov[3];
+		core::SocketAddress dst;
+		core::Buffer packet;
+		UdpTransport<DelegateType> *transport;
+		core::Buffer payload = core::Buffer(nullptr, 0);
+		// Entry in pending_uring_req, sends can complete out of order
+		typename std::list<UringSendPayload *>::iterator it;
+	};
+
+	static void uring_send_cb(IoUringOp &op, int res, uint32_t flags);
+
+	std::list<UringSendPayload *> pending_uring_req;
+	int fd = -1;
+#endif
 public:
 	using MessageType = typename TransportScaffoldType::MessageType;
 	static_assert(std::is_same_v<MessageType, core::BaseMessage>);
@@ -64,6 +87,10 @@ public:
 	bool is_internal();
 
 	int send(core::Buffer &&packet);
+	/// Send packet with payload inserted at offset, gathered by the kernel without copying payload
+	int send(core::Buffer &&packet, core::Buffer &&payload, size_t offset);
+	/// Send a single datagram which must not be fragmented, used for path MTU probes
+	int send_dont_fragment(MessageType &&packet);
 };
 
 
@@ -76,12 +103,7 @@ UdpTransport<DelegateType>::UdpTransport(
 	uv_udp_t *socket,
 	core::TransportManager<UdpTransport<DelegateType>> &transport_manager
 ) : TransportScaffoldType(src_addr, dst_addr, socket, transport_manager) {
-	if(
-		core::CidrBlock::from_string("10.0.0.0/8").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("172.16.0.0/12").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("192.168.0.0/16").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("127.0.0.0/8").does_contain_address(dst_addr)
-	) {
+	if(core::AddressClassifier::default_instance().classify(dst_addr) == core::AddressClass::Internal) {
 		internal = true;
 	}
 }
@@ -110,7 +132,13 @@ void UdpTransport<DelegateType>::send_cb(
 	}
 	data->transport->pending_req.pop_front();
 
-	if(status < 0) {
+	if(status == UV_EMSGSIZE) {
+		// Expected from path MTU probes larger than the interface allows
+		SPDLOG_DEBUG(
+			"Asyncio: Socket {}: Send callback error: Message too long",
+			data->transport->dst_addr.to_string()
+		);
+	} else if(status < 0) {
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Send callback error: {}",
 			data->transport->dst_addr.to_string(),
@@ -127,6 +155,106 @@ void UdpTransport<DelegateType>::send_cb(
 	delete req;
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+
+template<typename DelegateType>
+void UdpTransport<DelegateType>::uring_send_cb(
+	IoUringOp &op,
+	int res,
+	uint32_t
+) {
+	auto *data = (UringSendPayload *)op.data;
+	IoUring::default_instance().unref();
+
+	if(data->transport == nullptr) {
+		delete data;
+		return;
+	}
+	data->transport->pending_uring_req.erase(data->it);
+
+	if(res == -EMSGSIZE) {
+		// Expected from path MTU probes larger than the interface allows
+		SPDLOG_DEBUG(
+			"Asyncio: Socket {}: Send callback error: Message too long",
+			data->transport->dst_addr.to_string()
+		);
+	} else if(res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Send callback error: {}",
+			data->transport->dst_addr.to_string(),
+			res
+		);
+	} else {
+		data->transport->delegate->did_send(
+			*data->transport,
+			std::move(data->packet)
+		);
+	}
+
+	delete data;
+}
+
+//! called by higher level to send data, queued as a sendmsg on the shared ring
+/*!
+	\param packet Marlin::core::Buffer type of packet
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
+	return send(std::move(packet), core::Buffer(nullptr, 0), 0);
+}
+
+//! called by higher level to send a packet with a payload held elsewhere, queued as a single sendmsg
+/*!
+	\param packet Marlin::core::Buffer with everything except the payload
+	\param payload Marlin::core::Buffer referencing the payload, kept alive until the send completes
+	\param offset position in packet at which payload goes
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int UdpTransport<DelegateType>::send(core::Buffer &&packet, core::Buffer &&payload, size_t offset) {
+	if(fd < 0) {
+		int res = uv_fileno((uv_handle_t *)base_transport, &fd);
+		if (res < 0) {
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Send error: {}, To: {}",
+				src_addr.to_string(),
+				res,
+				dst_addr.to_string()
+			);
+			return res;
+		}
+	}
+
+	auto *data = new UringSendPayload{{}, {}, {}, dst_addr, std::move(packet), this, std::move(payload), {}};
+	data->op.cb = uring_send_cb;
+	data->op.data = data;
+	size_t iovlen = 0;
+	if(data->payload.size() == 0) {
+		data->iov[iovlen++] = {data->packet.data(), data->packet.size()};
+	} else {
+		data->iov[iovlen++] = {data->packet.data(), offset};
+		data->iov[iovlen++] = {data->payload.data(), data->payload.size()};
+		data->iov[iovlen++] = {data->packet.data() + offset, data->packet.size() - offset};
+	}
+	data->msg.msg_name = &data->dst;
+	data->msg.msg_namelen = data->dst.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+	data->msg.msg_iov = data->iov;
+	data->msg.msg_iovlen = iovlen;
+
+	data->it = pending_uring_req.insert(pending_uring_req.end(), data);
+
+	auto &uring = IoUring::default_instance();
+	auto *sqe = uring.get_sqe();
+	io_uring_prep_sendmsg(sqe, fd, &data->msg, 0);
+	io_uring_sqe_set_data(sqe, &data->op);
+	uring.ref();
+
+	return 0;
+}
+
+#else
+
 //! called by higher level to send data
 /*!
 	\param packet Marlin::core::Buffer type of packet
@@ -134,23 +262,51 @@ void UdpTransport<DelegateType>::send_cb(
 */
 template<typename DelegateType>
 int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
+	return send(std::move(packet), core::Buffer(nullptr, 0), 0);
+}
+
+//! called by higher level to send a packet with a payload held elsewhere, libuv sends the pieces with a single sendmsg
+/*!
+	\param packet Marlin::core::Buffer with everything except the payload
+	\param payload Marlin::core::Buffer referencing the payload, kept alive until the send completes
+	\param offset position in packet at which payload goes
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int UdpTransport<DelegateType>::send(core::Buffer &&packet, core::Buffer &&payload, size_t offset) {
 	uv_udp_send_t *req = new uv_udp_send_t();
-	auto req_data = new SendPayload{std::move(packet), this};
+	auto req_data = new SendPayload{std::move(packet), this, std::move(payload)};
 	req->data = req_data;
 
 	pending_req.push_back(req);
 
-	auto buf = uv_buf_init((char*)req_data->packet.data(), req_data->packet.size());
+	uv_buf_t bufs[3];
+	unsigned int nbufs = 0;
+	if(req_data->payload.size() == 0) {
+		bufs[nbufs++] = uv_buf_init((char*)req_data->packet.data(), req_data->packet.size());
+	} else {
+		bufs[nbufs++] = uv_buf_init((char*)req_data->packet.data(), offset);
+		bufs[nbufs++] = uv_buf_init((char*)req_data->payload.data(), req_data->payload.size());
+		bufs[nbufs++] = uv_buf_init((char*)req_data->packet.data() + offset, req_data->packet.size() - offset);
+	}
 	int res = uv_udp_send(
 		req,
 		base_transport,
-		&buf,
-		1,
+		bufs,
+		nbufs,
 		reinterpret_cast<const sockaddr *>(&dst_addr),
 		UdpTransport<DelegateType>::send_cb
 	);
 
-	if (res < 0) {
+	if (res == UV_EMSGSIZE) {
+		// Expected from path MTU probes larger than the interface allows
+		SPDLOG_DEBUG(
+			"Asyncio: Socket {}: Send error: Message too long, To: {}",
+			src_addr.to_string(),
+			dst_addr.to_string()
+		);
+		return res;
+	} else if (res < 0) {
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Send error: {}, To: {}",
 			src_addr.to_string(),
@@ -163,6 +319,94 @@ int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
 	return 0;
 }
 
+#endif
+
+//! sends a datagram right away with the don't fragment bit set, oversized ones fail to send or get dropped on the path instead
+/*!
+	The socket is shared with every other transport of the factory, so it is only switched to probing
+	for this one synchronous send and restored right after. Everything else keeps the kernel's default,
+	which fragments according to the path MTU the kernel has learnt.
+	Probing also leaves the kernel's path MTU estimate out of it so probes larger than that still go out.
+	\param packet Marlin::core::BaseMessage type of packet
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int UdpTransport<DelegateType>::send_dont_fragment(MessageType &&packet) {
+	auto bytes = std::move(packet).payload_buffer();
+
+	uv_os_fd_t sock;
+	int res = uv_fileno((uv_handle_t *)base_transport, &sock);
+	if (res < 0) {
+		return res;
+	}
+
+	int level = -1, optname = -1, probe = 0;
+	if(src_addr.ss_family == AF_INET) {
+#if defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_PROBE)
+		level = IPPROTO_IP;
+		optname = IP_MTU_DISCOVER;
+		probe = IP_PMTUDISC_PROBE;
+#endif
+	} else {
+#if defined(IPV6_MTU_DISCOVER) && defined(IPV6_PMTUDISC_PROBE)
+		level = IPPROTO_IPV6;
+		optname = IPV6_MTU_DISCOVER;
+		probe = IPV6_PMTUDISC_PROBE;
+#endif
+	}
+
+	int prev = 0;
+	socklen_t prev_len = sizeof(prev);
+	if(optname >= 0 && (
+		getsockopt(sock, level, optname, &prev, &prev_len) < 0 ||
+		setsockopt(sock, level, optname, &probe, sizeof(probe)) < 0
+	)) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Don't fragment error: {}",
+			src_addr.to_string(),
+			errno
+		);
+		return -errno;
+	}
+
+	auto sent = sendto(
+		sock,
+		bytes.data(),
+		bytes.size(),
+		0,
+		reinterpret_cast<const sockaddr *>(&dst_addr),
+		dst_addr.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6)
+	);
+	int send_errno = errno;
+
+	if(optname >= 0) {
+		setsockopt(sock, level, optname, &prev, sizeof(prev));
+	}
+
+	if(sent < 0) {
+		if(send_errno == EMSGSIZE) {
+			// Expected from path MTU probes larger than the interface allows
+			SPDLOG_DEBUG(
+				"Asyncio: Socket {}: Send error: Message too long, To: {}",
+				src_addr.to_string(),
+				dst_addr.to_string()
+			);
+		} else {
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Send error: {}, To: {}",
+				src_addr.to_string(),
+				send_errno,
+				dst_addr.to_string()
+			);
+		}
+		return -send_errno;
+	}
+
+	delegate->did_send(*this, std::move(bytes));
+
+	return 0;
+}
+
 template<typename DelegateType>
 int UdpTransport<DelegateType>::send(MessageType &&packet) {
 	return send(std::move(packet).payload_buffer());
@@ -176,6 +420,11 @@ void UdpTransport<DelegateType>::close(uint16_t reason) {
 		auto *data = (SendPayload *)req->data;
 		data->transport = nullptr;
 	}
+#ifdef MARLIN_ASYNCIO_IO_URING
+	for (auto *data : pending_uring_req) {
+		data->transport = nullptr;
+	}
+#endif
 	transport_manager.erase(dst_addr);
 }
 
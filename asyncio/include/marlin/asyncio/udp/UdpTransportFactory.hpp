@@ -9,9 +9,13 @@
 
 #include <uv.h>
 #include <marlin/uvpp/Udp.hpp>
+#include <marlin/asyncio/core/IoUring.hpp>
 #include <marlin/core/transports/TransportFactoryScaffold.hpp>
 #include "marlin/core/Buffer.hpp"
 #include "marlin/core/SocketAddress.hpp"
+#include "marlin/core/AddressClassifier.hpp"
+#include "marlin/core/PrefixRateLimiter.hpp"
+#include <marlin/asyncio/core/EventLoop.hpp>
 #include "UdpTransport.hpp"
 
 #include <spdlog/spdlog.h>
@@ -59,11 +63,55 @@ private:
 
 	bool is_listening = false;
 
+public:
+	/// Packets from unknown sources dropped before a transport is created, by stage
+	struct DropStats {
+		/// Source prefix classified Blocked
+		uint64_t blocked = 0;
+		/// Source prefix out of new peer tokens
+		uint64_t rate_limited = 0;
+		/// Declined by the listen delegate
+		uint64_t rejected = 0;
+	};
+
+	/// New transports per second allowed per source prefix
+	static constexpr double DefaultNewPeerRate = 50;
+	static constexpr double DefaultNewPeerBurst = 100;
+	/// Same for prefixes classified RateLimited
+	static constexpr double DefaultRestrictedPeerRate = 2;
+	static constexpr double DefaultRestrictedPeerBurst = 5;
+
+private:
+	DropStats drop_stats;
+	core::PrefixRateLimiter new_peer_limiter{DefaultNewPeerRate, DefaultNewPeerBurst};
+	core::PrefixRateLimiter restricted_peer_limiter{DefaultRestrictedPeerRate, DefaultRestrictedPeerBurst};
+
 	struct RecvPayload {
 		UdpTransportFactory<ListenDelegate, TransportDelegate> *factory;
 		ListenDelegate *delegate;
 	};
 
+	void did_recv_packet(
+		core::SocketAddress const &addr,
+		ListenDelegate &delegate,
+		core::Buffer &&packet
+	);
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	/// Multishot recvmsg state, outlives the factory until cancellation completes
+	struct UringRecvPayload {
+		IoUringOp op;
+		msghdr msg;
+		UdpTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		ListenDelegate *delegate;
+		int fd;
+	};
+	UringRecvPayload *uring_recv = nullptr;
+
+	static void arm_uring_recv(UringRecvPayload &payload);
+	static void uring_recv_cb(IoUringOp &op, int res, uint32_t flags);
+#endif
+
 public:
 	using TransportFactoryScaffoldType::addr;
 
@@ -80,6 +128,21 @@ public:
 	int dial(core::SocketAddress const &addr, ListenDelegate &delegate, Args&&... args);
 
 	using TransportFactoryScaffoldType::get_transport;
+
+	DropStats const& get_drop_stats() const {
+		return drop_stats;
+	}
+
+	/// Limit transport creation per source prefix, for Public and for RateLimited prefixes
+	void set_new_peer_limits(
+		double rate_per_sec,
+		double burst,
+		double restricted_rate_per_sec,
+		double restricted_burst
+	) {
+		new_peer_limiter.set_limit(rate_per_sec, burst);
+		restricted_peer_limiter.set_limit(restricted_rate_per_sec, restricted_burst);
+	}
 };
 
 
@@ -105,6 +168,13 @@ close_cb(uv_handle_t *handle) {
 template<typename ListenDelegate, typename TransportDelegate>
 UdpTransportFactory<ListenDelegate, TransportDelegate>::
 ~UdpTransportFactory() {
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(uring_recv != nullptr) {
+		// Payload is freed by the final (cancelled) completion
+		uring_recv->factory = nullptr;
+		IoUring::default_instance().cancel_fd(uring_recv->fd);
+	}
+#endif
 	uv_close(
 		(uv_handle_t *)(uv_udp_t*)base_factory,
 		close_cb
@@ -202,30 +272,140 @@ void UdpTransportFactory<ListenDelegate, TransportDelegate>::recv_cb(
 	auto &factory = *(payload->factory);
 	auto &delegate = *static_cast<ListenDelegate *>(payload->delegate);
 
-	auto *transport = factory.transport_manager.get(addr);
+	factory.did_recv_packet(
+		addr,
+		delegate,
+		core::Buffer((uint8_t*)buf->base, nread)
+	);
+}
+
+//! redirects a received packet to the transport for its source, creating one if permitted
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::did_recv_packet(
+	core::SocketAddress const &addr,
+	ListenDelegate &delegate,
+	core::Buffer &&packet
+) {
+	auto *transport = transport_manager.get(addr);
 	if(transport == nullptr) {
+		// Cheapest checks first, spoofed floods should not get as far as allocating a transport
+		auto cls = core::AddressClassifier::default_instance().classify(addr);
+		if(cls == core::AddressClass::Blocked) {
+			drop_stats.blocked++;
+			return;
+		}
+
+		if(cls != core::AddressClass::Internal) {
+			auto& limiter = cls == core::AddressClass::RateLimited ? restricted_peer_limiter : new_peer_limiter;
+			if(!limiter.allow(addr, EventLoop::now())) {
+				drop_stats.rate_limited++;
+				return;
+			}
+		}
+
 		// Create new transport if permitted
 		if(delegate.should_accept(addr)) {
-			transport = factory.transport_manager.get_or_create(
+			transport = transport_manager.get_or_create(
 				addr,
-				factory.addr,
+				this->addr,
 				addr,
-				factory.base_factory,
-				factory.transport_manager
+				base_factory,
+				transport_manager
 			).first;
 			delegate.did_create_transport(*transport);
 		} else {
-			delete[] buf->base;
+			drop_stats.rejected++;
 			return;
 		}
 	}
 
 	transport->did_recv(
-		handle,
-		core::Buffer((uint8_t*)buf->base, nread)
+		base_factory,
+		std::move(packet)
 	);
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::arm_uring_recv(
+	UringRecvPayload &payload
+) {
+	auto &uring = IoUring::default_instance();
+	auto *sqe = uring.get_sqe();
+	io_uring_prep_recvmsg_multishot(sqe, payload.fd, &payload.msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = IoUring::DGRAM_BGID;
+	io_uring_sqe_set_data(sqe, &payload.op);
+
+	uring.ref();
+}
+
+//! io_uring counterpart of recv_cb, one completion per datagram
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::uring_recv_cb(
+	IoUringOp &op,
+	int res,
+	uint32_t flags
+) {
+	auto &payload = *(UringRecvPayload *)op.data;
+	auto &uring = IoUring::default_instance();
+
+	bool more = flags & IORING_CQE_F_MORE;
+	if(!more) {
+		uring.unref();
+	}
+
+	if(res >= 0 && (flags & IORING_CQE_F_BUFFER) && payload.factory != nullptr) {
+		auto bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		auto packet = uring.dgram_bufs->take(bid, res);
+
+		auto *out = io_uring_recvmsg_validate(packet.data(), res, &payload.msg);
+		if(out == nullptr || out->payloadlen == 0 || (out->flags & MSG_TRUNC)) {
+			// Malformed or truncated, drop
+		} else {
+			auto *payload_ptr = (uint8_t*)io_uring_recvmsg_payload(out, &payload.msg);
+			auto payload_len = io_uring_recvmsg_payload_length(out, res, &payload.msg);
+			core::SocketAddress addr(*(sockaddr const *)io_uring_recvmsg_name(out));
+
+			packet.cover_unsafe(payload_ptr - packet.data());
+			packet.truncate_unsafe(packet.size() - payload_len);
+
+			payload.factory->did_recv_packet(addr, *payload.delegate, std::move(packet));
+		}
+	} else if(res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Recv callback error: {}",
+			payload.factory == nullptr ? "closed" : payload.factory->addr.to_string(),
+			res
+		);
+	} else if(flags & IORING_CQE_F_BUFFER) {
+		uring.dgram_bufs->recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+	}
+
+	if(!more) {
+		if(payload.factory == nullptr) {
+			delete &payload;
+		} else if(res >= 0 || res == -ENOBUFS || res == -ECANCELED) {
+			// Multishot ended on its own or ran out of buffers, keep receiving
+			arm_uring_recv(payload);
+		} else {
+			// Socket error such as -EBADF would just come back on every rearm, stop
+			// receiving until the next listen instead of spinning on it
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Recv stopped: {}",
+				payload.factory->addr.to_string(),
+				res
+			);
+			payload.factory->uring_recv = nullptr;
+			payload.factory->is_listening = false;
+			delete &payload;
+		}
+	}
+}
+
+#endif
+
 
 //! starts listening for incoming messages on the socket address
 template<typename ListenDelegate, typename TransportDelegate>
@@ -239,6 +419,34 @@ listen(ListenDelegate &delegate) {
 		this,
 		&delegate
 	};
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(uring_recv != nullptr) {
+		uring_recv->delegate = &delegate;
+		return 0;
+	}
+
+	int fd;
+	int res = uv_fileno((uv_handle_t *)(uv_udp_t*)base_factory, &fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Start recv error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	uring_recv = new UringRecvPayload();
+	uring_recv->op.cb = uring_recv_cb;
+	uring_recv->op.data = uring_recv;
+	// Kernel writes source address into the head of each provided buffer
+	uring_recv->msg.msg_namelen = sizeof(sockaddr_storage);
+	uring_recv->factory = this;
+	uring_recv->delegate = &delegate;
+	uring_recv->fd = fd;
+	arm_uring_recv(*uring_recv);
+#else
 	int res = uv_udp_recv_start(
 		base_factory,
 		naive_alloc_cb,
@@ -252,6 +460,7 @@ listen(ListenDelegate &delegate) {
 		);
 		return res;
 	}
+#endif
 
 	is_listening = true;
 
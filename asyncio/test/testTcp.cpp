@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/tcp/TcpTransportFactory.hpp"
+
+#include <functional>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+struct Delegate {
+	std::function<void(TcpTransport<Delegate> &, Buffer &&)> on_recv;
+	std::function<void(TcpTransport<Delegate> &)> on_dial;
+	std::function<void(TcpTransport<Delegate> &)> on_close;
+
+	void did_recv(TcpTransport<Delegate> &transport, Buffer &&bytes) {
+		if(on_recv) {
+			on_recv(transport, std::move(bytes));
+		}
+	}
+
+	void did_send(TcpTransport<Delegate> &, Buffer &&) {}
+
+	void did_dial(TcpTransport<Delegate> &transport) {
+		if(on_dial) {
+			on_dial(transport);
+		}
+	}
+
+	void did_close(TcpTransport<Delegate> &transport, uint16_t) {
+		if(on_close) {
+			on_close(transport);
+		}
+	}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TcpTransport<Delegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+// Runs with whichever backend asyncio was built with, libuv or io_uring
+TEST(TcpTransport, CloseFlushesQueuedSends) {
+	size_t recv_bytes = 0;
+	bool is_corrupt = false;
+	bool server_closed = false;
+
+	{
+		Delegate server;
+		server.on_recv = [&](TcpTransport<Delegate> &, Buffer &&bytes) {
+			for(size_t i = 0; i < bytes.size(); i++) {
+				if(bytes.data()[i] != (uint8_t)((recv_bytes + i) % 251)) {
+					is_corrupt = true;
+				}
+			}
+			recv_bytes += bytes.size();
+		};
+		server.on_close = [&](TcpTransport<Delegate> &) {
+			server_closed = true;
+		};
+
+		Delegate client;
+		client.on_dial = [&](TcpTransport<Delegate> &transport) {
+			// Several sends queue up behind the first write, then close in the same loop iteration
+			for(size_t i = 0; i < 10; i++) {
+				Buffer bytes(1000);
+				for(size_t j = 0; j < 1000; j++) {
+					bytes.data()[j] = (i * 1000 + j) % 251;
+				}
+				EXPECT_EQ(transport.send(std::move(bytes)), 0);
+			}
+			transport.close();
+			// Closing again is a no-op
+			transport.close();
+		};
+
+		TcpTransportFactory<Delegate, Delegate> s, c;
+		s.bind(SocketAddress::loopback_ipv4(8700));
+		s.listen(server);
+		c.bind(SocketAddress::loopback_ipv4(0));
+		c.dial(SocketAddress::loopback_ipv4(8700), client);
+
+		while(!server_closed) {
+			uv_run(uv_default_loop(), UV_RUN_ONCE);
+		}
+
+		EXPECT_EQ(recv_bytes, 10000u);
+		EXPECT_FALSE(is_corrupt);
+	}
+
+	// Let the factories release their sockets
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+}
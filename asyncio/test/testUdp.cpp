@@ -104,6 +104,137 @@ TEST(UdpTransport, CanSend) {
 	EXPECT_TRUE(did_call_delegate);
 }
 
+TEST(UdpTransport, CanGatherSend) {
+	auto *sock = new uv_udp_t();
+	uv_udp_init(uv_default_loop(), sock);
+
+	auto *recv_sock = new uv_udp_t();
+	uv_udp_init(uv_default_loop(), recv_sock);
+	auto addr = SocketAddress::loopback_ipv4(8002);
+	uv_udp_bind(recv_sock, reinterpret_cast<sockaddr const *>(&addr), 0);
+
+	static bool did_recv = false;
+	uv_udp_recv_start(
+		recv_sock,
+		[](uv_handle_t *, size_t, uv_buf_t *buf) {
+			static char data[64];
+			*buf = uv_buf_init(data, sizeof(data));
+		},
+		[](uv_udp_t *handle, ssize_t nread, uv_buf_t const *buf, sockaddr const *, unsigned) {
+			if(nread <= 0) {
+				return;
+			}
+			did_recv = true;
+
+			EXPECT_EQ(nread, 10);
+			EXPECT_TRUE(std::memcmp(buf->base, "123456789", 10) == 0);
+
+			uv_close((uv_handle_t*)handle, close_cb);
+		}
+	);
+
+	TransportManager<UdpTransport<TransportDelegate>> tm;
+	UdpTransport<TransportDelegate> t(
+		SocketAddress::loopback_ipv4(8000),
+		addr,
+		sock,
+		tm
+	);
+
+	bool did_call_delegate = false;
+
+	TransportDelegate td;
+	td.did_send = [&] (
+		UdpTransport<TransportDelegate> &transport,
+		Buffer &&packet
+	) {
+		did_call_delegate = true;
+
+		// Payload is not part of the packet handed back
+		EXPECT_EQ(&transport, &t);
+		EXPECT_EQ(packet.size(), 5);
+
+		uv_close((uv_handle_t*)sock, close_cb);
+	};
+
+	t.setup(&td);
+	auto res = t.send(
+		Buffer({'1','2','8','9',0}, 5),
+		Buffer({'3','4','5','6','7'}, 5),
+		2
+	);
+
+	EXPECT_EQ(res, 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_TRUE(did_call_delegate);
+	EXPECT_TRUE(did_recv);
+}
+
+TEST(UdpTransport, CanSendDontFragment) {
+	auto *sock = new uv_udp_t();
+	uv_udp_init(uv_default_loop(), sock);
+	auto src = SocketAddress::loopback_ipv4(8004);
+	uv_udp_bind(sock, reinterpret_cast<sockaddr const *>(&src), 0);
+
+	auto *recv_sock = new uv_udp_t();
+	uv_udp_init(uv_default_loop(), recv_sock);
+	auto addr = SocketAddress::loopback_ipv4(8005);
+	uv_udp_bind(recv_sock, reinterpret_cast<sockaddr const *>(&addr), 0);
+
+	static bool did_recv = false;
+	uv_udp_recv_start(
+		recv_sock,
+		[](uv_handle_t *, size_t, uv_buf_t *buf) {
+			static char data[64];
+			*buf = uv_buf_init(data, sizeof(data));
+		},
+		[](uv_udp_t *handle, ssize_t nread, uv_buf_t const *buf, sockaddr const *, unsigned) {
+			if(nread <= 0) {
+				return;
+			}
+			did_recv = true;
+
+			EXPECT_EQ(nread, 10);
+			EXPECT_TRUE(std::memcmp(buf->base, "123456789", 10) == 0);
+
+			uv_close((uv_handle_t*)handle, close_cb);
+		}
+	);
+
+	uv_os_fd_t fd;
+	uv_fileno((uv_handle_t *)sock, &fd);
+	int before = 0;
+	socklen_t len = sizeof(before);
+	getsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &before, &len);
+
+	TransportManager<UdpTransport<TransportDelegate>> tm;
+	UdpTransport<TransportDelegate> t(src, addr, sock, tm);
+
+	size_t did_send_count = 0;
+	TransportDelegate td;
+	td.did_send = [&] (UdpTransport<TransportDelegate> &, Buffer &&) {
+		did_send_count++;
+	};
+	t.setup(&td);
+
+	// Sent synchronously, errors are returned right away
+	EXPECT_EQ(t.send_dont_fragment(BaseMessage(Buffer({'1','2','3','4','5','6','7','8','9',0}, 10))), 0);
+	EXPECT_EQ(t.send_dont_fragment(BaseMessage(Buffer(70000))), -EMSGSIZE);
+	EXPECT_EQ(did_send_count, 1u);
+
+	// Socket is shared with other transports, it is left as it was
+	int after = -1;
+	getsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &after, &len);
+	EXPECT_EQ(after, before);
+
+	uv_close((uv_handle_t*)sock, close_cb);
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_TRUE(did_recv);
+}
+
 TEST(UdpTransportFactory, CanBind) {
 	UdpTransportFactory<ListenDelegate, TransportDelegate> f;
 
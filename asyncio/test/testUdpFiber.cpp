@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/udp/UdpFiber.hpp"
+#include "marlin/core/fabric/Fabric.hpp"
+#include "marlin/core/fibers/VersioningFiber.hpp"
+
+#include <span>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+using VersionedType = VersionedMessage<Buffer>;
+
+struct App {
+	std::vector<size_t> recv_batches;
+	size_t num_recvd = 0;
+	size_t num_sent = 0;
+
+	int did_recv(auto&&, VersionedType&&, SocketAddress) {
+		num_recvd++;
+		return 0;
+	}
+
+	int did_recv_batch(auto&&, std::span<BatchEntry<VersionedType>> batch) {
+		recv_batches.push_back(batch.size());
+		num_recvd += batch.size();
+		return 0;
+	}
+
+	int did_send(auto&&, Buffer&&) {
+		num_sent++;
+		return 0;
+	}
+};
+
+using FabricType = Fabric<App&, UdpFiber, VersioningFiber>;
+
+// Datagrams sent with one send_batch reach the other end through recvmmsg in fewer batches than datagrams
+TEST(UdpFiber, ExchangesBatches) {
+	App server, client;
+	FabricType s(std::forward_as_tuple(server, std::make_tuple(), std::make_tuple()));
+	FabricType c(std::forward_as_tuple(client, std::make_tuple(), std::make_tuple()));
+
+	ASSERT_EQ(s.i(server).bind(SocketAddress::loopback_ipv4(8800)), 0);
+	ASSERT_EQ(s.i(server).listen(), 0);
+	ASSERT_EQ(c.i(client).bind(SocketAddress::loopback_ipv4(8801)), 0);
+	ASSERT_EQ(c.i(client).listen(), 0);
+
+	std::vector<BatchEntry<VersionedType>> batch;
+	for(size_t i = 0; i < 10; i++) {
+		batch.push_back({VersionedType(100), SocketAddress::loopback_ipv4(8800)});
+	}
+	EXPECT_EQ(c.o(client).send_batch(client, std::span(batch)), 0);
+
+	while(server.num_recvd < 10) {
+		uv_run(uv_default_loop(), UV_RUN_ONCE);
+	}
+
+	EXPECT_EQ(client.num_sent, 10u);
+	EXPECT_EQ(server.num_recvd, 10u);
+	EXPECT_LT(server.recv_batches.size(), 10u);
+}
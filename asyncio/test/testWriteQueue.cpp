@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/core/WriteQueue.hpp"
+#include "marlin/core/Buffer.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <functional>
+#include <memory>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+struct Delegate;
+using QueueType = WriteQueue<Buffer, Delegate>;
+
+struct Delegate {
+	std::function<void(QueueType &, Buffer &&, int)> did_write;
+};
+
+// Pipe over a socketpair, the other end is drained so that writes complete
+struct PipeFixture {
+	int fds[2];
+	uv_pipe_t writer;
+	uv_pipe_t reader;
+	size_t read_bytes = 0;
+
+	PipeFixture() {
+		socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+		uv_pipe_init(uv_default_loop(), &writer, 0);
+		uv_pipe_open(&writer, fds[0]);
+		uv_pipe_init(uv_default_loop(), &reader, 0);
+		uv_pipe_open(&reader, fds[1]);
+		reader.data = this;
+
+		uv_read_start(
+			(uv_stream_t *)&reader,
+			[](uv_handle_t *, size_t suggested_size, uv_buf_t *buf) {
+				buf->base = new char[suggested_size];
+				buf->len = suggested_size;
+			},
+			[](uv_stream_t *stream, ssize_t nread, uv_buf_t const *buf) {
+				auto &fixture = *(PipeFixture *)stream->data;
+				delete[] buf->base;
+				if(nread > 0) {
+					fixture.read_bytes += nread;
+				}
+			}
+		);
+	}
+
+	void stop_reading() {
+		uv_read_stop((uv_stream_t *)&reader);
+	}
+
+	void close() {
+		stop_reading();
+		uv_close((uv_handle_t *)&writer, nullptr);
+		uv_close((uv_handle_t *)&reader, nullptr);
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	}
+};
+
+TEST(WriteQueue, WritesEveryBufferOnce) {
+	PipeFixture pipe;
+	size_t written = 0;
+	size_t written_bytes = 0;
+
+	Delegate delegate;
+	delegate.did_write = [&](QueueType &, Buffer &&bytes, int status) {
+		EXPECT_EQ(status, 0);
+		written++;
+		written_bytes += bytes.size();
+	};
+
+	QueueType queue;
+	queue.setup((uv_stream_t *)&pipe.writer, &delegate);
+	for(size_t i = 0; i < 10; i++) {
+		queue.send(Buffer(1000));
+	}
+
+	while(written < 10 || pipe.read_bytes < 10000) {
+		uv_run(uv_default_loop(), UV_RUN_ONCE);
+	}
+
+	EXPECT_EQ(written, 10u);
+	EXPECT_EQ(written_bytes, 10000u);
+	pipe.close();
+}
+
+TEST(WriteQueue, CanBeDestroyedFromSynchronousCompletion) {
+	PipeFixture pipe;
+	size_t written = 0;
+
+	auto queue = std::make_unique<QueueType>();
+	Delegate delegate;
+	delegate.did_write = [&](QueueType &, Buffer &&, int) {
+		written++;
+		queue.reset();
+		pipe.stop_reading();
+	};
+
+	queue->setup((uv_stream_t *)&pipe.writer, &delegate);
+	for(size_t i = 0; i < 10; i++) {
+		queue->send(Buffer(100));
+	}
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	// Rest of the batch is dropped along with the queue
+	EXPECT_EQ(written, 1u);
+	EXPECT_EQ(queue, nullptr);
+	pipe.close();
+}
+
+TEST(WriteQueue, CanBeDestroyedFromWriteCallback) {
+	PipeFixture pipe;
+	size_t written = 0;
+
+	auto queue = std::make_unique<QueueType>();
+	Delegate delegate;
+	delegate.did_write = [&](QueueType &, Buffer &&, int) {
+		written++;
+		queue.reset();
+		pipe.stop_reading();
+	};
+
+	queue->setup((uv_stream_t *)&pipe.writer, &delegate);
+	// More than the socket buffer takes, the rest goes out through uv_write
+	for(size_t i = 0; i < 10; i++) {
+		queue->send(Buffer(1000000));
+	}
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(written, 1u);
+	EXPECT_EQ(queue, nullptr);
+	pipe.close();
+}
+
+TEST(WriteQueue, CloseFlushesQueuedSends) {
+	PipeFixture pipe;
+	size_t written = 0;
+
+	Delegate delegate;
+	delegate.did_write = [&](QueueType &, Buffer &&, int status) {
+		EXPECT_EQ(status, 0);
+		written++;
+	};
+
+	QueueType queue;
+	queue.setup((uv_stream_t *)&pipe.writer, &delegate);
+	EXPECT_EQ(queue.send(Buffer(100)), 0);
+	EXPECT_EQ(queue.send(Buffer(100)), 0);
+
+	// Send then close within one loop iteration, the sends must not be dropped
+	queue.close();
+	EXPECT_TRUE(queue.is_closed());
+	EXPECT_EQ(written, 2u);
+	EXPECT_EQ(queue.send(Buffer(100)), UV_EPIPE);
+
+	while(pipe.read_bytes < 200) {
+		uv_run(uv_default_loop(), UV_RUN_ONCE);
+	}
+
+	EXPECT_EQ(pipe.read_bytes, 200u);
+	pipe.close();
+}
@@ -11,6 +11,8 @@
 #include <marlin/core/fibers/VersioningFiber.hpp>
 #include <marlin/core/fabric/Fabric.hpp>
 #include <map>
+#include <span>
+#include <vector>
 
 #include <sodium.h>
 #include <boost/iterator/filter_iterator.hpp>
@@ -62,6 +64,11 @@ private:
 	FiberType fiber;
 	FiberType h_fiber;
 
+	// Replies to a received batch, sent together once it is processed
+	bool is_batching = false;
+	std::vector<core::BatchEntry<BaseMessageType>> replies;
+	void reply(FiberType& fiber, BaseMessageType&& packet, core::SocketAddress addr);
+
 	// Discovery protocol
 	void did_recv_DISCPROTO(FiberType& fiber, core::SocketAddress addr);
 	void send_LISTPROTO(FiberType& fiber, core::SocketAddress addr);
@@ -99,6 +106,7 @@ public:
 	// Transport delegate
 	int did_dial(FiberType& fiber, core::SocketAddress addr);
 	int did_recv(FiberType& fiber, BaseMessageType &&packet, core::SocketAddress addr);
+	int did_recv_batch(FiberType& fiber, std::span<core::BatchEntry<BaseMessageType>> batch);
 	int did_send(FiberType& fiber, core::Buffer &&packet);
 
 private:
@@ -141,6 +149,24 @@ public:
 //---------------- Discovery protocol functions begin ----------------//
 
 
+/*!
+	Sends a reply right away, or queues it while a batch is being processed
+*/
+template<DISCOVERYSERVER_TEMPLATE>
+void DISCOVERYSERVER::reply(
+	FiberType& fiber,
+	BaseMessageType &&packet,
+	core::SocketAddress addr
+) {
+	if(is_batching) {
+		replies.push_back({std::move(packet), addr});
+		return;
+	}
+
+	fiber.o(*this).send(*this, std::move(packet), addr);
+}
+
+
 /*!
 	\li Callback on receipt of disc proto
 	\li Sends back the protocols supported on this node
@@ -160,7 +186,7 @@ void DISCOVERYSERVER::send_LISTPROTO(
 	FiberType& fiber,
 	core::SocketAddress addr
 ) {
-	fiber.o(*this).send(*this, LISTPROTO(), addr);
+	reply(fiber, LISTPROTO(), addr);
 }
 
 
@@ -198,7 +224,7 @@ void DISCOVERYSERVER::send_LISTPEER(
 	auto t_end = boost::make_transform_iterator(f_end, transformation);
 
 	while(t_begin != t_end) {
-		fiber.o(*this).send(*this, LISTPEER(150).set_peers(t_begin, t_end), addr);
+		reply(fiber, LISTPEER(150).set_peers(t_begin, t_end), addr);
 	}
 }
 
@@ -426,7 +452,7 @@ void DISCOVERYSERVER::send_LISTCLUSTER(
 	auto t_end = boost::make_transform_iterator(f_end, transformation);
 
 	while(t_begin != t_end) {
-		fiber.o(*this).send(*this, LISTCLUSTER(150).set_clusters(t_begin, t_end), addr);
+		reply(fiber, LISTCLUSTER(150).set_clusters(t_begin, t_end), addr);
 	}
 }
 
@@ -457,7 +483,7 @@ void DISCOVERYSERVER::send_LISTCLUSTER2(
 	auto t_end = boost::make_transform_iterator(f_end, transformation);
 
 	while(t_begin != t_end) {
-		fiber.o(*this).send(*this, LISTCLUSTER2(150).set_clusters(t_begin, t_end), addr);
+		reply(fiber, LISTCLUSTER2(150).set_clusters(t_begin, t_end), addr);
 	}
 }
 
@@ -541,6 +567,31 @@ int DISCOVERYSERVER::did_recv(
 	return 0;
 }
 
+//! receives a batch of packets, e.g. from one recvmmsg call
+/*!
+	Processes each packet like did_recv and sends all the replies with one send_batch, i.e. sendmmsg on udp
+*/
+template<DISCOVERYSERVER_TEMPLATE>
+int DISCOVERYSERVER::did_recv_batch(
+	FiberType& fiber,
+	std::span<core::BatchEntry<BaseMessageType>> batch
+) {
+	is_batching = true;
+	for(auto& entry : batch) {
+		(void)did_recv(fiber, std::move(entry.msg), entry.addr);
+	}
+	is_batching = false;
+
+	if(replies.empty()) {
+		return 0;
+	}
+
+	auto res = fiber.o(*this).send_batch(*this, std::span(replies));
+	replies.clear();
+
+	return res;
+}
+
 template<DISCOVERYSERVER_TEMPLATE>
 int DISCOVERYSERVER::did_send(
 	FiberType&,
@@ -2,6 +2,7 @@
 #define MARLIN_BEACON_MESSAGES_HPP
 
 #include <marlin/core/Buffer.hpp>
+#include <marlin/core/messages/Schema.hpp>
 
 
 namespace marlin {
@@ -216,6 +217,12 @@ template<typename BaseMessageType>
 struct LISTPEERWrapper {
 	BaseMessageType base;
 
+	/// Layout of a peer entry, serialized address followed by the static key
+	using PeerSchema = core::MessageSchema<
+		core::BytesField<8, 0>,
+		core::BytesField<crypto_box_PUBLICKEYBYTES, 8>
+	>;
+
 	operator BaseMessageType() && {
 		return std::move(base);
 	}
@@ -229,10 +236,10 @@ struct LISTPEERWrapper {
 	template<typename It>
 	LISTPEERWrapper& set_peers(It& begin, It end) & {
 		size_t idx = 1;
-		while(begin != end && idx + 8 + crypto_box_PUBLICKEYBYTES <= base.payload_buffer().size()) {
+		while(begin != end && idx + PeerSchema::size <= base.payload_buffer().size()) {
 			begin->first.serialize(base.payload()+idx, 8);
 			base.payload_buffer().write_unsafe(idx+8, begin->second.data(), crypto_box_PUBLICKEYBYTES);
-			idx += 8 + crypto_box_PUBLICKEYBYTES;
+			idx += PeerSchema::size;
 
 			++begin;
 		}
@@ -247,7 +254,8 @@ struct LISTPEERWrapper {
 	}
 
 	[[nodiscard]] bool validate() const {
-		if(base.payload_buffer().size() < 1 || base.payload_buffer().size() % 8 != 1) {
+		auto size = base.payload_buffer().size();
+		if(size < 1 || (size - 1) % PeerSchema::size != 0) {
 			return false;
 		}
 		return true;
@@ -268,15 +276,14 @@ struct LISTPEERWrapper {
 		iterator(core::WeakBuffer buf, size_t offset = 0) : buf(buf), offset(offset) {}
 
 		value_type operator*() const {
-			auto peer_addr = core::SocketAddress::deserialize(buf.data()+offset, 8);
-			std::array<uint8_t, 32> key;
-			buf.read_unsafe(offset+8, key.data(), crypto_box_PUBLICKEYBYTES);
+			auto [addr_bytes, key] = PeerSchema::read_unsafe(buf.data()+offset);
+			auto peer_addr = core::SocketAddress::deserialize(addr_bytes.data(), 8);
 
 			return std::make_tuple(peer_addr, key);
 		}
 
 		iterator& operator++() {
-			offset += 8 + crypto_box_PUBLICKEYBYTES;
+			offset += PeerSchema::size;
 
 			return *this;
 		}
@@ -295,7 +302,7 @@ struct LISTPEERWrapper {
 	}
 
 	iterator peers_end() const {
-		// Relies on validation ensuring correct size i.e. size % 8 = 1
+		// Relies on validation ensuring correct size i.e. a whole number of peer entries
 		// Otherwise, need to modify size below
 		return iterator(base.payload_buffer(), base.payload_buffer().size());
 	}
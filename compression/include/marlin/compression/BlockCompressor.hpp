@@ -4,6 +4,7 @@
 #include <marlin/core/Buffer.hpp>
 #include <cryptopp/blake2.h>
 
+#include <list>
 #include <unordered_map>
 #include <numeric>
 
@@ -13,8 +14,22 @@ namespace compression {
 
 struct BlockCompressor {
 private:
-	std::unordered_map<uint64_t, core::Buffer> txns;
-	std::unordered_map<uint64_t, uint64_t> txn_seen;
+	struct CachedTxn {
+		core::Buffer txn;
+		uint64_t seen;
+		std::list<uint64_t>::iterator order;
+	};
+
+	std::unordered_map<uint64_t, CachedTxn> txns;
+	// Txn ids, least recently seen first
+	std::list<uint64_t> seen_order;
+	size_t txn_bytes = 0;
+
+	void erase_txn(std::unordered_map<uint64_t, CachedTxn>::iterator iter) {
+		txn_bytes -= iter->second.txn.size();
+		seen_order.erase(iter->second.order);
+		txns.erase(iter);
+	}
 public:
 	void add_txn(core::Buffer&& txn, uint64_t timestamp) {
 		CryptoPP::BLAKE2b blake2b((uint)8);
@@ -22,12 +37,64 @@ public:
 		uint64_t txn_id;
 		blake2b.TruncatedFinal((uint8_t*)&txn_id, 8);
 
+		add_txn(txn_id, std::move(txn), timestamp);
+	}
+
+	/// Add a txn whose id was already computed, returns false if it was cached already.
+	/// Timestamps are not expected to go back.
+	bool add_txn(uint64_t txn_id, core::Buffer&& txn, uint64_t timestamp) {
+		auto iter = txns.find(txn_id);
+		if(iter != txns.end()) {
+			iter->second.seen = timestamp;
+			seen_order.splice(seen_order.end(), seen_order, iter->second.order);
+			return false;
+		}
+
+		txn_bytes += txn.size();
 		txns.try_emplace(
 			txn_id,
-			std::move(txn)
+			CachedTxn{std::move(txn), timestamp, seen_order.insert(seen_order.end(), txn_id)}
 		);
+		return true;
+	}
 
-		txn_seen[txn_id] = timestamp;
+	bool has_txn(uint64_t txn_id) const {
+		return txns.find(txn_id) != txns.end();
+	}
+
+	size_t num_txns() const {
+		return txns.size();
+	}
+
+	/// Total size of the cached txns
+	size_t num_bytes() const {
+		return txn_bytes;
+	}
+
+	/// Drop txns last seen before timestamp, returns the number dropped
+	size_t evict_txns(uint64_t timestamp) {
+		size_t num = 0;
+		while(!seen_order.empty()) {
+			auto iter = txns.find(seen_order.front());
+			if(iter->second.seen >= timestamp) {
+				break;
+			}
+
+			erase_txn(iter);
+			num++;
+		}
+
+		return num;
+	}
+
+	/// Drop the least recently seen txn, returns false if the cache is empty
+	bool evict_oldest() {
+		if(seen_order.empty()) {
+			return false;
+		}
+
+		erase_txn(txns.find(seen_order.front()));
+		return true;
 	}
 
 	void remove_txn(core::WeakBuffer const& txn) {
@@ -36,13 +103,14 @@ public:
 		uint64_t txn_id;
 		blake2b.TruncatedFinal((uint8_t*)&txn_id, 8);
 
-		txns.erase(txn_id);
-		txn_seen.erase(txn_id);
+		remove_txn(txn_id);
 	}
 
 	void remove_txn(uint64_t txn_id) {
-		txns.erase(txn_id);
-		txn_seen.erase(txn_id);
+		auto iter = txns.find(txn_id);
+		if(iter != txns.end()) {
+			erase_txn(iter);
+		}
 	}
 
 	core::Buffer compress(
@@ -171,7 +239,7 @@ public:
 				} else {
 					// Add txn
 					// FIXME: Const stripping, vector cannot hold const objects
-					txn_bufs.emplace_back((uint8_t*)iter->second.data(), iter->second.size());
+					txn_bufs.emplace_back((uint8_t*)iter->second.txn.data(), iter->second.txn.size());
 				}
 
 				offset += 9;
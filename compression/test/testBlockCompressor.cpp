@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+#include "marlin/compression/BlockCompressor.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::compression;
+
+static Buffer make_txn(uint8_t fill, size_t size = 100) {
+	Buffer txn(size);
+	std::memset(txn.data(), fill, size);
+	return txn;
+}
+
+static uint64_t txn_id(Buffer const& txn) {
+	CryptoPP::BLAKE2b blake2b((uint)8);
+	blake2b.Update(txn.data(), txn.size());
+	uint64_t id;
+	blake2b.TruncatedFinal((uint8_t*)&id, 8);
+	return id;
+}
+
+TEST(BlockCompressor, DedupsTxnsById) {
+	BlockCompressor compressor;
+
+	EXPECT_TRUE(compressor.add_txn(1, make_txn(1), 10));
+	EXPECT_FALSE(compressor.add_txn(1, make_txn(2), 20));
+	EXPECT_TRUE(compressor.add_txn(2, make_txn(2), 20));
+
+	EXPECT_EQ(compressor.num_txns(), 2u);
+	EXPECT_TRUE(compressor.has_txn(1));
+	EXPECT_TRUE(compressor.has_txn(2));
+	EXPECT_FALSE(compressor.has_txn(3));
+}
+
+TEST(BlockCompressor, EvictsTxnsNotSeenSinceTimestamp) {
+	BlockCompressor compressor;
+
+	compressor.add_txn(1, make_txn(1), 0);
+	compressor.add_txn(2, make_txn(2), 0);
+	// Seen again, the copy is dropped but the txn stays fresh
+	compressor.add_txn(1, make_txn(1), 100);
+
+	EXPECT_EQ(compressor.evict_txns(0), 0u);
+	EXPECT_EQ(compressor.evict_txns(50), 1u);
+	EXPECT_TRUE(compressor.has_txn(1));
+	EXPECT_FALSE(compressor.has_txn(2));
+
+	EXPECT_EQ(compressor.evict_txns(101), 1u);
+	EXPECT_EQ(compressor.num_txns(), 0u);
+	EXPECT_EQ(compressor.evict_txns(1000), 0u);
+}
+
+TEST(BlockCompressor, ReusesIdsAfterEvictionAndRemoval) {
+	BlockCompressor compressor;
+
+	compressor.add_txn(1, make_txn(1), 0);
+	compressor.evict_txns(10);
+	EXPECT_FALSE(compressor.has_txn(1));
+
+	EXPECT_TRUE(compressor.add_txn(1, make_txn(3), 20));
+	EXPECT_EQ(compressor.evict_txns(10), 0u);
+	EXPECT_TRUE(compressor.has_txn(1));
+
+	compressor.remove_txn(1);
+	EXPECT_FALSE(compressor.has_txn(1));
+	// Removed txns are not counted again on eviction
+	EXPECT_EQ(compressor.evict_txns(1000), 0u);
+
+	EXPECT_TRUE(compressor.add_txn(1, make_txn(4), 30));
+	EXPECT_EQ(compressor.num_txns(), 1u);
+}
+
+TEST(BlockCompressor, EvictsLeastRecentlySeenFirst) {
+	BlockCompressor compressor;
+
+	compressor.add_txn(1, make_txn(1, 100), 0);
+	compressor.add_txn(2, make_txn(2, 200), 10);
+	compressor.add_txn(3, make_txn(3, 300), 20);
+	// Seen again, moves behind 3
+	compressor.add_txn(1, make_txn(1, 100), 30);
+	EXPECT_EQ(compressor.num_bytes(), 600u);
+
+	EXPECT_TRUE(compressor.evict_oldest());
+	EXPECT_FALSE(compressor.has_txn(2));
+	EXPECT_EQ(compressor.num_bytes(), 400u);
+
+	compressor.remove_txn(3);
+	EXPECT_EQ(compressor.num_bytes(), 100u);
+
+	EXPECT_TRUE(compressor.evict_oldest());
+	EXPECT_FALSE(compressor.has_txn(1));
+	EXPECT_EQ(compressor.num_txns(), 0u);
+	EXPECT_EQ(compressor.num_bytes(), 0u);
+	EXPECT_FALSE(compressor.evict_oldest());
+}
+
+TEST(BlockCompressor, RemovesTxnsByContent) {
+	BlockCompressor compressor;
+	auto txn = make_txn(5);
+	auto id = txn_id(txn);
+
+	compressor.add_txn(make_txn(5), 0);
+	EXPECT_TRUE(compressor.has_txn(id));
+
+	compressor.remove_txn(WeakBuffer(txn.data(), txn.size()));
+	EXPECT_FALSE(compressor.has_txn(id));
+}
+
+TEST(BlockCompressor, CompressesCachedTxnsToIds) {
+	BlockCompressor compressor;
+	auto cached = make_txn(1);
+	auto uncached = make_txn(2);
+	compressor.add_txn(make_txn(1), 0);
+
+	uint8_t misc[] = {1, 2, 3};
+	auto compressed = compressor.compress(
+		{WeakBuffer(misc, sizeof(misc))},
+		{WeakBuffer(cached.data(), cached.size()), WeakBuffer(uncached.data(), uncached.size())}
+	);
+	// Misc, a 9 byte id for the cached txn and the other txn in full
+	EXPECT_EQ(compressed.size(), 8 + 8 + sizeof(misc) + 9 + 9 + uncached.size());
+
+	auto res = compressor.decompress(WeakBuffer(compressed.data(), compressed.size()));
+	ASSERT_TRUE(res.has_value());
+	auto& [misc_bufs, txn_bufs, holes] = *res;
+	ASSERT_EQ(misc_bufs.size(), 1u);
+	EXPECT_EQ(std::memcmp(misc_bufs[0].data(), misc, sizeof(misc)), 0);
+	ASSERT_EQ(txn_bufs.size(), 2u);
+	ASSERT_EQ(txn_bufs[0].size(), cached.size());
+	EXPECT_EQ(std::memcmp(txn_bufs[0].data(), cached.data(), cached.size()), 0);
+	ASSERT_EQ(txn_bufs[1].size(), uncached.size());
+	EXPECT_EQ(std::memcmp(txn_bufs[1].data(), uncached.data(), uncached.size()), 0);
+	EXPECT_TRUE(holes.empty());
+
+	// Decompressing without the txn leaves a hole
+	BlockCompressor empty;
+	auto holed = empty.decompress(WeakBuffer(compressed.data(), compressed.size()));
+	ASSERT_TRUE(holed.has_value());
+	EXPECT_EQ(std::get<2>(*holed).size(), 1u);
+}
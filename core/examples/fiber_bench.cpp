@@ -0,0 +1,199 @@
+// Throughput of the framing fibers on the split patterns used in the fiber tests:
+// many frames per read, frames straddling reads and frames spanning several reads
+
+#include <marlin/core/BufferPool.hpp>
+#include <marlin/core/fibers/LengthFramingFiber.hpp>
+#include <marlin/core/fibers/LengthBufferFiber.hpp>
+#include <marlin/core/fibers/SentinelFramingFiber.hpp>
+#include <marlin/core/fibers/SentinelBufferFiber.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace marlin::core;
+
+#define TOTAL_BYTES 1000000000
+
+struct Source {
+	int leftover(auto&& source, auto&& buf, SocketAddress addr) {
+		return source.did_recv(*this, std::move(buf), addr);
+	}
+};
+
+// LengthFramingFiber -> LengthBufferFiber -> sink
+struct LengthPipeline {
+	struct Outer {
+		LengthPipeline* p;
+		Outer(auto&&...) {}
+		auto& i(auto&&) { return *this; }
+		auto& o(auto&&) { return *this; }
+		auto& is(auto& f) { return f; }
+		auto& os(auto& f) { return f; }
+
+		int did_recv(auto&&, Buffer&& buf, uint64_t br, SocketAddress addr);
+		int did_recv_frame(auto&&, SocketAddress addr);
+	};
+	struct Inner {
+		LengthPipeline* p;
+		Inner(auto&&...) {}
+		auto& i(auto&&) { return *this; }
+		auto& o(auto&&) { return *this; }
+		auto& is(auto& f) { return f; }
+		auto& os(auto& f) { return f; }
+
+		int did_recv(auto&&, Buffer&& buf, SocketAddress addr);
+		void reset(uint64_t len);
+	};
+
+	Outer outer;
+	Inner inner;
+	LengthFramingFiber<Outer&> framing;
+	LengthBufferFiber<Inner&> buffer;
+	size_t frame_size;
+	uint64_t frames = 0;
+
+	LengthPipeline(size_t frame_size) :
+		framing(std::forward_as_tuple(outer)),
+		buffer(std::forward_as_tuple(inner)),
+		frame_size(frame_size) {
+		outer.p = this;
+		inner.p = this;
+		buffer.reset(frame_size);
+	}
+};
+
+int LengthPipeline::Outer::did_recv(auto&&, Buffer&& buf, uint64_t br, SocketAddress addr) {
+	return p->buffer.did_recv(*this, std::move(buf), br, addr);
+}
+
+int LengthPipeline::Outer::did_recv_frame(auto&&, SocketAddress addr) {
+	return p->buffer.did_recv_frame(*this, addr);
+}
+
+int LengthPipeline::Inner::did_recv(auto&&, Buffer&&, SocketAddress) {
+	p->frames++;
+	p->buffer.reset(p->frame_size);
+	return 0;
+}
+
+void LengthPipeline::Inner::reset(uint64_t len) {
+	p->framing.reset(len);
+}
+
+// SentinelFramingFiber -> SentinelBufferFiber -> sink
+struct SentinelPipeline {
+	struct Outer {
+		SentinelPipeline* p;
+		Outer(auto&&...) {}
+		auto& i(auto&&) { return *this; }
+		auto& o(auto&&) { return *this; }
+		auto& is(auto& f) { return f; }
+		auto& os(auto& f) { return f; }
+
+		int did_recv(auto&&, Buffer&& buf, SocketAddress addr);
+		int did_recv_sentinel(auto&&, SocketAddress addr);
+	};
+	struct Inner {
+		SentinelPipeline* p;
+		Inner(auto&&...) {}
+		auto& i(auto&&) { return *this; }
+		auto& o(auto&&) { return *this; }
+		auto& is(auto& f) { return f; }
+		auto& os(auto& f) { return f; }
+
+		int did_recv(auto&&, Buffer&& buf, SocketAddress addr);
+	};
+
+	Outer outer;
+	Inner inner;
+	SentinelFramingFiber<Outer&, '\n'> framing;
+	SentinelBufferFiber<Inner&> buffer;
+	size_t frame_size;
+	uint64_t frames = 0;
+
+	SentinelPipeline(size_t frame_size) :
+		framing(std::forward_as_tuple(outer)),
+		buffer(std::forward_as_tuple(inner)),
+		frame_size(frame_size) {
+		outer.p = this;
+		inner.p = this;
+		buffer.reset(frame_size);
+	}
+};
+
+int SentinelPipeline::Outer::did_recv(auto&&, Buffer&& buf, SocketAddress addr) {
+	return p->buffer.did_recv(*this, std::move(buf), addr);
+}
+
+int SentinelPipeline::Outer::did_recv_sentinel(auto&&, SocketAddress addr) {
+	return p->buffer.did_recv_sentinel(*this, addr);
+}
+
+int SentinelPipeline::Inner::did_recv(auto&&, Buffer&&, SocketAddress) {
+	p->frames++;
+	p->buffer.reset(p->frame_size);
+	return 0;
+}
+
+// Pre-generate one read worth of stream data, frames are repeated so any chunk offset works
+static void fill_sentinel_stream(uint8_t* out, size_t size, size_t frame_size) {
+	for(size_t i = 0; i < size; i++) {
+		out[i] = (i % frame_size == frame_size - 1) ? '\n' : 'a';
+	}
+}
+
+template<typename Pipeline>
+void bench(char const* name, size_t frame_size, size_t chunk_size, bool sentinel) {
+	// Frame and read sizes are powers of two so the pattern tiles the stream exactly
+	auto& pool = BufferPool::default_instance();
+	Pipeline pipeline(frame_size);
+	Source source;
+	auto addr = SocketAddress::from_string("127.0.0.1:8000");
+
+	auto pattern_size = std::max(frame_size, chunk_size);
+	std::vector<uint8_t> pattern(pattern_size);
+	if(sentinel) {
+		fill_sentinel_stream(pattern.data(), pattern_size, frame_size);
+	} else {
+		std::memset(pattern.data(), 'a', pattern_size);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	size_t offset = 0;
+	for(uint64_t total = 0; total < TOTAL_BYTES; total += chunk_size) {
+		// Stand in for the socket read into a pooled block
+		auto* raw = pool.acquire_raw();
+		std::memcpy(raw, pattern.data() + offset, chunk_size);
+		offset = (offset + chunk_size) % pattern_size;
+		pipeline.framing.did_recv(source, pool.adopt(raw, chunk_size), addr);
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	SPDLOG_INFO(
+		"{}: frame {} B, read {} B: {:.0f} MB/s, {:.2f} M frames/s",
+		name,
+		frame_size,
+		chunk_size,
+		TOTAL_BYTES / elapsed / 1e6,
+		pipeline.frames / elapsed / 1e6
+	);
+}
+
+int main() {
+	// Many frames per read
+	bench<LengthPipeline>("Length", 64, 65536, false);
+	bench<SentinelPipeline>("Sentinel", 64, 65536, true);
+	// Few frames per read
+	bench<LengthPipeline>("Length", 4096, 65536, false);
+	bench<SentinelPipeline>("Sentinel", 4096, 65536, true);
+	// Frames spanning several reads
+	bench<LengthPipeline>("Length", 262144, 65536, false);
+	bench<SentinelPipeline>("Sentinel", 262144, 65536, true);
+	// Small reads
+	bench<LengthPipeline>("Length", 1024, 1024, false);
+	bench<SentinelPipeline>("Sentinel", 1024, 1024, true);
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+// Throughput of the devp2p and NEAR framing loops over a recorded stream
+// Usage: framing_bench [near capture]
+//
+// The capture is a raw dump of the bytes a NEAR peer sent after connecting, e.g. one side
+// of a tcpflow session. Without it, and always for devp2p whose frames are encrypted on the
+// wire, a stream is synthesized from the message size mix an OnRamp sees: mostly small
+// announcements and transactions with the occasional block. Headers carry plaintext lengths
+// here, rlpx_bench measures the crypto on its own.
+
+#include <marlin/core/BufferPool.hpp>
+#include <marlin/core/FrameAssembler.hpp>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace marlin::core;
+
+#define TOTAL_BYTES 1000000000
+
+static size_t sample_message_size(std::mt19937& rng) {
+	auto p = rng() % 100;
+	if(p < 60) {
+		return 40 + rng() % 200;      // hash announcements, pings
+	} else if(p < 95) {
+		return 200 + rng() % 2000;    // transactions
+	} else {
+		return 20000 + rng() % 80000; // blocks
+	}
+}
+
+static std::vector<uint8_t> synthesize_devp2p(size_t size) {
+	std::mt19937 rng(1);
+	std::vector<uint8_t> stream;
+	stream.reserve(size + 200000);
+
+	while(stream.size() < size) {
+		uint32_t length = sample_message_size(rng);
+		uint32_t padded = (length + 15) / 16 * 16;
+
+		uint8_t header[32] = {(uint8_t)(length >> 16), (uint8_t)(length >> 8), (uint8_t)length, 0xc2, 0x80, 0x80};
+		stream.insert(stream.end(), header, header + 32);
+		stream.resize(stream.size() + padded + 16, 0xab);
+	}
+
+	return stream;
+}
+
+static std::vector<uint8_t> synthesize_near(size_t size) {
+	std::mt19937 rng(2);
+	std::vector<uint8_t> stream;
+	stream.reserve(size + 200000);
+
+	while(stream.size() < size) {
+		uint32_t length = sample_message_size(rng);
+
+		uint8_t prefix[4] = {(uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24)};
+		stream.insert(stream.end(), prefix, prefix + 4);
+		stream.resize(stream.size() + length, 0xcd);
+	}
+
+	return stream;
+}
+
+// Cut a capture after its last complete message so replays stay aligned
+static void trim_near(std::vector<uint8_t>& stream) {
+	size_t offset = 0;
+	while(offset + 4 <= stream.size()) {
+		uint32_t length = (uint32_t)stream[offset] | ((uint32_t)stream[offset + 1] << 8) |
+			((uint32_t)stream[offset + 2] << 16) | ((uint32_t)stream[offset + 3] << 24);
+		if(offset + 4 + (size_t)length > stream.size()) {
+			break;
+		}
+		offset += 4 + (size_t)length;
+	}
+
+	stream.resize(offset);
+}
+
+// Same loop as RlpxTransport::did_recv after the handshake
+struct Devp2pFramer {
+	FrameAssembler assembler;
+	bool in_header = true;
+	uint64_t messages = 0;
+
+	Devp2pFramer() {
+		assembler.expect(32);
+	}
+
+	void did_recv(Buffer&& bytes) {
+		while(bytes.size() > 0) {
+			auto unit = assembler.next(bytes);
+			if(!unit.has_value()) {
+				return;
+			}
+
+			if(in_header) {
+				uint32_t length = ((uint32_t)unit->data()[0] << 16) | ((uint32_t)unit->data()[1] << 8) | (uint32_t)unit->data()[2];
+				assembler.expect((length + 15) / 16 * 16 + 16);
+			} else {
+				messages++;
+				assembler.expect(32);
+			}
+			in_header = !in_header;
+		}
+	}
+};
+
+// Same loop as NearTransport::did_recv
+struct NearFramer {
+	FrameAssembler assembler;
+	bool in_length = true;
+	uint64_t messages = 0;
+
+	NearFramer() {
+		assembler.expect(4);
+	}
+
+	void did_recv(Buffer&& bytes) {
+		while(bytes.size() > 0) {
+			if(in_length) {
+				auto* prefix = assembler.peek(bytes, 4);
+				if(prefix == nullptr) {
+					return;
+				}
+
+				uint32_t length = (uint32_t)prefix[0] | ((uint32_t)prefix[1] << 8) |
+					((uint32_t)prefix[2] << 16) | ((uint32_t)prefix[3] << 24);
+				assembler.expect(4 + (size_t)length);
+				in_length = false;
+			}
+
+			auto message = assembler.next(bytes);
+			if(!message.has_value()) {
+				return;
+			}
+
+			message->cover_unsafe(4);
+			messages++;
+			assembler.expect(4);
+			in_length = true;
+		}
+	}
+};
+
+template<typename Framer>
+void bench(char const* name, std::vector<uint8_t> const& stream, size_t read_size) {
+	auto& pool = BufferPool::default_instance();
+	Framer framer;
+
+	uint64_t total = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(total < TOTAL_BYTES) {
+		// Replay the stream, a read never crosses the end so frames stay aligned across passes
+		for(size_t offset = 0; offset < stream.size(); offset += read_size) {
+			auto size = std::min(read_size, stream.size() - offset);
+
+			// Stand in for the socket read into a pooled block
+			auto* raw = pool.acquire_raw();
+			std::memcpy(raw, stream.data() + offset, size);
+			framer.did_recv(pool.adopt(raw, size));
+		}
+		total += stream.size();
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	SPDLOG_INFO(
+		"{}: read {} B: {:.0f} MB/s, {:.2f} M messages/s",
+		name,
+		read_size,
+		total / elapsed / 1e6,
+		framer.messages / elapsed / 1e6
+	);
+}
+
+int main(int argc, char** argv) {
+	auto devp2p = synthesize_devp2p(16000000);
+
+	std::vector<uint8_t> near;
+	if(argc > 1) {
+		std::ifstream capture(argv[1], std::ios::binary);
+		near.assign(std::istreambuf_iterator<char>(capture), std::istreambuf_iterator<char>());
+		trim_near(near);
+		SPDLOG_INFO("NEAR capture: {} bytes", near.size());
+	}
+	if(near.empty()) {
+		near = synthesize_near(16000000);
+	}
+
+	// Full libuv reads
+	bench<Devp2pFramer>("devp2p", devp2p, 65536);
+	bench<NearFramer>("NEAR", near, 65536);
+	// Segment sized reads, most messages span reads
+	bench<Devp2pFramer>("devp2p", devp2p, 1448);
+	bench<NearFramer>("NEAR", near, 1448);
+
+	return 0;
+}
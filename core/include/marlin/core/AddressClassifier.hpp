@@ -0,0 +1,69 @@
+/*! \file AddressClassifier.hpp
+	\brief Classifies peer addresses by longest matching prefix
+*/
+
+#ifndef MARLIN_CORE_ADDRESSCLASSIFIER_HPP
+#define MARLIN_CORE_ADDRESSCLASSIFIER_HPP
+
+#include "marlin/core/PrefixTrie.hpp"
+
+#include <cstdint>
+
+namespace marlin {
+namespace core {
+
+/// Class of an address, decided by the most specific configured prefix containing it
+enum class AddressClass : uint8_t {
+	Public = 0,
+	Internal,
+	Blocked,
+	RateLimited
+};
+
+/// @brief Prefix table classifying addresses, checked for every new peer
+/// @headerfile AddressClassifier.hpp <marlin/core/AddressClassifier.hpp>
+///
+/// More specific prefixes override less specific ones, so a single host
+/// can be blocked inside an internal range. Unmatched addresses are Public.
+class AddressClassifier {
+private:
+	PrefixTrie<AddressClass> trie;
+
+public:
+	/// Assign class to every address in block
+	void add(CidrBlock const& block, AddressClass cls) {
+		trie.insert(block, cls);
+	}
+
+	/// Assign class to every address in block given in string form
+	void add(std::string const& block, AddressClass cls) {
+		add(CidrBlock::from_string(block), cls);
+	}
+
+	AddressClass classify(SocketAddress const& addr) const {
+		auto* cls = trie.lookup(addr);
+		return cls == nullptr ? AddressClass::Public : *cls;
+	}
+
+	/// Shared classifier used by transports, starts out with private,
+	/// loopback and link local ranges marked Internal
+	static AddressClassifier& default_instance() {
+		static AddressClassifier classifier = [] {
+			AddressClassifier classifier;
+			classifier.add("10.0.0.0/8", AddressClass::Internal);
+			classifier.add("172.16.0.0/12", AddressClass::Internal);
+			classifier.add("192.168.0.0/16", AddressClass::Internal);
+			classifier.add("127.0.0.0/8", AddressClass::Internal);
+			classifier.add("::1/128", AddressClass::Internal);
+			classifier.add("fc00::/7", AddressClass::Internal);
+			classifier.add("fe80::/10", AddressClass::Internal);
+			return classifier;
+		}();
+		return classifier;
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_ADDRESSCLASSIFIER_HPP
@@ -6,12 +6,28 @@
 
 #include "marlin/core/WeakBuffer.hpp"
 
+#include <atomic>
+
 namespace marlin {
 namespace core {
 
+/// @brief Reference counted owner of memory shared between several Buffers
+/// @headerfile Buffer.hpp <marlin/core/Buffer.hpp>
+struct BufferStorage {
+	std::atomic<uint32_t> refcount = 1;
+	/// Called with the underlying memory once the last reference is gone
+	void (*release_fn)(BufferStorage*, uint8_t*) = nullptr;
+	void* data = nullptr;
+};
+
 /// @brief Byte buffer implementation with modifiable bounds and memory ownership
 /// @headerfile Buffer.hpp <marlin/core/Buffer.hpp>
 class Buffer : public BaseBuffer<Buffer> {
+private:
+	/// Shared owner of memory, nullptr if the buffer owns it exclusively
+	BufferStorage* storage = nullptr;
+
+	void destroy();
 public:
 	using BaseBuffer<Buffer>::BaseBuffer;
 
@@ -27,6 +43,9 @@ public:
 	/// Construct from uint8_t array - unsafe if uint8_t * isn't obtained from new
 	Buffer(uint8_t *buf, size_t size);
 
+	/// Construct from memory owned by storage, takes over one reference
+	Buffer(uint8_t *buf, size_t size, BufferStorage *storage);
+
 	/// Move contructor
 	Buffer(Buffer &&b) noexcept;
 
@@ -51,17 +70,27 @@ public:
 		return WeakBuffer((uint8_t*)data(), size());
 	}
 
-	/// Release the memory held by the buffer
-	inline uint8_t *release() {
-		uint8_t *_buf = buf;
-
-		buf = nullptr;
-		capacity = 0;
-		start_index = 0;
-		end_index = 0;
-
-		return _buf;
-	}
+	/// @brief Split off the first num bytes of the buffer without copying
+	/// @param num Number of bytes to split off, must not exceed size()
+	/// @return Buffer over the first num bytes, sharing memory with this one
+	///
+	/// This buffer is covered past the split point. The two buffers must not
+	/// be uncovered/expanded across the split point afterwards.
+	Buffer split(size_t num) &;
+
+	/// @brief Take another reference to the bytes of the buffer without copying
+	/// @return Buffer over the same bytes, sharing memory with this one
+	///
+	/// Lets one encoded message be handed to several transports. The bytes
+	/// must be treated as read-only while shared.
+	Buffer share() &;
+
+	/// Whether memory is shared with other buffers
+	bool is_shared() const;
+
+	/// @brief Release the memory held by the buffer, must not be shared
+	/// @return Memory from new[], or a raw block to be handed back with BufferPool::release_raw
+	uint8_t *release();
 
 	/// Get a WeakBuffer corresponding to the payload area
 	WeakBuffer payload_buffer() &;
@@ -0,0 +1,171 @@
+/*! \file BufferPool.hpp
+	\brief Pools of fixed size blocks for socket reads and variable sized frames
+*/
+
+#ifndef MARLIN_CORE_BUFFERPOOL_HPP
+#define MARLIN_CORE_BUFFERPOOL_HPP
+
+#include "marlin/core/Buffer.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace marlin {
+namespace core {
+
+/// @brief Recycles fixed size blocks handed out as Buffers
+/// @headerfile BufferPool.hpp <marlin/core/BufferPool.hpp>
+///
+/// Every block carries its BufferStorage header right in front of the data so
+/// that raw pointers handed to C APIs (libuv alloc callbacks) can be adopted back
+/// into Buffers. Blocks return to the pool once the last Buffer referencing them,
+/// including ones produced by Buffer::split, is destroyed.
+/// Not thread safe, buffers must be destroyed on the thread owning the pool.
+class BufferPool {
+private:
+	static constexpr size_t header_size = (sizeof(BufferStorage) + 15) & ~size_t(15);
+
+	size_t block_size;
+	size_t max_free;
+	std::vector<uint8_t*> free_blocks;
+
+	static BufferStorage* storage_of(uint8_t* data) {
+		return (BufferStorage*)(data - header_size);
+	}
+
+	static void release_block(BufferStorage* storage, uint8_t* data) {
+		auto& pool = *(BufferPool*)storage->data;
+		if(pool.free_blocks.size() < pool.max_free) {
+			pool.free_blocks.push_back(data);
+		} else {
+			free_block(data);
+		}
+	}
+
+	static void free_block(uint8_t* data) {
+		storage_of(data)->~BufferStorage();
+		delete[] (data - header_size);
+	}
+
+public:
+	/// Construct pool of blocks of given size, keeping at most max_free blocks around
+	BufferPool(size_t block_size, size_t max_free) :
+		block_size(block_size), max_free(max_free) {}
+
+	BufferPool(BufferPool const&) = delete;
+
+	~BufferPool() {
+		for(auto* data : free_blocks) {
+			free_block(data);
+		}
+	}
+
+	/// Pool of 64 KB blocks matching the libuv read size
+	static BufferPool& default_instance() {
+		static BufferPool pool(65536, 256);
+		return pool;
+	}
+
+	size_t get_block_size() const {
+		return block_size;
+	}
+
+	/// Get a block as raw memory of get_block_size() bytes, must be passed to adopt or release_raw
+	uint8_t* acquire_raw() {
+		if(!free_blocks.empty()) {
+			auto* data = free_blocks.back();
+			free_blocks.pop_back();
+			storage_of(data)->refcount.store(1, std::memory_order_relaxed);
+			return data;
+		}
+
+		auto* block = new uint8_t[header_size + block_size];
+		auto* storage = new (block) BufferStorage();
+		storage->release_fn = release_block;
+		storage->data = this;
+
+		return block + header_size;
+	}
+
+	/// Wrap the first size bytes of a raw block into a Buffer
+	Buffer adopt(uint8_t* data, size_t size) {
+		return Buffer(data, block_size, storage_of(data)).truncate_unsafe(block_size - size);
+	}
+
+	/// Return a raw block that was never adopted, nullptr is ignored
+	void release_raw(uint8_t* data) {
+		if(data == nullptr) {
+			return;
+		}
+		release_block(storage_of(data), data);
+	}
+
+	/// Get a block as a Buffer of get_block_size() bytes
+	Buffer get() {
+		return adopt(acquire_raw(), block_size);
+	}
+};
+
+/// @brief Hands out Buffers of any size from power of two size classes
+/// @headerfile BufferPool.hpp <marlin/core/BufferPool.hpp>
+///
+/// Every class is a BufferPool, a request is served from the smallest class that fits
+/// and the Buffer is truncated to the requested size. Requests above the largest class
+/// get plain heap memory. Each class keeps at most max_free_bytes worth of free blocks
+/// (at least one) so idle memory stays bounded no matter how large the classes get.
+/// Same threading rules as BufferPool.
+class SizeClassPool {
+private:
+	size_t min_block_size;
+	std::vector<std::unique_ptr<BufferPool>> pools;
+
+public:
+	/// Construct size classes from min_block_size up to max_block_size, both powers of two
+	SizeClassPool(size_t min_block_size, size_t max_block_size, size_t max_free_bytes) :
+		min_block_size(min_block_size) {
+		for(size_t block_size = min_block_size; block_size <= max_block_size; block_size *= 2) {
+			pools.emplace_back(new BufferPool(block_size, std::max<size_t>(1, max_free_bytes / block_size)));
+		}
+	}
+
+	SizeClassPool(SizeClassPool const&) = delete;
+
+	/// Classes from 256 B up to 16 MB, enough for any devp2p frame
+	static SizeClassPool& default_instance() {
+		static SizeClassPool pool(256, 1 << 24, 1 << 22);
+		return pool;
+	}
+
+	/// Block size of the class serving the given size, 0 if it is served from the heap
+	size_t block_size_for(size_t size) const {
+		size_t block_size = min_block_size;
+		for(size_t i = 0; i < pools.size(); i++) {
+			if(size <= block_size) {
+				return block_size;
+			}
+			block_size *= 2;
+		}
+
+		return 0;
+	}
+
+	/// Get a Buffer of exactly size bytes
+	Buffer get(size_t size) {
+		size_t block_size = min_block_size;
+		for(auto& pool : pools) {
+			if(size <= block_size) {
+				return pool->adopt(pool->acquire_raw(), size);
+			}
+			block_size *= 2;
+		}
+
+		return Buffer(size);
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_BUFFERPOOL_HPP
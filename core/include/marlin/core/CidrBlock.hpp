@@ -18,11 +18,14 @@ public:
 	/// Copy from another CidrBlock
 	CidrBlock(const CidrBlock &addr);
 
-	/// Build from block string
+	/// Build from block string, IPv4 or IPv6 prefix followed by /length
 	static CidrBlock from_string(std::string blockString);
 	/// Return the block in standard notation
 	std::string to_string() const;
 
+	/// Return the prefix length
+	uint16_t get_prefix_length() const;
+
 	/// Returns true if the block contains addr
 	bool does_contain_address(const SocketAddress &addr) const;
 };
@@ -0,0 +1,73 @@
+/*! \file ExpiringSet.hpp
+	\brief Set whose entries expire individually after a fixed time
+*/
+
+#ifndef MARLIN_CORE_EXPIRINGSET_HPP
+#define MARLIN_CORE_EXPIRINGSET_HPP
+
+#include <absl/container/flat_hash_map.h>
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace marlin {
+namespace core {
+
+/// @brief Set of keys that each expire ttl after their last insert
+/// @headerfile ExpiringSet.hpp <marlin/core/ExpiringSet.hpp>
+///
+/// Time is passed in by the caller so the set works with both the real and the simulated event loop.
+/// Expired keys stop being reported right away, expire() reclaims their memory in insertion order.
+template<typename KeyType>
+class ExpiringSet {
+private:
+	uint64_t ttl;
+	absl::flat_hash_map<KeyType, uint64_t> expiry;
+	// Insertion order, stale entries from reinserts or erases are skipped on expire
+	std::deque<std::pair<uint64_t, KeyType>> queue;
+
+public:
+	ExpiringSet(uint64_t ttl) : ttl(ttl) {}
+
+	/// Insert key, or push back its expiry if already present
+	void insert(KeyType const& key, uint64_t now) {
+		expiry[key] = now + ttl;
+		queue.emplace_back(now + ttl, key);
+	}
+
+	bool contains(KeyType const& key, uint64_t now) const {
+		auto iter = expiry.find(key);
+		return iter != expiry.end() && iter->second > now;
+	}
+
+	void erase(KeyType const& key) {
+		expiry.erase(key);
+	}
+
+	/// Drop every key that expired at or before now
+	void expire(uint64_t now) {
+		while(!queue.empty() && queue.front().first <= now) {
+			auto iter = expiry.find(queue.front().second);
+			if(iter != expiry.end() && iter->second <= now) {
+				expiry.erase(iter);
+			}
+			queue.pop_front();
+		}
+	}
+
+	/// Number of keys, including expired ones not yet dropped by expire()
+	size_t size() const {
+		return expiry.size();
+	}
+
+	void clear() {
+		expiry.clear();
+		queue.clear();
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_EXPIRINGSET_HPP
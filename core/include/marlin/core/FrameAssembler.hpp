@@ -0,0 +1,122 @@
+/*! \file FrameAssembler.hpp
+	\brief Cuts frames of known size out of a stream of reads
+*/
+
+#ifndef MARLIN_CORE_FRAMEASSEMBLER_HPP
+#define MARLIN_CORE_FRAMEASSEMBLER_HPP
+
+#include "marlin/core/BufferPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+namespace marlin {
+namespace core {
+
+/// @brief Turns reads from a byte stream into frames whose size is set before each frame
+/// @headerfile FrameAssembler.hpp <marlin/core/FrameAssembler.hpp>
+///
+/// A frame that is whole within a read is split off it by reference, so it can be decoded
+/// in place without copying. Only a frame that spans reads is gathered into storage from
+/// SizeClassPool. Meant to be driven from a loop in the transport's did_recv:
+///
+///     while(bytes.size() > 0) {
+///         auto frame = assembler.next(bytes);
+///         if(!frame.has_value()) return;
+///         // decode, then set the size of the following frame with expect
+///     }
+///
+/// Length prefixes are read with peek, which leaves the prefix as part of the frame.
+class FrameAssembler {
+private:
+	// Frame gathered so far when it spans reads
+	Buffer buf = Buffer(nullptr, 0);
+	size_t buf_size = 0;
+	size_t frame_size = 0;
+
+	// Copy up to size bytes of the current frame from bytes into buf
+	void gather(Buffer& bytes, size_t size) {
+		if(buf_size == 0) {
+			buf = SizeClassPool::default_instance().get(frame_size);
+		}
+
+		auto num = std::min(size - buf_size, bytes.size());
+		std::memcpy(buf.data() + buf_size, bytes.data(), num);
+		buf_size += num;
+		bytes.cover_unsafe(num);
+	}
+
+public:
+	/// Set the size of the current frame, bytes already gathered for it are kept
+	void expect(size_t size) {
+		if(buf_size > 0 && buf.size() < size) {
+			auto grown = SizeClassPool::default_instance().get(size);
+			std::memcpy(grown.data(), buf.data(), buf_size);
+			buf = std::move(grown);
+		}
+
+		frame_size = size;
+	}
+
+	/// Size of the current frame
+	size_t size() const {
+		return frame_size;
+	}
+
+	/// Bytes of the current frame gathered from previous reads
+	size_t gathered() const {
+		return buf_size;
+	}
+
+	/// @brief Look at the first num bytes of the current frame without taking them
+	/// @return Pointer to the bytes, nullptr if bytes did not have enough of them, in which
+	/// case everything in bytes has been gathered and the caller should wait for more reads
+	///
+	/// Grows the current frame to num bytes if it is smaller.
+	uint8_t const* peek(Buffer& bytes, size_t num) {
+		if(buf_size == 0 && bytes.size() >= num) {
+			return bytes.data();
+		}
+
+		if(frame_size < num) {
+			expect(num);
+		}
+
+		if(buf_size < num) {
+			gather(bytes, num);
+		}
+
+		return buf_size >= num ? buf.data() : nullptr;
+	}
+
+	/// @brief Take the current frame out of bytes
+	/// @return The frame, nullopt if bytes ended before it did, in which case everything
+	/// in bytes has been gathered and the caller should wait for more reads
+	///
+	/// The frame size has to be set again with expect before the next frame.
+	std::optional<Buffer> next(Buffer& bytes) {
+		if(buf_size == 0 && bytes.size() >= frame_size) {
+			// Whole frame in this read, no copy
+			auto frame = bytes.size() == frame_size ? std::move(bytes) : bytes.split(frame_size);
+			frame_size = 0;
+			return frame;
+		}
+
+		gather(bytes, frame_size);
+		if(buf_size < frame_size) {
+			return std::nullopt;
+		}
+
+		auto frame = std::move(buf);
+		frame.truncate_unsafe(frame.size() - frame_size);
+		buf_size = 0;
+		frame_size = 0;
+		return frame;
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_FRAMEASSEMBLER_HPP
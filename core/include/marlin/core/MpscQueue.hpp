@@ -0,0 +1,82 @@
+/*! \file MpscQueue.hpp
+	\brief Lock-free multi producer single consumer queue
+*/
+
+#ifndef MARLIN_CORE_MPSCQUEUE_HPP
+#define MARLIN_CORE_MPSCQUEUE_HPP
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace marlin {
+namespace core {
+
+/// @brief Unbounded queue that any thread can push to and a single thread pops from
+/// @headerfile MpscQueue.hpp <marlin/core/MpscQueue.hpp>
+///
+/// Intrusive linked list with a stub node, producers only ever swap the head so a push is
+/// a single atomic exchange. A pop can miss an element whose push is still in progress,
+/// producers are expected to wake the consumer after pushing so it gets picked up then.
+template<typename T>
+class MpscQueue {
+private:
+	struct Node {
+		std::atomic<Node*> next = nullptr;
+		std::optional<T> value;
+	};
+
+	// Last pushed node, shared by producers
+	alignas(64) std::atomic<Node*> head;
+	// Last popped node, owned by the consumer
+	alignas(64) Node* tail;
+
+public:
+	MpscQueue() {
+		auto* stub = new Node();
+		head.store(stub, std::memory_order_relaxed);
+		tail = stub;
+	}
+
+	MpscQueue(MpscQueue const&) = delete;
+
+	~MpscQueue() {
+		while(pop().has_value()) {}
+		delete tail;
+	}
+
+	/// Push from any thread
+	void push(T&& value) {
+		auto* node = new Node();
+		node->value.emplace(std::move(value));
+
+		auto* prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/// Pop from the consumer thread, returns nullopt if there is nothing to pop
+	std::optional<T> pop() {
+		auto* next = tail->next.load(std::memory_order_acquire);
+		if(next == nullptr) {
+			return std::nullopt;
+		}
+
+		T value = std::move(*next->value);
+		next->value.reset();
+
+		delete tail;
+		tail = next;
+
+		return value;
+	}
+
+	/// Check from the consumer thread if there is nothing to pop
+	bool empty() const {
+		return tail->next.load(std::memory_order_acquire) == nullptr;
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_MPSCQUEUE_HPP
@@ -0,0 +1,139 @@
+/*! \file PrefixRateLimiter.hpp
+	\brief Token bucket rate limits shared by all addresses in a prefix
+*/
+
+#ifndef MARLIN_CORE_PREFIXRATELIMITER_HPP
+#define MARLIN_CORE_PREFIXRATELIMITER_HPP
+
+#include "marlin/core/SocketAddress.hpp"
+
+#include <absl/container/flat_hash_map.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+
+namespace marlin {
+namespace core {
+
+/// @brief Token bucket per source prefix
+/// @headerfile PrefixRateLimiter.hpp <marlin/core/PrefixRateLimiter.hpp>
+///
+/// Addresses are grouped by their leading bits (a /24 for IPv4 and a /48 for IPv6 by default)
+/// so a single host cannot get around the limit by cycling ports or neighbouring addresses.
+/// The number of tracked prefixes is capped. Buckets are kept in least recently used order and a
+/// new prefix evicts the bucket idle the longest, which has refilled the most, in constant time.
+/// Time is passed in by the caller in milliseconds.
+class PrefixRateLimiter {
+private:
+	struct Bucket {
+		SocketAddressKey key;
+		double tokens;
+		uint64_t last;
+	};
+	using BucketList = std::list<Bucket>;
+
+	// Tokens per millisecond
+	double rate;
+	double burst;
+	uint16_t ipv4_prefix;
+	uint16_t ipv6_prefix;
+	size_t max_buckets;
+
+	// Least recently used first
+	BucketList lru;
+	absl::flat_hash_map<SocketAddressKey, BucketList::iterator> buckets;
+	size_t num_evictions = 0;
+
+	SocketAddressKey prefix_key(SocketAddress const& addr) const {
+		auto key = addr.key();
+		key.port = 0;
+
+		size_t prefix_length = addr.is_ipv6() ? ipv6_prefix : ipv4_prefix;
+		for(size_t i = 0; i < key.ip.size(); i++) {
+			if(prefix_length >= 8) {
+				prefix_length -= 8;
+			} else {
+				key.ip[i] &= (0xff << (8 - prefix_length)) & 0xff;
+				prefix_length = 0;
+			}
+		}
+
+		return key;
+	}
+
+	double refill(Bucket const& bucket, uint64_t now) const {
+		return std::min(burst, bucket.tokens + (now - bucket.last) * rate);
+	}
+
+public:
+	/// Allow rate_per_sec events per prefix on average with bursts of up to burst events
+	PrefixRateLimiter(
+		double rate_per_sec,
+		double burst,
+		uint16_t ipv4_prefix = 24,
+		uint16_t ipv6_prefix = 48,
+		size_t max_buckets = 65536
+	) : rate(rate_per_sec / 1000),
+		burst(burst),
+		ipv4_prefix(ipv4_prefix),
+		ipv6_prefix(ipv6_prefix),
+		max_buckets(max_buckets) {}
+
+	/// Change the limits, existing buckets keep their tokens
+	void set_limit(double rate_per_sec, double burst) {
+		this->rate = rate_per_sec / 1000;
+		this->burst = burst;
+	}
+
+	/// Consume a token from the bucket of addr's prefix, returns false if there is none left
+	bool allow(SocketAddress const& addr, uint64_t now) {
+		auto key = prefix_key(addr);
+
+		auto iter = buckets.find(key);
+		if(iter == buckets.end()) {
+			if(burst < 1) {
+				return false;
+			}
+			if(buckets.size() >= max_buckets) {
+				// Reuse the node of the least recently used bucket
+				auto& oldest = lru.front();
+				buckets.erase(oldest.key);
+				oldest = Bucket{key, burst - 1, now};
+				lru.splice(lru.end(), lru, lru.begin());
+				num_evictions++;
+			} else {
+				lru.push_back(Bucket{key, burst - 1, now});
+			}
+
+			buckets.emplace(key, std::prev(lru.end()));
+			return true;
+		}
+
+		lru.splice(lru.end(), lru, iter->second);
+		auto& bucket = *iter->second;
+		bucket.tokens = refill(bucket, now);
+		bucket.last = now;
+		if(bucket.tokens < 1) {
+			return false;
+		}
+
+		bucket.tokens -= 1;
+		return true;
+	}
+
+	/// Number of prefixes currently tracked
+	size_t size() const {
+		return buckets.size();
+	}
+
+	/// Number of buckets evicted to make room for new prefixes
+	size_t evictions() const {
+		return num_evictions;
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_PREFIXRATELIMITER_HPP
@@ -0,0 +1,112 @@
+/*! \file PrefixTrie.hpp
+	\brief Longest prefix match table keyed by CidrBlock
+*/
+
+#ifndef MARLIN_CORE_PREFIXTRIE_HPP
+#define MARLIN_CORE_PREFIXTRIE_HPP
+
+#include "marlin/core/CidrBlock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace marlin {
+namespace core {
+
+/// @brief Maps CidrBlocks to values, lookups return the value of the longest matching prefix
+/// @headerfile PrefixTrie.hpp <marlin/core/PrefixTrie.hpp>
+///
+/// Multibit trie with 8 bit strides, prefixes not on a byte boundary are expanded
+/// into every slot they cover. A lookup reads one slot per address byte and stops at
+/// the first missing child, so at most 4 reads for IPv4 and 16 for IPv6.
+/// Meant to be built once from configuration, inserts are not optimized.
+template<typename ValueType>
+class PrefixTrie {
+private:
+	struct Slot {
+		// Index into nodes, 0 when there is no child since roots are never children
+		uint32_t child = 0;
+		// Index into values plus one, 0 when no prefix covers this slot
+		uint32_t value = 0;
+		// Length of the prefix owning value, longer ones win on overlap
+		uint32_t length = 0;
+	};
+	using Node = std::array<Slot, 256>;
+
+	static constexpr uint32_t ipv4_root = 0;
+	static constexpr uint32_t ipv6_root = 1;
+
+	std::vector<Node> nodes;
+	std::vector<ValueType> values;
+	// Values of /0 prefixes
+	uint32_t ipv4_default = 0;
+	uint32_t ipv6_default = 0;
+
+public:
+	PrefixTrie() : nodes(2) {}
+
+	/// Map every address in block to value, replaces the value of an identical prefix
+	void insert(CidrBlock const& block, ValueType value) {
+		auto key = block.key();
+		uint32_t max_length = block.is_ipv6() ? 128 : 32;
+		uint32_t length = std::min<uint32_t>(block.get_prefix_length(), max_length);
+
+		values.push_back(std::move(value));
+		uint32_t value_idx = values.size();
+
+		if(length == 0) {
+			(block.is_ipv6() ? ipv6_default : ipv4_default) = value_idx;
+			return;
+		}
+
+		uint32_t node = block.is_ipv6() ? ipv6_root : ipv4_root;
+		uint32_t depth = (length - 1) / 8;
+		for(uint32_t i = 0; i < depth; i++) {
+			if(nodes[node][key.ip[i]].child == 0) {
+				// Might reallocate, do not hold slot references across this
+				nodes.emplace_back();
+				nodes[node][key.ip[i]].child = nodes.size() - 1;
+			}
+			node = nodes[node][key.ip[i]].child;
+		}
+
+		// Expand remaining bits over the slots they cover
+		uint32_t bits = length - depth * 8;
+		uint32_t start = key.ip[depth] & (0xff << (8 - bits)) & 0xff;
+		uint32_t end = start + (1 << (8 - bits));
+		for(uint32_t i = start; i < end; i++) {
+			auto& slot = nodes[node][i];
+			if(slot.length <= length) {
+				slot.value = value_idx;
+				slot.length = length;
+			}
+		}
+	}
+
+	/// Return value of the longest prefix containing addr, nullptr if there is none
+	ValueType const* lookup(SocketAddress const& addr) const {
+		auto key = addr.key();
+		uint32_t node = addr.is_ipv6() ? ipv6_root : ipv4_root;
+		uint32_t best = addr.is_ipv6() ? ipv6_default : ipv4_default;
+		size_t num_bytes = addr.is_ipv6() ? 16 : 4;
+
+		for(size_t i = 0; i < num_bytes; i++) {
+			auto const& slot = nodes[node][key.ip[i]];
+			if(slot.value != 0) {
+				best = slot.value;
+			}
+			if(slot.child == 0) {
+				break;
+			}
+			node = slot.child;
+		}
+
+		return best == 0 ? nullptr : &values[best - 1];
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_PREFIXTRIE_HPP
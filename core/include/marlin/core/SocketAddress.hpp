@@ -4,12 +4,31 @@
 #include <stdint.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <array>
+#include <compare>
 #include <string>
 #include <vector>
 
+#include <absl/hash/hash.h>
+
 namespace marlin {
 namespace core {
 
+/// Compact comparable form of a SocketAddress, holds only the bytes that identify it
+/// IPv4 addresses use the first 4 bytes of ip, the rest are zero
+struct SocketAddressKey {
+	std::array<uint8_t, 16> ip = {};
+	uint16_t port = 0;
+	uint16_t family = 0;
+
+	auto operator<=>(const SocketAddressKey &other) const = default;
+
+	template<typename H>
+	friend H AbslHashValue(H h, const SocketAddressKey &key) {
+		return H::combine(std::move(h), key.ip, key.port, key.family);
+	}
+};
+
 /// Wraps sockaddr(_*) and adds convenience methods
 class SocketAddress: public sockaddr_storage
 {
@@ -42,7 +61,7 @@ public:
 	/// Copy assign from a sockaddr_in6
 	SocketAddress &operator=(const sockaddr_in6 &addr);
 
-	/// Build from address string
+	/// Build from address string, a.b.c.d:port or [ipv6]:port
 	static SocketAddress from_string(std::string addrString);
 	/// Return the address and port in standard notation
 	std::string to_string() const;
@@ -57,6 +76,16 @@ public:
 
 	/// Loopback IPv4 address
 	static SocketAddress loopback_ipv4(uint16_t port);
+	/// Loopback IPv6 address
+	static SocketAddress loopback_ipv6(uint16_t port);
+
+	/// Returns true for AF_INET addresses
+	bool is_ipv4() const;
+	/// Returns true for AF_INET6 addresses
+	bool is_ipv6() const;
+
+	/// Return the compact key, ignores padding, flow info and scope
+	SocketAddressKey key() const;
 
 	/// Equality operator
 	bool operator==(const SocketAddress &other) const;
@@ -64,7 +93,13 @@ public:
 	/// Comparison operator
 	bool operator<(const SocketAddress &other) const;
 
-	/// Serialize into bytes
+	/// Hash for absl containers, seeded per process
+	template<typename H>
+	friend H AbslHashValue(H h, const SocketAddress &addr) {
+		return H::combine(std::move(h), addr.key());
+	}
+
+	/// Serialize into bytes, 8 bytes for IPv4 and 20 bytes for IPv6
 	size_t serialize(uint8_t* bytes, size_t size) const;
 	/// Deserialize from bytes
 	static SocketAddress deserialize(uint8_t const* bytes, size_t size);
@@ -79,9 +114,10 @@ namespace std {
 	struct hash<marlin::core::SocketAddress>
 	{
 		/// Hash function for SocketAddress so it can be used as a key
+		/// Uses the per process seeded absl hash so peers cannot pick colliding addresses
 		size_t operator()(const marlin::core::SocketAddress &addr) const
 		{
-			return std::hash<uint32_t>()(reinterpret_cast<const sockaddr_in *>(&addr)->sin_addr.s_addr) ^ std::hash<uint16_t>()(reinterpret_cast<const sockaddr_in *>(&addr)->sin_port);
+			return absl::Hash<marlin::core::SocketAddressKey>()(addr.key());
 		}
 	};
 }
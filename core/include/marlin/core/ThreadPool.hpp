@@ -0,0 +1,217 @@
+/*! \file ThreadPool.hpp
+	\brief Work stealing thread pool for CPU heavy jobs
+*/
+
+#ifndef MARLIN_CORE_THREADPOOL_HPP
+#define MARLIN_CORE_THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace marlin {
+namespace core {
+
+/// @brief Move only type erased callable with no arguments
+/// @headerfile ThreadPool.hpp <marlin/core/ThreadPool.hpp>
+///
+/// Unlike std::function it can hold callables that capture move only state like Buffers.
+class Task {
+private:
+	struct Base {
+		virtual ~Base() = default;
+		virtual void run() = 0;
+	};
+
+	template<typename F>
+	struct Impl final : Base {
+		F f;
+
+		Impl(F&& f) : f(std::move(f)) {}
+
+		void run() override {
+			f();
+		}
+	};
+
+	std::unique_ptr<Base> impl;
+
+public:
+	Task() = default;
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+	Task(F&& f) : impl(new Impl<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(f)))) {}
+
+	void operator()() {
+		impl->run();
+	}
+
+	explicit operator bool() const {
+		return impl != nullptr;
+	}
+};
+
+/// @brief Fixed set of worker threads with a task deque each
+/// @headerfile ThreadPool.hpp <marlin/core/ThreadPool.hpp>
+///
+/// Tasks submitted from a worker go to the back of its own deque and are popped LIFO, which
+/// keeps follow up work on a warm cache. Tasks from other threads are spread round robin.
+/// A worker that runs dry steals from the front of the other deques before going to sleep.
+///
+/// A pool with zero threads runs every task inline on the submitting thread, which gives
+/// deterministic execution order for tests and simulations.
+class ThreadPool {
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	// Round robin index for external submissions
+	std::atomic<size_t> next_worker = 0;
+	// Tasks queued but not yet picked up
+	std::atomic<size_t> pending = 0;
+	// Workers blocked on idle_cv
+	std::atomic<size_t> sleeping = 0;
+
+	std::mutex idle_mutex;
+	std::condition_variable idle_cv;
+	bool stopping = false;
+
+	inline static thread_local ThreadPool* current_pool = nullptr;
+	inline static thread_local size_t current_index = 0;
+
+	bool pop_local(size_t idx, Task& task) {
+		auto& worker = *workers[idx];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if(worker.tasks.empty()) {
+			return false;
+		}
+
+		task = std::move(worker.tasks.back());
+		worker.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(size_t idx, Task& task) {
+		for(size_t i = 1; i < workers.size(); i++) {
+			auto& victim = *workers[(idx + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if(victim.tasks.empty()) {
+				continue;
+			}
+
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+
+		return false;
+	}
+
+	void run_worker(size_t idx) {
+		current_pool = this;
+		current_index = idx;
+
+		while(true) {
+			Task task;
+			if(pop_local(idx, task) || steal(idx, task)) {
+				pending.fetch_sub(1);
+				task();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			sleeping.fetch_add(1);
+			idle_cv.wait(lock, [this] { return stopping || pending.load() > 0; });
+			sleeping.fetch_sub(1);
+
+			if(stopping && pending.load() == 0) {
+				return;
+			}
+		}
+	}
+
+public:
+	/// Start the given number of worker threads, zero runs tasks inline
+	ThreadPool(size_t num_threads) {
+		workers.reserve(num_threads);
+		for(size_t i = 0; i < num_threads; i++) {
+			workers.emplace_back(new Worker());
+		}
+
+		threads.reserve(num_threads);
+		for(size_t i = 0; i < num_threads; i++) {
+			threads.emplace_back(&ThreadPool::run_worker, this, i);
+		}
+	}
+
+	ThreadPool(ThreadPool const&) = delete;
+
+	/// Runs every queued task before joining the workers
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			stopping = true;
+		}
+		idle_cv.notify_all();
+
+		for(auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	/// Pool with a worker for every core except the one running the event loop
+	static ThreadPool& default_instance() {
+		static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		return pool;
+	}
+
+	/// Number of worker threads
+	size_t size() const {
+		return threads.size();
+	}
+
+	/// Queue a task, callable from any thread
+	void submit(Task&& task) {
+		if(workers.empty()) {
+			task();
+			return;
+		}
+
+		size_t idx = current_pool == this ?
+			current_index :
+			next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+		// Counted before the push so it never goes below zero when a worker grabs the task early
+		pending.fetch_add(1);
+
+		{
+			auto& worker = *workers[idx];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+		}
+
+		// Pairs with the sleeping count in run_worker, either the worker sees the task
+		// before it waits or we see it sleeping and wake it up
+		if(sleeping.load() > 0) {
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			idle_cv.notify_one();
+		}
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_THREADPOOL_HPP
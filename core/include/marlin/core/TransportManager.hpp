@@ -4,6 +4,7 @@
 #ifndef MARLIN_CORE_TRANSPORTMANAGER_HPP
 #define MARLIN_CORE_TRANSPORTMANAGER_HPP
 
+#include <memory>
 #include <unordered_map>
 #include <utility>
 #include "marlin/core/SocketAddress.hpp"
@@ -20,6 +21,13 @@ class TransportManager {
 		std::unique_ptr<TransportType>
 	> transport_map;
 
+	/// Transports which can also be found by a connection id, for transports which outlive an address.
+	/// Can be shared with managers of other local addresses
+	std::shared_ptr<absl::flat_hash_map<
+		uint32_t,
+		TransportType *
+	>> conn_id_map = std::make_shared<absl::flat_hash_map<uint32_t, TransportType *>>();
+
 	// Prevent copy, causes subtle bugs with objects holding onto different instances because of implicit copy somewhere
 	TransportManager(TransportManager const&) = delete;
 public:
@@ -55,6 +63,50 @@ public:
 	void erase(SocketAddress const &addr) {
 		transport_map.erase(addr);
 	}
+
+	/// Exchange the transports at two destination addresses,
+	/// used when a connection moves over to the address of another transport
+	void swap(SocketAddress const &addr1, SocketAddress const &addr2) {
+		auto iter1 = transport_map.find(addr1);
+		auto iter2 = transport_map.find(addr2);
+		if(iter1 == transport_map.end() || iter2 == transport_map.end()) {
+			return;
+		}
+
+		std::swap(iter1->second, iter2->second);
+	}
+
+	/// Get transport with a given connection id,
+	/// returns nullptr if no transport is found
+	TransportType *get_by_conn_id(uint32_t conn_id) {
+		auto iter = conn_id_map->find(conn_id);
+		if(iter == conn_id_map->end()) {
+			return nullptr;
+		}
+
+		return iter->second;
+	}
+
+	/// Make transport findable by the given connection id,
+	/// returns false and leaves the mapping alone if another transport has the id
+	bool set_conn_id(uint32_t conn_id, TransportType *transport) {
+		auto res = conn_id_map->try_emplace(conn_id, transport);
+		return res.second || res.first->second == transport;
+	}
+
+	/// Remove connection id of the given transport, ignored if the id belongs to another transport
+	void erase_conn_id(uint32_t conn_id, TransportType *transport) {
+		auto iter = conn_id_map->find(conn_id);
+		if(iter != conn_id_map->end() && iter->second == transport) {
+			conn_id_map->erase(iter);
+		}
+	}
+
+	/// Find transports by connection id across both managers, ids set on this one so far are dropped.
+	/// Used by managers of different local addresses of the same node
+	void share_conn_ids(TransportManager &other) {
+		conn_id_map = other.conn_id_map;
+	}
 };
 
 } // namespace core
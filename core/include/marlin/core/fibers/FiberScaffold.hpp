@@ -4,9 +4,72 @@
 #include <marlin/core/Buffer.hpp>
 #include <marlin/core/SocketAddress.hpp>
 
+#include <span>
+#include <type_traits>
+#include <vector>
+
 namespace marlin {
 namespace core {
 
+/// Message along with its peer address, unit of the batch interface
+template<typename MessageType>
+struct BatchEntry {
+	MessageType msg;
+	SocketAddress addr;
+};
+
+/// Deliver a batch inwards, in one call if target implements did_recv_batch, one did_recv per message otherwise
+/// Every message is delivered, the first error is returned
+template<typename MessageType>
+int batch_did_recv(auto&& target, auto&& src, std::span<BatchEntry<MessageType>> batch) {
+	if constexpr (requires { target.did_recv_batch(src, batch); }) {
+		return target.did_recv_batch(src, batch);
+	} else {
+		int ret = 0;
+		for(auto& entry : batch) {
+			auto res = target.did_recv(src, std::move(entry.msg), entry.addr);
+			if(res < 0 && ret == 0) {
+				ret = res;
+			}
+		}
+		return ret;
+	}
+}
+
+/// Send a batch outwards, in one call if target implements send_batch, one send per message otherwise
+/// Every message is sent, the first error is returned
+template<typename MessageType>
+int batch_send(auto&& target, auto&& src, std::span<BatchEntry<MessageType>> batch) {
+	if constexpr (requires { target.send_batch(src, batch); }) {
+		return target.send_batch(src, batch);
+	} else {
+		int ret = 0;
+		for(auto& entry : batch) {
+			auto res = target.send(src, std::move(entry.msg), entry.addr);
+			if(res < 0 && ret == 0) {
+				ret = res;
+			}
+		}
+		return ret;
+	}
+}
+
+/// Hand a batch on as ToType, the message type of the next hop
+/// Converting means moving every message into a new batch, done once per hop and not per message
+template<typename ToType, typename MessageType>
+int batch_convert(auto&& forward, std::span<BatchEntry<MessageType>> batch) {
+	if constexpr (std::is_same_v<ToType, MessageType>) {
+		return forward(batch);
+	} else {
+		std::vector<BatchEntry<ToType>> converted;
+		converted.reserve(batch.size());
+		for(auto& entry : batch) {
+			converted.push_back({ToType(std::move(entry.msg)), entry.addr});
+		}
+		return forward(std::span(converted));
+	}
+}
+
 
 template<typename Fiber, typename ExtFabric, typename IMT = Buffer, typename OMT = Buffer>
 class FiberScaffold {
@@ -20,6 +83,30 @@ public:
 protected:
 	[[no_unique_address]] ExtFabric ext_fabric;
 
+private:
+	// Whether Fiber leaves did_recv/send to the scaffold, batches can then skip the fiber entirely
+	template<typename SrcType>
+	static constexpr bool is_recv_passthrough() {
+		if constexpr (requires { &Fiber::template did_recv<SrcType>; }) {
+			return std::is_same_v<
+				decltype(&Fiber::template did_recv<SrcType>),
+				decltype(&FiberScaffold::template did_recv<SrcType>)
+			>;
+		}
+		return false;
+	}
+
+	template<typename SrcType>
+	static constexpr bool is_send_passthrough() {
+		if constexpr (requires { &Fiber::template send<SrcType>; }) {
+			return std::is_same_v<
+				decltype(&Fiber::template send<SrcType>),
+				decltype(&FiberScaffold::template send<SrcType>)
+			>;
+		}
+		return false;
+	}
+
 public:
 	template<typename ExtTupleType>
 	FiberScaffold(std::tuple<ExtTupleType>&& init_tuple) :
@@ -30,6 +117,26 @@ public:
 		return ext_fabric.i(*(Fiber*)this).did_recv(ext_fabric.is(*(Fiber*)this), std::move(buf), addr);
 	}
 
+	/// Batch counterpart of did_recv, fibers can implement it to amortize per message work
+	/// Fibers that do not get each message through their did_recv in order
+	template<typename MessageType>
+	int did_recv_batch(auto&& src, std::span<BatchEntry<MessageType>> batch) {
+		if constexpr (is_recv_passthrough<decltype(src)>()) {
+			return batch_convert<InnerMessageType>([&](auto inner) {
+				return batch_did_recv(ext_fabric.i(*(Fiber*)this), ext_fabric.is(*(Fiber*)this), inner);
+			}, batch);
+		} else {
+			int ret = 0;
+			for(auto& entry : batch) {
+				auto res = ((Fiber*)this)->did_recv(src, std::move(entry.msg), entry.addr);
+				if(res < 0 && ret == 0) {
+					ret = res;
+				}
+			}
+			return ret;
+		}
+	}
+
 	int did_dial(auto&&, SocketAddress addr, auto&&... args) {
 		return ext_fabric.i(*(Fiber*)this).did_dial(ext_fabric.is(*(Fiber*)this), addr, std::forward<decltype(args)>(args)...);
 	}
@@ -38,6 +145,26 @@ public:
 		return ext_fabric.o(*(Fiber*)this).send(ext_fabric.os(*(Fiber*)this), std::move(buf), std::forward<decltype(args)>(args)...);
 	}
 
+	/// Batch counterpart of send, fibers can implement it to amortize per message work
+	/// Fibers that do not get each message through their send in order
+	template<typename MessageType>
+	int send_batch(auto&& src, std::span<BatchEntry<MessageType>> batch) {
+		if constexpr (is_send_passthrough<decltype(src)>()) {
+			return batch_convert<OuterMessageType>([&](auto outer) {
+				return batch_send(ext_fabric.o(*(Fiber*)this), ext_fabric.os(*(Fiber*)this), outer);
+			}, batch);
+		} else {
+			int ret = 0;
+			for(auto& entry : batch) {
+				auto res = ((Fiber*)this)->send(src, std::move(entry.msg), entry.addr);
+				if(res < 0 && ret == 0) {
+					ret = res;
+				}
+			}
+			return ret;
+		}
+	}
+
 	int did_send(auto&&, InnerMessageType&& buf) {
 		return ext_fabric.i(*(Fiber*)this).did_send(ext_fabric.is(*(Fiber*)this), std::move(buf));
 	}
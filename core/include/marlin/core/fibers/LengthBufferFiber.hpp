@@ -29,13 +29,26 @@ public:
 	using FiberScaffoldType::FiberScaffoldType;
 
 	core::Buffer buf = core::Buffer(0);
+	uint64_t frame_len = 0;
 
 	void reset(uint64_t max_len) {
-		buf = core::Buffer(max_len);
+		// allocated lazily, frames arriving in one piece are passed on as is
+		frame_len = max_len;
+		buf = core::Buffer(0);
 		this->ext_fabric.o(*this).reset(max_len);
 	}
 
 	int did_recv(auto&&, InnerMessageType&& bytes, uint64_t bytes_remaining, SocketAddress) {
+		// entire frame in one piece, no need to reassemble
+		if(bytes.size() == frame_len) {
+			buf = std::move(bytes);
+			return 0;
+		}
+
+		if(buf.size() != frame_len) {
+			buf = core::Buffer(frame_len);
+		}
+
 		auto idx = buf.size() - bytes.size() - bytes_remaining;
 
 		// copy
@@ -47,17 +47,15 @@ public:
 			);
 		}
 
-		// copy leftovers and truncate
+		// split frame off by reference, rest stays in bytes as leftover
 		auto num_leftover = bytes.size() - bytes_remaining;
-		auto leftover = core::Buffer(num_leftover);
-		leftover.write_unsafe(0, bytes.data() + bytes_remaining, num_leftover);
-		bytes.truncate_unsafe(num_leftover);
+		auto frame = num_leftover > 0 ? bytes.split(bytes_remaining) : std::move(bytes);
 		bytes_remaining = 0;
 
 		// send
 		auto res = this->ext_fabric.i(*this).did_recv(
 			this->ext_fabric.is(*this),
-			std::move(bytes),
+			std::move(frame),
 			bytes_remaining,
 			addr
 		);
@@ -70,7 +68,7 @@ public:
 
 		// report leftover if any
 		if(num_leftover > 0) {
-			return source.leftover(*this, std::move(leftover), addr);
+			return source.leftover(*this, std::move(bytes), addr);
 		}
 
 		return 0;
@@ -29,13 +29,36 @@ public:
 	using FiberScaffoldType::FiberScaffoldType;
 
 	core::Buffer buf = core::Buffer(0);
+	uint64_t max_len = 0;
+	bool reassembling = false;
 
 	void reset(uint64_t max_len) {
-		buf = core::Buffer(max_len);
-		buf.truncate_unsafe(max_len);
+		// allocated lazily, frames arriving in one piece are passed on as is
+		this->max_len = max_len;
+		buf = core::Buffer(0);
+		reassembling = false;
 	}
 
 	int did_recv(auto&&, InnerMessageType&& bytes, SocketAddress) {
+		if(bytes.size() > max_len) {
+			return -1;
+		}
+
+		if(!reassembling) {
+			if(buf.size() == 0) {
+				// first piece, hold on to it without copying
+				buf = std::move(bytes);
+				return 0;
+			}
+
+			// second piece, switch to copying into a frame sized buffer
+			auto nbuf = core::Buffer(max_len);
+			nbuf.write_unsafe(0, buf.data(), buf.size());
+			nbuf.truncate_unsafe(max_len - buf.size());
+			buf = std::move(nbuf);
+			reassembling = true;
+		}
+
 		auto idx = buf.size();
 		// expand and check if there is enough room to copy
 		if(!buf.expand(bytes.size())) {
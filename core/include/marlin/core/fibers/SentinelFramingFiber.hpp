@@ -6,6 +6,8 @@
 
 #include <spdlog/spdlog.h>
 
+#include <cstring>
+
 namespace marlin {
 namespace core {
 
@@ -32,22 +34,22 @@ public:
 
 	int did_recv(auto&& source, InnerMessageType&& bytes, SocketAddress addr) {
 		SPDLOG_DEBUG("SFF: did_recv: {} bytes", bytes.size());
-		// get idx of sentinel if present
-		size_t sentinel_idx = std::find(
+		// get idx of sentinel if present, memchr is vectorized in libc
+		auto* sentinel_ptr = (uint8_t const*)std::memchr(
 			bytes.data(),
-			bytes.data() + bytes.size(),
-			sentinel
-		) - bytes.data();
+			sentinel,
+			bytes.size()
+		);
 
-		if(sentinel_idx == bytes.size()) {
+		if(sentinel_ptr == nullptr) {
 			// sentinel not found, just forward
 			return FiberScaffoldType::did_recv(*this, std::move(bytes), addr);
 		}
+		size_t sentinel_idx = sentinel_ptr - bytes.data();
 
 		// sentinel found
-		// copy and send
-		core::Buffer n_bytes(sentinel_idx+1);
-		bytes.read_unsafe(0, n_bytes.data(), sentinel_idx+1);
+		// split off by reference and send, rest stays in bytes as leftover
+		auto n_bytes = sentinel_idx+1 < bytes.size() ? bytes.split(sentinel_idx+1) : std::move(bytes);
 		auto res = FiberScaffoldType::did_recv(*this, std::move(n_bytes), addr);
 		if(res < 0) {
 			return res;
@@ -57,7 +59,6 @@ public:
 		this->ext_fabric.i(*this).did_recv_sentinel(this->ext_fabric.is(*this), addr);
 
 		// report leftover if any
-		bytes.cover_unsafe(sentinel_idx+1);
 		if(bytes.size() > 0) {
 			return source.leftover(*this, std::move(bytes), addr);
 		}
@@ -4,11 +4,14 @@
 #include <marlin/core/Buffer.hpp>
 #include <marlin/core/fibers/FiberScaffold.hpp>
 
-namespace marlin {
-namespace core {
+#include <span>
+#include <vector>
 
 #include <marlin/core/messages/FieldDef.hpp>
 
+namespace marlin {
+namespace core {
+
 template<
 	typename BaseMessageType,
 	typename VERSION = std::integral_constant<uint8_t, 0>,
@@ -62,6 +65,31 @@ public:
 		}
 		return FiberScaffoldType::did_recv(*this, std::move(buf), addr);
 	}
+
+	/// Drops invalid messages and hands the rest on as one batch
+	template<typename MessageType>
+	int did_recv_batch(auto&&, std::span<BatchEntry<MessageType>> batch) {
+		std::vector<BatchEntry<InnerMessageType>> valid;
+		valid.reserve(batch.size());
+
+		int ret = 0;
+		for(auto& entry : batch) {
+			InnerMessageType msg(std::move(entry.msg));
+			if(!msg.validate()) {
+				// Validation failure
+				ret = -1;
+				continue;
+			}
+			valid.push_back({std::move(msg), entry.addr});
+		}
+
+		if(valid.empty()) {
+			return ret;
+		}
+
+		auto res = batch_did_recv(this->ext_fabric.i(*this), this->ext_fabric.is(*this), std::span(valid));
+		return ret < 0 ? ret : res;
+	}
 };
 
 }  // namespace core
@@ -1,3 +1,5 @@
+#include <marlin/core/messages/Schema.hpp>
+
 #define MARLIN_MESSAGES_BASE(Derived) \
 	/** @brief Message type */ \
 	using SelfType = Derived<BaseMessageType>; \
@@ -95,6 +97,31 @@
 		return std::move(truncate_unsafe(size)); \
 	}
 
+#define MARLIN_MESSAGES_SCHEMA(...) \
+	/** @brief Layout of the fixed size header */ \
+	using Schema = core::MessageSchema<__VA_ARGS__>; \
+ \
+	/** @brief Read the header fields at the given indices, all of them if none are given */ \
+	/** Message has to be validated first */ \
+	template<size_t... Idx> \
+	auto read_header() const { \
+		return Schema::template read_unsafe<Idx...>(base.payload()); \
+	} \
+ \
+	/** @brief Set every header field with a single copy */ \
+	template<typename... Args> \
+	SelfType& set_header(Args&&... args) & { \
+		Schema::write_unsafe(base.payload(), std::forward<Args>(args)...); \
+ \
+		return *this; \
+	} \
+ \
+	/** @brief Set every header field with a single copy */ \
+	template<typename... Args> \
+	SelfType&& set_header(Args&&... args) && { \
+		return std::move(set_header(std::forward<Args>(args)...)); \
+	}
+
 #define MARLIN_MESSAGES_ARRAY_FIELD(type, begin_offset, end_offset) \
 private: \
 	template<typename type> \
@@ -2,6 +2,7 @@
 #undef MARLIN_MESSAGES_UINT32_FIELD
 #undef MARLIN_MESSAGES_UINT64_FIELD
 #undef MARLIN_MESSAGES_PAYLOAD_FIELD
+#undef MARLIN_MESSAGES_SCHEMA
 #undef MARLIN_MESSAGES_UINT_FIELD
 #undef MARLIN_MESSAGES_GET_5
 #undef MARLIN_MESSAGES_UINT_FIELD_SINGLE_OFFSET
@@ -0,0 +1,184 @@
+/*! \file Schema.hpp
+	\brief Compile time layouts of fixed size message headers
+*/
+
+#ifndef MARLIN_CORE_MESSAGES_SCHEMA_HPP
+#define MARLIN_CORE_MESSAGES_SCHEMA_HPP
+
+#include "marlin/core/Endian.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+namespace marlin {
+namespace core {
+
+/// Byte order of a field on the wire, matches the BaseBuffer accessors with the same suffix
+enum class FieldEndian {
+	Le,
+	Be
+};
+
+/// @brief Unsigned integer of type T at a fixed offset
+/// @headerfile Schema.hpp <marlin/core/messages/Schema.hpp>
+///
+/// Reads and writes go through memcpy so unaligned offsets still compile to plain loads and stores.
+template<typename T, size_t Offset, FieldEndian endian = FieldEndian::Be>
+struct UintField {
+	static_assert(std::is_unsigned_v<T>);
+
+	using value_type = T;
+
+	static constexpr size_t offset = Offset;
+	static constexpr size_t width = sizeof(T);
+	static constexpr size_t end = Offset + sizeof(T);
+
+	static T read(uint8_t const* in) {
+		T res;
+		std::memcpy(&res, in + Offset, sizeof(T));
+
+		if constexpr (is_swapped) {
+			return swap(res);
+		} else {
+			return res;
+		}
+	}
+
+	static void write(uint8_t* out, T num) {
+		if constexpr (is_swapped) {
+			num = swap(num);
+		}
+
+		std::memcpy(out + Offset, &num, sizeof(T));
+	}
+
+private:
+#if MARLIN_CORE_ENDIANNESS == MARLIN_CORE_BIG_ENDIAN
+	static constexpr bool is_swapped = endian == FieldEndian::Le;
+#elif MARLIN_CORE_ENDIANNESS == MARLIN_CORE_LITTLE_ENDIAN
+	static constexpr bool is_swapped = endian == FieldEndian::Be;
+#endif
+
+	static T swap(T num) {
+		if constexpr (sizeof(T) == 1) {
+			return num;
+		} else if constexpr (sizeof(T) == 2) {
+			return __builtin_bswap16(num);
+		} else if constexpr (sizeof(T) == 4) {
+			return __builtin_bswap32(num);
+		} else {
+			static_assert(sizeof(T) == 8);
+			return __builtin_bswap64(num);
+		}
+	}
+};
+
+/// @brief N opaque bytes at a fixed offset, e.g. keys and serialized addresses
+/// @headerfile Schema.hpp <marlin/core/messages/Schema.hpp>
+template<size_t N, size_t Offset>
+struct BytesField {
+	using value_type = std::array<uint8_t, N>;
+
+	static constexpr size_t offset = Offset;
+	static constexpr size_t width = N;
+	static constexpr size_t end = Offset + N;
+
+	static value_type read(uint8_t const* in) {
+		value_type res;
+		std::memcpy(res.data(), in + Offset, N);
+
+		return res;
+	}
+
+	static void write(uint8_t* out, value_type const& bytes) {
+		std::memcpy(out + Offset, bytes.data(), N);
+	}
+};
+
+/// @brief Layout of a fixed size message header
+/// @headerfile Schema.hpp <marlin/core/messages/Schema.hpp>
+///
+/// The header size is known at compile time, so parsing a message needs a single bounds check
+/// after which every field is read without further checks. Values are returned as a tuple in
+/// the order the fields are listed, meant to be unpacked with structured bindings.
+///
+/// Writing assembles the header on the stack and copies it out with one memcpy, so the compiler
+/// emits a few wide stores instead of one store per field.
+template<typename... Fields>
+struct MessageSchema {
+	static_assert(sizeof...(Fields) > 0);
+
+	/// Size of the header in bytes
+	static constexpr size_t size = std::max({Fields::end...});
+
+	/// Type of the field at index Idx
+	template<size_t Idx>
+	using field = std::tuple_element_t<Idx, std::tuple<Fields...>>;
+
+	/// Field values in order
+	using values_type = std::tuple<typename Fields::value_type...>;
+
+	/// Do fields cover the header exactly once, i.e. no gaps and no overlaps
+	static constexpr bool is_packed() {
+		constexpr size_t begins[] = {Fields::offset...};
+		constexpr size_t ends[] = {Fields::end...};
+
+		if((Fields::width + ...) != size) {
+			return false;
+		}
+
+		for(size_t i = 0; i < sizeof...(Fields); i++) {
+			for(size_t j = i + 1; j < sizeof...(Fields); j++) {
+				if(begins[i] < ends[j] && begins[j] < ends[i]) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/// Check that a buffer of the given size can hold the header
+	static constexpr bool validate(size_t available) {
+		return available >= size;
+	}
+
+	/// Read the fields at the given indices, all fields if none are given, without bounds checking
+	template<size_t... Idx>
+	static auto read_unsafe(uint8_t const* in) {
+		if constexpr (sizeof...(Idx) == 0) {
+			return values_type(Fields::read(in)...);
+		} else {
+			return std::tuple<typename field<Idx>::value_type...>(field<Idx>::read(in)...);
+		}
+	}
+
+	/// Read all fields, returns nullopt if the buffer is too small to hold the header
+	static std::optional<values_type> read(uint8_t const* in, size_t available) {
+		if(!validate(available)) {
+			return std::nullopt;
+		}
+
+		return read_unsafe(in);
+	}
+
+	/// Write all fields without bounds checking, the header has to be packed
+	static void write_unsafe(uint8_t* out, typename Fields::value_type const&... values) {
+		static_assert(is_packed(), "Header has gaps or overlapping fields, write fields individually");
+
+		uint8_t header[size];
+		(Fields::write(header, values), ...);
+
+		std::memcpy(out, header, size);
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_MESSAGES_SCHEMA_HPP
@@ -19,8 +19,12 @@ BaseBuffer(new uint8_t[size], size) {
 Buffer::Buffer(uint8_t *buf, size_t size) :
 BaseBuffer(buf, size) {}
 
+Buffer::Buffer(uint8_t *buf, size_t size, BufferStorage *storage) :
+BaseBuffer(buf, size), storage(storage) {}
+
 Buffer::Buffer(Buffer &&b) noexcept :
-BaseBuffer(static_cast<BaseBuffer&&>(std::move(b))) {
+BaseBuffer(static_cast<BaseBuffer&&>(std::move(b))), storage(b.storage) {
+	b.storage = nullptr;
 	b.buf = nullptr;
 	b.capacity = 0;
 	b.start_index = 0;
@@ -29,9 +33,11 @@ BaseBuffer(static_cast<BaseBuffer&&>(std::move(b))) {
 
 Buffer &Buffer::operator=(Buffer &&b) noexcept {
 	// Destroy old
-	delete[] buf;
+	destroy();
 
 	// Assign from new
+	storage = b.storage;
+	b.storage = nullptr;
 	buf = b.buf;
 	capacity = b.capacity;
 	start_index = b.start_index;
@@ -46,7 +52,77 @@ Buffer &Buffer::operator=(Buffer &&b) noexcept {
 }
 
 Buffer::~Buffer() {
+	destroy();
+}
+
+void Buffer::destroy() {
+	if(storage == nullptr) {
+		delete[] buf;
+		return;
+	}
+
+	if(storage->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		storage->release_fn(storage, buf);
+	}
+	storage = nullptr;
+}
+
+static void release_split_storage(BufferStorage* storage, uint8_t* buf) {
 	delete[] buf;
+	delete storage;
+}
+
+Buffer Buffer::split(size_t num) & {
+	if(storage == nullptr) {
+		storage = new BufferStorage();
+		storage->release_fn = release_split_storage;
+	}
+	storage->refcount.fetch_add(1, std::memory_order_relaxed);
+
+	Buffer head(buf, capacity, storage);
+	head.start_index = start_index;
+	head.end_index = start_index + num;
+
+	start_index += num;
+
+	return head;
+}
+
+Buffer Buffer::share() & {
+	if(storage == nullptr) {
+		storage = new BufferStorage();
+		storage->release_fn = release_split_storage;
+	}
+	storage->refcount.fetch_add(1, std::memory_order_relaxed);
+
+	Buffer other(buf, capacity, storage);
+	other.start_index = start_index;
+	other.end_index = end_index;
+
+	return other;
+}
+
+uint8_t *Buffer::release() {
+	assert(!is_shared());
+
+	// Split storage only does the bookkeeping for new[] memory, pool storage lives in the block
+	if(storage != nullptr && storage->release_fn == release_split_storage) {
+		delete storage;
+	}
+	storage = nullptr;
+
+	uint8_t *_buf = buf;
+
+	buf = nullptr;
+	capacity = 0;
+	start_index = 0;
+	end_index = 0;
+
+	return _buf;
+}
+
+bool Buffer::is_shared() const {
+	return storage != nullptr && storage->refcount.load(std::memory_order_relaxed) > 1;
 }
 
 WeakBuffer Buffer::payload_buffer() & {
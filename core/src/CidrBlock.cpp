@@ -1,5 +1,6 @@
 #include "marlin/core/CidrBlock.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #include <arpa/inet.h>
@@ -12,45 +13,57 @@ CidrBlock::CidrBlock() : SocketAddress() {}
 CidrBlock::CidrBlock(const CidrBlock &addr) : SocketAddress(addr) {}
 
 CidrBlock CidrBlock::from_string(std::string blockString) {
-	// TODO: Add support for other formats
 	CidrBlock addr;
-	inet_pton(AF_INET, blockString.substr(0,blockString.find("/")).c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
-	reinterpret_cast<sockaddr_in *>(&addr)->sin_port = htons(std::stoi(blockString.substr(blockString.find("/")+1)));
+	auto slash = blockString.find("/");
+	auto ip = blockString.substr(0, slash);
+	uint16_t prefix_length = std::stoi(blockString.substr(slash + 1));
+
+	if(ip.find(":") != std::string::npos) {
+		auto *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		addr6->sin6_family = AF_INET6;
+		inet_pton(AF_INET6, ip.c_str(), &addr6->sin6_addr);
+		addr6->sin6_port = htons(prefix_length);
+		return addr;
+	}
+
+	inet_pton(AF_INET, ip.c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
+	reinterpret_cast<sockaddr_in *>(&addr)->sin_port = htons(prefix_length);
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_family = AF_INET;
 	return addr;
 }
 
 std::string CidrBlock::to_string() const {
-	// TODO: Add support for other formats
-	char buf[100];
-	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
-
 	std::stringstream blockString;
-	blockString<<buf<<"/"<<ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
+	blockString<<ip_string()<<"/"<<get_prefix_length();
 
 	return blockString.str();
 }
 
+uint16_t CidrBlock::get_prefix_length() const {
+	return get_port();
+}
+
 bool CidrBlock::does_contain_address(const SocketAddress &addr) const {
-	char *_prefix = (char *)&(reinterpret_cast<const sockaddr_in *>(this)->sin_addr);
-	uint16_t _prefix_length = ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
-
-	char *_addr = (char *)&(reinterpret_cast<const sockaddr_in *>(&addr)->sin_addr);
-
-	for (int i=0; i<4 && _prefix_length>0; i++) {
-		if (_prefix_length >= 8) {
-			if (_addr[i] != _prefix[i]) {
-				return false;
-			}
-		} else {
-			if ((_addr[i]>>(8-_prefix_length)) != (_prefix[i]>>(8-_prefix_length))) {
-				return false;
-			}
-		}
-		_prefix_length -= 8;
+	if(addr.ss_family != ss_family) {
+		return false;
+	}
+
+	auto prefix = key();
+	auto other = addr.key();
+	size_t prefix_length = std::min<size_t>(get_prefix_length(), is_ipv6() ? 128 : 32);
+
+	size_t full_bytes = prefix_length / 8;
+	if(std::memcmp(prefix.ip.data(), other.ip.data(), full_bytes) != 0) {
+		return false;
+	}
+
+	size_t rem_bits = prefix_length % 8;
+	if(rem_bits == 0) {
+		return true;
 	}
 
-	return true;
+	uint8_t mask = 0xff << (8 - rem_bits);
+	return (prefix.ip[full_bytes] & mask) == (other.ip[full_bytes] & mask);
 }
 
 } // namespace core
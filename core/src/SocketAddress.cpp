@@ -58,8 +58,16 @@ SocketAddress &SocketAddress::operator=(const sockaddr_in6 &addr) {
 }
 
 SocketAddress SocketAddress::from_string(std::string addrString) {
-	// TODO: Add support for other formats
 	SocketAddress addr;
+	if(!addrString.empty() && addrString[0] == '[') {
+		auto end = addrString.find("]");
+		auto *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		addr6->sin6_family = AF_INET6;
+		inet_pton(AF_INET6, addrString.substr(1, end - 1).c_str(), &addr6->sin6_addr);
+		addr6->sin6_port = htons(std::stoi(addrString.substr(end + 2)));
+		return addr;
+	}
+
 	inet_pton(AF_INET, addrString.substr(0,addrString.find(":")).c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_port = htons(std::stoi(addrString.substr(addrString.find(":")+1)));
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_family = AF_INET;
@@ -67,7 +75,13 @@ SocketAddress SocketAddress::from_string(std::string addrString) {
 }
 
 std::string SocketAddress::to_string() const {
-	// TODO: Add support for other formats
+	if(is_ipv6()) {
+		std::stringstream addrString;
+		addrString<<"["<<ip_string()<<"]:"<<get_port();
+
+		return addrString.str();
+	}
+
 	char buf[100];
 	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
 
@@ -78,14 +92,19 @@ std::string SocketAddress::to_string() const {
 }
 
 std::string SocketAddress::ip_string() const {
-	// TODO: Add support for other formats
 	char buf[100];
+	if(is_ipv6()) {
+		inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 *>(this)->sin6_addr, buf, 100);
+		return std::string(buf);
+	}
+
 	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
 
 	return std::string(buf);
 }
 
 uint16_t SocketAddress::get_port() const {
+	// sin_port and sin6_port share the same offset
 	return ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
 }
 
@@ -97,19 +116,58 @@ SocketAddress SocketAddress::loopback_ipv4(uint16_t port) {
 	return from_string(std::string("127.0.0.1:").append(std::to_string(port)));
 }
 
-// TODO - Temporary hack - previously used to memcmp bytes directly which wasn't working
-// Possibly because struct isn't zeroed out entirely so "unused" bytes have random data
+SocketAddress SocketAddress::loopback_ipv6(uint16_t port) {
+	return from_string(std::string("[::1]:").append(std::to_string(port)));
+}
+
+bool SocketAddress::is_ipv4() const {
+	return ss_family == AF_INET;
+}
+
+bool SocketAddress::is_ipv6() const {
+	return ss_family == AF_INET6;
+}
+
+SocketAddressKey SocketAddress::key() const {
+	// Only copy meaningful fields, the rest of the storage isn't guaranteed to be zeroed
+	SocketAddressKey key;
+	key.family = ss_family;
+	key.port = get_port();
+	if(is_ipv6()) {
+		memcpy(key.ip.data(), &reinterpret_cast<const sockaddr_in6 *>(this)->sin6_addr, 16);
+	} else {
+		memcpy(key.ip.data(), &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, 4);
+	}
+
+	return key;
+}
+
 bool SocketAddress::operator==(const SocketAddress &other) const {
-	return this->to_string() == other.to_string();
+	return this->key() == other.key();
 }
 
-// TODO - Temporary hack - previously used to memcmp bytes directly which wasn't working
-// Possibly because struct isn't zeroed out entirely so "unused" bytes have random data
 bool SocketAddress::operator<(const SocketAddress &other) const {
-	return this->to_string() < other.to_string();
+	return this->key() < other.key();
 }
 
 size_t SocketAddress::serialize(uint8_t* bytes, size_t size) const {
+	if(is_ipv6()) {
+		if(size < 20) {
+			return 0;
+		}
+
+		uint16_t family = ss_family;
+		uint16_t port = reinterpret_cast<const sockaddr_in6 *>(this)->sin6_port;
+
+		bytes[0] = static_cast<uint8_t>(family >> 8);
+		bytes[1] = static_cast<uint8_t>(family & 0xff);
+		std::memcpy(bytes+2, &reinterpret_cast<const sockaddr_in6 *>(this)->sin6_addr, 16);
+		bytes[18] = port >> 8;
+		bytes[19] = port & 0xff;
+
+		return 20;
+	}
+
 	if(size < 8) {
 		return 0;
 	}
@@ -134,6 +192,19 @@ SocketAddress SocketAddress::deserialize(uint8_t const* bytes, size_t size) {
 		return addr;
 	}
 
+	uint16_t family = ((uint16_t)bytes[0] << 8) + (uint16_t)bytes[1];
+	if(family == AF_INET6) {
+		if(size < 20) {
+			return addr;
+		}
+
+		auto *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		addr6->sin6_family = AF_INET6;
+		memcpy(&addr6->sin6_addr, &(bytes[2]), 16);
+		addr6->sin6_port = ((uint16_t)bytes[18] << 8) + (uint16_t)bytes[19];
+		return addr;
+	}
+
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_family =
 		((uint16_t)bytes[0] << 8) + (uint16_t)bytes[1];
 	memcpy(&(reinterpret_cast<sockaddr_in *>(&addr)->sin_addr), &(bytes[2]), 4);
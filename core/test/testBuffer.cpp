@@ -615,3 +615,74 @@ TEST(BufferWriteBE, CannotWriteUint64BEWithOverflow) {
 
 	EXPECT_FALSE(res);
 }
+
+TEST(BufferSplit, SplitSharesMemory) {
+	auto buf = Buffer({'0','1','2','3','4','5'}, 6);
+	uint8_t *raw_ptr = buf.data();
+
+	auto head = buf.split(2);
+
+	EXPECT_EQ(head.data(), raw_ptr);
+	EXPECT_EQ(head.size(), 2);
+	EXPECT_EQ(buf.data(), raw_ptr + 2);
+	EXPECT_EQ(buf.size(), 4);
+	EXPECT_TRUE(head.is_shared());
+	EXPECT_TRUE(buf.is_shared());
+	EXPECT_TRUE(std::memcmp(head.data(), "01", 2) == 0);
+	EXPECT_TRUE(std::memcmp(buf.data(), "2345", 4) == 0);
+}
+
+TEST(BufferSplit, SplitOutlivesOriginal) {
+	auto buf = Buffer({'0','1','2','3','4','5'}, 6);
+
+	auto head = buf.split(2);
+	auto mid = buf.split(2);
+	{
+		auto tail = std::move(buf);
+	}
+
+	EXPECT_TRUE(std::memcmp(head.data(), "01", 2) == 0);
+	EXPECT_TRUE(std::memcmp(mid.data(), "23", 2) == 0);
+	EXPECT_TRUE(head.is_shared());
+
+	mid = Buffer(0);
+	EXPECT_FALSE(head.is_shared());
+}
+
+TEST(BufferShare, ShareOutlivesOriginal) {
+	auto buf = Buffer({'0','1','2','3','4','5'}, 6);
+	uint8_t *raw_ptr = buf.data();
+
+	auto first = buf.share();
+	auto second = buf.share();
+	EXPECT_EQ(first.data(), raw_ptr);
+	EXPECT_EQ(first.size(), 6);
+	EXPECT_TRUE(buf.is_shared());
+
+	buf = Buffer(0);
+	first.cover_unsafe(2);
+	EXPECT_TRUE(std::memcmp(first.data(), "2345", 4) == 0);
+	EXPECT_TRUE(std::memcmp(second.data(), "012345", 6) == 0);
+
+	first = Buffer(0);
+	EXPECT_FALSE(second.is_shared());
+}
+
+TEST(BufferRelease, ReleaseAfterSplitDropsStorage) {
+	auto buf = Buffer({'0','1','2','3','4','5'}, 6);
+	uint8_t *raw_ptr = buf.data();
+
+	{
+		auto head = buf.split(2);
+	}
+	EXPECT_FALSE(buf.is_shared());
+
+	uint8_t *released = buf.release();
+	EXPECT_EQ(released, raw_ptr);
+	EXPECT_EQ(buf.data(), nullptr);
+	EXPECT_FALSE(buf.is_shared());
+
+	// Buffer no longer owns the memory, destroying it must not free it again
+	buf = Buffer(0);
+	delete[] released;
+}
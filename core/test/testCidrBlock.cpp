@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+#include "marlin/core/CidrBlock.hpp"
+
+
+using namespace marlin::core;
+
+TEST(CidrBlockTest, StringConvertible) {
+	EXPECT_EQ(CidrBlock::from_string("10.0.0.0/8").to_string(), "10.0.0.0/8");
+	EXPECT_EQ(CidrBlock::from_string("2001:db8::/32").to_string(), "2001:db8::/32");
+	EXPECT_EQ(CidrBlock::from_string("2001:db8::/32").get_prefix_length(), 32);
+}
+
+TEST(CidrBlockTest, ContainsIpv4) {
+	auto block = CidrBlock::from_string("172.16.0.0/12");
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("172.16.0.1:80")));
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("172.31.255.255:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("172.32.0.0:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("172.15.255.255:80")));
+}
+
+TEST(CidrBlockTest, HighBitPrefix) {
+	auto block = CidrBlock::from_string("192.168.128.0/17");
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("192.168.200.1:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("192.168.100.1:80")));
+}
+
+TEST(CidrBlockTest, ContainsIpv6) {
+	auto block = CidrBlock::from_string("fc00::/7");
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("[fd12:3456::1]:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("[fe80::1]:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("10.0.0.1:80")));
+}
+
+TEST(CidrBlockTest, DefaultContainsAllIpv4) {
+	CidrBlock block;
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("1.2.3.4:80")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("[::1]:80")));
+}
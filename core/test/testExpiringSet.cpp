@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "marlin/core/ExpiringSet.hpp"
+#include "marlin/core/SocketAddress.hpp"
+
+
+using namespace marlin::core;
+
+TEST(ExpiringSetTest, ExpiresAfterTtl) {
+	ExpiringSet<SocketAddress> set(100);
+	auto addr = SocketAddress::from_string("1.2.3.4:80");
+
+	set.insert(addr, 1000);
+	EXPECT_TRUE(set.contains(addr, 1000));
+	EXPECT_TRUE(set.contains(addr, 1099));
+	EXPECT_FALSE(set.contains(addr, 1100));
+	EXPECT_FALSE(set.contains(SocketAddress::from_string("1.2.3.5:80"), 1000));
+}
+
+TEST(ExpiringSetTest, EntriesExpireIndividually) {
+	ExpiringSet<SocketAddress> set(100);
+	auto a = SocketAddress::from_string("1.2.3.4:80");
+	auto b = SocketAddress::from_string("1.2.3.5:80");
+
+	set.insert(a, 1000);
+	set.insert(b, 1050);
+
+	set.expire(1120);
+	EXPECT_EQ(set.size(), 1);
+	EXPECT_FALSE(set.contains(a, 1120));
+	EXPECT_TRUE(set.contains(b, 1120));
+
+	set.expire(1150);
+	EXPECT_EQ(set.size(), 0);
+}
+
+TEST(ExpiringSetTest, ReinsertExtends) {
+	ExpiringSet<SocketAddress> set(100);
+	auto addr = SocketAddress::from_string("1.2.3.4:80");
+
+	set.insert(addr, 1000);
+	set.insert(addr, 1080);
+
+	// Stale queue entry from the first insert must not drop it
+	set.expire(1100);
+	EXPECT_TRUE(set.contains(addr, 1100));
+	EXPECT_EQ(set.size(), 1);
+
+	set.expire(1180);
+	EXPECT_EQ(set.size(), 0);
+}
+
+TEST(ExpiringSetTest, Erase) {
+	ExpiringSet<SocketAddress> set(100);
+	auto addr = SocketAddress::from_string("1.2.3.4:80");
+
+	set.insert(addr, 1000);
+	set.erase(addr);
+	EXPECT_FALSE(set.contains(addr, 1000));
+
+	set.insert(addr, 1050);
+	// Queue entry of the erased insert must not drop the new one
+	set.expire(1100);
+	EXPECT_TRUE(set.contains(addr, 1100));
+}
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include <marlin/core/fabric/Fabric.hpp>
+#include <marlin/core/fibers/FiberScaffold.hpp>
+#include <marlin/core/fibers/VersioningFiber.hpp>
+
+#include <functional>
+#include <vector>
+
+using namespace marlin::core;
+
+using EntryType = BatchEntry<Buffer>;
+
+struct Source {};
+
+// Accepts single messages only
+struct Terminal {
+	Terminal(auto&&...) {}
+
+	auto& i(auto&&) { return *this; }
+	auto& o(auto&&) { return *this; }
+	auto& is(auto& f) { return f; }
+	auto& os(auto& f) { return f; }
+
+	std::vector<size_t> recvd;
+	std::vector<size_t> sent;
+	int ret = 0;
+
+	int did_recv(auto&&, Buffer&& buf, SocketAddress) {
+		recvd.push_back(buf.size());
+		return buf.size() == 3 ? ret : 0;
+	}
+
+	int send(auto&&, Buffer&& buf, SocketAddress) {
+		sent.push_back(buf.size());
+		return buf.size() == 3 ? ret : 0;
+	}
+};
+
+// Accepts whole batches
+struct BatchTerminal : Terminal {
+	BatchTerminal(auto&&...) {}
+
+	auto& i(auto&&) { return *this; }
+	auto& o(auto&&) { return *this; }
+
+	std::vector<size_t> recv_batches;
+	std::vector<size_t> send_batches;
+
+	int did_recv_batch(auto&&, std::span<EntryType> batch) {
+		recv_batches.push_back(batch.size());
+		return 0;
+	}
+
+	int send_batch(auto&&, std::span<EntryType> batch) {
+		send_batches.push_back(batch.size());
+		return 0;
+	}
+};
+
+// Leaves did_recv and send to the scaffold
+template<typename ExtFabric>
+struct PassthroughFiber : public FiberScaffold<PassthroughFiber<ExtFabric>, ExtFabric, Buffer, Buffer> {
+	using FiberScaffold<PassthroughFiber<ExtFabric>, ExtFabric, Buffer, Buffer>::FiberScaffold;
+};
+
+// Looks at every message
+template<typename ExtFabric>
+struct CountingFiber : public FiberScaffold<CountingFiber<ExtFabric>, ExtFabric, Buffer, Buffer> {
+	using FiberScaffoldType = FiberScaffold<CountingFiber<ExtFabric>, ExtFabric, Buffer, Buffer>;
+	using FiberScaffoldType::FiberScaffoldType;
+
+	size_t count = 0;
+
+	int did_recv(auto&& src, Buffer&& buf, SocketAddress addr) {
+		count++;
+		return FiberScaffoldType::did_recv(src, std::move(buf), addr);
+	}
+
+	int send(auto&& src, Buffer&& buf, SocketAddress addr) {
+		count++;
+		return FiberScaffoldType::send(src, std::move(buf), addr);
+	}
+};
+
+static std::vector<EntryType> make_batch(std::initializer_list<size_t> sizes) {
+	std::vector<EntryType> batch;
+	for(auto size : sizes) {
+		batch.push_back({Buffer(size), SocketAddress::from_string("127.0.0.1:8000")});
+	}
+	return batch;
+}
+
+TEST(FiberBatch, AdapterDeliversEachMessage) {
+	Source s;
+	Terminal t;
+	auto batch = make_batch({1, 2, 3, 4});
+
+	EXPECT_EQ(batch_did_recv<Buffer>(t, s, std::span(batch)), 0);
+	EXPECT_EQ(t.recvd, (std::vector<size_t>{1, 2, 3, 4}));
+
+	batch = make_batch({5, 6});
+	EXPECT_EQ(batch_send<Buffer>(t, s, std::span(batch)), 0);
+	EXPECT_EQ(t.sent, (std::vector<size_t>{5, 6}));
+}
+
+TEST(FiberBatch, AdapterReturnsFirstError) {
+	Source s;
+	Terminal t;
+	t.ret = -2;
+	auto batch = make_batch({1, 3, 4, 3});
+
+	EXPECT_EQ(batch_did_recv<Buffer>(t, s, std::span(batch)), -2);
+	EXPECT_EQ(t.recvd, (std::vector<size_t>{1, 3, 4, 3}));
+}
+
+TEST(FiberBatch, PassthroughForwardsWholeBatch) {
+	Source s;
+	BatchTerminal t;
+	PassthroughFiber<BatchTerminal&> f(std::forward_as_tuple(t));
+	auto batch = make_batch({1, 2, 3});
+
+	EXPECT_EQ(f.did_recv_batch(s, std::span(batch)), 0);
+	EXPECT_EQ(t.recv_batches, (std::vector<size_t>{3}));
+	EXPECT_TRUE(t.recvd.empty());
+
+	EXPECT_EQ(f.send_batch(s, std::span(batch)), 0);
+	EXPECT_EQ(t.send_batches, (std::vector<size_t>{3}));
+	EXPECT_TRUE(t.sent.empty());
+}
+
+TEST(FiberBatch, PassthroughToSingleTerminal) {
+	Source s;
+	Terminal t;
+	PassthroughFiber<Terminal&> f(std::forward_as_tuple(t));
+	auto batch = make_batch({1, 2, 3});
+
+	EXPECT_EQ(f.did_recv_batch(s, std::span(batch)), 0);
+	EXPECT_EQ(t.recvd, (std::vector<size_t>{1, 2, 3}));
+}
+
+TEST(FiberBatch, OverridingFiberSeesEachMessage) {
+	Source s;
+	BatchTerminal t;
+	CountingFiber<BatchTerminal&> f(std::forward_as_tuple(t));
+	auto batch = make_batch({1, 2, 3});
+
+	EXPECT_EQ(f.did_recv_batch(s, std::span(batch)), 0);
+	EXPECT_EQ(f.count, 3);
+	EXPECT_TRUE(t.recv_batches.empty());
+	EXPECT_EQ(t.recvd, (std::vector<size_t>{1, 2, 3}));
+
+	batch = make_batch({4, 5});
+	EXPECT_EQ(f.send_batch(s, std::span(batch)), 0);
+	EXPECT_EQ(f.count, 5);
+	EXPECT_EQ(t.sent, (std::vector<size_t>{4, 5}));
+}
+
+using VersionedType = VersionedMessage<Buffer>;
+
+// Sits at both ends of a fabric and takes whole batches
+struct App {
+	std::vector<size_t> recv_batches;
+	std::vector<size_t> send_batches;
+	size_t num_recvd = 0;
+	size_t num_sent = 0;
+
+	int did_recv(auto&&, VersionedType&&, SocketAddress) {
+		num_recvd++;
+		return 0;
+	}
+
+	int did_recv_batch(auto&&, std::span<BatchEntry<VersionedType>> batch) {
+		recv_batches.push_back(batch.size());
+		return 0;
+	}
+
+	int send(auto&&, Buffer&&, SocketAddress) {
+		num_sent++;
+		return 0;
+	}
+
+	int send_batch(auto&&, std::span<EntryType> batch) {
+		send_batches.push_back(batch.size());
+		return 0;
+	}
+};
+
+// Takes single messages only, like most fabric users
+struct SingleApp {
+	size_t num_recvd = 0;
+
+	int did_recv(auto&&, VersionedType&&, SocketAddress) {
+		num_recvd++;
+		return 0;
+	}
+};
+
+using FabricType = Fabric<App&, PassthroughFiber, VersioningFiber>;
+
+static Buffer versioned(uint8_t version, size_t size) {
+	Buffer buf(size);
+	if(size > 0) {
+		buf.data()[0] = version;
+	}
+	return buf;
+}
+
+TEST(FiberBatch, ReachesApplicationThroughFabric) {
+	App app;
+	FabricType fabric(std::forward_as_tuple(app, std::make_tuple(), std::make_tuple()));
+
+	std::vector<EntryType> batch;
+	batch.push_back({versioned(0, 10), SocketAddress::from_string("127.0.0.1:8000")});
+	batch.push_back({versioned(0, 0), SocketAddress::from_string("127.0.0.1:8001")});
+	batch.push_back({versioned(1, 10), SocketAddress::from_string("127.0.0.1:8002")});
+	batch.push_back({versioned(0, 20), SocketAddress::from_string("127.0.0.1:8003")});
+
+	// As the socket fiber would hand over a recvmmsg batch, versioning drops the empty and unknown version messages
+	auto& outer = fabric.i(app);
+	EXPECT_EQ(outer.did_recv_batch(outer, std::span(batch)), -1);
+	EXPECT_EQ(app.recv_batches, (std::vector<size_t>{2}));
+	EXPECT_EQ(app.num_recvd, 0u);
+}
+
+TEST(FiberBatch, ReachesSingleApplicationThroughFabric) {
+	SingleApp app;
+	Fabric<SingleApp&, PassthroughFiber, VersioningFiber> fabric(std::forward_as_tuple(app, std::make_tuple(), std::make_tuple()));
+
+	std::vector<EntryType> batch;
+	for(size_t i = 0; i < 3; i++) {
+		batch.push_back({versioned(0, 10), SocketAddress::from_string("127.0.0.1:8000")});
+	}
+
+	auto& outer = fabric.i(app);
+	EXPECT_EQ(outer.did_recv_batch(outer, std::span(batch)), 0);
+	EXPECT_EQ(app.num_recvd, 3u);
+}
+
+TEST(FiberBatch, LeavesThroughFabricAsOneBatch) {
+	App app;
+	FabricType fabric(std::forward_as_tuple(app, std::make_tuple(), std::make_tuple()));
+
+	std::vector<BatchEntry<VersionedType>> batch;
+	for(size_t i = 0; i < 3; i++) {
+		batch.push_back({VersionedType(10), SocketAddress::from_string("127.0.0.1:8000")});
+	}
+
+	EXPECT_EQ(fabric.o(app).send_batch(app, std::span(batch)), 0);
+	EXPECT_EQ(app.send_batches, (std::vector<size_t>{3}));
+	EXPECT_EQ(app.num_sent, 0u);
+}
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+#include "marlin/core/FrameAssembler.hpp"
+
+#include <cstring>
+
+using namespace marlin::core;
+
+static Buffer make_bytes(char const* str) {
+	auto size = std::strlen(str);
+	Buffer bytes(size);
+	std::memcpy(bytes.data(), str, size);
+	return bytes;
+}
+
+TEST(FrameAssembler, WholeFramesAreSplitInPlace) {
+	FrameAssembler assembler;
+	auto bytes = make_bytes("abcdefgh");
+	auto* raw_ptr = bytes.data();
+
+	assembler.expect(3);
+	auto frame = assembler.next(bytes);
+	ASSERT_TRUE(frame.has_value());
+	EXPECT_EQ(frame->data(), raw_ptr);
+	EXPECT_EQ(frame->size(), 3);
+	EXPECT_EQ(bytes.size(), 5);
+
+	assembler.expect(5);
+	frame = assembler.next(bytes);
+	ASSERT_TRUE(frame.has_value());
+	EXPECT_EQ(frame->data(), raw_ptr + 3);
+	EXPECT_TRUE(std::memcmp(frame->data(), "defgh", 5) == 0);
+	EXPECT_EQ(bytes.size(), 0);
+}
+
+TEST(FrameAssembler, FramesSpanningReadsAreGathered) {
+	FrameAssembler assembler;
+	auto first = make_bytes("abc");
+	auto second = make_bytes("defg");
+	auto third = make_bytes("hij");
+
+	assembler.expect(8);
+	EXPECT_FALSE(assembler.next(first).has_value());
+	EXPECT_EQ(first.size(), 0);
+	EXPECT_EQ(assembler.gathered(), 3);
+
+	EXPECT_FALSE(assembler.next(second).has_value());
+	EXPECT_EQ(assembler.gathered(), 7);
+
+	auto frame = assembler.next(third);
+	ASSERT_TRUE(frame.has_value());
+	EXPECT_EQ(frame->size(), 8);
+	EXPECT_TRUE(std::memcmp(frame->data(), "abcdefgh", 8) == 0);
+	EXPECT_EQ(assembler.gathered(), 0);
+
+	// Leftover stays in the read
+	EXPECT_EQ(third.size(), 2);
+	EXPECT_TRUE(std::memcmp(third.data(), "ij", 2) == 0);
+}
+
+TEST(FrameAssembler, PeekDoesNotTakeBytes) {
+	FrameAssembler assembler;
+	auto bytes = make_bytes("\x03xyz!");
+
+	assembler.expect(1);
+	auto* prefix = assembler.peek(bytes, 1);
+	ASSERT_NE(prefix, nullptr);
+	EXPECT_EQ(bytes.size(), 5);
+
+	assembler.expect(1 + prefix[0]);
+	auto frame = assembler.next(bytes);
+	ASSERT_TRUE(frame.has_value());
+	EXPECT_TRUE(std::memcmp(frame->data(), "\x03xyz", 4) == 0);
+	EXPECT_EQ(bytes.size(), 1);
+}
+
+TEST(FrameAssembler, PrefixSpanningReadsIsKeptInFrame) {
+	FrameAssembler assembler;
+	Buffer first(1);
+	first.data()[0] = 0;
+	auto second = make_bytes("\x04" "abcd");
+
+	// Two byte big endian length prefix split across reads
+	assembler.expect(2);
+	EXPECT_EQ(assembler.peek(first, 2), nullptr);
+	EXPECT_EQ(first.size(), 0);
+
+	auto* prefix = assembler.peek(second, 2);
+	ASSERT_NE(prefix, nullptr);
+	EXPECT_EQ(second.size(), 4);
+
+	assembler.expect(2 + ((prefix[0] << 8) | prefix[1]));
+	auto frame = assembler.next(second);
+	ASSERT_TRUE(frame.has_value());
+	EXPECT_EQ(frame->size(), 6);
+	EXPECT_TRUE(std::memcmp(frame->data(), "\x00\x04" "abcd", 6) == 0);
+	EXPECT_EQ(second.size(), 0);
+}
+
+TEST(FrameAssembler, ByteAtATime) {
+	FrameAssembler assembler;
+	char const* stream = "0123456789";
+
+	assembler.expect(4);
+	size_t frames = 0;
+	for(size_t i = 0; i < 10; i++) {
+		Buffer bytes(1);
+		bytes.data()[0] = stream[i];
+
+		auto frame = assembler.next(bytes);
+		if(frame.has_value()) {
+			EXPECT_TRUE(std::memcmp(frame->data(), stream + frames * 4, 4) == 0);
+			frames++;
+			assembler.expect(4);
+		}
+	}
+
+	EXPECT_EQ(frames, 2);
+	EXPECT_EQ(assembler.gathered(), 2);
+}
@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+#include "marlin/core/messages/Schema.hpp"
+#include "marlin/core/Buffer.hpp"
+
+using namespace marlin::core;
+
+using TestSchema = MessageSchema<
+	UintField<uint8_t, 0>,
+	UintField<uint32_t, 1, FieldEndian::Le>,
+	UintField<uint64_t, 5, FieldEndian::Le>,
+	UintField<uint16_t, 13>
+>;
+
+static_assert(TestSchema::size == 15);
+static_assert(TestSchema::is_packed());
+static_assert(!MessageSchema<UintField<uint8_t, 0>, UintField<uint8_t, 2>>::is_packed());
+static_assert(!MessageSchema<UintField<uint32_t, 0>, UintField<uint16_t, 2>>::is_packed());
+
+TEST(MessageSchemaTest, MatchesBufferAccessors) {
+	Buffer buf(20);
+	buf.write_uint8_unsafe(0, 7);
+	buf.write_uint32_le_unsafe(1, 0x01020304);
+	buf.write_uint64_le_unsafe(5, 0x0102030405060708);
+	buf.write_uint16_be_unsafe(13, 0xabcd);
+
+	auto [type, id, number, channel] = TestSchema::read_unsafe(buf.data());
+	EXPECT_EQ(type, 7);
+	EXPECT_EQ(id, 0x01020304u);
+	EXPECT_EQ(number, 0x0102030405060708u);
+	EXPECT_EQ(channel, 0xabcd);
+
+	auto [number_only] = TestSchema::read_unsafe<2>(buf.data());
+	EXPECT_EQ(number_only, 0x0102030405060708u);
+}
+
+TEST(MessageSchemaTest, WritesWholeHeader) {
+	Buffer buf(20);
+	std::memset(buf.data(), 0xff, buf.size());
+
+	TestSchema::write_unsafe(buf.data(), 7, 0x01020304, 0x0102030405060708, 0xabcd);
+
+	EXPECT_EQ(buf.read_uint8_unsafe(0), 7);
+	EXPECT_EQ(buf.read_uint32_le_unsafe(1), 0x01020304u);
+	EXPECT_EQ(buf.read_uint64_le_unsafe(5), 0x0102030405060708u);
+	EXPECT_EQ(buf.read_uint16_be_unsafe(13), 0xabcd);
+
+	// Bytes past the header are left alone
+	for(size_t i = TestSchema::size; i < buf.size(); i++) {
+		EXPECT_EQ(buf.data()[i], 0xff);
+	}
+}
+
+TEST(MessageSchemaTest, ChecksSizeOnce) {
+	Buffer buf(20);
+	TestSchema::write_unsafe(buf.data(), 1, 2, 3, 4);
+
+	EXPECT_FALSE(TestSchema::read(buf.data(), TestSchema::size - 1).has_value());
+
+	auto res = TestSchema::read(buf.data(), TestSchema::size);
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(*res, std::make_tuple(uint8_t(1), uint32_t(2), uint64_t(3), uint16_t(4)));
+}
+
+TEST(MessageSchemaTest, ReadsBytesFields) {
+	using KeySchema = MessageSchema<BytesField<4, 0>, UintField<uint16_t, 4>>;
+
+	uint8_t bytes[6];
+	KeySchema::write_unsafe(bytes, {1, 2, 3, 4}, 5);
+
+	auto [key, value] = KeySchema::read_unsafe(bytes);
+	EXPECT_EQ(key, (std::array<uint8_t, 4>{1, 2, 3, 4}));
+	EXPECT_EQ(value, 5);
+}
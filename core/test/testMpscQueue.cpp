@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+#include "marlin/core/MpscQueue.hpp"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace marlin::core;
+
+TEST(MpscQueueTest, PopsInPushOrder) {
+	MpscQueue<int> queue;
+	EXPECT_TRUE(queue.empty());
+	EXPECT_FALSE(queue.pop().has_value());
+
+	for(int i = 0; i < 10; i++) {
+		queue.push(int(i));
+	}
+	EXPECT_FALSE(queue.empty());
+
+	for(int i = 0; i < 10; i++) {
+		auto res = queue.pop();
+		ASSERT_TRUE(res.has_value());
+		EXPECT_EQ(*res, i);
+	}
+	EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTest, HoldsMoveOnlyValues) {
+	MpscQueue<std::unique_ptr<int>> queue;
+	queue.push(std::make_unique<int>(5));
+
+	// Left in the queue on purpose, destructor has to free it
+	queue.push(std::make_unique<int>(6));
+
+	auto res = queue.pop();
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(**res, 5);
+}
+
+TEST(MpscQueueTest, KeepsPerProducerOrder) {
+	constexpr int producers = 4;
+	constexpr int per_producer = 20000;
+
+	MpscQueue<std::pair<int, int>> queue;
+	std::vector<std::thread> threads;
+	for(int p = 0; p < producers; p++) {
+		threads.emplace_back([&queue, p]() {
+			for(int i = 0; i < per_producer; i++) {
+				queue.push(std::make_pair(p, i));
+			}
+		});
+	}
+
+	std::vector<int> next(producers, 0);
+	int total = 0;
+	while(total < producers * per_producer) {
+		auto res = queue.pop();
+		if(!res.has_value()) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto [p, i] = *res;
+		EXPECT_EQ(i, next[p]);
+		next[p] = i + 1;
+		total++;
+	}
+
+	for(auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "marlin/core/PrefixRateLimiter.hpp"
+
+#include <string>
+
+
+using namespace marlin::core;
+
+TEST(PrefixRateLimiterTest, BurstThenRate) {
+	// 10 per second, bursts of 3
+	PrefixRateLimiter limiter(10, 3);
+	auto addr = SocketAddress::from_string("1.2.3.4:80");
+
+	EXPECT_TRUE(limiter.allow(addr, 1000));
+	EXPECT_TRUE(limiter.allow(addr, 1000));
+	EXPECT_TRUE(limiter.allow(addr, 1000));
+	EXPECT_FALSE(limiter.allow(addr, 1000));
+
+	// One token every 100 ms
+	EXPECT_FALSE(limiter.allow(addr, 1050));
+	EXPECT_TRUE(limiter.allow(addr, 1150));
+	EXPECT_FALSE(limiter.allow(addr, 1150));
+
+	// Refill caps at burst
+	EXPECT_TRUE(limiter.allow(addr, 10000));
+	EXPECT_TRUE(limiter.allow(addr, 10000));
+	EXPECT_TRUE(limiter.allow(addr, 10000));
+	EXPECT_FALSE(limiter.allow(addr, 10000));
+}
+
+TEST(PrefixRateLimiterTest, SharedAcrossPrefix) {
+	PrefixRateLimiter limiter(1, 2);
+
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.2.3.4:80"), 0));
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.2.3.5:81"), 0));
+	EXPECT_FALSE(limiter.allow(SocketAddress::from_string("1.2.3.200:9000"), 0));
+	// Different /24
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.2.4.4:80"), 0));
+	EXPECT_EQ(limiter.size(), 2);
+}
+
+TEST(PrefixRateLimiterTest, Ipv6Prefix) {
+	PrefixRateLimiter limiter(1, 1);
+
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("[2001:db8:1:2::1]:80"), 0));
+	EXPECT_FALSE(limiter.allow(SocketAddress::from_string("[2001:db8:1:ffff::1]:80"), 0));
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("[2001:db8:2::1]:80"), 0));
+}
+
+TEST(PrefixRateLimiterTest, BoundedBuckets) {
+	PrefixRateLimiter limiter(1, 2, 32, 128, 2);
+
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.0.0.1:80"), 0));
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.0.0.2:80"), 0));
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.0.0.1:80"), 1));
+	// Table full, the least recently used bucket makes room
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("1.0.0.3:80"), 2));
+	EXPECT_EQ(limiter.size(), 2);
+	EXPECT_EQ(limiter.evictions(), 1);
+
+	// 1.0.0.1 kept its bucket and has no tokens left
+	EXPECT_FALSE(limiter.allow(SocketAddress::from_string("1.0.0.1:80"), 2));
+}
+
+TEST(PrefixRateLimiterTest, FloodOfNewPrefixes) {
+	PrefixRateLimiter limiter(1, 2, 32, 128, 1024);
+
+	for(uint32_t i = 0; i < 1024; i++) {
+		auto addr = SocketAddress::from_string(
+			"10." + std::to_string(i >> 16) + "." + std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff) + ":80"
+		);
+		EXPECT_TRUE(limiter.allow(addr, 0));
+	}
+	EXPECT_EQ(limiter.size(), 1024);
+	EXPECT_EQ(limiter.evictions(), 0);
+
+	// Spoofed sources keep arriving in the same millisecond, each one evicts exactly one bucket
+	for(uint32_t i = 0; i < 100000; i++) {
+		auto addr = SocketAddress::from_string(
+			"11." + std::to_string(i >> 16) + "." + std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff) + ":80"
+		);
+		EXPECT_TRUE(limiter.allow(addr, 0));
+	}
+	EXPECT_EQ(limiter.size(), 1024);
+	EXPECT_EQ(limiter.evictions(), 100000);
+
+	// A legitimate new peer still gets in
+	EXPECT_TRUE(limiter.allow(SocketAddress::from_string("192.0.2.1:80"), 0));
+}
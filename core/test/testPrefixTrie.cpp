@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include "marlin/core/PrefixTrie.hpp"
+#include "marlin/core/AddressClassifier.hpp"
+
+
+using namespace marlin::core;
+
+static SocketAddress addr(std::string ip) {
+	return SocketAddress::from_string(ip);
+}
+
+TEST(PrefixTrieTest, EmptyMatchesNothing) {
+	PrefixTrie<int> trie;
+
+	EXPECT_EQ(trie.lookup(addr("1.2.3.4:80")), nullptr);
+	EXPECT_EQ(trie.lookup(addr("[::1]:80")), nullptr);
+}
+
+TEST(PrefixTrieTest, LongestPrefixWins) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("10.0.0.0/8"), 8);
+	trie.insert(CidrBlock::from_string("10.1.2.0/24"), 24);
+	trie.insert(CidrBlock::from_string("10.1.0.0/16"), 16);
+	trie.insert(CidrBlock::from_string("10.1.2.3/32"), 32);
+
+	EXPECT_EQ(*trie.lookup(addr("10.9.9.9:80")), 8);
+	EXPECT_EQ(*trie.lookup(addr("10.1.9.9:80")), 16);
+	EXPECT_EQ(*trie.lookup(addr("10.1.2.9:80")), 24);
+	EXPECT_EQ(*trie.lookup(addr("10.1.2.3:80")), 32);
+	EXPECT_EQ(trie.lookup(addr("11.1.2.3:80")), nullptr);
+}
+
+TEST(PrefixTrieTest, NonByteAlignedPrefixes) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("172.16.0.0/12"), 12);
+	trie.insert(CidrBlock::from_string("172.20.0.0/14"), 14);
+
+	EXPECT_EQ(*trie.lookup(addr("172.16.0.1:80")), 12);
+	EXPECT_EQ(*trie.lookup(addr("172.31.255.255:80")), 12);
+	EXPECT_EQ(*trie.lookup(addr("172.21.0.1:80")), 14);
+	EXPECT_EQ(*trie.lookup(addr("172.23.255.255:80")), 14);
+	EXPECT_EQ(*trie.lookup(addr("172.24.0.0:80")), 12);
+	EXPECT_EQ(trie.lookup(addr("172.32.0.0:80")), nullptr);
+	EXPECT_EQ(trie.lookup(addr("172.15.255.255:80")), nullptr);
+}
+
+TEST(PrefixTrieTest, ShorterInsertedLaterDoesNotOverride) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("192.168.128.0/17"), 17);
+	trie.insert(CidrBlock::from_string("192.168.0.0/16"), 16);
+
+	EXPECT_EQ(*trie.lookup(addr("192.168.200.1:80")), 17);
+	EXPECT_EQ(*trie.lookup(addr("192.168.100.1:80")), 16);
+}
+
+TEST(PrefixTrieTest, SamePrefixReplaces) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("10.0.0.0/8"), 1);
+	trie.insert(CidrBlock::from_string("10.0.0.0/8"), 2);
+
+	EXPECT_EQ(*trie.lookup(addr("10.0.0.1:80")), 2);
+}
+
+TEST(PrefixTrieTest, DefaultRoute) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("0.0.0.0/0"), 0);
+	trie.insert(CidrBlock::from_string("10.0.0.0/8"), 8);
+
+	EXPECT_EQ(*trie.lookup(addr("1.2.3.4:80")), 0);
+	EXPECT_EQ(*trie.lookup(addr("10.2.3.4:80")), 8);
+	EXPECT_EQ(trie.lookup(addr("[::1]:80")), nullptr);
+}
+
+TEST(PrefixTrieTest, Ipv6) {
+	PrefixTrie<int> trie;
+	trie.insert(CidrBlock::from_string("2001:db8::/32"), 32);
+	trie.insert(CidrBlock::from_string("2001:db8:1::/48"), 48);
+	trie.insert(CidrBlock::from_string("fc00::/7"), 7);
+
+	EXPECT_EQ(*trie.lookup(addr("[2001:db8:2::1]:80")), 32);
+	EXPECT_EQ(*trie.lookup(addr("[2001:db8:1::1]:80")), 48);
+	EXPECT_EQ(*trie.lookup(addr("[fd00::1]:80")), 7);
+	EXPECT_EQ(trie.lookup(addr("[fe80::1]:80")), nullptr);
+	// Families do not mix
+	EXPECT_EQ(trie.lookup(addr("32.1.13.184:80")), nullptr);
+}
+
+TEST(AddressClassifierTest, DefaultInternalRanges) {
+	auto& classifier = AddressClassifier::default_instance();
+
+	EXPECT_EQ(classifier.classify(addr("10.1.2.3:80")), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(addr("172.16.5.4:80")), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(addr("192.168.1.1:80")), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(SocketAddress::loopback_ipv4(80)), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(SocketAddress::loopback_ipv6(80)), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(addr("8.8.8.8:80")), AddressClass::Public);
+	EXPECT_EQ(classifier.classify(addr("[2001:db8::1]:80")), AddressClass::Public);
+}
+
+TEST(AddressClassifierTest, MoreSpecificClassWins) {
+	AddressClassifier classifier;
+	classifier.add("10.0.0.0/8", AddressClass::Internal);
+	classifier.add("10.0.0.5/32", AddressClass::Blocked);
+	classifier.add("100.64.0.0/10", AddressClass::RateLimited);
+
+	EXPECT_EQ(classifier.classify(addr("10.0.0.4:80")), AddressClass::Internal);
+	EXPECT_EQ(classifier.classify(addr("10.0.0.5:80")), AddressClass::Blocked);
+	EXPECT_EQ(classifier.classify(addr("100.100.0.1:80")), AddressClass::RateLimited);
+	EXPECT_EQ(classifier.classify(addr("100.128.0.1:80")), AddressClass::Public);
+}
@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 #include "marlin/core/SocketAddress.hpp"
 
+#include <cstring>
+#include <unordered_set>
+
 
 using namespace marlin::core;
 
@@ -51,3 +54,69 @@ TEST(SocketAddressTest, LoopbackConstructible) {
 
 	EXPECT_EQ(addr, SocketAddress::from_string("127.0.0.1:8000"));
 }
+
+TEST(SocketAddressTest, Ipv6StringConvertible) {
+	auto addr = SocketAddress::from_string("[2001:db8::1]:8000");
+
+	EXPECT_TRUE(addr.is_ipv6());
+	EXPECT_FALSE(addr.is_ipv4());
+	EXPECT_EQ(addr.get_port(), 8000);
+	EXPECT_EQ(addr.ip_string(), "2001:db8::1");
+	EXPECT_EQ(addr.to_string(), "[2001:db8::1]:8000");
+	EXPECT_EQ(addr, SocketAddress::from_string("[2001:0db8:0:0::1]:8000"));
+	EXPECT_EQ(SocketAddress::loopback_ipv6(8000).to_string(), "[::1]:8000");
+}
+
+TEST(SocketAddressTest, KeyIgnoresUnusedBytes) {
+	auto addr = SocketAddress::from_string("192.168.0.1:8000");
+	// Garbage past sockaddr_in
+	sockaddr_storage storage;
+	std::memset(&storage, 0xab, sizeof(storage));
+	std::memcpy(&storage, &addr, sizeof(sockaddr_in));
+	SocketAddress naddr(storage);
+
+	EXPECT_EQ(naddr.key(), addr.key());
+	EXPECT_EQ(naddr, addr);
+	EXPECT_EQ(std::hash<SocketAddress>()(naddr), std::hash<SocketAddress>()(addr));
+}
+
+TEST(SocketAddressTest, FamiliesAreDistinct) {
+	auto addr4 = SocketAddress::from_string("0.0.0.0:8000");
+	auto addr6 = SocketAddress::from_string("[::]:8000");
+
+	EXPECT_NE(addr4, addr6);
+	EXPECT_TRUE(addr4 < addr6 || addr6 < addr4);
+}
+
+TEST(SocketAddressTest, Ordered) {
+	auto a = SocketAddress::from_string("10.0.0.1:9000");
+	auto b = SocketAddress::from_string("10.0.0.2:8000");
+
+	EXPECT_TRUE(a < b);
+	EXPECT_FALSE(b < a);
+	EXPECT_FALSE(a < a);
+}
+
+TEST(SocketAddressTest, SequentialPortsDoNotCollide) {
+	// Same ip with sequential ports, the usual NAT pattern
+	std::unordered_set<size_t> hashes;
+	for(uint16_t port = 1000; port < 11000; port++) {
+		auto addr = SocketAddress::from_string("192.168.0.1:" + std::to_string(port));
+		hashes.insert(std::hash<SocketAddress>()(addr));
+	}
+
+	EXPECT_EQ(hashes.size(), 10000);
+}
+
+TEST(SocketAddressTest, SerializeRoundTrip) {
+	uint8_t bytes[20];
+
+	auto addr4 = SocketAddress::from_string("192.168.0.1:8000");
+	EXPECT_EQ(addr4.serialize(bytes, 20), 8);
+	EXPECT_EQ(SocketAddress::deserialize(bytes, 8), addr4);
+
+	auto addr6 = SocketAddress::from_string("[2001:db8::1]:8000");
+	EXPECT_EQ(addr6.serialize(bytes, 8), 0);
+	EXPECT_EQ(addr6.serialize(bytes, 20), 20);
+	EXPECT_EQ(SocketAddress::deserialize(bytes, 20), addr6);
+}
@@ -0,0 +1,58 @@
+#include "gtest/gtest.h"
+#include "marlin/core/ThreadPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace marlin::core;
+
+TEST(ThreadPoolTest, RunsInlineWithoutThreads) {
+	ThreadPool pool(0);
+	EXPECT_EQ(pool.size(), 0);
+
+	std::vector<int> order;
+	for(int i = 0; i < 5; i++) {
+		pool.submit([&order, i]() { order.push_back(i); });
+		// Already ran
+		EXPECT_EQ(order.size(), (size_t)i + 1);
+	}
+	EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST(ThreadPoolTest, RunsEveryTask) {
+	std::atomic<int> count = 0;
+	{
+		ThreadPool pool(4);
+		for(int i = 0; i < 10000; i++) {
+			pool.submit([&count]() { count.fetch_add(1); });
+		}
+		// Destructor drains the queues
+	}
+	EXPECT_EQ(count.load(), 10000);
+}
+
+TEST(ThreadPoolTest, RunsTasksSubmittedFromWorkers) {
+	std::atomic<int> count = 0;
+	{
+		ThreadPool pool(2);
+		for(int i = 0; i < 100; i++) {
+			pool.submit([&pool, &count]() {
+				for(int j = 0; j < 100; j++) {
+					pool.submit([&count]() { count.fetch_add(1); });
+				}
+			});
+		}
+	}
+	EXPECT_EQ(count.load(), 10000);
+}
+
+TEST(ThreadPoolTest, AcceptsMoveOnlyTasks) {
+	std::atomic<int> sum = 0;
+	{
+		ThreadPool pool(1);
+		auto value = std::make_unique<int>(42);
+		pool.submit([&sum, value = std::move(value)]() { sum.fetch_add(*value); });
+	}
+	EXPECT_EQ(sum.load(), 42);
+}
@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+#include "marlin/core/TransportManager.hpp"
+
+
+using namespace marlin::core;
+
+struct Transport {};
+
+TEST(TransportManagerTest, FindsTransportsByConnId) {
+	TransportManager<Transport> manager;
+	Transport a, b;
+
+	EXPECT_TRUE(manager.set_conn_id(1, &a));
+	EXPECT_TRUE(manager.set_conn_id(2, &b));
+	EXPECT_EQ(manager.get_by_conn_id(1), &a);
+	EXPECT_EQ(manager.get_by_conn_id(2), &b);
+	EXPECT_EQ(manager.get_by_conn_id(3), nullptr);
+}
+
+TEST(TransportManagerTest, RejectsConnIdOfAnotherTransport) {
+	TransportManager<Transport> manager;
+	Transport a, b;
+
+	EXPECT_TRUE(manager.set_conn_id(1, &a));
+	EXPECT_FALSE(manager.set_conn_id(1, &b));
+	EXPECT_EQ(manager.get_by_conn_id(1), &a);
+
+	// Setting the same mapping again is fine
+	EXPECT_TRUE(manager.set_conn_id(1, &a));
+
+	// Free for others once erased by its owner
+	manager.erase_conn_id(1, &b);
+	EXPECT_EQ(manager.get_by_conn_id(1), &a);
+	manager.erase_conn_id(1, &a);
+	EXPECT_TRUE(manager.set_conn_id(1, &b));
+	EXPECT_EQ(manager.get_by_conn_id(1), &b);
+}
+
+TEST(TransportManagerTest, SharedConnIdsCollideAcrossManagers) {
+	TransportManager<Transport> m1, m2;
+	Transport a, b;
+	m2.share_conn_ids(m1);
+
+	EXPECT_TRUE(m1.set_conn_id(1, &a));
+	EXPECT_FALSE(m2.set_conn_id(1, &b));
+	EXPECT_EQ(m2.get_by_conn_id(1), &a);
+}
@@ -1,6 +1,8 @@
 #include "OnRamp.hpp"
 #include <unistd.h>
 
+#include <optional>
+
 
 using namespace marlin::core;
 using namespace marlin::asyncio;
@@ -13,9 +15,11 @@ int main(int argc, char **argv) {
 	std::string beacon_addr = "127.0.0.1:8002";
 	std::string discovery_addr = "0.0.0.0:20202";
 	std::string pubsub_addr = "0.0.0.0:20200";
+	// Bytes per second of new txns published on channel 1
+	std::optional<uint64_t> txn_rate;
 
 	int c;
-	while ((c = getopt (argc, argv, "b::d::p::")) != -1) {
+	while ((c = getopt (argc, argv, "b::d::p::t::")) != -1) {
 		switch (c) {
 			case 'b':
 				beacon_addr = std::string(optarg);
@@ -26,6 +30,12 @@ int main(int argc, char **argv) {
 			case 'p':
 				pubsub_addr = std::string(optarg);
 				break;
+			case 't':
+				if(optarg == nullptr) {
+					return 1;
+				}
+				txn_rate = std::stoull(optarg);
+				break;
 			default:
 			return 1;
 		}
@@ -52,6 +62,9 @@ int main(int argc, char **argv) {
 	};
 
 	OnRamp onramp(clop);
+	if(txn_rate.has_value()) {
+		onramp.ingester.set_publish_limit(txn_rate.value(), txn_rate.value());
+	}
 
 	return uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 }
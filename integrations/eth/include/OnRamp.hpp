@@ -5,7 +5,10 @@
 #include <marlin/pubsub/attestation/SigAttester.hpp>
 #include <marlin/pubsub/witness/LpfBloomWitnesser.hpp>
 #include <marlin/rlpx/RlpxTransportFactory.hpp>
-#include <cryptopp/blake2.h>
+#include <marlin/rlpx/BlockFetcher.hpp>
+#include <marlin/rlpx/EthResponses.hpp>
+#include <marlin/rlpx/TxnIngester.hpp>
+#include <marlin/pubsub/attestation/MessageDigests.hpp>
 
 using namespace marlin;
 using namespace marlin::core;
@@ -21,13 +24,19 @@ public:
 	DefaultMulticastClientType multicastClient;
 	RlpxTransport<OnRamp> *rlpxt = nullptr;
 	RlpxTransportFactory<OnRamp, OnRamp> f;
+	using BlockFetcherType = BlockFetcher<OnRamp, RlpxTransport<OnRamp>>;
+	BlockFetcherType fetcher;
+	using TxnIngesterType = TxnIngester<OnRamp>;
+	TxnIngesterType ingester;
 
 	std::vector<std::tuple<uint32_t, uint16_t, uint16_t>> get_protocols() {
 		return {};
 	}
 
-	OnRamp(DefaultMulticastClientOptions clop, uint8_t* key) : multicastClient(clop, key), header(0) {
+	OnRamp(DefaultMulticastClientOptions clop, uint8_t* key) : multicastClient(clop, key) {
 		multicastClient.delegate = this;
+		fetcher.delegate = this;
+		ingester.delegate = this;
 		f.bind(SocketAddress::loopback_ipv4(12121));
 		f.listen(*this);
 	}
@@ -72,18 +81,11 @@ public:
 		uint16_t
 	) {}
 
-	Buffer header;
-
 	void did_recv(RlpxTransport<OnRamp> &transport, Buffer &&message) {
-		CryptoPP::BLAKE2b blake2b((uint)8);
-		blake2b.Update((uint8_t *)message.data(), message.size());
-		uint64_t message_id;
-		blake2b.TruncatedFinal((uint8_t *)&message_id, 8);
 		SPDLOG_DEBUG(
-			"Transport {{ Src: {}, Dst: {} }}: Did recv message {}: {} bytes",
+			"Transport {{ Src: {}, Dst: {} }}: Did recv message: {} bytes",
 			transport.src_addr.to_string(),
 			transport.dst_addr.to_string(),
-			message_id,
 			message.size()
 		);
 
@@ -95,6 +97,8 @@ public:
 				message.size()
 			);
 
+			fetcher.did_recv_status(transport, message);
+
 			Buffer response(message.size());
 
 			std::memcpy(response.data(), message.data(), message.size());
@@ -112,36 +116,7 @@ public:
 				message.size()
 			);
 
-			if(message.size() > 60) {
-				// FIXME: Currently, doesn't work if more than one hash in message
-				SPDLOG_ERROR(
-					"Transport {{ Src: {}, Dst: {} }}: Too many hashes: {} bytes",
-					transport.src_addr.to_string(),
-					transport.dst_addr.to_string(),
-					message.size()
-				);
-
-				return;
-			}
-
-			// Get header
-			Buffer headermsg(38);
-			headermsg.write_uint8_unsafe(0, 0x13);
-			headermsg.write_uint8_unsafe(1, 0xe4);
-			headermsg.write_unsafe(2, message.data() + 3, 33);
-			headermsg.write_uint8_unsafe(35, 1);
-			headermsg.write_uint8_unsafe(36, 0x80);
-			headermsg.write_uint8_unsafe(37, 0x80);
-
-			transport.send(std::move(headermsg));
-
-			// Get body
-			Buffer bodymsg(35);
-			bodymsg.write_uint8_unsafe(0, 0x15);
-			bodymsg.write_uint8_unsafe(1, 0xe1);
-			bodymsg.write_unsafe(2, message.data() + 3, 33);
-
-			transport.send(std::move(bodymsg));
+			fetcher.did_recv_announcement(transport, std::move(message));
 		} else if(message.data()[0] == 0x13) { // eth63 GetBlockHeaders
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: GetBlockHeaders message: {} bytes",
@@ -149,7 +124,9 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
-			transport.send(Buffer({0x14, 0xc0}, 2));
+			if(auto response = eth_empty_response(message, 0x14, fetcher.has_request_ids(transport))) {
+				transport.send(std::move(*response));
+			}
 		} else if(message.data()[0] == 0x14) { // eth63 BlockHeaders
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: BlockHeaders message: {} bytes",
@@ -157,7 +134,7 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
-			header = std::move(message);
+			fetcher.did_recv_headers(transport, std::move(message));
 		} else if(message.data()[0] == 0x15) { // eth63 GetBlockBodies
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: GetBlockBodies message: {} bytes",
@@ -165,7 +142,9 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
-			transport.send(Buffer({0x16, 0xc0}, 2));
+			if(auto response = eth_empty_response(message, 0x16, fetcher.has_request_ids(transport))) {
+				transport.send(std::move(*response));
+			}
 		} else if(message.data()[0] == 0x16) { // eth63 BlockBodies
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: BlockBodies message: {} bytes",
@@ -174,85 +153,7 @@ public:
 				message.size()
 			);
 
-			auto&& header = std::move(this->header);
-			header.cover_unsafe(1);
-			if(header.size() <= 56) {
-				header.cover_unsafe(1);
-			} else {
-				uint8_t hll = header.read_uint8_unsafe(0) - 0xf7;
-				header.cover_unsafe(1 + hll);
-			}
-
-			message.cover_unsafe(1);
-			if(message.size() <= 56) {
-				message.cover_unsafe(1);
-			} else {
-				uint8_t hll = message.read_uint8_unsafe(0) - 0xf7;
-				message.cover_unsafe(1 + hll);
-			}
-			if(message.size() <= 56) {
-				message.cover_unsafe(1);
-			} else {
-				uint8_t hll = message.read_uint8_unsafe(0) - 0xf7;
-				message.cover_unsafe(1 + hll);
-			}
-
-			Buffer final(1 + 9 + 9 + header.size() + message.size() + 1);
-			uint64_t pos = final.size();
-			final.write_uint8_unsafe(pos - 1, 0x80); pos--;
-			final.write_unsafe(pos - message.size(), message.data(), message.size()); pos -= message.size();
-			final.write_unsafe(pos - header.size(), header.data(), header.size()); pos -= header.size();
-
-			{
-				uint64_t size = header.size() + message.size();
-				uint8_t length = 0;
-				while(size > 0) {
-					final.write_uint8_unsafe(pos - 1, (uint8_t)size); pos--;
-					length++;
-					size = size >> 8;
-				}
-				final.write_uint8_unsafe(pos - 1, length + 0xf7); pos--;
-			}
-
-			{
-				uint64_t size = final.size() - pos;
-				uint8_t length = 0;
-				while(size > 0) {
-					final.write_uint8_unsafe(pos - 1, (uint8_t)size); pos--;
-					length++;
-					size = size >> 8;
-				}
-				final.write_uint8_unsafe(pos - 1, length + 0xf7); pos--;
-			}
-
-			final.write_uint8_unsafe(pos - 1, 0x17); pos--;
-			final.cover_unsafe(pos);
-
-			// SPDLOG_INFO(
-			// 	"Transport {{ Src: {}, Dst: {} }}: Final message: {} bytes: {}",
-			// 	transport.src_addr.to_string(),
-			// 	transport.dst_addr.to_string(),
-			// 	final.size(),
-			// 	spdlog::to_hex(final.data(), final.data() + final.size())
-			// );
-
-			CryptoPP::BLAKE2b blake2b((uint)8);
-			blake2b.Update((uint8_t *)final.data(), final.size());
-			uint64_t message_id;
-			blake2b.TruncatedFinal((uint8_t *)&message_id, 8);
-
-			SPDLOG_INFO(
-				"Received message {} on channel 0",
-				message_id
-			);
-			multicastClient.ps.send_message_on_channel(
-				0,
-				message_id,
-				final.data(),
-				final.size()
-			);
-
-			// transport.send(std::move(final));
+			fetcher.did_recv_bodies(transport, std::move(message));
 		} else if(message.data()[0] == 0x1d) { // eth63 GetNodeData
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: GetNodeData message: {} bytes",
@@ -260,7 +161,9 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
-			transport.send(Buffer({0x1e, 0xc0}, 2));
+			if(auto response = eth_empty_response(message, 0x1e, fetcher.has_request_ids(transport))) {
+				transport.send(std::move(*response));
+			}
 		} else if(message.data()[0] == 0x12) { // eth63 Transactions
 			SPDLOG_DEBUG(
 				"Transport {{ Src: {}, Dst: {} }}: Transactions message: {} bytes",
@@ -268,12 +171,7 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
-			// multicastClient.ps.send_message_on_channel(
-			// 	1,
-			// 	message_id,
-			// 	message.data(),
-			// 	message.size()
-			// );
+			ingester.did_recv_txns(std::move(message));
 		} else if(message.data()[0] == 0x17) { // eth63 NewBlock
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: NewBlock message: {} bytes",
@@ -281,18 +179,26 @@ public:
 				transport.dst_addr.to_string(),
 				message.size()
 			);
+
+			// Message id and the hash attesters sign, in one pass
+			MessageDigests digests(message.data(), message.size());
+			MessageHeader header;
+			header.message_hash = digests.keccak;
+
 			SPDLOG_INFO(
 				"Received message {} on channel 0",
-				message_id
+				digests.message_id
 			);
 			multicastClient.ps.send_message_on_channel(
 				0,
-				message_id,
+				digests.message_id,
 				message.data(),
-				message.size()
+				message.size(),
+				nullptr,
+				header
 			);
 		} else if(message.data()[0] == 0x18) { // eth65 PooledTransactions
-			// Nothing
+			ingester.did_recv_txns(std::move(message));
 		} else {
 			SPDLOG_INFO(
 				"Transport {{ Src: {}, Dst: {} }}: Unknown message: {} bytes: {}",
@@ -304,6 +210,50 @@ public:
 		}
 	}
 
+	void did_fetch_block(BlockFetcherType &, Buffer &&header, Buffer &&body) {
+		// NewBlock: [[header, transactions, uncles], td]
+		auto final = RlpEncoder<>::encode([&](auto &e) {
+			e.begin_list();
+			e.begin_list();
+			e.add_raw(header.data(), header.size());
+			e.add_raw(body.data(), body.size());
+			e.end_list();
+			e.add_uint(0);
+			e.end_list();
+		}, 1);
+		final.data()[0] = 0x17;
+
+		// Message id and the hash attesters sign, in one pass
+		MessageDigests digests(final.data(), final.size());
+		MessageHeader message_header;
+		message_header.message_hash = digests.keccak;
+
+		SPDLOG_INFO(
+			"Received message {} on channel 0",
+			digests.message_id
+		);
+		multicastClient.ps.send_message_on_channel(
+			0,
+			digests.message_id,
+			final.data(),
+			final.size(),
+			nullptr,
+			message_header
+		);
+
+		// Published, the txns of the block can leave the cache once the grace period for compressing it is over
+		ingester.did_recv_block(body);
+	}
+
+	void did_ingest_txn(TxnIngesterType &, uint64_t txn_id, Buffer const &txn) {
+		multicastClient.ps.send_message_on_channel(
+			1,
+			txn_id,
+			txn.data(),
+			txn.size()
+		);
+	}
+
 	void did_send(
 		RlpxTransport<OnRamp> &transport __attribute__((unused)),
 		Buffer &&message __attribute__((unused))
@@ -324,11 +274,15 @@ public:
 
 	void did_create_transport(RlpxTransport<OnRamp> &transport) {
 		rlpxt  = &transport;
+		fetcher.add_peer(transport);
 		transport.setup(this);
 	}
 
-	void did_close(RlpxTransport<OnRamp> &, uint16_t) {
-		rlpxt = nullptr;
+	void did_close(RlpxTransport<OnRamp> &transport, uint16_t) {
+		fetcher.remove_peer(transport);
+		if(rlpxt == &transport) {
+			rlpxt = nullptr;
+		}
 	}
 };
 
@@ -25,8 +25,10 @@ struct CliOptions {
 	std::optional<std::string> keystore_pass_path;
 	enum class Contracts { mainnet, kovan };
 	std::optional<Contracts> contracts;
+	// Bytes per second of new txns published on channel 1
+	std::optional<uint64_t> txn_rate;
 };
-STRUCTOPT(CliOptions, discovery_addr, pubsub_addr, beacon_addr, keystore_path, keystore_pass_path, contracts);
+STRUCTOPT(CliOptions, discovery_addr, pubsub_addr, beacon_addr, keystore_path, keystore_pass_path, contracts, txn_rate);
 
 std::string get_key(std::string keystore_path, std::string keystore_pass_path);
 
@@ -134,6 +136,9 @@ int main(int argc, char** argv) {
 		};
 
 		OnRamp onramp(clop, (uint8_t*)key.data());
+		if(options.txn_rate.has_value()) {
+			onramp.ingester.set_publish_limit(options.txn_rate.value(), options.txn_rate.value());
+		}
 
 		return uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 	} catch (structopt::exception& e) {
@@ -28,8 +28,10 @@ struct CliOptions {
 	std::optional<Contracts> contracts;
 	// std::optional<SpamCheckMode> spamcheck;
 	std::optional<std::string> spamcheck_addr;
+	// Bytes per second of new txns published on channel 1
+	std::optional<uint64_t> txn_rate;
 };
-STRUCTOPT(CliOptions, discovery_addr, pubsub_addr, beacon_addr, keystore_path, keystore_pass_path, contracts, spamcheck_addr);
+STRUCTOPT(CliOptions, discovery_addr, pubsub_addr, beacon_addr, keystore_path, keystore_pass_path, contracts, spamcheck_addr, txn_rate);
 
 std::string get_key(std::string keystore_path, std::string keystore_pass_path);
 
@@ -143,6 +145,9 @@ int main(int argc, char** argv) {
 		};
 
 		OnRamp onramp(clop, listen_addr, options.spamcheck_addr, (uint8_t*)key.data());
+		if(options.txn_rate.has_value()) {
+			onramp.ingester.set_publish_limit(options.txn_rate.value(), options.txn_rate.value());
+		}
 
 		return uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 	} catch (structopt::exception& e) {
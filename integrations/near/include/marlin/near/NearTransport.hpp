@@ -3,6 +3,7 @@
 
 // #include <spdlog/spdlog.h>
 #include <marlin/asyncio/tcp/TcpTransport.hpp>
+#include <marlin/core/FrameAssembler.hpp>
 #include <cryptopp/sha.h>
 #include <sodium.h>
 
@@ -24,17 +25,17 @@ private:
 	using BaseTransport = asyncio::TcpTransport<Self>;
 	BaseTransport &transport;
 	enum struct State {
-		Idle,
 		LengthWait,
-		MessageReading,
-		Done
+		MessageReading
 	};
-	State state = State::Idle;
+	State state = State::LengthWait;
 	core::TransportManager <Self> &transportManager;
 
-	uint8_t *buf; // The limit is yet to be set.
-	uint32_t buf_size = 0;
-	uint32_t bytes_remaining = 0;
+	// Cuts length prefixed messages out of reads
+	core::FrameAssembler assembler;
+
+	// Largest message nearcore's peer codec accepts, larger ones close the connection
+	static constexpr uint32_t max_message_size = 512 * 1024 * 1024;
 public:
 
 	DelegateType *delegate;
@@ -78,7 +79,6 @@ void NearTransport<DelegateType>::did_send(BaseTransport &, core::Buffer &&) {
 
 template<typename DelegateType>
 void NearTransport<DelegateType>::did_close(BaseTransport &, uint16_t reason) {
-	delete[] buf;
 	delegate->did_close(*this, reason);
 	transportManager.erase(dst_addr);
 }
@@ -90,6 +90,7 @@ NearTransport<DelegateType>::NearTransport(
 	BaseTransport &transport,
 	core::TransportManager<Self> &transportManager
 ): transport(transport), transportManager(transportManager), src_addr(src_addr), dst_addr(dst_addr) {
+	assembler.expect(4);
 }
 
 template<typename DelegateType>
@@ -115,47 +116,37 @@ void NearTransport<DelegateType>::did_recv(
 	core::Buffer &&bytes
 ) {
 	// SPDLOG_DEBUG("{}", spdlog::to_hex(bytes.data(), bytes.data() + bytes.size()));
-	if(bytes_remaining > bytes.size()) { // Partial message
-		SPDLOG_DEBUG("Partial: {}, {}, {}", buf_size, bytes.size(), bytes_remaining);
-		std::memcpy(buf + buf_size, bytes.data(), bytes.size());
-		buf_size += bytes.size();
-		bytes_remaining -= bytes.size();
-		bytes.cover_unsafe(bytes.size());
-	} else { // Full message
-		SPDLOG_DEBUG("Full: {}, {}, {}, {}", buf_size, bytes.size(), bytes_remaining, state);
-		std::memcpy(buf + buf_size, bytes.data(), bytes_remaining);
-		buf_size += bytes_remaining;
-		bytes.cover_unsafe(bytes_remaining);
-		bytes_remaining = 0;
-
-		if(state == State::Idle) {
-			bytes_remaining = 4;
-			buf = new uint8_t[4];
-			state = State::LengthWait;
-		} else if(state == State::LengthWait) {
-			bytes_remaining = 0;
-			for(int i = 3; i >= 0; i--) {
-				bytes_remaining = buf[i] + (bytes_remaining << 8);
+	while(bytes.size() > 0) {
+		if(state == State::LengthWait) {
+			auto *prefix = assembler.peek(bytes, 4);
+			if(prefix == nullptr) {
+				return;
+			}
+
+			// Little endian length, the prefix stays in front of the message
+			uint32_t length = (uint32_t)prefix[0] | ((uint32_t)prefix[1] << 8) |
+				((uint32_t)prefix[2] << 16) | ((uint32_t)prefix[3] << 24);
+			if(length > max_message_size) {
+				SPDLOG_ERROR("NearTransport: Message too large: {}", length);
+				transport.close();
+				return;
 			}
-			uint8_t *size = buf;
-			buf = new uint8_t[bytes_remaining + 4];
-			memcpy(buf, size, 4);
-			delete[] size;
+
+			assembler.expect(4 + (size_t)length);
 			state = State::MessageReading;
-		} else if(state == State::MessageReading) {
-			state = State::Done;
-			core::Buffer message(buf, buf_size);
-			buf = nullptr;
-			message.cover_unsafe(4);
-			delegate->did_recv(*this, std::move(message));
-			state = State::Idle;
-			bytes_remaining = 0;
-			buf_size = 0;
 		}
 
-		if(bytes.size() > 0) {
-			did_recv(transport, std::move(bytes));
+		SPDLOG_DEBUG("Recv: {}, {}, {}", assembler.gathered(), bytes.size(), assembler.size());
+		auto message = assembler.next(bytes);
+		if(!message.has_value()) {
+			return;
 		}
+
+		assembler.expect(4);
+		state = State::LengthWait;
+
+		message->cover_unsafe(4);
+		delegate->did_recv(*this, std::move(*message));
 	}
 }
 
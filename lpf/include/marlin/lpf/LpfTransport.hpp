@@ -75,6 +75,11 @@ public:
 	int send(core::Buffer &&message);
 	void close(uint16_t reason = 0);
 
+	/// Encode a message with its length prefix as send would
+	static core::Buffer frame(uint8_t const* data, size_t size);
+	/// Send a message already encoded with frame, lets one encoded message go out on several transports
+	int send_framed(core::Buffer &&frame);
+
 	bool is_active();
 	double get_rtt();
 
@@ -341,12 +346,47 @@ int LpfTransport<
 >::send(
 	core::Buffer &&message
 ) {
-	core::Buffer lpf_message(message.size() + 8);
+	return transport.send(frame(message.data(), message.size()));
+}
+
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	typename SHOULD_CUT_THROUGH,
+	typename PREFIX_LENGTH
+>
+core::Buffer LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	SHOULD_CUT_THROUGH,
+	PREFIX_LENGTH
+>::frame(
+	uint8_t const* data,
+	size_t size
+) {
+	core::Buffer lpf_message(size + 8);
 
-	lpf_message.write_uint64_be_unsafe(0, message.size());
-	lpf_message.write_unsafe(8, message.data(), message.size());
+	lpf_message.write_uint64_be_unsafe(0, size);
+	lpf_message.write_unsafe(8, data, size);
 
-	return transport.send(std::move(lpf_message));
+	return lpf_message;
+}
+
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	typename SHOULD_CUT_THROUGH,
+	typename PREFIX_LENGTH
+>
+int LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	SHOULD_CUT_THROUGH,
+	PREFIX_LENGTH
+>::send_framed(
+	core::Buffer &&frame
+) {
+	return transport.send(std::move(frame));
 }
 
 template<
@@ -1,16 +1,26 @@
 /*
 	- tcp server's enable cut through : false
 	- blockchainChannel : tendermint (can be configured according to the project. However not required to do so)
+	- any number of blockchain clients can connect, each multicast message is encoded once and the same
+	  buffer is queued for every client
+	- every client has a bounded queue, when a slow client fills it the bridge either drops its oldest
+	  queued messages (-odrop, default) or disconnects it (-odisconnect)
+	- only a window of each queue is handed to tcp at a time, sends from one loop iteration go out
+	  together in a single write
 */
 
 #include <sodium.h>
 #include <unistd.h>
 
 #include <marlin/multicast/DefaultMulticastClient.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
 #include <marlin/asyncio/tcp/TcpTransportFactory.hpp>
 #include <marlin/stream/StreamTransportFactory.hpp>
 #include <marlin/lpf/LpfTransportFactory.hpp>
 
+#include <chrono>
+#include <deque>
+
 
 using namespace marlin::multicast;
 using namespace marlin::core;
@@ -36,25 +46,147 @@ using LpfTcpTransport = LpfTransport<
 	std::bool_constant<enable_cut_through>
 >;
 
+enum class SlowClientPolicy {
+	DropOldest,
+	Disconnect
+};
+
 class MulticastDelegate {
+private:
+	static constexpr uint64_t ReportInterval = 10000;
+	// Bytes handed to tcp and not yet written, per client
+	static constexpr uint64_t MaxInflightBytes = 1 << 20;
+
+	static uint64_t now_ms() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+	}
+
+	struct QueuedMessage {
+		Buffer frame;
+		uint64_t queued_at;
+	};
+
+	struct Client {
+		// Waiting in the bridge, oldest first
+		std::deque<QueuedMessage> queue;
+		uint64_t queued_bytes = 0;
+		// Handed to tcp, not yet written
+		std::deque<uint64_t> inflight_queued_at;
+		uint64_t inflight_bytes = 0;
+
+		uint64_t sent_messages = 0;
+		uint64_t sent_bytes = 0;
+		uint64_t dropped_messages = 0;
+		uint64_t max_queued_bytes = 0;
+		uint64_t max_lag_ms = 0;
+	};
+
+	std::unordered_map<LpfTcpTransport*, Client> clients;
+	SlowClientPolicy policy;
+	uint64_t max_queue_bytes;
+	Timer timer;
+
+	// Hand queued messages to tcp while the window allows
+	void flush(LpfTcpTransport& transport, Client& client) {
+		while(!client.queue.empty() && client.inflight_bytes < MaxInflightBytes) {
+			auto& message = client.queue.front();
+			auto size = message.frame.size();
+
+			client.queued_bytes -= size;
+			auto queued_at = message.queued_at;
+			auto res = transport.send_framed(std::move(message.frame));
+			client.queue.pop_front();
+
+			if(res < 0) {
+				// Refused once the transport is closing, did_send will never come for it
+				client.dropped_messages++;
+				continue;
+			}
+
+			client.inflight_bytes += size;
+			client.inflight_queued_at.push_back(queued_at);
+		}
+	}
+
+	// Queue a message for the client, false if the client has to be disconnected
+	bool enqueue(LpfTcpTransport& transport, Client& client, Buffer&& frame, uint64_t now) {
+		auto size = frame.size();
+		while(client.queued_bytes + client.inflight_bytes + size > max_queue_bytes) {
+			if(policy == SlowClientPolicy::Disconnect) {
+				return false;
+			}
+
+			if(client.queue.empty()) {
+				// Everything queued is already with tcp, drop the new message instead
+				client.dropped_messages++;
+				return true;
+			}
+
+			client.queued_bytes -= client.queue.front().frame.size();
+			client.queue.pop_front();
+			client.dropped_messages++;
+		}
+
+		client.queue.push_back(QueuedMessage{std::move(frame), now});
+		client.queued_bytes += size;
+		client.max_queued_bytes = std::max(client.max_queued_bytes, client.queued_bytes + client.inflight_bytes);
+
+		flush(transport, client);
+
+		return true;
+	}
+
+	void report_cb() {
+		auto now = now_ms();
+		for(auto& [transport, client] : clients) {
+			auto oldest = !client.inflight_queued_at.empty() ? client.inflight_queued_at.front()
+				: !client.queue.empty() ? client.queue.front().queued_at
+				: now;
+
+			SPDLOG_INFO(
+				"Bridge: Client {}: sent {} messages, {} bytes, queued {} messages, {} bytes, inflight {} bytes, dropped {} messages, lag {} ms, max lag {} ms, max queued {} bytes",
+				transport->dst_addr.to_string(),
+				client.sent_messages,
+				client.sent_bytes,
+				client.queue.size(),
+				client.queued_bytes,
+				client.inflight_bytes,
+				client.dropped_messages,
+				now - oldest,
+				client.max_lag_ms,
+				client.max_queued_bytes
+			);
+			client.max_lag_ms = 0;
+			client.max_queued_bytes = 0;
+		}
+	}
+
 public:
 	DefaultMulticastClient<MulticastDelegate>* multicastClient;
-	LpfTcpTransport* tcpClient = nullptr;
 	LpfTcpTransportFactory f;
 
-	MulticastDelegate(DefaultMulticastClientOptions clop, std::string lpftcp_bridge_addr) {
+	MulticastDelegate(
+		DefaultMulticastClientOptions clop,
+		std::string lpftcp_bridge_addr,
+		SlowClientPolicy policy,
+		uint64_t max_queue_bytes
+	) : policy(policy), max_queue_bytes(max_queue_bytes), timer(this) {
 		multicastClient = new DefaultMulticastClient<MulticastDelegate> (clop);
 		multicastClient->delegate = this;
 
 		// bind to address and start listening on tcpserver
 		f.bind(SocketAddress::from_string(lpftcp_bridge_addr));
 		f.listen(*this);
+
+		timer.start<MulticastDelegate, &MulticastDelegate::report_cb>(ReportInterval, ReportInterval);
 	}
 
 	//-----------------------delegates for Lpf-Tcp-Transport-----------------------------------
 
 	// Listen delegate
-	bool should_accept(SocketAddress const &addr) {
+	bool should_accept(SocketAddress const &) {
 		return true;
 	}
 
@@ -66,13 +198,13 @@ public:
 
 		transport.setup(this, NULL);
 
-		tcpClient = &transport;
+		clients[&transport];
 	}
 
 	// Transport delegate
 
 	// not required because server
-	void did_dial(LpfTcpTransport &transport) {
+	void did_dial(LpfTcpTransport &transport __attribute__((unused))) {
 		SPDLOG_DEBUG(
 			"DID DIAL: {}",
 			transport.dst_addr.to_string()
@@ -80,7 +212,7 @@ public:
 	}
 
 	// forward on marlin multicast
-	int did_recv(LpfTcpTransport &transport, Buffer &&message) {
+	int did_recv(LpfTcpTransport &, Buffer &&message) {
 		SPDLOG_INFO(
 			"Did recv from blockchain client, message with length {}: {}",
 			message.size(),
@@ -101,19 +233,35 @@ public:
 		return 0;
 	}
 
-	void did_send(LpfTcpTransport &transport, Buffer &&message) {}
+	void did_send(LpfTcpTransport &transport, Buffer &&message) {
+		auto iter = clients.find(&transport);
+		if(iter == clients.end()) {
+			return;
+		}
+		auto& client = iter->second;
+
+		// Length prefix is already covered
+		auto size = message.size() + 8;
+		client.inflight_bytes -= size;
+		client.sent_messages++;
+		client.sent_bytes += size;
+		client.max_lag_ms = std::max(client.max_lag_ms, now_ms() - client.inflight_queued_at.front());
+		client.inflight_queued_at.pop_front();
 
-	// TODO:
+		flush(transport, client);
+	}
+
+	// Also reached on write errors, the bytes tcp held never see did_send and go with the client
 	void did_close(LpfTcpTransport &transport, uint16_t) {
 		SPDLOG_DEBUG(
 			"Closed connection with client: {}",
 			transport.dst_addr.to_string()
 		);
-		tcpClient = nullptr;
+		clients.erase(&transport);
 	}
 
 	// TODO: not required because server
-	int dial(SocketAddress const &addr, uint8_t const *remote_static_pk) {
+	int dial(SocketAddress const &, uint8_t const *) {
 		return 0;
 	};
 
@@ -121,34 +269,59 @@ public:
 
 	template<typename T> // TODO: Code smell, remove later
 	void did_recv(
-		DefaultMulticastClient<MulticastDelegate> &client,
+		DefaultMulticastClient<MulticastDelegate> &,
 		Buffer &&message,
-		T header,
+		T,
 		uint16_t channel,
-		uint64_t message_id
+		uint64_t message_id __attribute__((unused))
 	) {
 		SPDLOG_DEBUG(
 			"Did recv from multicast, message-id: {}",
 			message_id
 		);
 
-		//TODO: send on tcp client
-		if (channel==blockchainChannel && tcpClient != nullptr) {
-			SPDLOG_DEBUG(
-				"Sending to blockchain client"
+		if(channel != blockchainChannel || clients.empty()) {
+			return;
+		}
+
+		SPDLOG_DEBUG(
+			"Sending to {} blockchain clients",
+			clients.size()
+		);
+
+		// Encoded once, every client gets a reference to the same bytes
+		auto frame = LpfTcpTransport::frame(message.data(), message.size());
+		auto now = now_ms();
+
+		std::vector<LpfTcpTransport*> slow_clients;
+		for(auto& [transport, client] : clients) {
+			if(!enqueue(*transport, client, frame.share(), now)) {
+				slow_clients.push_back(transport);
+			}
+		}
+
+		// Close completes on a later iteration, stop queueing for them right away
+		for(auto* transport : slow_clients) {
+			auto& client = clients[transport];
+			SPDLOG_WARN(
+				"Bridge: Disconnecting slow client {}, {} bytes queued, dropped {} messages",
+				transport->dst_addr.to_string(),
+				client.queued_bytes + client.inflight_bytes,
+				client.dropped_messages
 			);
-			tcpClient->send(std::move(message));
+			clients.erase(transport);
+			transport->close();
 		}
 	}
 
 	void did_subscribe(
-		DefaultMulticastClient<MulticastDelegate> &client,
-		uint16_t channel
+		DefaultMulticastClient<MulticastDelegate> &,
+		uint16_t
 	) {}
 
 	void did_unsubscribe(
-		DefaultMulticastClient<MulticastDelegate> &client,
-		uint16_t channel
+		DefaultMulticastClient<MulticastDelegate> &,
+		uint16_t
 	) {}
 };
 
@@ -158,9 +331,12 @@ int main(int argc, char **argv) {
 	std::string discovery_addr = "0.0.0.0:15002";
 	std::string pubsub_addr = "0.0.0.0:15000";
 	std::string lpftcp_bridge_addr = "0.0.0.0:15003";
+	SlowClientPolicy policy = SlowClientPolicy::DropOldest;
+	// In MB
+	uint64_t max_queue_size = 16;
 
 	char c;
-	while ((c = getopt (argc, argv, "b::d::p::l::")) != -1) {
+	while ((c = getopt (argc, argv, "b::d::p::l::o::q::")) != -1) {
 		switch (c) {
 			case 'b':
 				beacon_addr = std::string(optarg);
@@ -174,17 +350,32 @@ int main(int argc, char **argv) {
 			case 'l':
 				lpftcp_bridge_addr = std::string(optarg);
 				break;
+			case 'o':
+				if(std::string(optarg) == "drop") {
+					policy = SlowClientPolicy::DropOldest;
+				} else if(std::string(optarg) == "disconnect") {
+					policy = SlowClientPolicy::Disconnect;
+				} else {
+					SPDLOG_ERROR("Unknown slow client policy: {}, expected drop or disconnect", optarg);
+					return 1;
+				}
+				break;
+			case 'q':
+				max_queue_size = std::stoull(optarg);
+				break;
 			default:
 			return 1;
 		}
 	}
 
 	SPDLOG_INFO(
-		"Beacon: {}, Discovery: {}, PubSub: {} TcpBridge: {}",
+		"Beacon: {}, Discovery: {}, PubSub: {} TcpBridge: {}, Slow clients: {}, Queue: {} MB",
 		beacon_addr,
 		discovery_addr,
 		pubsub_addr,
-		lpftcp_bridge_addr
+		lpftcp_bridge_addr,
+		policy == SlowClientPolicy::DropOldest ? "drop" : "disconnect",
+		max_queue_size
 	);
 
 	uint8_t static_sk[crypto_box_SECRETKEYBYTES];
@@ -200,7 +391,7 @@ int main(int argc, char **argv) {
 		pubsub_addr
 	};
 
-	MulticastDelegate del(clop, lpftcp_bridge_addr);
+	MulticastDelegate del(clop, lpftcp_bridge_addr, policy, max_queue_size << 20);
 
 	return DefaultMulticastClient<MulticastDelegate>::run_event_loop();
 }
@@ -0,0 +1,198 @@
+// Latency from the network to a C consumer for each delivery mode
+// Usage: multicastsdk_c_latency <copy|borrowed|ring> [message_size] [count]
+//
+// Needs a beacon and relays running on localhost like main.c. One client
+// publishes a message every ms with its send time in the first 8 bytes,
+// another client receives it and hands it to the consumer in the chosen mode.
+// In ring mode the consumer is a separate thread polling the ring as a reader.
+//
+// Reported per mode:
+//   e2e - publisher send to consumer, includes the relay hop
+//   sdk - SDK handover to consumer, borrowed and ring only
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+#include <marlin/multicast/MarlinMulticastClient.h>
+
+enum Mode { COPY, BORROWED, RING };
+
+static enum Mode mode;
+static uint64_t message_size = 256;
+static uint64_t count = 10000;
+
+static uint64_t* e2e;
+static uint64_t* sdk;
+static volatile uint64_t received = 0;
+
+static MarlinMulticastClient_t* publisher;
+static MarlinMulticastRing_t* ring;
+static MarlinMulticastRing_t* reader;
+static uint8_t* message;
+
+static int cmp(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char* name, uint64_t* samples) {
+	qsort(samples, count, sizeof(uint64_t), cmp);
+	printf(
+		"%s: p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+		name,
+		(unsigned long long)samples[count / 2],
+		(unsigned long long)samples[count * 99 / 100],
+		(unsigned long long)samples[count * 999 / 1000],
+		(unsigned long long)samples[count - 1]
+	);
+}
+
+static void record(const uint8_t* data, uint64_t length, uint64_t recv_ns) {
+	uint64_t now = marlin_multicast_now_ns();
+	if(received == count || length < 8) {
+		return;
+	}
+
+	uint64_t sent;
+	memcpy(&sent, data, 8);
+	e2e[received] = now - sent;
+	sdk[received] = now - recv_ns;
+	received++;
+
+	if(received == count) {
+		report("e2e", e2e);
+		if(mode != COPY) {
+			report("sdk", sdk);
+		}
+		if(mode == RING) {
+			printf("dropped: %llu\n", (unsigned long long)marlin_multicast_ring_dropped(reader));
+		}
+		exit(0);
+	}
+}
+
+static void did_recv(
+	MarlinMulticastClient_t* client,
+	const uint8_t* data,
+	uint64_t message_length,
+	uint16_t channel,
+	uint64_t message_id
+) {
+	(void)client; (void)channel; (void)message_id;
+	record(data, message_length, 0);
+}
+
+static void did_recv_borrowed(
+	MarlinMulticastClient_t* client,
+	MarlinMulticastMessage_t* msg
+) {
+	(void)client;
+	record(
+		marlin_multicast_message_data(msg),
+		marlin_multicast_message_length(msg),
+		marlin_multicast_message_recv_ns(msg)
+	);
+	marlin_multicast_message_release(msg);
+}
+
+static void* ring_consumer(void* arg) {
+	(void)arg;
+	MarlinMulticastRingEntry_t entry;
+	for(;;) {
+		if(marlin_multicast_ring_poll(reader, &entry)) {
+			uint64_t sent;
+			memcpy(&sent, entry.message, 8);
+			if(marlin_multicast_ring_release(reader)) {
+				record((const uint8_t*)&sent, 8, entry.recv_ns);
+			}
+		}
+	}
+	return NULL;
+}
+
+static void publish_cb(uv_timer_t* handle) {
+	(void)handle;
+	uint64_t now = marlin_multicast_now_ns();
+	memcpy(message, &now, 8);
+	marlin_multicast_client_send_message_on_channel(publisher, 0, message, message_size);
+}
+
+int main(int argc, char** argv) {
+	if(argc < 2) {
+		printf("Usage: %s <copy|borrowed|ring> [message_size] [count]\n", argv[0]);
+		return 1;
+	}
+	mode = strcmp(argv[1], "ring") == 0 ? RING : strcmp(argv[1], "borrowed") == 0 ? BORROWED : COPY;
+	if(argc > 2) {
+		message_size = strtoull(argv[2], NULL, 10);
+		if(message_size < 8) {
+			message_size = 8;
+		}
+	}
+	if(argc > 3) {
+		count = strtoull(argv[3], NULL, 10);
+		if(count == 0) {
+			count = 1;
+		}
+	}
+
+	e2e = calloc(count, sizeof(uint64_t));
+	sdk = calloc(count, sizeof(uint64_t));
+	message = calloc(message_size, 1);
+
+	MarlinMulticastClientDelegate_t *delegate = marlin_multicast_clientdelegate_create();
+	if(mode == RING) {
+		ring = marlin_multicast_ring_create("/marlin_latency", 1 << 24);
+		if(ring == NULL) {
+			return 1;
+		}
+		marlin_multicast_clientdelegate_set_ring(delegate, ring);
+
+		reader = marlin_multicast_ring_open("/marlin_latency");
+		if(reader == NULL) {
+			return 1;
+		}
+
+		pthread_t consumer;
+		pthread_create(&consumer, NULL, ring_consumer, NULL);
+	} else if(mode == BORROWED) {
+		marlin_multicast_clientdelegate_set_did_recv_borrowed(delegate, did_recv_borrowed);
+	} else {
+		marlin_multicast_clientdelegate_set_did_recv(delegate, did_recv);
+	}
+
+	uint8_t static_sk1[32];
+	uint8_t static_pk1[32];
+	marlin_multicast_create_keypair(static_pk1, static_sk1);
+
+	uint8_t static_sk2[32];
+	uint8_t static_pk2[32];
+	marlin_multicast_create_keypair(static_pk2, static_sk2);
+
+	MarlinMulticastClient_t *consumer = marlin_multicast_client_create(
+		static_sk2,
+		static_pk2,
+		"127.0.0.1:9002",
+		"127.0.0.1:7002",
+		"127.0.0.1:7000"
+	);
+	marlin_multicast_client_set_delegate(consumer, delegate);
+
+	publisher = marlin_multicast_client_create(
+		static_sk1,
+		static_pk1,
+		"127.0.0.1:9002",
+		"127.0.0.1:8002",
+		"127.0.0.1:8000"
+	);
+	marlin_multicast_client_set_delegate(publisher, marlin_multicast_clientdelegate_create());
+
+	// Same loop as the SDK, give discovery a few seconds before publishing
+	uv_timer_t timer;
+	uv_timer_init(uv_default_loop(), &timer);
+	uv_timer_start(&timer, publish_cb, 5000, 1);
+
+	return marlin_multicast_run_event_loop();
+}
@@ -5,6 +5,7 @@
 #include <marlin/pubsub/witness/LpfBloomWitnesser.hpp>
 #include <marlin/beacon/ClusterDiscoverer.hpp>
 #include <tuple>
+#include <unordered_map>
 
 
 namespace marlin {
@@ -22,6 +23,8 @@ struct DefaultMulticastClientOptions {
 	std::string staking_url = "/subgraphs/name/marlinprotocol/staking";
 	std::string network_id = "0xaaaebeba3810b1e6b70781f14b2d72c1cb89c0b2b320c43bb67ff79f562f5ff4";
 	size_t max_conn = 2;
+	// Per channel, applied by relays so filtered out messages are never sent
+	std::unordered_map<uint16_t, pubsub::MessageFilter> filters = {};
 };
 
 
@@ -191,6 +194,7 @@ public:
 
 	Delegate *delegate = nullptr;
 	std::vector<uint16_t> channels = {0};
+	std::unordered_map<uint16_t, pubsub::MessageFilter> filters;
 
 	template<typename... Args>
 	DefaultMulticastClient(
@@ -209,7 +213,8 @@ public:
 			std::forward_as_tuple(std::forward<Args>(attester_args)...),
 			std::tie(options.static_pk)
 		),
-		channels(options.channels) {
+		channels(options.channels),
+		filters(options.filters) {
 		SPDLOG_DEBUG(
 			"Beacon: {}, Discovery: {}, PubSub: {}",
 			options.beacon_addr,
@@ -220,6 +225,10 @@ public:
 		b.delegate = this;
 		ps.delegate = this;
 
+		for(auto& [channel, filter] : filters) {
+			ps.set_filter(channel, filter);
+		}
+
 		b.start_discovery(core::SocketAddress::from_string(options.beacon_addr));
 	}
 
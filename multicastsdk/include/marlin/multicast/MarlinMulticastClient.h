@@ -10,6 +10,8 @@ extern "C" {
 
 typedef struct MarlinMulticastClient MarlinMulticastClient_t;
 typedef struct MarlinMulticastClientDelegate MarlinMulticastClientDelegate_t;
+typedef struct MarlinMulticastMessage MarlinMulticastMessage_t;
+typedef struct MarlinMulticastRing MarlinMulticastRing_t;
 
 // Delegate
 MarlinMulticastClientDelegate_t* marlin_multicast_clientdelegate_create();
@@ -29,6 +31,27 @@ void marlin_multicast_clientdelegate_set_did_recv(
 	did_recv_func f
 );
 
+// Zero copy delivery, the message is lent to the callback and stays valid
+// until released with marlin_multicast_message_release. Release has to
+// happen on the event loop thread, either in the callback or later.
+// Takes precedence over did_recv when set.
+typedef void (*did_recv_borrowed_func) (
+	MarlinMulticastClient_t* client,
+	MarlinMulticastMessage_t* message
+);
+void marlin_multicast_clientdelegate_set_did_recv_borrowed(
+	MarlinMulticastClientDelegate_t *delegate,
+	did_recv_borrowed_func f
+);
+
+// Deliver into a shared memory ring instead of calling back, the ring
+// is polled by a consumer with marlin_multicast_ring_poll. Takes
+// precedence over both callbacks when set, pass NULL to unset.
+void marlin_multicast_clientdelegate_set_ring(
+	MarlinMulticastClientDelegate_t *delegate,
+	MarlinMulticastRing_t* ring
+);
+
 typedef void (*did_subscribe_func) (
 	MarlinMulticastClient_t* client,
 	uint16_t channel
@@ -78,11 +101,72 @@ bool marlin_multicast_client_remove_channel(
 	uint16_t channel
 );
 
+// Have relays only send messages on channel that have match at offset of
+// the message, or match one of the other prefixes added for the channel.
+// Up to 16 prefixes of up to 32 bytes each per channel.
+bool marlin_multicast_client_add_filter(
+	MarlinMulticastClient_t* client,
+	uint16_t channel,
+	uint16_t offset,
+	const uint8_t* match,
+	uint8_t length
+);
+void marlin_multicast_client_clear_filter(
+	MarlinMulticastClient_t* client,
+	uint16_t channel
+);
+
+// Borrowed message
+const uint8_t* marlin_multicast_message_data(MarlinMulticastMessage_t const* message);
+uint64_t marlin_multicast_message_length(MarlinMulticastMessage_t const* message);
+uint16_t marlin_multicast_message_channel(MarlinMulticastMessage_t const* message);
+uint64_t marlin_multicast_message_id(MarlinMulticastMessage_t const* message);
+// marlin_multicast_now_ns when the message was handed to the SDK
+uint64_t marlin_multicast_message_recv_ns(MarlinMulticastMessage_t const* message);
+void marlin_multicast_message_release(MarlinMulticastMessage_t* message);
+
+// Shared memory ring, one producer and up to 64 readers that can be in
+// other processes. The producer never waits, a reader that falls a whole
+// ring behind skips ahead and counts the messages it missed.
+typedef struct MarlinMulticastRingEntry {
+	const uint8_t* message;
+	uint64_t message_length;
+	uint16_t channel;
+	uint64_t message_id;
+	uint64_t recv_ns;
+} MarlinMulticastRingEntry_t;
+
+// Producer side, capacity in bytes is rounded up to a power of two
+MarlinMulticastRing_t* marlin_multicast_ring_create(
+	const char* name,
+	uint64_t capacity
+);
+// Reader side, takes one of the reader slots until destroyed
+MarlinMulticastRing_t* marlin_multicast_ring_open(const char* name);
+void marlin_multicast_ring_destroy(MarlinMulticastRing_t* ring);
+
+// Oldest unread message, false if there is none. The entry points into the
+// ring and stays valid until marlin_multicast_ring_release.
+bool marlin_multicast_ring_poll(
+	MarlinMulticastRing_t* ring,
+	MarlinMulticastRingEntry_t* entry
+);
+// False if the producer overwrote the entry while it was being read,
+// anything read from it should then be discarded
+bool marlin_multicast_ring_release(MarlinMulticastRing_t* ring);
+// Messages a reader missed by falling behind, or all readers for the producer
+uint64_t marlin_multicast_ring_dropped(MarlinMulticastRing_t* ring);
+// Bytes a reader has yet to read
+uint64_t marlin_multicast_ring_lag(MarlinMulticastRing_t* ring);
+
 // Util
 int marlin_multicast_run_event_loop();
 
 void marlin_multicast_create_keypair(uint8_t* static_pk, uint8_t* static_sk);
 
+// Monotonic clock in ns, comparable across processes on a host
+uint64_t marlin_multicast_now_ns();
+
 #ifdef __cplusplus
 }
 #endif
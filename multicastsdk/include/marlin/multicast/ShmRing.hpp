@@ -0,0 +1,449 @@
+#ifndef MARLIN_MULTICAST_SHMRING_HPP
+#define MARLIN_MULTICAST_SHMRING_HPP
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace marlin {
+namespace multicast {
+
+/// @brief Ring of messages in POSIX shared memory, one producer and any number of readers
+///
+/// The client process creates the ring and pushes messages as they are delivered, readers
+/// in the same or other processes open it by name and poll. Messages are read in place.
+///
+/// The producer never waits for readers. A reader that falls a whole ring behind is lapped,
+/// it notices on its next poll or release, skips ahead to the newest message and counts
+/// what it missed. Each reader has a slot in the ring with its position so the producer can
+/// report how far behind every reader is.
+///
+/// Records are a fixed header followed by the message, padded to 8 bytes. Positions only ever
+/// grow and are reduced modulo the capacity, which is a power of two.
+class ShmRing {
+public:
+	static constexpr uint64_t Magic = 0x326e69524d4c524d; // "MRLMRin2"
+	static constexpr size_t MaxReaders = 64;
+
+	struct RecordHeader {
+		uint32_t size;
+		uint16_t channel;
+		uint16_t flags;
+		uint64_t message_id;
+		uint64_t recv_ns;
+		uint64_t seq;
+	};
+	static_assert(sizeof(RecordHeader) == 32);
+
+	/// Record at the end of the ring that is skipped over by readers
+	static constexpr uint16_t PadFlag = 1;
+
+	enum ReaderState : uint32_t {
+		Free = 0,
+		Attached = 1
+	};
+
+	struct alignas(64) ReaderSlot {
+		std::atomic<uint32_t> state;
+		std::atomic<int32_t> pid;
+		// Position and seq of the next message to read
+		std::atomic<uint64_t> tail;
+		std::atomic<uint64_t> seq;
+		// Messages missed by being lapped
+		std::atomic<uint64_t> lost;
+	};
+
+	struct Header {
+		uint64_t magic;
+		uint64_t capacity;
+		// Producer, reserve is bumped before a record is written and head after
+		alignas(64) std::atomic<uint64_t> head;
+		std::atomic<uint64_t> reserve;
+		std::atomic<uint64_t> seq;
+		// Messages lost across all readers, and pushes too big for the ring
+		alignas(64) std::atomic<uint64_t> dropped;
+		ReaderSlot readers[MaxReaders];
+	};
+
+	/// A message in the ring, valid until it is popped
+	struct Entry {
+		uint8_t const* data;
+		uint64_t size;
+		uint16_t channel;
+		uint64_t message_id;
+		uint64_t recv_ns;
+	};
+
+	/// Where a reader stands, as seen by the producer
+	struct ReaderStats {
+		size_t slot;
+		int32_t pid;
+		uint64_t lag_bytes;
+		uint64_t lag_messages;
+		uint64_t lost;
+	};
+
+private:
+	std::string name;
+	bool is_owner;
+	// Inode of the ring created, the name may point to a newer ring by the time it is unlinked
+	ino_t ino;
+	size_t map_size;
+	Header* header;
+	uint8_t* ring;
+	uint64_t mask;
+
+	// Reader
+	ReaderSlot* slot = nullptr;
+	uint64_t tail = 0;
+	uint64_t seq = 0;
+	// Size of the record at the tail if peeked
+	uint64_t peeked = 0;
+
+	ShmRing(std::string const& name, bool is_owner, ino_t ino, void* map, size_t map_size) :
+		name(name), is_owner(is_owner), ino(ino), map_size(map_size), header((Header*)map),
+		ring((uint8_t*)map + sizeof(Header)), mask(header->capacity - 1) {}
+
+	static uint64_t record_size(uint64_t size) {
+		return (sizeof(RecordHeader) + size + 7) & ~(uint64_t)7;
+	}
+
+	static void* map_fd(int fd, size_t size) {
+		void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		return map == MAP_FAILED ? nullptr : map;
+	}
+
+	bool attach() {
+		for(size_t i = 0; i < MaxReaders; i++) {
+			uint32_t state = Free;
+			auto& s = header->readers[i];
+			if(s.state.compare_exchange_strong(state, Attached, std::memory_order_acq_rel)) {
+				// seq is bumped before head, so this is at least the seq of the record at tail
+				tail = header->head.load(std::memory_order_acquire);
+				seq = header->seq.load(std::memory_order_relaxed);
+				s.pid.store(getpid(), std::memory_order_relaxed);
+				s.tail.store(tail, std::memory_order_relaxed);
+				s.seq.store(seq, std::memory_order_relaxed);
+				s.lost.store(0, std::memory_order_relaxed);
+				slot = &s;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Whether bytes from pos on may have been overwritten since they were read
+	bool is_lapped(uint64_t pos) const {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return header->reserve.load(std::memory_order_relaxed) > pos + header->capacity;
+	}
+
+	// Skip to the newest message, losses are counted from seq once a record is read
+	void resync() {
+		tail = header->head.load(std::memory_order_acquire);
+		peeked = 0;
+		slot->tail.store(tail, std::memory_order_relaxed);
+	}
+
+public:
+	ShmRing(ShmRing const&) = delete;
+
+	~ShmRing() {
+		if(slot != nullptr) {
+			slot->pid.store(0, std::memory_order_relaxed);
+			slot->state.store(Free, std::memory_order_release);
+		}
+		munmap(header, map_size);
+		if(is_owner) {
+			int fd = shm_open(name.c_str(), O_RDONLY, 0);
+			struct stat st;
+			if(fd >= 0 && fstat(fd, &st) == 0 && st.st_ino == ino) {
+				shm_unlink(name.c_str());
+			}
+			if(fd >= 0) {
+				close(fd);
+			}
+		}
+	}
+
+	/// Create the ring named name, capacity is rounded up to a power of two, nullptr on failure
+	///
+	/// A ring left under the name, e.g. by a producer that crashed, is unlinked rather than
+	/// truncated, so readers still mapping it keep their pages instead of faulting.
+	static std::unique_ptr<ShmRing> create(std::string const& name, uint64_t capacity) {
+		uint64_t cap = 4096;
+		while(cap < capacity) {
+			cap <<= 1;
+		}
+
+		if(shm_unlink(name.c_str()) == 0) {
+			SPDLOG_WARN("ShmRing: {}: Replaced an existing ring", name);
+		}
+		// Fails if another producer recreated the name meanwhile
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if(fd < 0) {
+			SPDLOG_ERROR("ShmRing: {}: shm_open failed: {}", name, std::strerror(errno));
+			return nullptr;
+		}
+
+		size_t map_size = sizeof(Header) + cap;
+		struct stat st;
+		if(ftruncate(fd, map_size) < 0 || fstat(fd, &st) < 0) {
+			SPDLOG_ERROR("ShmRing: {}: ftruncate failed: {}", name, std::strerror(errno));
+			close(fd);
+			shm_unlink(name.c_str());
+			return nullptr;
+		}
+
+		auto* map = map_fd(fd, map_size);
+		if(map == nullptr) {
+			SPDLOG_ERROR("ShmRing: {}: mmap failed: {}", name, std::strerror(errno));
+			shm_unlink(name.c_str());
+			return nullptr;
+		}
+
+		// Fresh pages are zero, which leaves every reader slot free
+		auto* header = new (map) Header();
+		header->capacity = cap;
+		// Readers check the magic last
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = Magic;
+
+		return std::unique_ptr<ShmRing>(new ShmRing(name, true, st.st_ino, map, map_size));
+	}
+
+	/// Attach to a ring created by another process as a reader, nullptr if it does not exist or has no free slot
+	static std::unique_ptr<ShmRing> open(std::string const& name) {
+		int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if(fd < 0) {
+			SPDLOG_ERROR("ShmRing: {}: shm_open failed: {}", name, std::strerror(errno));
+			return nullptr;
+		}
+
+		struct stat st;
+		if(fstat(fd, &st) < 0 || (size_t)st.st_size <= sizeof(Header)) {
+			SPDLOG_ERROR("ShmRing: {}: Not a ring", name);
+			close(fd);
+			return nullptr;
+		}
+
+		auto* map = map_fd(fd, st.st_size);
+		if(map == nullptr) {
+			SPDLOG_ERROR("ShmRing: {}: mmap failed: {}", name, std::strerror(errno));
+			return nullptr;
+		}
+
+		auto* header = (Header*)map;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(header->magic != Magic || sizeof(Header) + header->capacity != (size_t)st.st_size) {
+			SPDLOG_ERROR("ShmRing: {}: Not a ring", name);
+			munmap(map, st.st_size);
+			return nullptr;
+		}
+
+		auto reader = std::unique_ptr<ShmRing>(new ShmRing(name, false, st.st_ino, map, st.st_size));
+		if(!reader->attach()) {
+			SPDLOG_ERROR("ShmRing: {}: No free reader slot", name);
+			return nullptr;
+		}
+
+		return reader;
+	}
+
+	uint64_t capacity() const {
+		return header->capacity;
+	}
+
+	/// Messages lost by this reader, or by all readers for the producer
+	uint64_t dropped() const {
+		if(slot != nullptr) {
+			return slot->lost.load(std::memory_order_relaxed);
+		}
+
+		return header->dropped.load(std::memory_order_relaxed);
+	}
+
+	/// Bytes written that this reader has not popped yet
+	uint64_t used() const {
+		return header->head.load(std::memory_order_acquire) - tail;
+	}
+
+	//---------------- Producer ----------------//
+
+	/// Copy a message in, false if it is too big for the ring
+	bool push(
+		uint16_t channel,
+		uint64_t message_id,
+		uint64_t recv_ns,
+		uint8_t const* data,
+		uint64_t size
+	) {
+		auto head = header->head.load(std::memory_order_relaxed);
+		auto total = record_size(size);
+		if(total > header->capacity) {
+			header->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// Records never wrap, pad out the end of the ring instead
+		auto to_end = header->capacity - (head & mask);
+		auto pad = to_end < total ? to_end : 0;
+
+		// Readers seeing the reservation treat everything a ring behind it as gone
+		header->reserve.store(head + pad + total, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		if(pad > 0) {
+			// Less than a record header left is skipped by readers without a marker
+			if(pad >= sizeof(RecordHeader)) {
+				RecordHeader marker = {0, 0, PadFlag, 0, 0, 0};
+				std::memcpy(ring + (head & mask), &marker, sizeof(RecordHeader));
+			}
+			head += pad;
+		}
+
+		auto seq = header->seq.load(std::memory_order_relaxed);
+		RecordHeader record = {(uint32_t)size, channel, 0, message_id, recv_ns, seq};
+		auto* out = ring + (head & mask);
+		std::memcpy(out, &record, sizeof(RecordHeader));
+		std::memcpy(out + sizeof(RecordHeader), data, size);
+
+		header->seq.store(seq + 1, std::memory_order_relaxed);
+		header->head.store(head + total, std::memory_order_release);
+		return true;
+	}
+
+	/// Visit every attached reader
+	template<typename F>
+	void for_each_reader(F&& f) const {
+		auto head = header->head.load(std::memory_order_acquire);
+		auto seq = header->seq.load(std::memory_order_relaxed);
+		for(size_t i = 0; i < MaxReaders; i++) {
+			auto& s = header->readers[i];
+			if(s.state.load(std::memory_order_acquire) != Attached) {
+				continue;
+			}
+
+			auto reader_tail = s.tail.load(std::memory_order_relaxed);
+			auto reader_seq = s.seq.load(std::memory_order_relaxed);
+			f(ReaderStats {
+				i,
+				s.pid.load(std::memory_order_relaxed),
+				head > reader_tail ? head - reader_tail : 0,
+				seq > reader_seq ? seq - reader_seq : 0,
+				s.lost.load(std::memory_order_relaxed)
+			});
+		}
+	}
+
+	/// Free the slots of readers whose process is gone, returns how many
+	size_t reap_readers() {
+		size_t reaped = 0;
+		for(size_t i = 0; i < MaxReaders; i++) {
+			auto& s = header->readers[i];
+			if(s.state.load(std::memory_order_acquire) != Attached) {
+				continue;
+			}
+
+			auto pid = s.pid.load(std::memory_order_relaxed);
+			if(pid > 0 && kill(pid, 0) < 0 && errno == ESRCH) {
+				s.pid.store(0, std::memory_order_relaxed);
+				s.state.store(Free, std::memory_order_release);
+				reaped++;
+			}
+		}
+
+		return reaped;
+	}
+
+	//---------------- Reader ----------------//
+
+	/// Oldest message not yet read, false if there is none
+	bool peek(Entry& entry) {
+		if(slot == nullptr) {
+			return false;
+		}
+
+		for(;;) {
+			auto head = header->head.load(std::memory_order_acquire);
+			if(tail == head) {
+				return false;
+			}
+
+			if(head - tail > header->capacity) {
+				resync();
+				continue;
+			}
+
+			auto to_end = header->capacity - (tail & mask);
+			RecordHeader record = {};
+			if(to_end >= sizeof(RecordHeader)) {
+				std::memcpy(&record, ring + (tail & mask), sizeof(RecordHeader));
+			}
+
+			if(is_lapped(tail)) {
+				resync();
+				continue;
+			}
+
+			if(to_end < sizeof(RecordHeader) || (record.flags & PadFlag)) {
+				tail += to_end;
+				slot->tail.store(tail, std::memory_order_relaxed);
+				continue;
+			}
+
+			// Behind seq only for the first record after attaching during a push
+			if(record.seq > seq) {
+				auto lost = record.seq - seq;
+				slot->lost.fetch_add(lost, std::memory_order_relaxed);
+				header->dropped.fetch_add(lost, std::memory_order_relaxed);
+			}
+			seq = record.seq;
+
+			entry = {
+				ring + (tail & mask) + sizeof(RecordHeader),
+				record.size,
+				record.channel,
+				record.message_id,
+				record.recv_ns
+			};
+			peeked = record_size(record.size);
+			return true;
+		}
+	}
+
+	/// Done with the peeked message, false if it was overwritten while it was being read
+	bool pop() {
+		if(peeked == 0) {
+			return true;
+		}
+
+		bool is_intact = !is_lapped(tail);
+		tail += peeked;
+		seq++;
+		peeked = 0;
+
+		slot->tail.store(tail, std::memory_order_relaxed);
+		slot->seq.store(seq, std::memory_order_relaxed);
+
+		return is_intact;
+	}
+};
+
+} // namespace multicast
+} // namespace marlin
+
+#endif // MARLIN_MULTICAST_SHMRING_HPP
@@ -8,17 +8,41 @@
 
 #include <marlin/multicast/DefaultMulticastClient.hpp>
 #include <marlin/multicast/MarlinMulticastClient.h>
+#include <marlin/multicast/ShmRing.hpp>
 #include <algorithm>
+#include <chrono>
 
 using namespace marlin::multicast;
 using namespace marlin::core;
 using namespace marlin::asyncio;
 
+static uint64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+// Borrowed message, holds on to the received buffer until released
+struct MarlinMulticastMessage {
+	Buffer message = Buffer(nullptr, 0);
+	uint16_t channel = 0;
+	uint64_t message_id = 0;
+	uint64_t recv_ns = 0;
+	MarlinMulticastMessage* next_free = nullptr;
+};
+
+// Released messages are kept around so delivery does not allocate
+static MarlinMulticastMessage* free_messages = nullptr;
+static size_t num_free_messages = 0;
+static constexpr size_t MaxFreeMessages = 256;
+
 // Delegate
 struct MarlinMulticastClientDelegate {
 	did_recv_func m_did_recv = 0;
+	did_recv_borrowed_func m_did_recv_borrowed = 0;
 	did_subscribe_func m_did_subscribe = 0;
 	did_unsubscribe_func m_did_unsubscribe = 0;
+	ShmRing* m_ring = nullptr;
 
 	template<typename T> // TODO: Code smell, remove later
 	void did_recv(
@@ -39,6 +63,33 @@ struct MarlinMulticastClientDelegate {
 			message_id
 		);
 
+		if (this->m_ring != nullptr) {
+			this->m_ring->push(channel, message_id, now_ns(), message.data(), message.size());
+			return;
+		}
+
+		if (this->m_did_recv_borrowed != 0) {
+			auto recv_ns = now_ns();
+			auto* borrowed = free_messages;
+			if (borrowed != nullptr) {
+				free_messages = borrowed->next_free;
+				num_free_messages--;
+			} else {
+				borrowed = new MarlinMulticastMessage();
+			}
+
+			borrowed->message = std::move(message);
+			borrowed->channel = channel;
+			borrowed->message_id = message_id;
+			borrowed->recv_ns = recv_ns;
+
+			this->m_did_recv_borrowed(
+				reinterpret_cast<MarlinMulticastClient_t *> (&client),
+				borrowed
+			);
+			return;
+		}
+
 		// TODO: Should check or assert?
 		if (this->m_did_recv != 0) {
 			this->m_did_recv(
@@ -86,6 +137,20 @@ void marlin_multicast_clientdelegate_set_did_recv(
 	delegate->m_did_recv = f;
 }
 
+void marlin_multicast_clientdelegate_set_did_recv_borrowed(
+	MarlinMulticastClientDelegate_t *delegate,
+	did_recv_borrowed_func f
+) {
+	delegate->m_did_recv_borrowed = f;
+}
+
+void marlin_multicast_clientdelegate_set_ring(
+	MarlinMulticastClientDelegate_t *delegate,
+	MarlinMulticastRing_t* ring
+) {
+	delegate->m_ring = reinterpret_cast<ShmRing*>(ring);
+}
+
 void marlin_multicast_clientdelegate_set_did_subscribe(
 	MarlinMulticastClientDelegate_t *delegate,
 	did_subscribe_func f
@@ -189,6 +254,124 @@ bool marlin_multicast_client_remove_channel(
 	return false;
 }
 
+bool marlin_multicast_client_add_filter(
+	MarlinMulticastClient_t* client,
+	uint16_t channel,
+	uint16_t offset,
+	const uint8_t* match,
+	uint8_t length
+) {
+	auto* obj = reinterpret_cast<
+		DefaultMulticastClient<MarlinMulticastClientDelegate>*
+	>(client);
+
+	auto& filter = obj->filters[channel];
+	if (!filter.add(offset, match, length)) {
+		return false;
+	}
+
+	obj->ps.set_filter(channel, filter);
+	return true;
+}
+
+void marlin_multicast_client_clear_filter(
+	MarlinMulticastClient_t* client,
+	uint16_t channel
+) {
+	auto* obj = reinterpret_cast<
+		DefaultMulticastClient<MarlinMulticastClientDelegate>*
+	>(client);
+
+	obj->filters.erase(channel);
+	obj->ps.set_filter(channel, {});
+}
+
+// Borrowed message impl
+const uint8_t* marlin_multicast_message_data(MarlinMulticastMessage_t const* message) {
+	return message->message.data();
+}
+
+uint64_t marlin_multicast_message_length(MarlinMulticastMessage_t const* message) {
+	return message->message.size();
+}
+
+uint16_t marlin_multicast_message_channel(MarlinMulticastMessage_t const* message) {
+	return message->channel;
+}
+
+uint64_t marlin_multicast_message_id(MarlinMulticastMessage_t const* message) {
+	return message->message_id;
+}
+
+uint64_t marlin_multicast_message_recv_ns(MarlinMulticastMessage_t const* message) {
+	return message->recv_ns;
+}
+
+void marlin_multicast_message_release(MarlinMulticastMessage_t* message) {
+	// Frees the underlying buffer right away
+	message->message = Buffer(nullptr, 0);
+
+	if (num_free_messages == MaxFreeMessages) {
+		delete message;
+		return;
+	}
+
+	message->next_free = free_messages;
+	free_messages = message;
+	num_free_messages++;
+}
+
+
+// Ring impl
+MarlinMulticastRing_t* marlin_multicast_ring_create(
+	const char* name,
+	uint64_t capacity
+) {
+	return reinterpret_cast<MarlinMulticastRing_t *>(
+		ShmRing::create(name, capacity).release()
+	);
+}
+
+MarlinMulticastRing_t* marlin_multicast_ring_open(const char* name) {
+	return reinterpret_cast<MarlinMulticastRing_t *>(
+		ShmRing::open(name).release()
+	);
+}
+
+void marlin_multicast_ring_destroy(MarlinMulticastRing_t* ring) {
+	delete reinterpret_cast<ShmRing*>(ring);
+}
+
+bool marlin_multicast_ring_poll(
+	MarlinMulticastRing_t* ring,
+	MarlinMulticastRingEntry_t* entry
+) {
+	ShmRing::Entry e;
+	if (!reinterpret_cast<ShmRing*>(ring)->peek(e)) {
+		return false;
+	}
+
+	entry->message = e.data;
+	entry->message_length = e.size;
+	entry->channel = e.channel;
+	entry->message_id = e.message_id;
+	entry->recv_ns = e.recv_ns;
+
+	return true;
+}
+
+bool marlin_multicast_ring_release(MarlinMulticastRing_t* ring) {
+	return reinterpret_cast<ShmRing*>(ring)->pop();
+}
+
+uint64_t marlin_multicast_ring_dropped(MarlinMulticastRing_t* ring) {
+	return reinterpret_cast<ShmRing*>(ring)->dropped();
+}
+
+uint64_t marlin_multicast_ring_lag(MarlinMulticastRing_t* ring) {
+	return reinterpret_cast<ShmRing*>(ring)->used();
+}
+
 // Util
 int marlin_multicast_run_event_loop() {
 	return DefaultMulticastClient<MarlinMulticastClientDelegate>::run_event_loop();
@@ -197,3 +380,7 @@ int marlin_multicast_run_event_loop() {
 void marlin_multicast_create_keypair(uint8_t* static_pk, uint8_t* static_sk) {
 	crypto_box_keypair(static_pk, static_sk);
 }
+
+uint64_t marlin_multicast_now_ns() {
+	return now_ns();
+}
@@ -0,0 +1,238 @@
+/*
+	Receives and verifies the multicast feed once and fans it out to local
+	processes over a shared memory ring. Consumers read it with
+	marlin_multicast_ring_open and marlin_multicast_ring_poll from the C SDK.
+*/
+
+#include <sodium.h>
+#include <unistd.h>
+
+#include <marlin/multicast/DefaultMulticastClient.hpp>
+#include <marlin/multicast/ShmRing.hpp>
+#include <marlin/pubsub/attestation/SigAttester.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
+
+#include <structopt/app.hpp>
+
+#include <array>
+#include <chrono>
+
+
+#ifndef MARLIN_FANOUT_DEFAULT_PUBSUB_PORT
+#define MARLIN_FANOUT_DEFAULT_PUBSUB_PORT 15000
+#endif
+
+#ifndef MARLIN_FANOUT_DEFAULT_DISC_PORT
+#define MARLIN_FANOUT_DEFAULT_DISC_PORT 15002
+#endif
+
+#ifndef MARLIN_FANOUT_DEFAULT_NETWORK_ID
+#define MARLIN_FANOUT_DEFAULT_NETWORK_ID ""
+#endif
+
+#ifndef MARLIN_FANOUT_DEFAULT_RING
+#define MARLIN_FANOUT_DEFAULT_RING "/marlin_fanout"
+#endif
+
+// Pfff, of course macros make total sense!
+#define STRH(X) #X
+#define STR(X) STRH(X)
+
+
+using namespace marlin::multicast;
+using namespace marlin::pubsub;
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+
+class MulticastDelegate;
+
+using DefaultMulticastClientType = DefaultMulticastClient<
+	MulticastDelegate,
+	SigAttester,
+	LpfBloomWitnesser
+>;
+
+class MulticastDelegate {
+private:
+	static constexpr uint64_t ReportInterval = 1000;
+	// Readers are reported every interval once behind by this fraction of the ring
+	static constexpr uint64_t LagWarnDivisor = 2;
+	static constexpr uint64_t SummaryInterval = 10;
+
+	ShmRing& ring;
+	Timer timer;
+	uint64_t num_reports = 0;
+	uint64_t num_pushed = 0;
+	uint64_t bytes_pushed = 0;
+	// Losses of each reader slot at the last report
+	std::array<uint64_t, ShmRing::MaxReaders> last_lost = {};
+
+	void report_cb() {
+		auto reaped = ring.reap_readers();
+		if(reaped > 0) {
+			SPDLOG_INFO("Fanout: Released {} reader slots of exited processes", reaped);
+		}
+
+		num_reports++;
+		bool is_summary = num_reports % SummaryInterval == 0;
+		size_t num_readers = 0;
+
+		ring.for_each_reader([&](ShmRing::ReaderStats const& stats) {
+			num_readers++;
+
+			auto lost = stats.lost >= last_lost[stats.slot] ? stats.lost - last_lost[stats.slot] : stats.lost;
+			last_lost[stats.slot] = stats.lost;
+
+			if(stats.lag_bytes > ring.capacity()) {
+				SPDLOG_WARN(
+					"Fanout: Reader {} (pid {}) lapped, {} messages behind",
+					stats.slot,
+					stats.pid,
+					stats.lag_messages
+				);
+			} else if(lost > 0 || stats.lag_bytes > ring.capacity() / LagWarnDivisor) {
+				SPDLOG_WARN(
+					"Fanout: Reader {} (pid {}) slow, lag: {} messages, {} bytes, lost {} messages",
+					stats.slot,
+					stats.pid,
+					stats.lag_messages,
+					stats.lag_bytes,
+					lost
+				);
+			} else if(is_summary) {
+				SPDLOG_INFO(
+					"Fanout: Reader {} (pid {}) lag: {} messages, {} bytes, lost {} messages in total",
+					stats.slot,
+					stats.pid,
+					stats.lag_messages,
+					stats.lag_bytes,
+					stats.lost
+				);
+			}
+		});
+
+		if(is_summary) {
+			SPDLOG_INFO(
+				"Fanout: {} messages, {} bytes in the last {} s, {} readers",
+				num_pushed,
+				bytes_pushed,
+				ReportInterval * SummaryInterval / 1000,
+				num_readers
+			);
+			num_pushed = bytes_pushed = 0;
+		}
+	}
+
+public:
+	DefaultMulticastClientType* multicastClient;
+
+	MulticastDelegate(DefaultMulticastClientOptions clop, uint8_t* key, ShmRing& ring) : ring(ring), timer(this) {
+		multicastClient = new DefaultMulticastClientType (clop, key);
+		multicastClient->delegate = this;
+
+		timer.start<MulticastDelegate, &MulticastDelegate::report_cb>(ReportInterval, ReportInterval);
+	}
+
+	template<typename T> // TODO: Code smell, remove later
+	void did_recv(
+		DefaultMulticastClientType &,
+		Buffer &&message,
+		T,
+		uint16_t channel,
+		uint64_t message_id
+	) {
+		auto recv_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+
+		if(!ring.push(channel, message_id, recv_ns, message.data(), message.size())) {
+			SPDLOG_ERROR("Fanout: Message {} of {} bytes does not fit the ring", message_id, message.size());
+			return;
+		}
+
+		num_pushed++;
+		bytes_pushed += message.size();
+	}
+
+	void did_subscribe(
+		DefaultMulticastClientType &,
+		uint16_t
+	) {}
+
+	void did_unsubscribe(
+		DefaultMulticastClientType &,
+		uint16_t
+	) {}
+};
+
+struct CliOptions {
+	std::optional<std::string> discovery_addr;
+	std::optional<std::string> pubsub_addr;
+	std::optional<std::string> beacon_addr;
+	std::optional<std::string> ring;
+	std::optional<uint64_t> ring_size;
+};
+STRUCTOPT(CliOptions, discovery_addr, pubsub_addr, beacon_addr, ring, ring_size);
+
+
+int main(int argc, char** argv) {
+	if(sodium_init() == -1) {
+		return -1;
+	}
+
+	try {
+		auto options = structopt::app("fanout").parse<CliOptions>(argc, argv);
+		auto discovery_addr = SocketAddress::from_string(
+			options.discovery_addr.value_or("0.0.0.0:" STR(MARLIN_FANOUT_DEFAULT_DISC_PORT))
+		);
+		auto pubsub_addr = SocketAddress::from_string(
+			options.pubsub_addr.value_or("0.0.0.0:" STR(MARLIN_FANOUT_DEFAULT_PUBSUB_PORT))
+		);
+		auto beacon_addr = SocketAddress::from_string(
+			options.beacon_addr.value_or("127.0.0.1:8002")
+		);
+		auto ring_name = options.ring.value_or(MARLIN_FANOUT_DEFAULT_RING);
+		// In MB
+		auto ring_size = options.ring_size.value_or(64);
+
+		SPDLOG_INFO(
+			"Starting fanout with discovery: {}, pubsub: {}, beacon: {}, ring: {}, {} MB",
+			discovery_addr.to_string(),
+			pubsub_addr.to_string(),
+			beacon_addr.to_string(),
+			ring_name,
+			ring_size
+		);
+
+		auto ring = ShmRing::create(ring_name, ring_size << 20);
+		if(!ring) {
+			return -1;
+		}
+
+		uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+		uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+		crypto_box_keypair(static_pk, static_sk);
+
+		DefaultMulticastClientOptions clop {
+			static_sk,
+			static_pk,
+			std::vector<uint16_t>({0, 1}),
+			beacon_addr.to_string(),
+			discovery_addr.to_string(),
+			pubsub_addr.to_string(),
+			"/subgraphs/name/marlinprotocol/staking",
+			STR(MARLIN_FANOUT_DEFAULT_NETWORK_ID)
+		};
+
+		uint8_t pkey[32] = {};
+		MulticastDelegate del(clop, pkey, *ring);
+
+		return DefaultMulticastClientType::run_event_loop();
+	} catch (structopt::exception& e) {
+		SPDLOG_ERROR("{}", e.what());
+		SPDLOG_ERROR("{}", e.help());
+	}
+
+	return -1;
+}
@@ -0,0 +1,302 @@
+#include "gtest/gtest.h"
+#include "marlin/multicast/ShmRing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+
+using namespace marlin::multicast;
+
+// Message seq is its id, size and bytes follow from it
+static uint64_t message_size(uint64_t seq) {
+	return 1 + (seq * 37) % 700;
+}
+
+static std::vector<uint8_t> make_message(uint64_t seq) {
+	std::vector<uint8_t> message(message_size(seq));
+	for(size_t i = 0; i < message.size(); i++) {
+		message[i] = (seq + i) % 251;
+	}
+	return message;
+}
+
+static bool is_intact(ShmRing::Entry const& entry) {
+	if(entry.size != message_size(entry.message_id) || entry.channel != entry.message_id % 4) {
+		return false;
+	}
+	for(size_t i = 0; i < entry.size; i++) {
+		if(entry.data[i] != (entry.message_id + i) % 251) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void push(ShmRing& ring, uint64_t seq) {
+	auto message = make_message(seq);
+	ring.push(seq % 4, seq, seq, message.data(), message.size());
+}
+
+static std::string ring_name(char const* test) {
+	return "/marlin_test_" + std::to_string(getpid()) + "_" + test;
+}
+
+static size_t num_readers(ShmRing const& ring) {
+	size_t num = 0;
+	ring.for_each_reader([&](ShmRing::ReaderStats const&) { num++; });
+	return num;
+}
+
+// What a reader saw
+struct ReadStats {
+	uint64_t reads = 0;
+	uint64_t torn = 0;
+	uint64_t first_id = 0;
+	uint64_t last_id = 0;
+	bool is_ordered = true;
+	bool is_intact = true;
+};
+
+// Read until the last message is seen or the producer is done and the ring is empty
+static ReadStats read_all(ShmRing& reader, uint64_t last, std::atomic<bool> const* is_done) {
+	ReadStats stats;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	ShmRing::Entry entry;
+	std::vector<uint8_t> copy;
+
+	while(std::chrono::steady_clock::now() < deadline) {
+		if(!reader.peek(entry)) {
+			if(is_done != nullptr && is_done->load()) {
+				if(!reader.peek(entry)) {
+					break;
+				}
+			} else {
+				std::this_thread::yield();
+				continue;
+			}
+		}
+
+		// Checked after pop, the producer may overwrite the entry while it is read
+		copy.assign(entry.data, entry.data + entry.size);
+		auto copied = entry;
+		copied.data = copy.data();
+		bool intact = reader.pop();
+
+		if(stats.reads > 0 && copied.message_id <= stats.last_id) {
+			stats.is_ordered = false;
+		}
+		if(stats.reads == 0) {
+			stats.first_id = copied.message_id;
+		}
+		stats.reads++;
+		stats.last_id = copied.message_id;
+
+		if(!intact) {
+			stats.torn++;
+		} else if(!is_intact(copied)) {
+			stats.is_intact = false;
+		}
+
+		if(copied.message_id == last) {
+			break;
+		}
+	}
+
+	return stats;
+}
+
+TEST(ShmRing, ThreadReaderGetsEveryMessageInOrder) {
+	constexpr uint64_t num_messages = 20000;
+	auto name = ring_name("thread");
+	// Big enough to never lap the reader
+	auto producer = ShmRing::create(name, 1 << 24);
+	ASSERT_NE(producer, nullptr);
+	auto reader = ShmRing::open(name);
+	ASSERT_NE(reader, nullptr);
+
+	std::thread consumer([&]() {
+		auto stats = read_all(*reader, num_messages - 1, nullptr);
+		EXPECT_EQ(stats.reads, num_messages);
+		EXPECT_EQ(stats.first_id, 0u);
+		EXPECT_EQ(stats.torn, 0u);
+		EXPECT_TRUE(stats.is_ordered);
+		EXPECT_TRUE(stats.is_intact);
+	});
+
+	for(uint64_t seq = 0; seq < num_messages; seq++) {
+		push(*producer, seq);
+	}
+	consumer.join();
+
+	EXPECT_EQ(reader->dropped(), 0u);
+	EXPECT_EQ(producer->dropped(), 0u);
+}
+
+TEST(ShmRing, LappedReaderSkipsAheadAndCountsWhatItMissed) {
+	auto name = ring_name("skip");
+	auto producer = ShmRing::create(name, 4096);
+	ASSERT_NE(producer, nullptr);
+	auto reader = ShmRing::open(name);
+	ASSERT_NE(reader, nullptr);
+
+	// Several times the ring
+	for(uint64_t seq = 0; seq < 100; seq++) {
+		push(*producer, seq);
+	}
+
+	// Nothing left that is safe to read, the next message tells how much was missed
+	ShmRing::Entry entry;
+	EXPECT_FALSE(reader->peek(entry));
+	push(*producer, 100);
+	ASSERT_TRUE(reader->peek(entry));
+	EXPECT_EQ(entry.message_id, 100u);
+	EXPECT_TRUE(is_intact(entry));
+	EXPECT_TRUE(reader->pop());
+
+	EXPECT_EQ(reader->dropped(), 100u);
+	EXPECT_EQ(producer->dropped(), 100u);
+}
+
+TEST(ShmRing, LappedThreadReaderCountsWhatItMissed) {
+	constexpr uint64_t num_bursts = 200;
+	constexpr uint64_t burst_size = 1000;
+	auto name = ring_name("lapped");
+	auto producer = ShmRing::create(name, 1 << 13);
+	ASSERT_NE(producer, nullptr);
+	auto reader = ShmRing::open(name);
+	ASSERT_NE(reader, nullptr);
+
+	std::atomic<bool> is_done = false;
+	ReadStats stats;
+	std::thread consumer([&]() {
+		stats = read_all(*reader, ~0ull, &is_done);
+	});
+
+	auto wait_for_reader = [&]() {
+		uint64_t lag;
+		do {
+			std::this_thread::yield();
+			lag = 0;
+			producer->for_each_reader([&](ShmRing::ReaderStats const& reader_stats) { lag = reader_stats.lag_bytes; });
+		} while(lag > 0);
+	};
+
+	// Bursts far bigger than the ring lap the reader
+	uint64_t seq = 0;
+	for(uint64_t burst = 0; burst < num_bursts; burst++) {
+		for(uint64_t i = 0; i < burst_size; i++) {
+			push(*producer, seq++);
+		}
+		wait_for_reader();
+	}
+	// And a trickle it keeps up with
+	for(uint64_t i = 0; i < 10; i++) {
+		push(*producer, seq++);
+		wait_for_reader();
+	}
+	is_done = true;
+	consumer.join();
+
+	EXPECT_GE(stats.reads, 10u);
+	EXPECT_EQ(stats.last_id, seq - 1);
+	EXPECT_TRUE(stats.is_ordered);
+	EXPECT_TRUE(stats.is_intact);
+	// The reader attached before the first push, every message was either read or counted lost
+	EXPECT_EQ(stats.reads + reader->dropped(), seq);
+	EXPECT_EQ(producer->dropped(), reader->dropped());
+}
+
+TEST(ShmRing, ForkedReaderGetsEveryMessageInOrder) {
+	constexpr uint64_t num_messages = 20000;
+	auto name = ring_name("fork");
+	auto producer = ShmRing::create(name, 1 << 24);
+	ASSERT_NE(producer, nullptr);
+
+	auto pid = fork();
+	ASSERT_GE(pid, 0);
+	if(pid == 0) {
+		auto reader = ShmRing::open(name);
+		if(reader == nullptr) {
+			_exit(2);
+		}
+		auto stats = read_all(*reader, num_messages - 1, nullptr);
+		bool ok = stats.reads == num_messages && stats.first_id == 0 && stats.torn == 0
+			&& stats.is_ordered && stats.is_intact && reader->dropped() == 0;
+		_exit(ok ? 0 : 1);
+	}
+
+	// Messages pushed before the child attaches would be skipped
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while(num_readers(*producer) == 0 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(num_readers(*producer), 1u);
+
+	for(uint64_t seq = 0; seq < num_messages; seq++) {
+		push(*producer, seq);
+	}
+
+	int status;
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+	EXPECT_EQ(producer->dropped(), 0u);
+}
+
+TEST(ShmRing, ReapsReadersOfDeadProcesses) {
+	auto name = ring_name("reap");
+	auto producer = ShmRing::create(name, 1 << 16);
+	ASSERT_NE(producer, nullptr);
+
+	auto pid = fork();
+	ASSERT_GE(pid, 0);
+	if(pid == 0) {
+		// Exits holding its slot
+		auto* reader = ShmRing::open(name).release();
+		_exit(reader == nullptr ? 1 : 0);
+	}
+
+	int status;
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	ASSERT_TRUE(WIFEXITED(status));
+	ASSERT_EQ(WEXITSTATUS(status), 0);
+
+	EXPECT_EQ(num_readers(*producer), 1u);
+	EXPECT_EQ(producer->reap_readers(), 1u);
+	EXPECT_EQ(num_readers(*producer), 0u);
+}
+
+TEST(ShmRing, CreateReplacesAnExistingRingWithoutTruncatingIt) {
+	auto name = ring_name("replace");
+	auto old_producer = ShmRing::create(name, 1 << 16);
+	ASSERT_NE(old_producer, nullptr);
+	auto old_reader = ShmRing::open(name);
+	ASSERT_NE(old_reader, nullptr);
+	push(*old_producer, 5);
+
+	auto producer = ShmRing::create(name, 1 << 16);
+	ASSERT_NE(producer, nullptr);
+
+	// Still mapped and intact, truncating would fault here
+	ShmRing::Entry entry;
+	ASSERT_TRUE(old_reader->peek(entry));
+	EXPECT_EQ(entry.message_id, 5u);
+	EXPECT_TRUE(is_intact(entry));
+	EXPECT_TRUE(old_reader->pop());
+
+	// The old producer going away leaves the new ring's name alone
+	old_reader.reset();
+	old_producer.reset();
+	auto reader = ShmRing::open(name);
+	ASSERT_NE(reader, nullptr);
+	EXPECT_EQ(reader->used(), 0u);
+
+	push(*producer, 7);
+	ASSERT_TRUE(reader->peek(entry));
+	EXPECT_EQ(entry.message_id, 7u);
+	EXPECT_TRUE(is_intact(entry));
+}
@@ -0,0 +1,128 @@
+#ifndef MARLIN_PUBSUB_MESSAGEFILTER_HPP
+#define MARLIN_PUBSUB_MESSAGEFILTER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+namespace marlin {
+namespace pubsub {
+
+/// @brief Byte matches a subscriber registers with its relay along with SUBSCRIBE
+///
+/// The relay only sends a message on the channel if it passes, so light clients do not
+/// download what they would throw away. A message passes if any clause matches, a clause
+/// matches if the message data has the clause bytes at the clause offset. Offsets are into
+/// the message data, after attestation and witness. An empty filter passes everything.
+///
+/// Serialized as a clause count followed by each clause as offset (u16 BE), size (u8), bytes.
+struct MessageFilter {
+	static constexpr uint8_t MaxClauses = 16;
+	static constexpr uint8_t MaxMatchSize = 32;
+
+	struct Clause {
+		uint16_t offset;
+		uint8_t size;
+		uint8_t bytes[MaxMatchSize];
+	};
+
+	Clause clauses[MaxClauses];
+	uint8_t num_clauses = 0;
+
+	/// Add a clause, false if there are too many clauses or too many bytes
+	bool add(uint16_t offset, uint8_t const* bytes, uint8_t size) {
+		if(num_clauses == MaxClauses || size == 0 || size > MaxMatchSize) {
+			return false;
+		}
+
+		auto& clause = clauses[num_clauses++];
+		clause.offset = offset;
+		clause.size = size;
+		std::memcpy(clause.bytes, bytes, size);
+
+		return true;
+	}
+
+	bool empty() const {
+		return num_clauses == 0;
+	}
+
+	/// With is_partial, data is only the start of the message and clauses past it are taken to match
+	bool matches(uint8_t const* data, uint64_t size, bool is_partial = false) const {
+		if(num_clauses == 0) {
+			return true;
+		}
+
+		for(uint8_t i = 0; i < num_clauses; i++) {
+			auto& clause = clauses[i];
+			if((uint64_t)clause.offset + clause.size > size) {
+				if(is_partial) {
+					return true;
+				}
+				continue;
+			}
+
+			if(std::memcmp(data + clause.offset, clause.bytes, clause.size) == 0) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	size_t serialized_size() const {
+		size_t size = 1;
+		for(uint8_t i = 0; i < num_clauses; i++) {
+			size += 3 + clauses[i].size;
+		}
+
+		return size;
+	}
+
+	void serialize(uint8_t* out) const {
+		*out++ = num_clauses;
+		for(uint8_t i = 0; i < num_clauses; i++) {
+			auto& clause = clauses[i];
+			*out++ = clause.offset >> 8;
+			*out++ = clause.offset;
+			*out++ = clause.size;
+			std::memcpy(out, clause.bytes, clause.size);
+			out += clause.size;
+		}
+	}
+
+	/// Parse a filter taking up exactly size bytes, nullopt if malformed
+	static std::optional<MessageFilter> deserialize(uint8_t const* in, size_t size) {
+		if(size < 1 || in[0] > MaxClauses) {
+			return std::nullopt;
+		}
+
+		MessageFilter filter;
+		uint8_t num_clauses = in[0];
+		size_t pos = 1;
+		for(uint8_t i = 0; i < num_clauses; i++) {
+			if(size - pos < 3) {
+				return std::nullopt;
+			}
+
+			uint16_t offset = ((uint16_t)in[pos] << 8) | in[pos + 1];
+			uint8_t match_size = in[pos + 2];
+			pos += 3;
+			if(size - pos < match_size || !filter.add(offset, in + pos, match_size)) {
+				return std::nullopt;
+			}
+			pos += match_size;
+		}
+
+		if(pos != size) {
+			return std::nullopt;
+		}
+
+		return filter;
+	}
+};
+
+} // namespace pubsub
+} // namespace marlin
+
+#endif // MARLIN_PUBSUB_MESSAGEFILTER_HPP
@@ -6,6 +6,9 @@
 #define MARLIN_PUBSUB_PUBSUBNODE_HPP
 
 #include <marlin/asyncio/core/Timer.hpp>
+#include <marlin/asyncio/core/EventLoop.hpp>
+#include <marlin/core/ExpiringSet.hpp>
+#include <marlin/core/messages/Schema.hpp>
 #include <marlin/asyncio/tcp/TcpOutFiber.hpp>
 #include <marlin/core/fibers/DynamicFramingFiber.hpp>
 #include <marlin/core/fibers/SentinelFramingFiber.hpp>
@@ -26,6 +29,7 @@
 #include <spdlog/fmt/bin_to_hex.h>
 #include <random>
 #include <unordered_set>
+#include <absl/container/flat_hash_map.h>
 #include <tuple>
 
 #include <secp256k1_recovery.h>
@@ -34,6 +38,7 @@
 #include <rapidjson/document.h>
 
 #include "marlin/pubsub/PubSubTransportSet.hpp"
+#include "marlin/pubsub/MessageFilter.hpp"
 #include "marlin/pubsub/DefaultAbci.hpp"
 #include "marlin/pubsub/attestation/EmptyAttester.hpp"
 #include "marlin/pubsub/witness/EmptyWitnesser.hpp"
@@ -73,6 +78,18 @@ int status;
 template<typename X>
 using SentinelFramingFiberHelper = core::SentinelFramingFiber<X, '\n'>;
 
+/// Header of SUBSCRIBE and UNSUBSCRIBE following the message type: channel
+/// SUBSCRIBE can be followed by a MessageFilter
+using SUBSCRIBESchema = core::MessageSchema<
+	core::UintField<uint16_t, 0>
+>;
+
+/// Header of MESSAGE following the message type: message id, channel
+using MESSAGESchema = core::MessageSchema<
+	core::UintField<uint64_t, 0>,
+	core::UintField<uint16_t, 8>
+>;
+
 template<typename DelegateType>
 struct StakeRequester {
 	using FiberType = core::Fabric<
@@ -336,6 +353,8 @@ struct MessageHeader {
 	uint64_t attestation_size = 0;
 	uint8_t const* witness_data = nullptr;
 	uint64_t witness_size = 0;
+	// Keccak-256 of the message data if the sender already has it, see MessageDigests
+	uint8_t const* message_hash = nullptr;
 };
 
 //! Class containing the Pub-Sub functionality
@@ -430,9 +449,9 @@ public:
 	};
 	std::unordered_map<ClientKey, Connections> conn_map;
 	TransportSet unsol_conns;
-	std::unordered_map<core::SocketAddress, ClientKey> beacon_map;
+	absl::flat_hash_map<core::SocketAddress, ClientKey> beacon_map;
 
-	std::unordered_set<core::SocketAddress> blacklist_addr;
+	core::ExpiringSet<core::SocketAddress> blacklist_addr;
 	// TransportSet unsol_standby_conns;
 
 	void send_SUBSCRIBE(BaseTransport &transport, uint16_t channel);
@@ -445,6 +464,9 @@ public:
 
 	bool remove_conn(TransportSet &t_set, BaseTransport &Transport);
 
+	/// Ask relays to only send messages on channel that pass filter, an empty filter clears it
+	void set_filter(uint16_t channel, MessageFilter const& filter);
+
 	// int get_num_active_subscribers(uint16_t channel);
 	// void add_subscriber_to_channel(uint16_t channel, BaseTransport &transport);
 	// void add_subscriber_to_potential_channel(uint16_t channel, BaseTransport &transport);
@@ -481,7 +503,8 @@ private:
 	asyncio::Timer blacklist_timer;
 
 	void blacklist_timer_cb() {
-		this->blacklist_addr.clear();
+		// Entries expire individually, this only reclaims memory
+		this->blacklist_addr.expire(asyncio::EventLoop::now());
 	}
 
 //---------------- Pubsub protocol ----------------//
@@ -705,6 +728,39 @@ private:
 		pairhash
 	> cut_through_header_recv;
 
+//---------------- Subscription filters ----------------//
+private:
+	// Own filters, sent along with SUBSCRIBE
+	std::unordered_map<uint16_t, MessageFilter> channel_filters;
+	// Filters of subscribers
+	std::unordered_map<
+		std::pair<BaseTransport *, uint16_t>,
+		MessageFilter,
+		pairhash
+	> subscriber_filters;
+
+	// Whether the subscriber has a filter on the channel that the message fails
+	bool is_filtered(
+		BaseTransport *transport,
+		uint16_t channel,
+		uint64_t message_id __attribute__((unused)),
+		uint8_t const* data,
+		uint64_t size,
+		bool is_partial = false
+	) {
+		if(subscriber_filters.empty()) {
+			return false;
+		}
+
+		auto iter = subscriber_filters.find(std::make_pair(transport, channel));
+		if(iter == subscriber_filters.end() || iter->second.matches(data, size, is_partial)) {
+			return false;
+		}
+
+		SPDLOG_DEBUG("Message {} filtered out for {}", message_id, transport->dst_addr.to_string());
+		return true;
+	}
+
 	uint8_t const* keys = nullptr;
 };
 
@@ -747,12 +803,12 @@ int PUBSUBNODETYPE::did_recv_SUBSCRIBE(
 	core::Buffer &&bytes
 ) {
 	// Bounds check
-	if(bytes.size() < 2) {
+	if(!SUBSCRIBESchema::validate(bytes.size())) {
 		transport.close();
 		return -1;
 	}
 
-	uint16_t channel [[maybe_unused]] = bytes.read_uint16_be_unsafe(0);
+	[[maybe_unused]] auto [channel] = SUBSCRIBESchema::read_unsafe(bytes.data());
 
 	SPDLOG_DEBUG(
 		"Received subscribe on channel {} from {}",
@@ -760,10 +816,31 @@ int PUBSUBNODETYPE::did_recv_SUBSCRIBE(
 		transport.dst_addr.to_string()
 	);
 
+	// Optional filter, a SUBSCRIBE without one clears it
+	if(bytes.size() > SUBSCRIBESchema::size) {
+		auto filter = MessageFilter::deserialize(
+			bytes.data() + SUBSCRIBESchema::size,
+			bytes.size() - SUBSCRIBESchema::size
+		);
+		if(!filter.has_value()) {
+			SPDLOG_ERROR("Malformed subscription filter from {}", transport.dst_addr.to_string());
+			transport.close();
+			return -1;
+		}
+
+		if(filter->empty()) {
+			subscriber_filters.erase(std::make_pair(&transport, channel));
+		} else {
+			subscriber_filters[std::make_pair(&transport, channel)] = *filter;
+		}
+	} else {
+		subscriber_filters.erase(std::make_pair(&transport, channel));
+	}
+
 	// add_subscriber_to_channel(channel, transport);
 	if (accept_unsol_conn) {
 
-		if (blacklist_addr.find(transport.dst_addr) != blacklist_addr.end()) {
+		if (blacklist_addr.contains(transport.dst_addr, asyncio::EventLoop::now())) {
 			blacklist_addr.erase(transport.dst_addr);
 			add_sol_conn({}, transport);
 			return 0;
@@ -785,7 +862,7 @@ int PUBSUBNODETYPE::did_recv_SUBSCRIBE(
 	\verbatim
 
 	SUBSCRIBE (0x00)
-	Channel as payload.
+	Channel as payload, optionally followed by a MessageFilter.
 
 	Message format:
 
@@ -795,6 +872,8 @@ int PUBSUBNODETYPE::did_recv_SUBSCRIBE(
 	|      0x00     |      0x00     |
 	-----------------------------------------------------------------
 	|                         Channel Name                        ...
+	-----------------------------------------------------------------
+	|                      Filter (optional)                      ...
 	+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 	\endverbatim
@@ -804,8 +883,14 @@ void PUBSUBNODETYPE::send_SUBSCRIBE(
 	BaseTransport &transport,
 	uint16_t channel
 ) {
-	core::Buffer bytes({0}, 3);
-	bytes.write_uint16_be_unsafe(1, channel);
+	auto iter = channel_filters.find(channel);
+	size_t filter_size = iter == channel_filters.end() ? 0 : iter->second.serialized_size();
+
+	core::Buffer bytes({0}, 1 + SUBSCRIBESchema::size + filter_size);
+	SUBSCRIBESchema::write_unsafe(bytes.data() + 1, channel);
+	if(filter_size > 0) {
+		iter->second.serialize(bytes.data() + 1 + SUBSCRIBESchema::size);
+	}
 
 	SPDLOG_DEBUG(
 		"Sending subscribe on channel {} to {}",
@@ -827,12 +912,12 @@ void PUBSUBNODETYPE::did_recv_UNSUBSCRIBE(
 	core::Buffer &&bytes
 ) {
 	// Bounds check
-	if(bytes.size() < 2) {
+	if(!SUBSCRIBESchema::validate(bytes.size())) {
 		transport.close();
 		return;
 	}
 
-	uint16_t channel [[maybe_unused]] = bytes.read_uint16_be_unsafe(0);
+	[[maybe_unused]] auto [channel] = SUBSCRIBESchema::read_unsafe(bytes.data());
 
 	SPDLOG_DEBUG(
 		"Received unsubscribe on channel {} from {}",
@@ -840,6 +925,8 @@ void PUBSUBNODETYPE::did_recv_UNSUBSCRIBE(
 		transport.dst_addr.to_string()
 	);
 
+	subscriber_filters.erase(std::make_pair(&transport, channel));
+
 	// TODO
 	remove_conn(unsol_conns, transport);
 }
@@ -867,8 +954,8 @@ void PUBSUBNODETYPE::send_UNSUBSCRIBE(
 	BaseTransport &transport,
 	uint16_t channel
 ) {
-	core::Buffer bytes({1}, 3);
-	bytes.write_uint16_be_unsafe(1, channel);
+	core::Buffer bytes({1}, 1 + SUBSCRIBESchema::size);
+	SUBSCRIBESchema::write_unsafe(bytes.data() + 1, channel);
 
 	SPDLOG_DEBUG("Sending unsubscribe on channel {} to {}", channel, transport.dst_addr.to_string());
 
@@ -883,14 +970,14 @@ void PUBSUBNODETYPE::did_recv_RESPONSE(
 	BaseTransport &transport,
 	core::Buffer &&bytes
 ) {
-	bool success [[maybe_unused]] = bytes.data()[0];
-
 	// Bounds check on header
 	if(bytes.size() < 1) {
 		transport.close();
 		return;
 	}
 
+	bool success [[maybe_unused]] = bytes.data()[0];
+
 	// Hide success
 	bytes.cover_unsafe(1);
 
@@ -962,13 +1049,12 @@ int PUBSUBNODETYPE::did_recv_MESSAGE(
 	core::Buffer &&bytes
 ) {
 	// Bounds check on header
-	if(bytes.size() < 10) {
+	if(!MESSAGESchema::validate(bytes.size())) {
 		transport.close();
 		return -1;
 	}
 
-	auto message_id = bytes.read_uint64_be_unsafe(0);
-	auto channel = bytes.read_uint16_be_unsafe(8);
+	auto [message_id, channel] = MESSAGESchema::read_unsafe(bytes.data());
 
 	SPDLOG_DEBUG("PUBSUBNODE did_recv_MESSAGE ### message id: {}, channel: {}", message_id, channel);
 
@@ -983,7 +1069,7 @@ int PUBSUBNODETYPE::did_recv_MESSAGE(
 
 	// Send it onward
 	if(message_id_set.find(message_id) == message_id_set.end()) { // Deduplicate message
-		bytes.cover_unsafe(10);
+		bytes.cover_unsafe(MESSAGESchema::size);
 		MessageHeaderType header = {};
 
 		auto att_opt = attester.parse_size(bytes, 0);
@@ -1162,14 +1248,13 @@ core::Buffer PUBSUBNODETYPE::create_MESSAGE(
 	uint64_t size,
 	MessageHeaderType prev_header
 ) {
-	uint64_t buf_size = 11 + size;
+	uint64_t buf_size = 1 + MESSAGESchema::size + size;
 	buf_size += attester.attestation_size(message_id, channel, data, size, prev_header);
 	buf_size += witnesser.witness_size(prev_header);
 	core::Buffer m({3}, buf_size);
-	m.write_uint64_be_unsafe(1, message_id);
-	m.write_uint16_be_unsafe(9, channel);
+	MESSAGESchema::write_unsafe(m.data() + 1, message_id, channel);
 
-	uint64_t offset = 11;
+	uint64_t offset = 1 + MESSAGESchema::size;
 	auto res = attester.attest(message_id, channel, data, size, prev_header, m, offset);
 	if(res < 0) {
 		SPDLOG_ERROR("Attestation failed: {}", res);
@@ -1340,11 +1425,15 @@ void PUBSUBNODETYPE::did_close(BaseTransport &transport, uint16_t reason) {
 	// );
 
 	beacon_map.erase(transport.dst_addr);
+	std::erase_if(subscriber_filters, [&](auto const& item) {
+		return item.first.first == &transport;
+	});
+
 	for(auto& [client_key, conns] : conn_map) {
 		bool is_sol = remove_conn(conns.sol_conns, transport) || remove_conn(conns.sol_standby_conns, transport);
 		if (is_sol && reason == 1) {
 			// add to blacklist
-			blacklist_addr.insert(transport.dst_addr);
+			blacklist_addr.insert(transport.dst_addr, asyncio::EventLoop::now());
 		}
 
 		remove_conn(unsol_conns, transport);
@@ -1435,6 +1524,7 @@ PUBSUBNODETYPE::PubSubNode(
 	attester(std::get<AI>(attester_args)...),
 	witnesser(std::get<WI>(witnesser_args)...),
 	abci(this, std::get<ABI>(abci_args)...),
+	blacklist_addr(DefaultBlacklistTimerInterval),
 	peer_selection_timer(this),
 	blacklist_timer(this),
 	message_id_gen(std::random_device()()),
@@ -1518,6 +1608,16 @@ void PUBSUBNODETYPE::send_message_on_channel_impl(
 	core::SocketAddress const *excluded,
 	MessageHeaderType prev_header
 ) {
+	// Attestations are made per peer, hash the message once for all of them
+	uint8_t message_hash[32];
+	if constexpr(AttesterType::needs_message_hash) {
+		if(prev_header.attestation_size == 0 && prev_header.message_hash == nullptr) {
+			CryptoPP::Keccak_256 hasher;
+			hasher.CalculateTruncatedDigest(message_hash, 32, data, size);
+			prev_header.message_hash = message_hash;
+		}
+	}
+
 	if(conn_map.size() <= 5) {
 		for(auto& [client_key, conns] : conn_map) {
 			SPDLOG_DEBUG("Sending message {} to 0x{:spn}", message_id, spdlog::to_hex(client_key.data(), client_key.data()+client_key.size()));
@@ -1530,6 +1630,8 @@ void PUBSUBNODETYPE::send_message_on_channel_impl(
 				// Exclude given address, usually sender tp prevent loops
 				if(excluded != nullptr && (*it)->dst_addr == *excluded)
 					continue;
+				if(is_filtered(*it, channel, message_id, data, size))
+					continue;
 				send_message_with_cut_through_check(*it, channel, message_id, data, size, prev_header);
 			}
 		}
@@ -1547,6 +1649,8 @@ void PUBSUBNODETYPE::send_message_on_channel_impl(
 				// Exclude given address, usually sender tp prevent loops
 				if(excluded != nullptr && (*it)->dst_addr == *excluded)
 					continue;
+				if(is_filtered(*it, channel, message_id, data, size))
+					continue;
 				send_message_with_cut_through_check(*it, channel, message_id, data, size, prev_header);
 			}
 		}
@@ -1560,6 +1664,8 @@ void PUBSUBNODETYPE::send_message_on_channel_impl(
 		// Exclude given address, usually sender tp prevent loops
 		if(excluded != nullptr && (*it)->dst_addr == *excluded)
 			continue;
+		if(is_filtered(*it, channel, message_id, data, size))
+			continue;
 		send_message_with_cut_through_check(*it, channel, message_id, data, size, prev_header);
 	}
 }
@@ -1609,7 +1715,7 @@ void PUBSUBNODETYPE::subscribe(
 	uint8_t const *remote_static_pk
 ) {
 	// TODO: written so that relays with full unsol list dont occupy sol/standby lists in clients, and similarly masters with full unsol list dont occupy sol/standby lists in relays
-	if (blacklist_addr.find(addr) != blacklist_addr.end())
+	if (blacklist_addr.contains(addr, asyncio::EventLoop::now()))
 		return;
 
 	auto *transport = f.get_transport(addr);
@@ -1655,6 +1761,35 @@ void PUBSUBNODETYPE::unsubscribe(core::SocketAddress const &addr) {
 	);
 }
 
+//! sets the filter relays apply to messages on a channel before sending them here
+/*!
+	\param channel channel the filter applies to
+	\param filter filter to register, an empty filter clears it
+
+	Sent with every SUBSCRIBE from now on, and right away to relays already subscribed to
+	if the channel is one of the delegate's channels.
+*/
+template<PUBSUBNODE_TEMPLATE>
+void PUBSUBNODETYPE::set_filter(uint16_t channel, MessageFilter const& filter) {
+	if(filter.empty()) {
+		channel_filters.erase(channel);
+	} else {
+		channel_filters[channel] = filter;
+	}
+
+	// Relays only hear about channels we subscribe to
+	if(std::find(delegate->channels.begin(), delegate->channels.end(), channel) == delegate->channels.end()) {
+		return;
+	}
+
+	for(auto& [_, conns] : conn_map) {
+		(void)_;
+		for(auto* transport : conns.sol_conns) {
+			send_SUBSCRIBE(*transport, channel);
+		}
+	}
+}
+
 template<PUBSUBNODE_TEMPLATE>
 bool PUBSUBNODETYPE::add_sol_conn(ClientKey client_key, BaseTransport &transport) {
 	SPDLOG_DEBUG("add sol: {}, {}", spdlog::to_hex(client_key.data(), client_key.data()+client_key.size()), transport.dst_addr.to_string());
@@ -1783,14 +1918,13 @@ int PUBSUBNODETYPE::cut_through_recv_bytes(
 	);
 	if(!cut_through_header_recv[std::make_pair(&transport, id)]) {
 		// Bounds check on header
-		if(bytes.size() < 11) {
-			SPDLOG_ERROR("Not enough header: {}, {}", bytes.size(), 11);
+		if(bytes.size() < 1 + MESSAGESchema::size) {
+			SPDLOG_ERROR("Not enough header: {}, {}", bytes.size(), 1 + MESSAGESchema::size);
 			transport.close();
 			return -1;
 		}
 
-		auto message_id = bytes.read_uint64_be_unsafe(1);
-		auto channel = bytes.read_uint16_be_unsafe(9);
+		auto [message_id, channel] = MESSAGESchema::read_unsafe(bytes.data() + 1);
 
 		cut_through_header_recv[std::make_pair(&transport, id)] = true;
 
@@ -1809,7 +1943,7 @@ int PUBSUBNODETYPE::cut_through_recv_bytes(
 			message_id
 		);
 
-		size_t offset = 11;
+		size_t offset = 1 + MESSAGESchema::size;
 		MessageHeaderType header = {};
 
 		auto att_opt = attester.parse_size(bytes, offset);
@@ -1865,6 +1999,8 @@ int PUBSUBNODETYPE::cut_through_recv_bytes(
 				if(&transport == subscriber) continue;
 				bool found = witnesser.contains(header, subscriber->get_remote_static_pk());
 				if (found) continue;
+				// Only the start of the message is here
+				if(is_filtered(subscriber, channel, message_id, bytes.data() + offset, bytes.size() - offset, true)) continue;
 
 				auto sub_id = subscriber->cut_through_send_start(
 					cut_through_length[std::make_pair(&transport, id)]
@@ -1884,6 +2020,7 @@ int PUBSUBNODETYPE::cut_through_recv_bytes(
 			if(&transport == subscriber) continue;
 			bool found = witnesser.contains(header, subscriber->get_remote_static_pk());
 			if (found) continue;
+			if(is_filtered(subscriber, channel, message_id, bytes.data() + offset, bytes.size() - offset, true)) continue;
 
 			auto sub_id = subscriber->cut_through_send_start(
 				cut_through_length[std::make_pair(&transport, id)]
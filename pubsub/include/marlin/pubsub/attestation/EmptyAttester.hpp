@@ -9,6 +9,8 @@ namespace marlin {
 namespace pubsub {
 
 struct EmptyAttester {
+	static constexpr bool needs_message_hash = false;
+
 	template<typename HeaderType>
 	constexpr uint64_t attestation_size(
 		uint64_t,
@@ -11,6 +11,8 @@ namespace marlin {
 namespace pubsub {
 
 struct LpfAttester {
+	static constexpr bool needs_message_hash = false;
+
 	template<typename HeaderType>
 	constexpr uint64_t attestation_size(
 		uint64_t,
@@ -0,0 +1,44 @@
+#ifndef MARLIN_PUBSUB_ATTESTATION_MESSAGEDIGESTS_HPP
+#define MARLIN_PUBSUB_ATTESTATION_MESSAGEDIGESTS_HPP
+
+#include <stdint.h>
+#include <algorithm>
+
+#include <cryptopp/blake2.h>
+#include <cryptopp/keccak.h>
+
+
+namespace marlin {
+namespace pubsub {
+
+/// @brief Every digest a published message needs, computed in one pass over it
+///
+/// message_id is the 8 byte BLAKE2b message ids are derived from, keccak is the Keccak-256
+/// that SigAttester and StakeAttester sign. Both hashers take the message a chunk at a time
+/// so each chunk is read from memory once while it stays in cache for the second hasher.
+/// Pass keccak on as MessageHeader::message_hash so attesters reuse it.
+struct MessageDigests {
+	static constexpr size_t ChunkSize = 16384;
+
+	uint64_t message_id;
+	uint8_t keccak[32];
+
+	MessageDigests(uint8_t const* data, size_t size) {
+		CryptoPP::BLAKE2b blake2b((unsigned int)8);
+		CryptoPP::Keccak_256 keccak_256;
+
+		for(size_t offset = 0; offset < size; offset += ChunkSize) {
+			auto chunk_size = std::min(ChunkSize, size - offset);
+			blake2b.Update(data + offset, chunk_size);
+			keccak_256.Update(data + offset, chunk_size);
+		}
+
+		blake2b.TruncatedFinal((uint8_t*)&message_id, 8);
+		keccak_256.TruncatedFinal(keccak, 32);
+	}
+};
+
+} // namespace pubsub
+} // namespace marlin
+
+#endif // MARLIN_PUBSUB_ATTESTATION_MESSAGEDIGESTS_HPP
@@ -2,6 +2,7 @@
 #define MARLIN_PUBSUB_ATTESTATION_SIGATTESTER_HPP
 
 #include <stdint.h>
+#include <marlin/core/Buffer.hpp>
 #include <marlin/core/WeakBuffer.hpp>
 #include <ctime>
 #include <optional>
@@ -15,6 +16,9 @@ namespace marlin {
 namespace pubsub {
 
 struct SigAttester {
+	// Signs a Keccak-256 of the message, taken from MessageHeader::message_hash when set
+	static constexpr bool needs_message_hash = true;
+
 	secp256k1_context* ctx_signer = nullptr;
 	secp256k1_context* ctx_verifier = nullptr;
 	uint8_t key[32];
@@ -61,9 +65,13 @@ struct SigAttester {
 		out.write_uint16_le_unsafe(offset, 67);
 
 		uint8_t hash[32];
-		CryptoPP::Keccak_256 hasher;
-		// Hash message
-		hasher.CalculateTruncatedDigest(hash, 32, message_data, message_size);
+		if(prev_header.message_hash != nullptr) {
+			std::memcpy(hash, prev_header.message_hash, 32);
+		} else {
+			CryptoPP::Keccak_256 hasher;
+			// Hash message
+			hasher.CalculateTruncatedDigest(hash, 32, message_data, message_size);
+		}
 
 		// Get key
 		// if(key == nullptr) {
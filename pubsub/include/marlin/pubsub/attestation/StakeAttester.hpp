@@ -16,6 +16,9 @@ namespace marlin {
 namespace pubsub {
 
 struct StakeAttester {
+	// Signs a Keccak-256 of the message, taken from MessageHeader::message_hash when set
+	static constexpr bool needs_message_hash = true;
+
 	ABCInterface& abci;
 
 	secp256k1_context* ctx_signer = nullptr;
@@ -152,8 +155,12 @@ struct StakeAttester {
 
 		uint8_t hash[32];
 		CryptoPP::Keccak_256 hasher;
-		// Hash message
-		hasher.CalculateTruncatedDigest(hash, 32, message_data, message_size);
+		if(prev_header.message_hash != nullptr) {
+			std::memcpy(hash, prev_header.message_hash, 32);
+		} else {
+			// Hash message
+			hasher.CalculateTruncatedDigest(hash, 32, message_data, message_size);
+		}
 
 		// Hash for signature
 		hasher.Update((uint8_t*)&message_id, 8);  // FIXME: Fix endian
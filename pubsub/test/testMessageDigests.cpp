@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "marlin/pubsub/attestation/MessageDigests.hpp"
+#include "marlin/pubsub/attestation/SigAttester.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::pubsub;
+
+// Fields of MessageHeader the attesters read
+struct Header {
+	uint8_t const* attestation_data = nullptr;
+	uint64_t attestation_size = 0;
+	uint8_t const* message_hash = nullptr;
+};
+
+static std::vector<uint8_t> make_message(size_t size) {
+	std::vector<uint8_t> message(size);
+	for(size_t i = 0; i < size; i++) {
+		message[i] = (i * 31 + 7) % 251;
+	}
+	return message;
+}
+
+static std::vector<uint8_t> attest(SigAttester& attester, std::vector<uint8_t> const& message, uint8_t const* message_hash) {
+	Header header;
+	header.message_hash = message_hash;
+
+	Buffer out(attester.attestation_size(1, 0, message.data(), message.size(), header));
+	EXPECT_EQ(attester.attest(1, 0, message.data(), message.size(), header, out), 0);
+	return std::vector<uint8_t>(out.data(), out.data() + out.size());
+}
+
+// Sizes around the chunk boundaries
+static size_t const sizes[] = {
+	0, 1, 135, 136, MessageDigests::ChunkSize - 1, MessageDigests::ChunkSize,
+	MessageDigests::ChunkSize + 1, 3 * MessageDigests::ChunkSize + 5
+};
+
+TEST(MessageDigests, MatchesOneShotHashes) {
+	for(auto size : sizes) {
+		auto message = make_message(size);
+		MessageDigests digests(message.data(), message.size());
+
+		CryptoPP::BLAKE2b blake2b((unsigned int)8);
+		blake2b.Update(message.data(), message.size());
+		uint64_t message_id;
+		blake2b.TruncatedFinal((uint8_t*)&message_id, 8);
+		EXPECT_EQ(digests.message_id, message_id) << "size " << size;
+
+		CryptoPP::Keccak_256 keccak;
+		uint8_t hash[32];
+		keccak.CalculateTruncatedDigest(hash, 32, message.data(), message.size());
+		EXPECT_EQ(std::memcmp(digests.keccak, hash, 32), 0) << "size " << size;
+	}
+}
+
+TEST(MessageDigests, SigAttesterGivesSameAttestationWithPrecomputedHash) {
+	uint8_t key[32];
+	for(size_t i = 0; i < 32; i++) {
+		key[i] = i + 1;
+	}
+	SigAttester attester(key);
+
+	for(auto size : sizes) {
+		auto message = make_message(size);
+		MessageDigests digests(message.data(), message.size());
+
+		auto hashed = attest(attester, message, nullptr);
+		auto precomputed = attest(attester, message, digests.keccak);
+		ASSERT_EQ(hashed.size(), 67u);
+		EXPECT_EQ(precomputed, hashed) << "size " << size;
+
+		// Signature recovers to the key over the Keccak of the message
+		secp256k1_ecdsa_recoverable_signature sig;
+		ASSERT_EQ(secp256k1_ecdsa_recoverable_signature_parse_compact(attester.ctx_verifier, &sig, precomputed.data() + 2, precomputed[66]), 1);
+		secp256k1_pubkey recovered, expected;
+		ASSERT_EQ(secp256k1_ecdsa_recover(attester.ctx_verifier, &recovered, &sig, digests.keccak), 1);
+		ASSERT_EQ(secp256k1_ec_pubkey_create(attester.ctx_signer, &expected, key), 1);
+		EXPECT_EQ(std::memcmp(recovered.data, expected.data, sizeof(expected.data)), 0) << "size " << size;
+	}
+}
+
+TEST(MessageDigests, SigAttesterSignsThePrecomputedHash) {
+	uint8_t key[32];
+	std::memset(key, 3, 32);
+	SigAttester attester(key);
+
+	auto message = make_message(1000);
+	auto other = make_message(1001);
+	MessageDigests other_digests(other.data(), other.size());
+
+	// The header's hash is trusted, not recomputed
+	EXPECT_NE(attest(attester, message, other_digests.keccak), attest(attester, message, nullptr));
+	EXPECT_EQ(attest(attester, message, other_digests.keccak), attest(attester, other, nullptr));
+}
@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include "marlin/pubsub/MessageFilter.hpp"
+
+#include <vector>
+
+using namespace marlin::pubsub;
+
+using Bytes = std::vector<uint8_t>;
+
+static Bytes serialize(MessageFilter const& filter) {
+	Bytes out(filter.serialized_size());
+	filter.serialize(out.data());
+	return out;
+}
+
+TEST(MessageFilter, EmptyPassesEverything) {
+	MessageFilter filter;
+	EXPECT_TRUE(filter.empty());
+	EXPECT_TRUE(filter.matches(nullptr, 0));
+
+	Bytes data = {1, 2, 3};
+	EXPECT_TRUE(filter.matches(data.data(), data.size()));
+	EXPECT_EQ(serialize(filter), (Bytes{0}));
+}
+
+TEST(MessageFilter, MatchesAnyClause) {
+	Bytes type_a = {0xaa};
+	Bytes type_b = {0xbb, 0xcc};
+	MessageFilter filter;
+	ASSERT_TRUE(filter.add(0, type_a.data(), type_a.size()));
+	ASSERT_TRUE(filter.add(2, type_b.data(), type_b.size()));
+	EXPECT_FALSE(filter.empty());
+
+	EXPECT_TRUE(filter.matches(Bytes{0xaa, 0, 0, 0}.data(), 4));
+	EXPECT_TRUE(filter.matches(Bytes{0, 0, 0xbb, 0xcc}.data(), 4));
+	EXPECT_TRUE(filter.matches(Bytes{0xaa, 0, 0xbb, 0xcc}.data(), 4));
+	EXPECT_FALSE(filter.matches(Bytes{0, 0, 0, 0}.data(), 4));
+	// Every byte of a clause has to match
+	EXPECT_FALSE(filter.matches(Bytes{0, 0, 0xbb, 0}.data(), 4));
+	EXPECT_FALSE(filter.matches(Bytes{0, 0xaa, 0, 0}.data(), 4));
+}
+
+TEST(MessageFilter, ChecksBounds) {
+	Bytes match = {1, 2, 3};
+	MessageFilter filter;
+	ASSERT_TRUE(filter.add(5, match.data(), match.size()));
+
+	// Ends exactly at the end of the message
+	Bytes data = {0, 0, 0, 0, 0, 1, 2, 3};
+	EXPECT_TRUE(filter.matches(data.data(), data.size()));
+
+	// Runs past the end, does not match unless the data is only the start of the message
+	EXPECT_FALSE(filter.matches(data.data(), data.size() - 1));
+	EXPECT_TRUE(filter.matches(data.data(), data.size() - 1, true));
+	EXPECT_FALSE(filter.matches(data.data(), 0));
+	EXPECT_TRUE(filter.matches(data.data(), 0, true));
+
+	// In range and failing is not rescued by is_partial
+	Bytes other = {0, 0, 0, 0, 0, 1, 2, 4};
+	EXPECT_FALSE(filter.matches(other.data(), other.size(), true));
+
+	// Largest offset must not wrap around
+	MessageFilter far;
+	ASSERT_TRUE(far.add(0xffff, match.data(), match.size()));
+	EXPECT_FALSE(far.matches(data.data(), data.size()));
+	Bytes big(0xffff + 3, 0);
+	big[0xffff] = 1;
+	big[0xffff + 1] = 2;
+	big[0xffff + 2] = 3;
+	EXPECT_TRUE(far.matches(big.data(), big.size()));
+	EXPECT_FALSE(far.matches(big.data(), big.size() - 1));
+}
+
+TEST(MessageFilter, LimitsClauses) {
+	Bytes match(MessageFilter::MaxMatchSize + 1, 7);
+	MessageFilter filter;
+	EXPECT_FALSE(filter.add(0, match.data(), 0));
+	EXPECT_FALSE(filter.add(0, match.data(), MessageFilter::MaxMatchSize + 1));
+	EXPECT_TRUE(filter.empty());
+
+	for(uint8_t i = 0; i < MessageFilter::MaxClauses; i++) {
+		EXPECT_TRUE(filter.add(i, match.data(), MessageFilter::MaxMatchSize));
+	}
+	EXPECT_FALSE(filter.add(0, match.data(), 1));
+	EXPECT_EQ(filter.num_clauses, MessageFilter::MaxClauses);
+}
+
+TEST(MessageFilter, RoundTrips) {
+	Bytes a = {0xde, 0xad};
+	Bytes b(MessageFilter::MaxMatchSize, 0x5a);
+	MessageFilter filter;
+	ASSERT_TRUE(filter.add(0x1234, a.data(), a.size()));
+	ASSERT_TRUE(filter.add(0, b.data(), b.size()));
+
+	auto bytes = serialize(filter);
+	ASSERT_EQ(bytes.size(), 1 + 3 + a.size() + 3 + b.size());
+	EXPECT_EQ(Bytes(bytes.begin(), bytes.begin() + 6), (Bytes{2, 0x12, 0x34, 2, 0xde, 0xad}));
+
+	auto parsed = MessageFilter::deserialize(bytes.data(), bytes.size());
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(serialize(*parsed), bytes);
+
+	// An empty filter on the wire clears
+	Bytes empty = {0};
+	auto cleared = MessageFilter::deserialize(empty.data(), empty.size());
+	ASSERT_TRUE(cleared.has_value());
+	EXPECT_TRUE(cleared->empty());
+}
+
+TEST(MessageFilter, RejectsMalformed) {
+	std::vector<Bytes> malformed = {
+		// No clause count
+		{},
+		// Too many clauses
+		{MessageFilter::MaxClauses + 1},
+		// Clause header cut short
+		{1},
+		{1, 0x00, 0x01},
+		// Match bytes cut short
+		{1, 0x00, 0x01, 3, 0xaa, 0xbb},
+		// Empty and oversized matches
+		{1, 0x00, 0x01, 0},
+		// Fewer clauses than counted
+		{2, 0x00, 0x01, 1, 0xaa},
+		// Trailing bytes
+		{0, 0xff},
+		{1, 0x00, 0x01, 1, 0xaa, 0xff},
+	};
+	Bytes oversized = {1, 0x00, 0x00, MessageFilter::MaxMatchSize + 1};
+	oversized.resize(oversized.size() + MessageFilter::MaxMatchSize + 1, 0);
+	malformed.push_back(oversized);
+
+	for(size_t i = 0; i < malformed.size(); i++) {
+		auto& bytes = malformed[i];
+		EXPECT_FALSE(MessageFilter::deserialize(bytes.data(), bytes.size()).has_value()) << "case " << i;
+	}
+}
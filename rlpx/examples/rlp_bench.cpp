@@ -0,0 +1,203 @@
+// Throughput of RLP decoding and NewBlock reconstruction on block RLP
+// Usage: rlp_bench [blocks.rlp]
+//
+// blocks.rlp is a run of block RLP items, [header, transactions, uncles] each, as written by
+// `geth export <file> <first> <last>`. Without it blocks are synthesized with the shape of a
+// recent mainnet block: ~150 txns of ~200 bytes, a fifth of them typed.
+
+#include <marlin/rlpx/Rlp.hpp>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace marlin::rlpx;
+
+#define TOTAL_BYTES 2000000000
+
+static std::vector<uint8_t> synthesize_blocks(size_t num_blocks) {
+	std::mt19937 rng(1);
+	std::vector<uint8_t> blocks;
+	uint8_t filler[512];
+	for(auto& byte : filler) {
+		byte = rng();
+	}
+
+	for(size_t b = 0; b < num_blocks; b++) {
+		size_t num_txns = 100 + rng() % 100;
+		// One list per legacy txn
+		auto block = RlpEncoder<256>::encode([&](auto& e) {
+			e.begin_list();
+
+			// Header, 15 fields
+			e.begin_list();
+			for(size_t i = 0; i < 15; i++) {
+				e.add_string(filler + i, i == 6 ? 256 : 32);
+			}
+			e.end_list();
+
+			// Txns from a fixed seed so both passes agree
+			std::mt19937 txn_rng(b);
+			e.begin_list();
+			for(size_t t = 0; t < num_txns; t++) {
+				size_t data_size = txn_rng() % 200;
+				if(txn_rng() % 5 == 0) {
+					// Typed txn, an opaque string
+					e.add_string(filler, 100 + data_size);
+				} else {
+					e.begin_list();
+					e.add_uint(t);
+					e.add_uint(20000000000);
+					e.add_uint(21000);
+					e.add_string(filler, 20);
+					e.add_uint(txn_rng());
+					e.add_string(filler, data_size);
+					e.add_uint(37);
+					e.add_string(filler + 100, 32);
+					e.add_string(filler + 200, 32);
+					e.end_list();
+				}
+			}
+			e.end_list();
+
+			// Uncles
+			e.begin_list();
+			e.end_list();
+
+			e.end_list();
+		});
+
+		blocks.insert(blocks.end(), block.data(), block.data() + block.size());
+	}
+
+	return blocks;
+}
+
+// Walk every block down to txn fields, returns the number of txns
+static uint64_t decode(std::vector<uint8_t> const& blocks) {
+	uint64_t num_txns = 0;
+	RlpReader reader(blocks.data(), blocks.size());
+	while(auto block = reader.next(true)) {
+		auto parts = block->items();
+		auto header = parts.next(true);
+		auto txns = parts.next(true);
+		auto uncles = parts.next(true);
+		if(!header || !txns || !uncles) {
+			SPDLOG_ERROR("Malformed block");
+			return 0;
+		}
+
+		auto txn_reader = txns->items();
+		while(auto txn = txn_reader.next()) {
+			if(txn->is_list()) {
+				auto fields = txn->items();
+				auto nonce = fields.next(false);
+				if(!nonce || !nonce->as_uint().has_value()) {
+					SPDLOG_ERROR("Malformed txn");
+					return 0;
+				}
+				while(fields.next()) {}
+			}
+			num_txns++;
+		}
+	}
+
+	return num_txns;
+}
+
+// Rebuild a NewBlock from each block's header and body the way the OnRamps do
+static uint64_t reconstruct(std::vector<uint8_t> const& blocks, bool verify) {
+	uint64_t bytes = 0;
+	RlpReader reader(blocks.data(), blocks.size());
+	while(auto block = reader.next(true)) {
+		auto parts = block->items();
+		auto header = parts.next(true);
+		// Transactions and uncles lists, back to back
+		auto body = parts.position();
+		auto body_size = parts.bytes_left();
+
+		auto message = RlpEncoder<>::encode([&](auto& e) {
+			e.begin_list();
+			e.begin_list();
+			e.add_raw(header->data(), header->size());
+			e.add_raw(body, body_size);
+			e.end_list();
+			e.add_uint(0);
+			e.end_list();
+		}, 1);
+		message.data()[0] = 0x17;
+		bytes += message.size();
+
+		if(verify) {
+			auto new_block = RlpView::parse(message.data() + 1, message.size() - 1);
+			auto inner = new_block.has_value() ? new_block->items().next(true) : std::nullopt;
+			if(!inner || inner->size() != block->size() || std::memcmp(inner->data(), block->data(), block->size()) != 0) {
+				SPDLOG_ERROR("NewBlock does not round trip");
+				return 0;
+			}
+		}
+	}
+
+	return bytes;
+}
+
+int main(int argc, char** argv) {
+	std::vector<uint8_t> blocks;
+	if(argc > 1) {
+		std::ifstream file(argv[1], std::ios::binary);
+		blocks.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	if(blocks.empty()) {
+		blocks = synthesize_blocks(200);
+	}
+
+	RlpReader counter(blocks.data(), blocks.size());
+	size_t num_blocks = 0;
+	while(counter.next(true)) {
+		num_blocks++;
+	}
+	auto num_txns = decode(blocks);
+	if(num_blocks == 0 || num_txns == 0 || reconstruct(blocks, true) == 0) {
+		return 1;
+	}
+	SPDLOG_INFO("{} blocks, {} txns, {} bytes", num_blocks, num_txns, blocks.size());
+
+	size_t passes = TOTAL_BYTES / blocks.size() + 1;
+
+	{
+		uint64_t total_txns = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < passes; i++) {
+			total_txns += decode(blocks);
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		SPDLOG_INFO(
+			"Decode: {:.0f} MB/s, {:.0f} blocks/s, {:.2f} M txns/s",
+			passes * blocks.size() / elapsed / 1e6,
+			passes * num_blocks / elapsed,
+			total_txns / elapsed / 1e6
+		);
+	}
+
+	{
+		uint64_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < passes; i++) {
+			bytes += reconstruct(blocks, false);
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		SPDLOG_INFO(
+			"NewBlock: {:.0f} MB/s, {:.0f} blocks/s",
+			bytes / elapsed / 1e6,
+			passes * num_blocks / elapsed
+		);
+	}
+
+	return 0;
+}
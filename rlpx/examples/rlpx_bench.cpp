@@ -0,0 +1,67 @@
+// Frames/sec of the rlpx codec alone, no sockets and no snappy
+// Usage: rlpx_bench [frames]
+
+#include <marlin/rlpx/RlpxCrypto.hpp>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace marlin::rlpx;
+
+int main(int argc, char** argv) {
+	size_t frames = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+	// Both ends of a session, egress of one is ingress of the other
+	uint8_t aess[32], macs[32], nonce_a[32], nonce_b[32];
+	for(int i = 0; i < 32; i++) {
+		aess[i] = i;
+		macs[i] = 0x80 + i;
+		nonce_a[i] = 0x40 + i;
+		nonce_b[i] = 0xc0 + i;
+	}
+
+	for(size_t frame_size : {64, 256, 1024, 4096, 16384}) {
+		RlpxCrypto sender, receiver;
+		sender.set_secrets(aess, macs, nonce_b, nonce_a);
+		receiver.set_secrets(aess, macs, nonce_a, nonce_b);
+
+		size_t length = 32 + frame_size + 16;
+		std::vector<uint8_t> message(length, 0);
+
+		auto start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < frames; i++) {
+			std::memset(message.data(), 0, 32);
+			message[0] = (uint8_t)(frame_size >> 16);
+			message[1] = (uint8_t)(frame_size >> 8);
+			message[2] = (uint8_t)(frame_size);
+			message[3] = 0xc2;
+			message[4] = 0x80;
+			message[5] = 0x80;
+
+			sender.message_encrypt(message.data(), length, message.data());
+
+			if(!receiver.header_decrypt(message.data(), 32, message.data())
+				|| !receiver.frame_decrypt(message.data() + 32, length - 32, message.data() + 32)) {
+				SPDLOG_ERROR("Verification failed at frame {}", i);
+				return 1;
+			}
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start
+		).count();
+
+		SPDLOG_INFO(
+			"Frame {} bytes: {} frames in {} ms, {} frames/s, {} MB/s",
+			frame_size,
+			frames,
+			elapsed / 1000000,
+			frames * 1000000000 / elapsed,
+			frames * frame_size * 1000 / elapsed
+		);
+	}
+
+	return 0;
+}
@@ -0,0 +1,679 @@
+#ifndef MARLIN_RLPX_BLOCKFETCHER_HPP
+#define MARLIN_RLPX_BLOCKFETCHER_HPP
+
+#include <marlin/asyncio/core/EventLoop.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
+#include <marlin/core/Buffer.hpp>
+#include <marlin/core/ExpiringSet.hpp>
+#include <marlin/rlpx/Rlp.hpp>
+#include <marlin/rlpx/Trie.hpp>
+
+#include <absl/container/flat_hash_map.h>
+#include <cryptopp/keccak.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace marlin {
+namespace rlpx {
+
+/// @brief Fetches announced blocks from eth peers with many requests in flight per peer
+///
+/// Every hash from NewBlockHashes becomes one fetch, deduplicated across peers and for a
+/// while after completion. Headers are requested one per hash, bodies are batched per peer.
+/// Requests are matched to responses by eth/66 request id, peers on older versions are
+/// matched in send order. Among the peers that announced a hash the one with the lowest
+/// smoothed response time is asked first, a request that times out moves to the next one.
+/// Fetches are capped in total and per announcing peer, hashes over the cap are dropped.
+/// A body has to match the transactions root and uncles hash of the header, otherwise it is
+/// fetched again from another peer.
+///
+/// Delegate gets the header RLP item and the body's list payload (transactions list
+/// followed by uncles list), ready to be spliced into a NewBlock:
+///     void did_fetch_block(BlockFetcher&, core::Buffer&& header, core::Buffer&& body);
+template<typename DelegateType, typename TransportType>
+class BlockFetcher {
+public:
+	using Hash = std::array<uint8_t, 32>;
+
+	static constexpr uint64_t RequestTimeout = 2000;
+	static constexpr uint64_t TimerInterval = 250;
+	static constexpr uint64_t InitialRtt = 500;
+	static constexpr uint64_t CompletedTtl = 60000;
+	static constexpr uint32_t MaxAttempts = 3;
+	static constexpr size_t MaxFetches = 4096;
+	static constexpr size_t MaxFetchesPerPeer = 256;
+	/// Timed out requests to peers without request ids are kept this long for responses to line up
+	static constexpr uint64_t ExpiredTtl = 30000;
+
+private:
+	using Self = BlockFetcher<DelegateType, TransportType>;
+
+	struct Request {
+		uint8_t type;
+		uint64_t sent_at;
+		std::vector<Hash> hashes;
+		// Timed out on a peer without request ids, kept so later responses still line up
+		bool expired = false;
+	};
+
+	struct Peer {
+		bool has_request_ids = true;
+		uint64_t next_request_id = 1;
+		// Smoothed response time in ms
+		uint64_t rtt = InitialRtt;
+		absl::flat_hash_map<uint64_t, Request> requests;
+		// Send order per response type, for peers without request ids
+		std::deque<uint64_t> header_order;
+		std::deque<uint64_t> body_order;
+		// Live fetches this peer was the first to announce
+		size_t fetches = 0;
+	};
+
+	struct Fetch {
+		std::optional<core::Buffer> header;
+		std::optional<core::Buffer> body;
+		TransportType* header_peer = nullptr;
+		TransportType* body_peer = nullptr;
+		// Peer the body came from, charged if it does not match the header
+		TransportType* body_from = nullptr;
+		std::vector<TransportType*> announcers;
+		std::vector<TransportType*> tried;
+		uint32_t attempts = 0;
+		// First announcer, charged for the fetch until it ends
+		TransportType* origin = nullptr;
+	};
+
+	absl::flat_hash_map<TransportType*, Peer> peers;
+	absl::flat_hash_map<Hash, Fetch> fetches;
+	core::ExpiringSet<Hash> completed;
+
+	asyncio::Timer timer;
+
+	void erase_fetch(typename absl::flat_hash_map<Hash, Fetch>::iterator iter) {
+		if(iter->second.origin != nullptr) {
+			auto peer_iter = peers.find(iter->second.origin);
+			if(peer_iter != peers.end()) {
+				peer_iter->second.fetches--;
+			}
+		}
+		fetches.erase(iter);
+	}
+
+	//---------------- Requests ----------------//
+
+	// Send query, wrapped with a request id for eth/66 peers
+	template<typename QueryType>
+	void send_request(
+		TransportType& transport,
+		Peer& peer,
+		uint8_t type,
+		std::vector<Hash>&& hashes,
+		QueryType&& query
+	) {
+		auto id = peer.next_request_id++;
+		bool has_request_ids = peer.has_request_ids;
+
+		auto message = RlpEncoder<>::encode([&](auto& e) {
+			if(has_request_ids) {
+				e.begin_list();
+				e.add_uint(id);
+				query(e);
+				e.end_list();
+			} else {
+				query(e);
+			}
+		}, 1);
+		message.data()[0] = type;
+
+		transport.send(std::move(message));
+
+		if(!has_request_ids) {
+			(type == 0x13 ? peer.header_order : peer.body_order).push_back(id);
+		}
+		peer.requests.emplace(id, Request{type, asyncio::EventLoop::now(), std::move(hashes)});
+	}
+
+	void request_header(TransportType& transport, Peer& peer, Hash const& hash) {
+		send_request(transport, peer, 0x13, {hash}, [&](auto& e) {
+			// [origin, amount, skip, reverse]
+			e.begin_list();
+			e.add_string(hash.data(), 32);
+			e.add_uint(1);
+			e.add_uint(0);
+			e.add_uint(0);
+			e.end_list();
+		});
+	}
+
+	void request_bodies(TransportType& transport, Peer& peer, std::vector<Hash>&& hashes) {
+		// hashes is only moved into the request after the query is encoded
+		send_request(transport, peer, 0x15, std::move(hashes), [&](auto& e) {
+			// [hash, hash, ...]
+			e.begin_list();
+			for(auto& hash : hashes) {
+				e.add_string(hash.data(), 32);
+			}
+			e.end_list();
+		});
+	}
+
+	// Fastest announcer not tried yet, fastest announcer if all were tried
+	TransportType* choose_peer(Fetch& fetch) {
+		TransportType* best = nullptr;
+		TransportType* best_untried = nullptr;
+		for(auto* announcer : fetch.announcers) {
+			auto& rtt = peers[announcer].rtt;
+			if(best == nullptr || rtt < peers[best].rtt) {
+				best = announcer;
+			}
+			bool is_tried = std::find(fetch.tried.begin(), fetch.tried.end(), announcer) != fetch.tried.end();
+			if(!is_tried && (best_untried == nullptr || rtt < peers[best_untried].rtt)) {
+				best_untried = announcer;
+			}
+		}
+
+		return best_untried != nullptr ? best_untried : best;
+	}
+
+	// Request whatever is missing and not in flight for the given hashes
+	void fetch(std::vector<Hash> const& hashes) {
+		absl::flat_hash_map<TransportType*, std::vector<Hash>> bodies;
+
+		for(auto& hash : hashes) {
+			auto iter = fetches.find(hash);
+			if(iter == fetches.end()) {
+				continue;
+			}
+			auto& fetch = iter->second;
+
+			if(!fetch.header.has_value() && fetch.header_peer == nullptr) {
+				fetch.header_peer = choose_peer(fetch);
+				if(fetch.header_peer != nullptr) {
+					request_header(*fetch.header_peer, peers[fetch.header_peer], hash);
+				}
+			}
+
+			if(!fetch.body.has_value() && fetch.body_peer == nullptr) {
+				fetch.body_peer = choose_peer(fetch);
+				if(fetch.body_peer != nullptr) {
+					bodies[fetch.body_peer].push_back(hash);
+				}
+			}
+
+			if(fetch.header_peer == nullptr && fetch.body_peer == nullptr && !(fetch.header.has_value() && fetch.body.has_value())) {
+				// Every announcer is gone
+				erase_fetch(iter);
+			}
+		}
+
+		for(auto& [transport, peer_hashes] : bodies) {
+			request_bodies(*transport, peers[transport], std::move(peer_hashes));
+		}
+	}
+
+	// Request failed or timed out, hand its parts to other peers
+	void fail(TransportType* transport, Request const& request, std::vector<Hash>& refetch) {
+		for(auto& hash : request.hashes) {
+			auto iter = fetches.find(hash);
+			if(iter == fetches.end()) {
+				continue;
+			}
+			auto& fetch = iter->second;
+
+			auto& part_peer = request.type == 0x13 ? fetch.header_peer : fetch.body_peer;
+			if(part_peer != transport) {
+				continue;
+			}
+			part_peer = nullptr;
+
+			fetch.tried.push_back(transport);
+			if(++fetch.attempts > MaxAttempts) {
+				SPDLOG_WARN("BlockFetcher: Giving up on block after {} attempts", fetch.attempts - 1);
+				erase_fetch(iter);
+				continue;
+			}
+
+			refetch.push_back(hash);
+		}
+	}
+
+	// Body has to hash to the transactions root and uncles hash in the header
+	static bool body_matches(core::Buffer const& header, core::Buffer const& body) {
+		auto fields = RlpView::parse(header.data(), header.size());
+		if(!fields.has_value() || !fields->is_list()) {
+			return false;
+		}
+
+		// [parentHash, uncleHash, coinbase, stateRoot, txRoot, ...]
+		auto reader = fields->items();
+		std::optional<RlpView> uncles_hash, txns_root;
+		for(size_t i = 0; i < 5; i++) {
+			auto field = reader.next(false);
+			if(!field.has_value()) {
+				return false;
+			}
+
+			if(i == 1) {
+				uncles_hash = field;
+			} else if(i == 4) {
+				txns_root = field;
+			}
+		}
+		if(uncles_hash->payload_size() != 32 || txns_root->payload_size() != 32) {
+			return false;
+		}
+
+		// [txns, uncles, ...]
+		RlpReader lists(body.data(), body.size());
+		auto txns = lists.next(true);
+		auto uncles = lists.next(true);
+		if(!txns.has_value() || !uncles.has_value()) {
+			return false;
+		}
+
+		Hash digest;
+		CryptoPP::Keccak_256 keccak;
+		keccak.Update(uncles->data(), uncles->size());
+		keccak.TruncatedFinal(digest.data(), 32);
+		if(std::memcmp(digest.data(), uncles_hash->payload(), 32) != 0) {
+			return false;
+		}
+
+		digest = TrieRoot::ordered(*txns);
+		return std::memcmp(digest.data(), txns_root->payload(), 32) == 0;
+	}
+
+	void complete(Hash const& hash) {
+		auto iter = fetches.find(hash);
+		if(iter == fetches.end() || !iter->second.header.has_value() || !iter->second.body.has_value()) {
+			return;
+		}
+
+		if(!body_matches(*iter->second.header, *iter->second.body)) {
+			SPDLOG_WARN("BlockFetcher: Body does not match header");
+			iter->second.body.reset();
+			iter->second.tried.push_back(iter->second.body_from);
+			if(++iter->second.attempts > MaxAttempts) {
+				SPDLOG_WARN("BlockFetcher: Giving up on block after {} attempts", iter->second.attempts - 1);
+				erase_fetch(iter);
+				return;
+			}
+
+			fetch({hash});
+			return;
+		}
+
+		auto header = std::move(*iter->second.header);
+		auto body = std::move(*iter->second.body);
+		erase_fetch(iter);
+		completed.insert(hash, asyncio::EventLoop::now());
+
+		delegate->did_fetch_block(*this, std::move(header), std::move(body));
+	}
+
+	void update_rtt(Peer& peer, uint64_t sample) {
+		peer.rtt = (7 * peer.rtt + sample) / 8;
+	}
+
+	// Find the request a response belongs to, cover the request id if present
+	std::optional<Request> match(TransportType& transport __attribute__((unused)), Peer& peer, core::Buffer& payload, uint8_t type) {
+		uint64_t id;
+		if(peer.has_request_ids) {
+			auto outer = rlp_header(payload.data(), payload.size());
+			if(!outer.has_value() || !outer->is_list) {
+				return std::nullopt;
+			}
+			payload.cover_unsafe(outer->header_size);
+
+			auto id_item = rlp_header(payload.data(), payload.size());
+			if(!id_item.has_value() || id_item->is_list || id_item->payload_size > 8) {
+				return std::nullopt;
+			}
+			id = rlp_uint(payload.data() + id_item->header_size, id_item->payload_size);
+			payload.cover_unsafe(id_item->size());
+		} else {
+			auto& order = type == 0x14 ? peer.header_order : peer.body_order;
+			if(order.empty()) {
+				return std::nullopt;
+			}
+			id = order.front();
+			order.pop_front();
+		}
+
+		auto iter = peer.requests.find(id);
+		if(iter == peer.requests.end()) {
+			SPDLOG_DEBUG(
+				"Transport {{ Src: {}, Dst: {} }}: Unknown request id: {}",
+				transport.src_addr.to_string(),
+				transport.dst_addr.to_string(),
+				id
+			);
+			return std::nullopt;
+		}
+
+		auto request = std::move(iter->second);
+		peer.requests.erase(iter);
+		if(request.expired || request.type + 1 != type) {
+			return std::nullopt;
+		}
+
+		update_rtt(peer, asyncio::EventLoop::now() - request.sent_at);
+		return request;
+	}
+
+	// Forget requests that timed out ExpiredTtl ago on a peer without request ids, along with
+	// their place in the send order. A response later still lines up with the wrong request,
+	// the hash and root checks catch that.
+	void forget_expired(Peer& peer, std::deque<uint64_t>& order, uint64_t now) {
+		while(!order.empty()) {
+			auto iter = peer.requests.find(order.front());
+			if(iter != peer.requests.end()) {
+				auto& request = iter->second;
+				if(!request.expired || request.sent_at + RequestTimeout + ExpiredTtl > now) {
+					break;
+				}
+				peer.requests.erase(iter);
+			}
+			order.pop_front();
+		}
+	}
+
+	void timer_cb() {
+		auto now = asyncio::EventLoop::now();
+		std::vector<Hash> refetch;
+
+		for(auto& [transport, peer] : peers) {
+			std::vector<uint64_t> timed_out;
+			for(auto& [id, request] : peer.requests) {
+				if(!request.expired && request.sent_at + RequestTimeout <= now) {
+					timed_out.push_back(id);
+				}
+			}
+
+			for(auto id : timed_out) {
+				auto& request = peer.requests[id];
+				fail(transport, request, refetch);
+				peer.rtt = std::max(peer.rtt, RequestTimeout);
+
+				if(peer.has_request_ids) {
+					peer.requests.erase(id);
+				} else {
+					request.expired = true;
+				}
+			}
+
+			if(!peer.has_request_ids) {
+				forget_expired(peer, peer.header_order, now);
+				forget_expired(peer, peer.body_order, now);
+			}
+		}
+
+		fetch(refetch);
+		completed.expire(now);
+	}
+
+public:
+	DelegateType* delegate = nullptr;
+
+	BlockFetcher() : completed(CompletedTtl), timer(this) {
+		timer.template start<Self, &Self::timer_cb>(TimerInterval, TimerInterval);
+	}
+
+	BlockFetcher(BlockFetcher const&) = delete;
+
+	void add_peer(TransportType& transport) {
+		peers[&transport];
+	}
+
+	void remove_peer(TransportType& transport) {
+		auto iter = peers.find(&transport);
+		if(iter == peers.end()) {
+			return;
+		}
+
+		std::vector<Hash> refetch;
+		for(auto& [id, request] : iter->second.requests) {
+			fail(&transport, request, refetch);
+		}
+		peers.erase(iter);
+
+		for(auto& [hash, fetch] : fetches) {
+			if(fetch.origin == &transport) {
+				fetch.origin = nullptr;
+			}
+			fetch.announcers.erase(
+				std::remove(fetch.announcers.begin(), fetch.announcers.end(), &transport),
+				fetch.announcers.end()
+			);
+		}
+
+		fetch(refetch);
+	}
+
+	/// eth Status, picks request id framing from the negotiated version
+	void did_recv_status(TransportType& transport, core::Buffer const& message) {
+		auto list = rlp_header(message.data() + 1, message.size() - 1);
+		if(!list.has_value() || !list->is_list) {
+			return;
+		}
+
+		auto version_pos = 1 + list->header_size;
+		auto version = rlp_header(message.data() + version_pos, message.size() - version_pos);
+		if(!version.has_value() || version->is_list) {
+			return;
+		}
+
+		auto v = rlp_uint(message.data() + version_pos + version->header_size, version->payload_size);
+		peers[&transport].has_request_ids = v >= 66;
+		SPDLOG_INFO(
+			"Transport {{ Src: {}, Dst: {} }}: eth/{}",
+			transport.src_addr.to_string(),
+			transport.dst_addr.to_string(),
+			v
+		);
+	}
+
+	/// eth NewBlockHashes, starts fetches for hashes not seen before
+	void did_recv_announcement(TransportType& transport, core::Buffer&& message) {
+		auto now = asyncio::EventLoop::now();
+		message.cover_unsafe(1);
+
+		auto list = rlp_header(message.data(), message.size());
+		if(!list.has_value() || !list->is_list) {
+			return;
+		}
+		message.cover_unsafe(list->header_size);
+		message.truncate_unsafe(message.size() - list->payload_size);
+
+		auto& peer = peers[&transport];
+		std::vector<Hash> hashes;
+		size_t dropped = 0;
+		while(message.size() > 0) {
+			// [hash, number]
+			auto pair = rlp_header(message.data(), message.size());
+			if(!pair.has_value() || !pair->is_list) {
+				break;
+			}
+
+			auto hash_pos = pair->header_size;
+			if(pair->payload_size < 33 || message.data()[hash_pos] != 0xa0) {
+				break;
+			}
+
+			Hash hash;
+			std::memcpy(hash.data(), message.data() + hash_pos + 1, 32);
+			message.cover_unsafe(pair->size());
+
+			if(completed.contains(hash, now)) {
+				continue;
+			}
+
+			auto iter = fetches.find(hash);
+			if(iter == fetches.end()) {
+				if(fetches.size() >= MaxFetches || peer.fetches >= MaxFetchesPerPeer) {
+					dropped++;
+					continue;
+				}
+
+				iter = fetches.try_emplace(hash).first;
+				iter->second.origin = &transport;
+				peer.fetches++;
+				hashes.push_back(hash);
+			}
+
+			auto& announcers = iter->second.announcers;
+			if(std::find(announcers.begin(), announcers.end(), &transport) == announcers.end()) {
+				announcers.push_back(&transport);
+			}
+		}
+
+		if(dropped > 0) {
+			SPDLOG_WARN(
+				"Transport {{ Src: {}, Dst: {} }}: Too many fetches, dropped {} hashes",
+				transport.src_addr.to_string(),
+				transport.dst_addr.to_string(),
+				dropped
+			);
+		}
+
+		SPDLOG_DEBUG(
+			"Transport {{ Src: {}, Dst: {} }}: {} new hashes, {} fetches in flight",
+			transport.src_addr.to_string(),
+			transport.dst_addr.to_string(),
+			hashes.size(),
+			fetches.size()
+		);
+
+		fetch(hashes);
+	}
+
+	/// eth BlockHeaders
+	void did_recv_headers(TransportType& transport, core::Buffer&& message) {
+		auto& peer = peers[&transport];
+		message.cover_unsafe(1);
+
+		auto request = match(transport, peer, message, 0x14);
+		if(!request.has_value()) {
+			return;
+		}
+
+		auto list = rlp_header(message.data(), message.size());
+		std::optional<RlpHeader> header;
+		if(list.has_value() && list->is_list && list->payload_size > 0) {
+			header = rlp_header(message.data() + list->header_size, list->payload_size);
+		}
+
+		auto& hash = request->hashes[0];
+		std::vector<Hash> refetch;
+		if(!header.has_value()) {
+			// Peer does not have it
+			fail(&transport, *request, refetch);
+			fetch(refetch);
+			return;
+		}
+
+		message.cover_unsafe(list->header_size);
+		message.truncate_unsafe(message.size() - header->size());
+
+		// Guards against mismatched responses from peers without request ids
+		Hash digest;
+		CryptoPP::Keccak_256 keccak;
+		keccak.Update(message.data(), message.size());
+		keccak.TruncatedFinal(digest.data(), 32);
+		if(digest != hash) {
+			SPDLOG_WARN(
+				"Transport {{ Src: {}, Dst: {} }}: Header does not match requested hash",
+				transport.src_addr.to_string(),
+				transport.dst_addr.to_string()
+			);
+			fail(&transport, *request, refetch);
+			fetch(refetch);
+			return;
+		}
+
+		auto iter = fetches.find(hash);
+		if(iter == fetches.end() || iter->second.header.has_value()) {
+			return;
+		}
+		iter->second.header_peer = nullptr;
+		iter->second.header = std::move(message);
+
+		complete(hash);
+	}
+
+	/// eth BlockBodies
+	void did_recv_bodies(TransportType& transport, core::Buffer&& message) {
+		auto& peer = peers[&transport];
+		message.cover_unsafe(1);
+
+		auto request = match(transport, peer, message, 0x16);
+		if(!request.has_value()) {
+			return;
+		}
+
+		auto list = rlp_header(message.data(), message.size());
+		if(!list.has_value() || !list->is_list) {
+			return;
+		}
+		message.cover_unsafe(list->header_size);
+		message.truncate_unsafe(message.size() - list->payload_size);
+
+		// Bodies come back in request order, possibly fewer than asked for
+		size_t idx = 0;
+		for(; idx < request->hashes.size() && message.size() > 0; idx++) {
+			auto body = rlp_header(message.data(), message.size());
+			if(!body.has_value() || !body->is_list) {
+				break;
+			}
+
+			// Split off by reference, keeping only the list payload
+			message.cover_unsafe(body->header_size);
+			auto payload = message.size() > body->payload_size ? message.split(body->payload_size) : std::move(message);
+
+			auto iter = fetches.find(request->hashes[idx]);
+			if(iter == fetches.end() || iter->second.body.has_value()) {
+				continue;
+			}
+			iter->second.body_peer = nullptr;
+			iter->second.body_from = &transport;
+			iter->second.body = std::move(payload);
+
+			complete(request->hashes[idx]);
+		}
+
+		if(idx < request->hashes.size()) {
+			Request rest{request->type, request->sent_at, {request->hashes.begin() + idx, request->hashes.end()}};
+			std::vector<Hash> refetch;
+			fail(&transport, rest, refetch);
+			fetch(refetch);
+		}
+	}
+
+	/// Number of blocks being fetched
+	size_t in_flight() const {
+		return fetches.size();
+	}
+
+	/// Whether the peer's eth version frames requests and responses with request ids, eth/66 on
+	bool has_request_ids(TransportType& transport) const {
+		auto iter = peers.find(&transport);
+		return iter == peers.end() || iter->second.has_request_ids;
+	}
+
+	/// Requests to a peer awaiting a response, including timed out ones kept for peers without request ids
+	size_t pending(TransportType& transport) const {
+		auto iter = peers.find(&transport);
+		return iter == peers.end() ? 0 : iter->second.requests.size();
+	}
+};
+
+} // namespace rlpx
+} // namespace marlin
+
+#endif // MARLIN_RLPX_BLOCKFETCHER_HPP
@@ -0,0 +1,56 @@
+#ifndef MARLIN_RLPX_ETHRESPONSES_HPP
+#define MARLIN_RLPX_ETHRESPONSES_HPP
+
+#include <marlin/core/Buffer.hpp>
+#include <marlin/rlpx/Rlp.hpp>
+
+#include <optional>
+
+namespace marlin {
+namespace rlpx {
+
+/// Empty answer of the given type to an eth request there is nothing to serve for, e.g.
+/// BlockHeaders to GetBlockHeaders. From eth/66 on it echoes the request id as
+/// [request_id, []], before that it is a bare []. Nullopt if an eth/66 request carries no id.
+inline std::optional<core::Buffer> eth_empty_response(core::Buffer const& request, uint8_t type, bool has_request_ids) {
+	std::optional<uint64_t> id;
+	if(has_request_ids) {
+		if(request.size() < 1) {
+			return std::nullopt;
+		}
+
+		// [request_id, query]
+		auto outer = RlpView::parse(request.data() + 1, request.size() - 1);
+		if(!outer.has_value() || !outer->is_list()) {
+			return std::nullopt;
+		}
+		auto id_item = outer->items().next(false);
+		if(!id_item.has_value()) {
+			return std::nullopt;
+		}
+		id = id_item->as_uint();
+		if(!id.has_value()) {
+			return std::nullopt;
+		}
+	}
+
+	auto response = RlpEncoder<>::encode([&](auto& e) {
+		if(id.has_value()) {
+			e.begin_list();
+			e.add_uint(*id);
+		}
+		e.begin_list();
+		e.end_list();
+		if(id.has_value()) {
+			e.end_list();
+		}
+	}, 1);
+	response.data()[0] = type;
+
+	return response;
+}
+
+} // namespace rlpx
+} // namespace marlin
+
+#endif // MARLIN_RLPX_ETHRESPONSES_HPP
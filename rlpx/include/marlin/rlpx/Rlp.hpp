@@ -0,0 +1,343 @@
+#ifndef MARLIN_RLPX_RLP_HPP
+#define MARLIN_RLPX_RLP_HPP
+
+#include <marlin/core/Buffer.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+namespace marlin {
+namespace rlpx {
+
+/// Prefix of an RLP item
+struct RlpHeader {
+	bool is_list;
+	size_t header_size;
+	size_t payload_size;
+
+	/// Size of the whole item, prefix included
+	size_t size() const {
+		return header_size + payload_size;
+	}
+};
+
+/// Big endian unsigned integer of up to 8 bytes
+inline uint64_t rlp_uint(uint8_t const* data, size_t size) {
+	uint64_t num = 0;
+	for(size_t i = 0; i < size; i++) {
+		num = (num << 8) | data[i];
+	}
+	return num;
+}
+
+/// Decode the prefix of the item at data, nullopt if it is malformed, not in its shortest
+/// form or runs past available
+inline std::optional<RlpHeader> rlp_header(uint8_t const* data, size_t available) {
+	if(available == 0) {
+		return std::nullopt;
+	}
+
+	uint8_t prefix = data[0];
+	RlpHeader header;
+	if(prefix < 0x80) {
+		header = {false, 0, 1};
+	} else if(prefix < 0xb8) {
+		// A single byte below 0x80 is its own encoding
+		if(prefix == 0x81 && available > 1 && data[1] < 0x80) {
+			return std::nullopt;
+		}
+		header = {false, 1, (size_t)prefix - 0x80};
+	} else if(prefix < 0xc0 || prefix >= 0xf8) {
+		size_t ll = prefix < 0xc0 ? prefix - 0xb7 : prefix - 0xf7;
+		if(available < 1 + ll || ll > 8) {
+			return std::nullopt;
+		}
+		header = {prefix >= 0xf8, 1 + ll, rlp_uint(data + 1, ll)};
+		// Long form only past 55 bytes, without leading zeros in the length
+		if(data[1] == 0 || header.payload_size < 56) {
+			return std::nullopt;
+		}
+	} else {
+		header = {true, 1, (size_t)prefix - 0xc0};
+	}
+
+	if(header.payload_size > available - header.header_size) {
+		return std::nullopt;
+	}
+
+	return header;
+}
+
+class RlpReader;
+
+/// @brief An RLP item in place, the bytes stay owned by whoever owns the encoding
+class RlpView {
+private:
+	uint8_t const* ptr;
+	RlpHeader header;
+
+public:
+	RlpView(uint8_t const* ptr, RlpHeader header) : ptr(ptr), header(header) {}
+
+	/// The item at the start of data, nullopt if it is malformed or runs past size
+	static std::optional<RlpView> parse(uint8_t const* data, size_t size) {
+		auto header = rlp_header(data, size);
+		if(!header.has_value()) {
+			return std::nullopt;
+		}
+
+		return RlpView(data, *header);
+	}
+
+	bool is_list() const {
+		return header.is_list;
+	}
+
+	/// Whole encoding, prefix included
+	uint8_t const* data() const {
+		return ptr;
+	}
+
+	size_t size() const {
+		return header.size();
+	}
+
+	uint8_t const* payload() const {
+		return ptr + header.header_size;
+	}
+
+	size_t payload_size() const {
+		return header.payload_size;
+	}
+
+	/// Value of a string item of at most 8 bytes
+	std::optional<uint64_t> as_uint() const {
+		if(header.is_list || header.payload_size > 8) {
+			return std::nullopt;
+		}
+
+		return rlp_uint(payload(), header.payload_size);
+	}
+
+	/// Items of a list
+	RlpReader items() const;
+};
+
+/// @brief Walks a run of RLP items front to back, such as the payload of a list
+///
+/// Items are handed out as views over the original bytes, nothing is copied or allocated.
+class RlpReader {
+private:
+	uint8_t const* ptr;
+	size_t remaining;
+	bool malformed = false;
+
+public:
+	RlpReader(uint8_t const* data, size_t size) : ptr(data), remaining(size) {}
+
+	/// Next item, nullopt once the run is over or an item is malformed
+	std::optional<RlpView> next() {
+		if(remaining == 0 || malformed) {
+			return std::nullopt;
+		}
+
+		auto item = RlpView::parse(ptr, remaining);
+		if(!item.has_value()) {
+			malformed = true;
+			return std::nullopt;
+		}
+
+		ptr += item->size();
+		remaining -= item->size();
+		return item;
+	}
+
+	/// Next item if it is a list, or a string when is_list is false
+	std::optional<RlpView> next(bool is_list) {
+		auto item = next();
+		if(item.has_value() && item->is_list() != is_list) {
+			malformed = true;
+			return std::nullopt;
+		}
+
+		return item;
+	}
+
+	/// Start of the next item
+	uint8_t const* position() const {
+		return ptr;
+	}
+
+	size_t bytes_left() const {
+		return remaining;
+	}
+
+	bool done() const {
+		return remaining == 0 || malformed;
+	}
+
+	bool is_malformed() const {
+		return malformed;
+	}
+};
+
+inline RlpReader RlpView::items() const {
+	return header.is_list ? RlpReader(payload(), header.payload_size) : RlpReader(nullptr, 0);
+}
+
+/// @brief Two pass RLP encoder that writes straight into one preallocated buffer
+///
+/// The build function is called twice with the encoder, once to size every list and once
+/// to write, so it should not have side effects:
+///
+///     auto message = RlpEncoder<>::encode([&](auto& e) {
+///         e.begin_list();
+///         e.add_uint(id);
+///         e.add_raw(item.data(), item.size());
+///         e.end_list();
+///     }, 1);
+///
+/// List sizes are kept in a fixed array of MaxLists, building more lists than that throws
+/// std::length_error. Ending a list that was never begun, or leaving one open when the build
+/// function returns, throws std::logic_error.
+template<size_t MaxLists = 16>
+class RlpEncoder {
+private:
+	bool writing = false;
+
+	// Measuring, size of every list payload in the order the lists begin
+	size_t list_sizes[MaxLists];
+	size_t num_lists = 0;
+	// Lists open at the moment, with the bytes added to them so far
+	size_t open_lists[MaxLists];
+	size_t open_sizes[MaxLists + 1] = {0};
+	size_t depth = 0;
+
+	// Writing
+	uint8_t* out = nullptr;
+	size_t next_list = 0;
+
+	static size_t num_bytes(uint64_t num) {
+		size_t nb = 0;
+		while(num > 0) {
+			nb++;
+			num >>= 8;
+		}
+		return nb;
+	}
+
+	void write_be(uint64_t num, size_t nb) {
+		for(size_t i = nb; i > 0; i--) {
+			out[i - 1] = (uint8_t)num;
+			num >>= 8;
+		}
+		out += nb;
+	}
+
+	void write_prefix(uint8_t short_base, uint8_t long_base, size_t size) {
+		if(size < 56) {
+			*out++ = short_base + size;
+		} else {
+			auto nb = num_bytes(size);
+			*out++ = long_base + nb;
+			write_be(size, nb);
+		}
+	}
+
+	void measure(size_t size) {
+		open_sizes[depth] += size;
+	}
+
+public:
+	static size_t prefix_size(size_t payload_size) {
+		return payload_size < 56 ? 1 : 1 + num_bytes(payload_size);
+	}
+
+	void begin_list() {
+		if(writing) {
+			write_prefix(0xc0, 0xf7, list_sizes[next_list++]);
+			return;
+		}
+
+		if(num_lists == MaxLists) {
+			throw std::length_error("RlpEncoder: too many lists");
+		}
+		open_lists[depth++] = num_lists++;
+		open_sizes[depth] = 0;
+	}
+
+	void end_list() {
+		if(writing) {
+			return;
+		}
+
+		if(depth == 0) {
+			throw std::logic_error("RlpEncoder: end_list without begin_list");
+		}
+		auto payload_size = open_sizes[depth];
+		list_sizes[open_lists[--depth]] = payload_size;
+		measure(prefix_size(payload_size) + payload_size);
+	}
+
+	void add_string(uint8_t const* data, size_t size) {
+		if(!writing) {
+			measure(size == 1 && data[0] < 0x80 ? 1 : prefix_size(size) + size);
+			return;
+		}
+
+		if(size != 1 || data[0] >= 0x80) {
+			write_prefix(0x80, 0xb7, size);
+		}
+		std::memcpy(out, data, size);
+		out += size;
+	}
+
+	void add_uint(uint64_t num) {
+		auto nb = num_bytes(num);
+		if(!writing) {
+			measure(num > 0 && num < 0x80 ? 1 : 1 + nb);
+			return;
+		}
+
+		if(num == 0 || num >= 0x80) {
+			*out++ = 0x80 + nb;
+		}
+		write_be(num, nb);
+	}
+
+	/// Item that is already encoded, or a run of them
+	void add_raw(uint8_t const* data, size_t size) {
+		if(!writing) {
+			measure(size);
+			return;
+		}
+
+		std::memcpy(out, data, size);
+		out += size;
+	}
+
+	/// Encode into a single buffer with headroom bytes left free in front, e.g. for a message type
+	template<typename F>
+	static core::Buffer encode(F&& build, size_t headroom = 0) {
+		RlpEncoder encoder;
+		build(encoder);
+		if(encoder.depth != 0) {
+			throw std::logic_error("RlpEncoder: unbalanced lists");
+		}
+
+		core::Buffer buf(headroom + encoder.open_sizes[0]);
+		encoder.writing = true;
+		encoder.out = buf.data() + headroom;
+		build(encoder);
+
+		return buf;
+	}
+};
+
+} // namespace rlpx
+} // namespace marlin
+
+#endif // MARLIN_RLPX_RLP_HPP
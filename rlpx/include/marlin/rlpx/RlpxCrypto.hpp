@@ -1,6 +1,7 @@
 #ifndef MARLIN_RLPX_RLPXCRYPTO_HPP
 #define MARLIN_RLPX_RLPXCRYPTO_HPP
 
+#include <cryptopp/aes.h>
 #include <cryptopp/eccrypto.h>
 #include <cryptopp/keccak.h>
 #include <cryptopp/osrng.h>
@@ -30,6 +31,15 @@ private:
 
 	CryptoPP::Keccak_256 ingress_mac;
 	CryptoPP::Keccak_256 egress_mac;
+	// Scratch state to take digests without finalizing the running macs
+	CryptoPP::Keccak_256 scratch_mac;
+
+	// Truncated digests of the running macs as of the last update
+	uint8_t ingress_digest[16];
+	uint8_t egress_digest[16];
+
+	// Keyed with macs once per session
+	CryptoPP::AES::Encryption mac_cipher;
 
 	CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d;
 	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption encryption;
@@ -39,6 +49,10 @@ private:
 	void store_key();
 	void load_key();
 	void log_pub_key();
+
+	void init_session(uint8_t const *egress_nonce, uint8_t const *ack, size_t ack_size, uint8_t const *ingress_nonce, uint8_t const *auth, size_t auth_size);
+	void mac_digest(CryptoPP::Keccak_256 const &mac, uint8_t *out);
+	void mac_update(CryptoPP::Keccak_256 &mac, uint8_t const *block, uint8_t const *seed, uint8_t *out);
 public:
 	RlpxCrypto();
 	~RlpxCrypto();
@@ -52,11 +66,14 @@ public:
 
 	void compute_secrets(uint8_t *auth, uint8_t *authplain, size_t auth_size, uint8_t *ack, size_t ack_size);
 	void compute_secrets_old(uint8_t *auth, uint8_t *authplain, size_t auth_size, uint8_t *ack, size_t ack_size);
+	void set_secrets(uint8_t const *aes_secret, uint8_t const *mac_secret, uint8_t const *egress_nonce, uint8_t const *ingress_nonce);
 
 	bool header_decrypt(uint8_t *in, size_t in_size, uint8_t *out);
 	bool header_encrypt(uint8_t *in, size_t in_size, uint8_t *out);
 	bool frame_decrypt(uint8_t *in, size_t in_size, uint8_t *out);
 	bool frame_encrypt(uint8_t *in, size_t in_size, uint8_t *out);
+	// Header and frame in one pass, in_size covers both
+	bool message_encrypt(uint8_t *in, size_t in_size, uint8_t *out);
 };
 
 } // namespace rlpx
@@ -6,9 +6,10 @@
 #include <snappy.h>
 
 #include <marlin/asyncio/tcp/TcpTransport.hpp>
+#include <marlin/core/FrameAssembler.hpp>
 
 #include "RlpxCrypto.hpp"
-#include "RlpItem.hpp"
+#include "Rlp.hpp"
 
 namespace marlin {
 namespace rlpx {
@@ -33,10 +34,16 @@ private:
 	};
 	State state = State::Idle;
 
-	uint32_t buf_size = 0;
-	uint32_t bytes_remaining = 0;
+	// Cuts the unit expected in the current state out of reads
+	core::FrameAssembler assembler;
 	uint32_t length;
-	uint8_t buf[20000000]; // 20 MB limit(should never hit for ETH)
+
+	// Largest frame and decompressed message accepted from a peer, the devp2p limit
+	static constexpr uint32_t max_message_size = 16 * 1024 * 1024;
+	// Smallest EIP-8 auth message, including its length prefix, that holds all fields read from it
+	static constexpr uint32_t min_auth_size = 283;
+
+	bool did_recv_unit(core::Buffer &&unit);
 public:
 	// Delegate
 	void did_dial(BaseTransport &transport);
@@ -76,175 +83,203 @@ void RlpxTransport<DelegateType>::did_recv(
 	BaseTransport &,
 	core::Buffer &&bytes
 ) {
-	if(bytes_remaining > bytes.size()) { // Partial message
-		SPDLOG_DEBUG("Partial: {}, {}, {}", buf_size, bytes.size(), bytes_remaining);
-		std::memcpy(buf + buf_size, bytes.data(), bytes.size());
-		buf_size += bytes.size();
-		bytes_remaining -= bytes.size();
-	} else { // Full message
-		SPDLOG_DEBUG("Full: {}, {}, {}", buf_size, bytes.size(), bytes_remaining);
-		std::memcpy(buf + buf_size, bytes.data(), bytes_remaining);
-		buf_size += bytes_remaining;
-		bytes.cover_unsafe(bytes_remaining);
-		bytes_remaining = 0;
-
+	while(bytes.size() > 0) {
 		if(state == State::Idle) {
+			// Pre EIP-8 auth messages have a fixed size and no length prefix
 			if(bytes.size() == 307) {
-				bytes_remaining = 307;
+				assembler.expect(307);
 				state = State::AuthWait;
 			} else {
-				bytes_remaining = 2;
+				assembler.expect(2);
 				state = State::LengthWait;
 			}
-		} else if(state == State::LengthWait) {
-			bytes_remaining = ((uint32_t)buf[0] << 8) | (uint32_t)buf[1];
-			state = State::AuthWait;
-		} else if(state == State::AuthWait) {
-			// Have full auth message
-			uint8_t buf_backup[1500];
-			std::memcpy(buf_backup, buf, buf_size);
-
-			bool is_verified = buf_size == 307
-								? crypto.ecies_decrypt_old(buf, buf_size, buf + 81)
-								: crypto.ecies_decrypt(buf, buf_size, buf + 83);
-
-			if(is_verified) {
-				// Respond
-				uint8_t resp_ptxt[102] = {0xf8, 100, 0xb8};
-				crypto.get_ephemeral_public_key(resp_ptxt + 3);
-				resp_ptxt[3] = 0x40;
-				resp_ptxt[68] = 0xa0;
-				crypto.get_nonce(resp_ptxt + 69);
-				resp_ptxt[101] = 0x04;
-
-				core::Buffer resp(217);
-				resp.write_uint16_be_unsafe(0, 215);
-				crypto.ecies_encrypt(resp_ptxt, 102, resp.data());
-
-				buf_size == 307
-				? crypto.compute_secrets_old(buf_backup, buf, buf_size, resp.data(), 217)
-				: crypto.compute_secrets(buf_backup, buf, buf_size, resp.data(), 217);
-
-				transport.send(std::move(resp));
-
-				uint8_t *hello = new uint8_t[144];
-				std::memset(hello, 0, 144);
-				hello[2] = 91;
-				hello[3] = 0xc2;
-				hello[4] = 0x80;
-				hello[5] = 0x80;
-
-				crypto.header_encrypt(hello, 32, hello);
-
-				hello[32] = 0x80;
-				hello[33] = 0xf8;
-				hello[34] = 88;
-				hello[35] = 0x05;
-				hello[36] = 0x8c;
-				std::memcpy(hello + 37, "Marlin/Alpha", 12);
-				std::memcpy(hello + 49, "\xc6\xc5\x83\x65\x74\x68\x42\x80\xb8", 9);
-				crypto.get_static_public_key(hello + 58);
-				hello[58] = 0x40;
-
-				crypto.frame_encrypt(hello + 32, 112, hello + 32);
-
-				transport.send(core::Buffer(hello, 144));
-
-				bytes_remaining = 32;
-				buf_size = 0;
-				state = State::HelloHeaderWait;
-			} else {
-				SPDLOG_ERROR("Verification failed");
-				transport.close();
+		}
+
+		if(state == State::LengthWait) {
+			// Auth message is decrypted along with its length prefix
+			auto *prefix = assembler.peek(bytes, 2);
+			if(prefix == nullptr) {
+				return;
 			}
-		} else if(state == State::HelloHeaderWait) {
-			bool is_verified = crypto.header_decrypt(buf, 32, buf);
-			SPDLOG_DEBUG("Hello Header: {}", spdlog::to_hex(buf, buf + 32));
-
-			if(is_verified) {
-				length = bytes_remaining = ((uint32_t)buf[0] << 16) | ((uint32_t)buf[1] << 8) | (uint32_t)buf[2];
-				if(bytes_remaining % 16 != 0) {
-					bytes_remaining += 16 - bytes_remaining % 16;
-				}
-				bytes_remaining += 16;
-				buf_size = 0;
-				state = State::HelloFrameWait;
-			} else {
-				SPDLOG_ERROR("Verification failed");
+
+			uint32_t auth_size = 2 + (((uint32_t)prefix[0] << 8) | (uint32_t)prefix[1]);
+			if(auth_size < min_auth_size) {
+				SPDLOG_ERROR("Auth message too short: {}", auth_size);
 				transport.close();
+				return;
 			}
-		} else if(state == State::HelloFrameWait) {
-			bool is_verified = crypto.frame_decrypt(buf, buf_size, buf);
-			SPDLOG_DEBUG("Hello Frame: {}", spdlog::to_hex(buf, buf + buf_size));
 
-			if(is_verified) {
-				std::string cl(buf + 5, buf + 5 + (uint8_t)buf[4] - 0x80);
-				SPDLOG_DEBUG("Client: {}", cl);
+			assembler.expect(auth_size);
+			state = State::AuthWait;
+		}
+
+		SPDLOG_DEBUG("Recv: {}, {}, {}", assembler.gathered(), bytes.size(), assembler.size());
+		auto unit = assembler.next(bytes);
+		if(!unit.has_value()) {
+			return;
+		}
 
-				bytes_remaining = 32;
-				buf_size = 0;
-				state = State::RecvHeaderWait;
-			} else {
-				SPDLOG_ERROR("Verification failed");
-				transport.close();
-			}
-		} else if(state == State::RecvHeaderWait) {
-			bool is_verified = crypto.header_decrypt(buf, 32, buf);
-			SPDLOG_DEBUG("Recv Header: {}", spdlog::to_hex(buf, buf + 32));
-
-			if(is_verified) {
-				length = bytes_remaining = ((uint32_t)buf[0] << 16) | ((uint32_t)buf[1] << 8) | (uint32_t)buf[2];
-				if(bytes_remaining % 16 != 0) {
-					bytes_remaining += 16 - bytes_remaining % 16;
-				}
-				bytes_remaining += 16;
-				buf_size = 0;
-				state = State::RecvFrameWait;
-			} else {
-				SPDLOG_ERROR("Verification failed");
-				transport.close();
-			}
-		} else if(state == State::RecvFrameWait) {
-			bool is_verified = crypto.frame_decrypt(buf, buf_size, buf);
-			SPDLOG_DEBUG("Recv Frame: {} bytes: {}", length, spdlog::to_hex(buf, buf + buf_size));
+		if(!did_recv_unit(std::move(*unit))) {
+			return;
+		}
+	}
+}
 
-			if(is_verified) {
-				size_t ulen = 0;
-				snappy::GetUncompressedLength((char *)buf + 1, length - 1, &ulen);
+template<typename DelegateType>
+bool RlpxTransport<DelegateType>::did_recv_unit(
+	core::Buffer &&unit
+) {
+	if(state == State::AuthWait) {
+		// Have full auth message, decrypted separately since the ciphertext feeds the ingress mac
+		auto authplain = core::SizeClassPool::default_instance().get(unit.size());
+
+		bool is_old = unit.size() == 307;
+		bool is_verified = is_old
+							? crypto.ecies_decrypt_old(unit.data(), unit.size(), authplain.data() + 81)
+							: crypto.ecies_decrypt(unit.data(), unit.size(), authplain.data() + 83);
+
+		if(!is_verified) {
+			SPDLOG_ERROR("Verification failed");
+			transport.close();
+			return false;
+		}
 
-				uint8_t *ubuf = new uint8_t[ulen + 1];
-				ubuf[0] = buf[0];
-				snappy::RawUncompress((char *)buf + 1, length - 1, (char *)ubuf + 1);
+		// Respond
+		uint8_t resp_ptxt[102] = {0xf8, 100, 0xb8};
+		crypto.get_ephemeral_public_key(resp_ptxt + 3);
+		resp_ptxt[3] = 0x40;
+		resp_ptxt[68] = 0xa0;
+		crypto.get_nonce(resp_ptxt + 69);
+		resp_ptxt[101] = 0x04;
+
+		core::Buffer resp(217);
+		resp.write_uint16_be_unsafe(0, 215);
+		crypto.ecies_encrypt(resp_ptxt, 102, resp.data());
+
+		is_old
+		? crypto.compute_secrets_old(unit.data(), authplain.data(), unit.size(), resp.data(), 217)
+		: crypto.compute_secrets(unit.data(), authplain.data(), unit.size(), resp.data(), 217);
+
+		transport.send(std::move(resp));
+
+		uint8_t *hello = new uint8_t[144];
+		std::memset(hello, 0, 144);
+		hello[2] = 91;
+		hello[3] = 0xc2;
+		hello[4] = 0x80;
+		hello[5] = 0x80;
+
+		hello[32] = 0x80;
+		hello[33] = 0xf8;
+		hello[34] = 88;
+		hello[35] = 0x05;
+		hello[36] = 0x8c;
+		std::memcpy(hello + 37, "Marlin/Alpha", 12);
+		std::memcpy(hello + 49, "\xc6\xc5\x83\x65\x74\x68\x42\x80\xb8", 9);
+		crypto.get_static_public_key(hello + 58);
+		hello[58] = 0x40;
+
+		crypto.message_encrypt(hello, 144, hello);
+
+		transport.send(core::Buffer(hello, 144));
+
+		assembler.expect(32);
+		state = State::HelloHeaderWait;
+	} else if(state == State::HelloHeaderWait || state == State::RecvHeaderWait) {
+		// Decrypted in place, wherever the header landed
+		bool is_verified = crypto.header_decrypt(unit.data(), 32, unit.data());
+		SPDLOG_DEBUG("Header: {}", spdlog::to_hex(unit.data(), unit.data() + 32));
+
+		if(!is_verified) {
+			SPDLOG_ERROR("Verification failed");
+			transport.close();
+			return false;
+		}
 
-				core::Buffer message(ubuf, ulen + 1);
+		length = ((uint32_t)unit.data()[0] << 16) | ((uint32_t)unit.data()[1] << 8) | (uint32_t)unit.data()[2];
+		if(length == 0 || length > max_message_size) {
+			SPDLOG_ERROR("Invalid frame size: {}", length);
+			transport.close();
+			return false;
+		}
 
-				SPDLOG_DEBUG("Message: {} bytes: {}", ulen, spdlog::to_hex(ubuf, ubuf + ulen + 1));
+		uint32_t frame_size = length;
+		if(frame_size % 16 != 0) {
+			frame_size += 16 - frame_size % 16;
+		}
+		assembler.expect(frame_size + 16);
+		state = state == State::HelloHeaderWait ? State::HelloFrameWait : State::RecvFrameWait;
+	} else if(state == State::HelloFrameWait) {
+		bool is_verified = crypto.frame_decrypt(unit.data(), unit.size(), unit.data());
+		SPDLOG_DEBUG("Hello Frame: {}", spdlog::to_hex(unit.data(), unit.data() + unit.size()));
+
+		if(!is_verified) {
+			SPDLOG_ERROR("Verification failed");
+			transport.close();
+			return false;
+		}
 
-				if(message.data()[0] == 0x02) { // p2p Ping
-					auto pong = RlpItem::from_list({});
+		if(length > 5) {
+			size_t cl_size = std::min<size_t>((uint8_t)(unit.data()[4] - 0x80), length - 5);
+			std::string cl(unit.data() + 5, unit.data() + 5 + cl_size);
+			SPDLOG_DEBUG("Client: {}", cl);
+		}
 
-					core::Buffer res(pong.enc_size + 1);
-					res.data()[0] = 0x03;
-					pong.encode(res.data() + 1);
+		assembler.expect(32);
+		state = State::RecvHeaderWait;
+	} else if(state == State::RecvFrameWait) {
+		bool is_verified = crypto.frame_decrypt(unit.data(), unit.size(), unit.data());
+		SPDLOG_DEBUG("Recv Frame: {} bytes: {}", length, spdlog::to_hex(unit.data(), unit.data() + unit.size()));
 
-					this->send(std::move(res));
-				} else {
-					delegate->did_recv(*this, std::move(message));
-				}
+		if(!is_verified) {
+			SPDLOG_ERROR("Verification failed");
+			transport.close();
+			return false;
+		}
 
-				bytes_remaining = 32;
-				buf_size = 0;
-				state = State::RecvHeaderWait;
-			} else {
-				SPDLOG_ERROR("Verification failed");
-				transport.close();
-			}
+		// Declared uncompressed length is checked before anything is allocated for it
+		size_t ulen = 0;
+		if(!snappy::GetUncompressedLength((char *)unit.data() + 1, length - 1, &ulen)) {
+			SPDLOG_ERROR("Invalid snappy frame");
+			transport.close();
+			return false;
+		}
+
+		if(ulen > max_message_size) {
+			SPDLOG_ERROR("Message too large: {}", ulen);
+			transport.close();
+			return false;
 		}
 
-		if(bytes.size() > 0) {
-			did_recv(transport, std::move(bytes));
+		// Decompressed straight into pooled storage
+		auto message = core::SizeClassPool::default_instance().get(ulen + 1);
+		message.data()[0] = unit.data()[0];
+		if(!snappy::RawUncompress((char *)unit.data() + 1, length - 1, (char *)message.data() + 1)) {
+			SPDLOG_ERROR("Invalid snappy frame");
+			transport.close();
+			return false;
+		}
+
+		SPDLOG_DEBUG("Message: {} bytes: {}", ulen, spdlog::to_hex(message.data(), message.data() + ulen + 1));
+
+		// Set up for the next frame before handing out, the delegate might send or close
+		assembler.expect(32);
+		state = State::RecvHeaderWait;
+
+		if(message.data()[0] == 0x02) { // p2p Ping
+			auto pong = RlpEncoder<>::encode([](auto& e) {
+				e.begin_list();
+				e.end_list();
+			}, 1);
+			pong.data()[0] = 0x03;
+
+			this->send(std::move(pong));
+		} else {
+			delegate->did_recv(*this, std::move(message));
 		}
 	}
+
+	return true;
 }
 
 template<typename DelegateType>
@@ -312,9 +347,7 @@ int RlpxTransport<DelegateType>::send(
 	encoded[4] = (uint8_t)0x80;
 	encoded[5] = (uint8_t)0x80;
 
-	crypto.header_encrypt((uint8_t *)encoded, 32, (uint8_t *)encoded);
-
-	crypto.frame_encrypt((uint8_t *)encoded + 32, length - 32, (uint8_t *)encoded + 32);
+	crypto.message_encrypt((uint8_t *)encoded, length, (uint8_t *)encoded);
 
 	core::Buffer bytes((uint8_t *)encoded, length);
 	return transport.send(std::move(bytes));
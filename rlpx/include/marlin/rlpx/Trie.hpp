@@ -0,0 +1,191 @@
+#ifndef MARLIN_RLPX_TRIE_HPP
+#define MARLIN_RLPX_TRIE_HPP
+
+#include <marlin/rlpx/Rlp.hpp>
+
+#include <cryptopp/keccak.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace marlin {
+namespace rlpx {
+
+/// @brief Root hash of a Merkle Patricia trie built from scratch, for checking block bodies
+///
+/// Nothing is stored, the trie is encoded bottom up from the sorted items and only the root
+/// hash is kept. Values are referenced in place, so they have to outlive the call.
+class TrieRoot {
+public:
+	using Hash = std::array<uint8_t, 32>;
+
+	struct Item {
+		std::vector<uint8_t> key;
+		uint8_t const* value;
+		size_t value_size;
+	};
+
+private:
+	using Bytes = std::vector<uint8_t>;
+
+	struct Node {
+		Bytes nibbles;
+		uint8_t const* value;
+		size_t value_size;
+	};
+
+	static Hash keccak(uint8_t const* data, size_t size) {
+		Hash hash;
+		CryptoPP::Keccak_256 keccak;
+		keccak.Update(data, size);
+		keccak.TruncatedFinal(hash.data(), 32);
+		return hash;
+	}
+
+	// Hex prefix encoding of a path, flagged as leaf or extension
+	template<typename EncoderType>
+	static void add_path(EncoderType& e, uint8_t const* nibbles, size_t size, bool is_leaf) {
+		Bytes path;
+		path.reserve(size / 2 + 1);
+		uint8_t flags = (is_leaf ? 2 : 0) + size % 2;
+		size_t i = 0;
+		if(size % 2 == 1) {
+			path.push_back((flags << 4) | nibbles[i++]);
+		} else {
+			path.push_back(flags << 4);
+		}
+		for(; i < size; i += 2) {
+			path.push_back((nibbles[i] << 4) | nibbles[i + 1]);
+		}
+		e.add_string(path.data(), path.size());
+	}
+
+	// How a parent refers to a node, in place below 32 bytes and by hash otherwise
+	static Bytes reference(core::Buffer const& node) {
+		if(node.size() < 32) {
+			return Bytes(node.data(), node.data() + node.size());
+		}
+
+		auto hash = keccak(node.data(), node.size());
+		Bytes ref(33, 0xa0);
+		std::copy(hash.begin(), hash.end(), ref.begin() + 1);
+		return ref;
+	}
+
+	// Node holding the sorted nodes [begin, end), which share their first depth nibbles
+	static core::Buffer encode(Node const* begin, Node const* end, size_t depth) {
+		if(end - begin == 1) {
+			return RlpEncoder<>::encode([&](auto& e) {
+				e.begin_list();
+				add_path(e, begin->nibbles.data() + depth, begin->nibbles.size() - depth, true);
+				e.add_string(begin->value, begin->value_size);
+				e.end_list();
+			});
+		}
+
+		// A key ending here sorts first and stops any shared path
+		size_t shared = 0;
+		if(begin->nibbles.size() > depth) {
+			auto& first = begin->nibbles;
+			auto& last = (end - 1)->nibbles;
+			auto limit = std::min(first.size(), last.size());
+			while(depth + shared < limit && first[depth + shared] == last[depth + shared]) {
+				shared++;
+			}
+		}
+
+		if(shared > 0) {
+			auto child = reference(encode(begin, end, depth + shared));
+			return RlpEncoder<>::encode([&](auto& e) {
+				e.begin_list();
+				add_path(e, begin->nibbles.data() + depth, shared, false);
+				e.add_raw(child.data(), child.size());
+				e.end_list();
+			});
+		}
+
+		Node const* value = nullptr;
+		if(begin->nibbles.size() == depth) {
+			value = begin++;
+		}
+
+		std::array<Bytes, 16> children;
+		while(begin != end) {
+			auto nibble = begin->nibbles[depth];
+			auto next = begin;
+			while(next != end && next->nibbles[depth] == nibble) {
+				next++;
+			}
+			children[nibble] = reference(encode(begin, next, depth + 1));
+			begin = next;
+		}
+
+		return RlpEncoder<>::encode([&](auto& e) {
+			e.begin_list();
+			for(auto& child : children) {
+				if(child.empty()) {
+					e.add_string(nullptr, 0);
+				} else {
+					e.add_raw(child.data(), child.size());
+				}
+			}
+			if(value != nullptr) {
+				e.add_string(value->value, value->value_size);
+			} else {
+				e.add_string(nullptr, 0);
+			}
+			e.end_list();
+		});
+	}
+
+public:
+	/// Root of the trie holding the given items, keys have to be unique
+	static Hash compute(std::vector<Item> const& items) {
+		if(items.empty()) {
+			uint8_t empty = 0x80;
+			return keccak(&empty, 1);
+		}
+
+		std::vector<Node> nodes;
+		nodes.reserve(items.size());
+		for(auto& item : items) {
+			Bytes nibbles;
+			nibbles.reserve(2 * item.key.size());
+			for(auto byte : item.key) {
+				nibbles.push_back(byte >> 4);
+				nibbles.push_back(byte & 0x0f);
+			}
+			nodes.push_back(Node{std::move(nibbles), item.value, item.value_size});
+		}
+		std::sort(nodes.begin(), nodes.end(), [](Node const& a, Node const& b) {
+			return a.nibbles < b.nibbles;
+		});
+
+		auto root = encode(nodes.data(), nodes.data() + nodes.size(), 0);
+		return keccak(root.data(), root.size());
+	}
+
+	/// Root of the items of a list keyed by their RLP encoded index, e.g. transactionsRoot.
+	/// Strings are stored by their payload, so typed txns go in as type byte and payload.
+	static Hash ordered(RlpView const& list) {
+		std::vector<Item> items;
+		auto reader = list.items();
+		while(auto item = reader.next()) {
+			auto key = RlpEncoder<>::encode([&](auto& e) { e.add_uint(items.size()); });
+			if(item->is_list()) {
+				items.push_back(Item{Bytes(key.data(), key.data() + key.size()), item->data(), item->size()});
+			} else {
+				items.push_back(Item{Bytes(key.data(), key.data() + key.size()), item->payload(), item->payload_size()});
+			}
+		}
+
+		return compute(items);
+	}
+};
+
+} // namespace rlpx
+} // namespace marlin
+
+#endif // MARLIN_RLPX_TRIE_HPP
@@ -0,0 +1,286 @@
+#ifndef MARLIN_RLPX_TXNINGESTER_HPP
+#define MARLIN_RLPX_TXNINGESTER_HPP
+
+#include <marlin/asyncio/core/EventLoop.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
+#include <marlin/compression/BlockCompressor.hpp>
+#include <marlin/core/Buffer.hpp>
+#include <marlin/rlpx/Rlp.hpp>
+
+#include <cryptopp/blake2.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace marlin {
+namespace rlpx {
+
+/// @brief Feeds txns from eth Transactions and PooledTransactions messages into a txn cache
+///
+/// A message is split into its txns by reference, without copying them, and the batch is
+/// hashed in one pass. The cache is shared by all peers so a txn is stored once however many
+/// peers relay it, and is meant for block compression. Txns are evicted TxnTtl after they were
+/// last seen, or BlockTxnTtl after they show up in a block, which leaves time to compress that
+/// block. Past MaxTxns txns or MaxTxnBytes bytes, the txns seen longest ago are evicted first.
+/// Items that are not a legacy or typed txn are dropped.
+///
+/// New txns can also be handed to the delegate for publishing, limited to a byte rate which
+/// is off by default:
+///     void did_ingest_txn(TxnIngester&, uint64_t txn_id, core::Buffer const& txn);
+///
+/// A txn that is at least half of its message is cached by reference and keeps the message
+/// alive, smaller ones are copied out so a cached txn never pins more than twice its size.
+template<typename DelegateType>
+class TxnIngester {
+public:
+	static constexpr uint64_t TxnTtl = 600000;
+	static constexpr uint64_t BlockTxnTtl = 30000;
+	static constexpr uint64_t TimerInterval = 10000;
+	static constexpr size_t MaxTxns = 100000;
+	static constexpr size_t MaxTxnBytes = 128 << 20;
+
+private:
+	using Self = TxnIngester<DelegateType>;
+
+	// Publish budget in bytes, rate is per ms
+	double publish_rate = 0;
+	double publish_burst = 0;
+	double tokens = 0;
+	uint64_t last_refill = 0;
+
+	size_t max_txns = MaxTxns;
+	size_t max_txn_bytes = MaxTxnBytes;
+
+	CryptoPP::BLAKE2b blake2b;
+	// Reused across messages
+	std::vector<core::Buffer> batch;
+	std::vector<uint64_t> batch_ids;
+	// Txns of received blocks along with when to drop them, in that order
+	std::deque<std::pair<uint64_t, uint64_t>> block_txns;
+
+	uint64_t num_seen = 0;
+	uint64_t num_new = 0;
+	uint64_t num_published = 0;
+	uint64_t num_limited = 0;
+	uint64_t num_capped = 0;
+	uint64_t num_invalid = 0;
+
+	asyncio::Timer timer;
+
+	bool allow_publish(size_t size, uint64_t now) {
+		tokens = std::min(publish_burst, tokens + (now - last_refill) * publish_rate);
+		last_refill = now;
+		if(tokens < size) {
+			return false;
+		}
+
+		tokens -= size;
+		return true;
+	}
+
+	// Legacy txns are lists, typed txns a string of the type byte followed by a list
+	static bool is_txn(uint8_t const* data, RlpHeader const& item) {
+		if(item.is_list) {
+			return true;
+		}
+
+		auto payload = data + item.header_size;
+		if(item.payload_size < 2 || payload[0] == 0 || payload[0] >= 0x80) {
+			return false;
+		}
+
+		auto body = rlp_header(payload + 1, item.payload_size - 1);
+		return body.has_value() && body->is_list && body->size() == item.payload_size - 1;
+	}
+
+	// Split a list payload into its txns by reference, dropping items that are not txns
+	void split_items(core::Buffer&& items) {
+		batch.clear();
+		while(items.size() > 0) {
+			auto item = rlp_header(items.data(), items.size());
+			if(!item.has_value()) {
+				SPDLOG_DEBUG("TxnIngester: Malformed txn list");
+				break;
+			}
+
+			bool is_last = item->size() == items.size();
+			if(!is_txn(items.data(), *item)) {
+				num_invalid++;
+				if(is_last) {
+					break;
+				}
+				items.cover_unsafe(item->size());
+				continue;
+			}
+
+			if(is_last) {
+				batch.push_back(std::move(items));
+				break;
+			}
+			batch.push_back(items.split(item->size()));
+		}
+
+		batch_ids.resize(batch.size());
+		for(size_t i = 0; i < batch.size(); i++) {
+			blake2b.Update(batch[i].data(), batch[i].size());
+			blake2b.TruncatedFinal((uint8_t*)&batch_ids[i], 8);
+		}
+	}
+
+	// Cover everything outside the payload of the list at the start of buf
+	static bool cover_list(core::Buffer& buf) {
+		auto list = rlp_header(buf.data(), buf.size());
+		if(!list.has_value() || !list->is_list) {
+			return false;
+		}
+
+		buf.truncate_unsafe(buf.size() - list->size());
+		buf.cover_unsafe(list->header_size);
+		return true;
+	}
+
+	// Drop the txns seen longest ago until the cache is within its caps
+	void evict_over_cap() {
+		while(cache.num_txns() > max_txns || cache.num_bytes() > max_txn_bytes) {
+			cache.evict_oldest();
+			num_capped++;
+		}
+	}
+
+	size_t evict_block_txns(uint64_t now) {
+		size_t num = 0;
+		while(!block_txns.empty() && block_txns.front().first <= now) {
+			if(cache.has_txn(block_txns.front().second)) {
+				cache.remove_txn(block_txns.front().second);
+				num++;
+			}
+			block_txns.pop_front();
+		}
+
+		return num;
+	}
+
+	void timer_cb() {
+		auto now = asyncio::EventLoop::now();
+		auto evicted = cache.evict_txns(now > TxnTtl ? now - TxnTtl : 0);
+		evicted += evict_block_txns(now);
+
+		SPDLOG_INFO(
+			"TxnIngester: {} txns seen, {} new, {} invalid, {} published, {} over limit, {} evicted, {} over cap, {} cached, {} bytes",
+			num_seen,
+			num_new,
+			num_invalid,
+			num_published,
+			num_limited,
+			evicted,
+			num_capped,
+			cache.num_txns(),
+			cache.num_bytes()
+		);
+		num_seen = num_new = num_invalid = num_published = num_limited = num_capped = 0;
+	}
+
+public:
+	compression::BlockCompressor cache;
+	DelegateType* delegate = nullptr;
+
+	TxnIngester() : blake2b((uint)8), timer(this) {
+		timer.template start<Self, &Self::timer_cb>(TimerInterval, TimerInterval);
+	}
+
+	TxnIngester(TxnIngester const&) = delete;
+
+	/// Publish up to rate_per_sec bytes of new txns per second with bursts of up to burst bytes, 0 turns publishing off
+	void set_publish_limit(double rate_per_sec, double burst) {
+		publish_rate = rate_per_sec / 1000;
+		publish_burst = burst;
+		tokens = burst;
+		last_refill = asyncio::EventLoop::now();
+	}
+
+	/// Cap the cache at max_txns txns and max_bytes bytes of txns
+	void set_cache_limit(size_t max_txns, size_t max_bytes) {
+		this->max_txns = max_txns;
+		this->max_txn_bytes = max_bytes;
+		evict_over_cap();
+	}
+
+	/// eth Transactions or PooledTransactions
+	void did_recv_txns(core::Buffer&& message) {
+		auto now = asyncio::EventLoop::now();
+		auto message_size = message.size();
+		bool is_pooled = message.data()[0] == 0x18;
+		message.cover_unsafe(1);
+
+		if(!cover_list(message)) {
+			return;
+		}
+
+		if(is_pooled) {
+			// eth/66 wraps the txns as [request-id, [txn, ...]], a request id is at most 8 bytes
+			// while a lone typed txn is far longer
+			auto id = rlp_header(message.data(), message.size());
+			if(id.has_value() && !id->is_list && id->payload_size <= 8 && id->size() < message.size()) {
+				auto txns = rlp_header(message.data() + id->size(), message.size() - id->size());
+				if(txns.has_value() && txns->is_list && id->size() + txns->size() == message.size()) {
+					message.cover_unsafe(id->size() + txns->header_size);
+				}
+			}
+		}
+
+		split_items(std::move(message));
+
+		for(size_t i = 0; i < batch.size(); i++) {
+			num_seen++;
+			if(!cache.has_txn(batch_ids[i])) {
+				num_new++;
+				if(publish_rate > 0 && delegate != nullptr) {
+					if(allow_publish(batch[i].size(), now)) {
+						num_published++;
+						delegate->did_ingest_txn(*this, batch_ids[i], batch[i]);
+					} else {
+						num_limited++;
+					}
+				}
+
+				if(batch[i].size() * 2 < message_size) {
+					core::Buffer txn(batch[i].size());
+					txn.write_unsafe(0, batch[i].data(), batch[i].size());
+					batch[i] = std::move(txn);
+				}
+			}
+
+			cache.add_txn(batch_ids[i], std::move(batch[i]), now);
+		}
+		batch.clear();
+
+		evict_over_cap();
+	}
+
+	/// Drop the txns of a block from the cache BlockTxnTtl from now, takes the body's list payload as given by BlockFetcher
+	void did_recv_block(core::Buffer const& body) {
+		auto txns = RlpView::parse(body.data(), body.size());
+		if(!txns.has_value() || !txns->is_list()) {
+			return;
+		}
+
+		auto expiry = asyncio::EventLoop::now() + BlockTxnTtl;
+		auto reader = txns->items();
+		while(auto txn = reader.next()) {
+			uint64_t txn_id;
+			blake2b.Update(txn->data(), txn->size());
+			blake2b.TruncatedFinal((uint8_t*)&txn_id, 8);
+			if(cache.has_txn(txn_id)) {
+				block_txns.emplace_back(expiry, txn_id);
+			}
+		}
+	}
+};
+
+} // namespace rlpx
+} // namespace marlin
+
+#endif // MARLIN_RLPX_TXNINGESTER_HPP
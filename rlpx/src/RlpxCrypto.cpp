@@ -391,33 +391,7 @@ void RlpxCrypto::compute_secrets(uint8_t *auth, uint8_t *authplain, size_t auth_
 	keccak256.TruncatedFinal(macs, 32);
 	SPDLOG_DEBUG("MACS: {:spn}", spdlog::to_hex(macs, macs + 32));
 
-	// inititalize enc/dec
-	uint8_t iv[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-	d.SetKeyWithIV(aess, 32, iv, 16);
-	encryption.SetKeyWithIV(aess, 32, iv, 16);
-
-	// egress mac
-	uint8_t temp[32];
-	for(int i = 0; i < 32; i++) {
-		temp[i] = macs[i] ^ authplain[219 + i];
-	}
-	egress_mac.Update(temp, 32);
-	egress_mac.Update(ack, ack_size);
-
-	// ingress mac
-	for(int i = 0; i < 32; i++) {
-		temp[i] = macs[i] ^ nonce[i];
-	}
-	ingress_mac.Update(temp, 32);
-	ingress_mac.Update(auth, auth_size);
-
-	auto temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(digest, 32);
-	SPDLOG_DEBUG("IGD: {:spn}", spdlog::to_hex(digest, digest + 32));
-
-	temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(digest, 32);
-	SPDLOG_DEBUG("EGD: {:spn}", spdlog::to_hex(digest, digest + 32));
+	init_session(authplain + 219, ack, ack_size, nonce, auth, auth_size);
 }
 
 void RlpxCrypto::compute_secrets_old(uint8_t *auth, uint8_t *authplain, size_t auth_size, uint8_t *ack, size_t ack_size) {
@@ -494,61 +468,76 @@ void RlpxCrypto::compute_secrets_old(uint8_t *auth, uint8_t *authplain, size_t a
 	keccak256.TruncatedFinal(macs, 32);
 	SPDLOG_DEBUG("MACS: {:spn}", spdlog::to_hex(macs, macs + 32));
 
+	init_session(authplain + 242, ack, ack_size, nonce, auth, auth_size);
+}
+
+void RlpxCrypto::init_session(uint8_t const *egress_nonce, uint8_t const *ack, size_t ack_size, uint8_t const *ingress_nonce, uint8_t const *auth, size_t auth_size) {
 	// inititalize enc/dec
 	uint8_t iv[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 	d.SetKeyWithIV(aess, 32, iv, 16);
 	encryption.SetKeyWithIV(aess, 32, iv, 16);
 
+	// Key schedule is expanded once here instead of on every frame
+	mac_cipher.SetKey(macs, 32);
+
 	// egress mac
 	uint8_t temp[32];
 	for(int i = 0; i < 32; i++) {
-		temp[i] = macs[i] ^ authplain[242 + i];
+		temp[i] = macs[i] ^ egress_nonce[i];
 	}
+	egress_mac.Restart();
 	egress_mac.Update(temp, 32);
 	egress_mac.Update(ack, ack_size);
 
 	// ingress mac
 	for(int i = 0; i < 32; i++) {
-		temp[i] = macs[i] ^ nonce[i];
+		temp[i] = macs[i] ^ ingress_nonce[i];
 	}
+	ingress_mac.Restart();
 	ingress_mac.Update(temp, 32);
 	ingress_mac.Update(auth, auth_size);
 
-	auto temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(digest, 32);
-	SPDLOG_DEBUG("IGD: {:spn}", spdlog::to_hex(digest, digest + 32));
+	mac_digest(ingress_mac, ingress_digest);
+	SPDLOG_DEBUG("IGD: {:spn}", spdlog::to_hex(ingress_digest, ingress_digest + 16));
 
-	temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(digest, 32);
-	SPDLOG_DEBUG("EGD: {:spn}", spdlog::to_hex(digest, digest + 32));
+	mac_digest(egress_mac, egress_digest);
+	SPDLOG_DEBUG("EGD: {:spn}", spdlog::to_hex(egress_digest, egress_digest + 16));
 }
 
-bool RlpxCrypto::header_decrypt(uint8_t *in, size_t, uint8_t *out) {
-	using namespace CryptoPP;
+void RlpxCrypto::set_secrets(uint8_t const *aes_secret, uint8_t const *mac_secret, uint8_t const *egress_nonce, uint8_t const *ingress_nonce) {
+	std::memcpy(aess, aes_secret, 32);
+	std::memcpy(macs, mac_secret, 32);
 
-	uint8_t digest[16];
-	auto temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
+	init_session(egress_nonce, nullptr, 0, ingress_nonce, nullptr, 0);
+}
 
-	ECB_Mode<AES>::Encryption e;
-	e.SetKey(macs, 32);
-	e.ProcessData(digest, digest, 16);
+void RlpxCrypto::mac_digest(CryptoPP::Keccak_256 const &mac, uint8_t *out) {
+	// Assigning reuses the scratch state's storage, finalizing it leaves mac untouched
+	scratch_mac = mac;
+	scratch_mac.TruncatedFinal(out, 16);
+}
 
-	SPDLOG_DEBUG("AES: {:spn}", spdlog::to_hex(digest, digest + 16));
+void RlpxCrypto::mac_update(CryptoPP::Keccak_256 &mac, uint8_t const *block, uint8_t const *seed, uint8_t *out) {
+	uint8_t temp[16];
+	mac_cipher.ProcessBlock(block, temp);
 
 	for(int i = 0; i < 16; i++) {
-		digest[i] = digest[i] ^ in[i];
+		temp[i] = temp[i] ^ seed[i];
 	}
 
-	SPDLOG_DEBUG("XOR: {:spn}", spdlog::to_hex(digest, digest + 16));
+	mac.Update(temp, 16);
+	mac_digest(mac, out);
+}
+
+// The digest taken after the previous update is exactly what the next header mac needs,
+// so headers only finalize the mac once and frames twice.
 
-	ingress_mac.Update(digest, 16);
-	temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
+bool RlpxCrypto::header_decrypt(uint8_t *in, size_t, uint8_t *out) {
+	mac_update(ingress_mac, ingress_digest, in, ingress_digest);
 
-	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(digest, digest + 16));
+	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(ingress_digest, ingress_digest + 16));
 
-	if(std::memcmp(in + 16, digest, 16) != 0) {
+	if(std::memcmp(in + 16, ingress_digest, 16) != 0) {
 		return false;
 	}
 
@@ -558,65 +547,27 @@ bool RlpxCrypto::header_decrypt(uint8_t *in, size_t, uint8_t *out) {
 }
 
 bool RlpxCrypto::header_encrypt(uint8_t *in, size_t, uint8_t *out) {
-	using namespace CryptoPP;
-
 	encryption.ProcessData(out, in, 16);
 
-	uint8_t digest[16];
-	auto temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
-
-	ECB_Mode<AES>::Encryption e;
-	e.SetKey(macs, 32);
-	e.ProcessData(digest, digest, 16);
-
-	SPDLOG_DEBUG("AES: {:spn}", spdlog::to_hex(digest, digest + 16));
-
-	for(int i = 0; i < 16; i++) {
-		digest[i] = digest[i] ^ out[i];
-	}
+	mac_update(egress_mac, egress_digest, out, egress_digest);
 
-	SPDLOG_DEBUG("XOR: {:spn}", spdlog::to_hex(digest, digest + 16));
+	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(egress_digest, egress_digest + 16));
 
-	egress_mac.Update(digest, 16);
-	temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
-
-	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(digest, digest + 16));
-
-	std::memcpy(out + 16, digest, 16);
+	std::memcpy(out + 16, egress_digest, 16);
 
 	return true;
 }
 
 bool RlpxCrypto::frame_decrypt(uint8_t *in, size_t in_size, uint8_t *out) {
-	using namespace CryptoPP;
-
 	uint8_t temp[16];
-	uint8_t digest[16];
 	ingress_mac.Update(in, in_size - 16);
-	auto temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(temp, 16);
+	mac_digest(ingress_mac, temp);
 
-	ECB_Mode<AES>::Encryption e;
-	e.SetKey(macs, 32);
-	e.ProcessData(digest, temp, 16);
+	mac_update(ingress_mac, temp, temp, ingress_digest);
 
-	SPDLOG_DEBUG("AES: {:spn}", spdlog::to_hex(digest, digest + 16));
-
-	for(int i = 0; i < 16; i++) {
-		digest[i] = digest[i] ^ temp[i];
-	}
+	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(ingress_digest, ingress_digest + 16));
 
-	SPDLOG_DEBUG("XOR: {:spn}", spdlog::to_hex(digest, digest + 16));
-
-	ingress_mac.Update(digest, 16);
-	temp_mac = ingress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
-
-	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(digest, digest + 16));
-
-	if(std::memcmp(in + in_size - 16, digest, 16) != 0) {
+	if(std::memcmp(in + in_size - 16, ingress_digest, 16) != 0) {
 		return false;
 	}
 
@@ -626,35 +577,41 @@ bool RlpxCrypto::frame_decrypt(uint8_t *in, size_t in_size, uint8_t *out) {
 }
 
 bool RlpxCrypto::frame_encrypt(uint8_t *in, size_t in_size, uint8_t *out) {
-	using namespace CryptoPP;
-
 	encryption.ProcessData(out, in, in_size - 16);
 
 	uint8_t temp[16];
-	uint8_t digest[16];
 	egress_mac.Update(out, in_size - 16);
-	auto temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(temp, 16);
+	mac_digest(egress_mac, temp);
 
-	ECB_Mode<AES>::Encryption e;
-	e.SetKey(macs, 32);
-	e.ProcessData(digest, temp, 16);
+	mac_update(egress_mac, temp, temp, egress_digest);
 
-	SPDLOG_DEBUG("AES: {:spn}", spdlog::to_hex(digest, digest + 16));
+	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(egress_digest, egress_digest + 16));
 
-	for(int i = 0; i < 16; i++) {
-		digest[i] = digest[i] ^ temp[i];
-	}
+	std::memcpy(out + in_size - 16, egress_digest, 16);
 
-	SPDLOG_DEBUG("XOR: {:spn}", spdlog::to_hex(digest, digest + 16));
+	return true;
+}
 
-	egress_mac.Update(digest, 16);
-	temp_mac = egress_mac;
-	temp_mac.TruncatedFinal(digest, 16);
+bool RlpxCrypto::message_encrypt(uint8_t *in, size_t in_size, uint8_t *out) {
+	// in:
+	// 0	16	header
+	// 16	16	header mac
+	// 32	X	frame
+	// 32+X	16	frame mac
 
-	SPDLOG_DEBUG("MAC: {:spn}", spdlog::to_hex(digest, digest + 16));
+	// Header and frame follow each other in the keystream, the header mac slot is skipped
+	encryption.ProcessData(out, in, 16);
+	encryption.ProcessData(out + 32, in + 32, in_size - 48);
+
+	mac_update(egress_mac, egress_digest, out, egress_digest);
+	std::memcpy(out + 16, egress_digest, 16);
+
+	uint8_t temp[16];
+	egress_mac.Update(out + 32, in_size - 48);
+	mac_digest(egress_mac, temp);
 
-	std::memcpy(out + in_size - 16, digest, 16);
+	mac_update(egress_mac, temp, temp, egress_digest);
+	std::memcpy(out + in_size - 16, egress_digest, 16);
 
 	return true;
 }
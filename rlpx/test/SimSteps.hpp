@@ -0,0 +1,25 @@
+#ifndef MARLIN_RLPX_TEST_SIMSTEPS_HPP
+#define MARLIN_RLPX_TEST_SIMSTEPS_HPP
+
+#include "marlin/simulator/core/Simulator.hpp"
+
+#include <functional>
+
+// Runs a callback at a simulated tick
+struct StepEvent : public marlin::simulator::Event<marlin::simulator::Simulator> {
+	std::function<void()> step;
+
+	StepEvent(uint64_t tick, std::function<void()>&& step) : Event(tick), step(std::move(step)) {}
+
+	void run(marlin::simulator::Simulator&) override {
+		step();
+	}
+};
+
+// Steps have to be scheduled in order and before anything else that starts a timer,
+// the simulator cannot add an event ahead of its next one
+inline void at(uint64_t tick, std::function<void()>&& step) {
+	marlin::simulator::Simulator::default_instance.add_event(new StepEvent(tick, std::move(step)));
+}
+
+#endif // MARLIN_RLPX_TEST_SIMSTEPS_HPP
@@ -0,0 +1,513 @@
+#define MARLIN_ASYNCIO_SIMULATOR
+
+#include "gtest/gtest.h"
+#include "marlin/core/SocketAddress.hpp"
+#include "marlin/rlpx/BlockFetcher.hpp"
+#include "marlin/rlpx/Trie.hpp"
+#include "SimSteps.hpp"
+
+#include <optional>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::rlpx;
+using marlin::simulator::Simulator;
+
+using Hash = std::array<uint8_t, 32>;
+using Bytes = std::vector<uint8_t>;
+
+// Records every message instead of sending it
+struct FakeTransport {
+	SocketAddress src_addr = SocketAddress::from_string("127.0.0.1:30303");
+	SocketAddress dst_addr = SocketAddress::from_string("127.0.0.1:30304");
+
+	std::vector<Buffer> sent;
+
+	void send(Buffer&& message) {
+		sent.push_back(std::move(message));
+	}
+};
+
+struct Delegate;
+using FetcherType = BlockFetcher<Delegate, FakeTransport>;
+
+struct Delegate {
+	std::vector<std::pair<Bytes, Bytes>> blocks;
+
+	void did_fetch_block(FetcherType&, Buffer&& header, Buffer&& body) {
+		blocks.emplace_back(
+			Bytes(header.data(), header.data() + header.size()),
+			Bytes(body.data(), body.data() + body.size())
+		);
+	}
+};
+
+// Sent request, decoded
+struct Request {
+	uint8_t type;
+	uint64_t id;
+	std::vector<Hash> hashes;
+};
+
+static Request decode(Buffer const& message, bool has_request_ids = true) {
+	Request request{message.data()[0], 0, {}};
+
+	auto outer = RlpView::parse(message.data() + 1, message.size() - 1);
+	auto query = outer;
+	if(has_request_ids) {
+		auto items = outer->items();
+		request.id = *items.next(false)->as_uint();
+		query = items.next(true);
+	}
+
+	auto items = query->items();
+	while(auto item = items.next()) {
+		// Header queries carry amount, skip and reverse after the hash
+		if(item->is_list() || item->payload_size() != 32) {
+			break;
+		}
+		Hash hash;
+		std::memcpy(hash.data(), item->payload(), 32);
+		request.hashes.push_back(hash);
+	}
+
+	return request;
+}
+
+struct Block {
+	Bytes header;
+	Bytes body;
+	Hash hash;
+
+	explicit Block(uint64_t number) {
+		// [[tx], []]
+		Bytes tx(10, (uint8_t)number);
+		auto body_buf = RlpEncoder<>::encode([&](auto& e) {
+			e.begin_list();
+			e.begin_list();
+			e.add_string(tx.data(), tx.size());
+			e.end_list();
+			e.begin_list();
+			e.end_list();
+			e.end_list();
+		});
+		body.assign(body_buf.data(), body_buf.data() + body_buf.size());
+
+		auto lists = RlpView::parse(body.data(), body.size())->items();
+		auto txns_root = TrieRoot::ordered(*lists.next(true));
+		auto uncles = lists.next(true);
+		Hash uncles_hash;
+		CryptoPP::Keccak_256 keccak;
+		keccak.Update(uncles->data(), uncles->size());
+		keccak.TruncatedFinal(uncles_hash.data(), 32);
+
+		// [parentHash, uncleHash, coinbase, stateRoot, txRoot, number]
+		Bytes zeros(32, 0);
+		auto header_buf = RlpEncoder<>::encode([&](auto& e) {
+			e.begin_list();
+			e.add_string(zeros.data(), 32);
+			e.add_string(uncles_hash.data(), 32);
+			e.add_string(zeros.data(), 20);
+			e.add_string(zeros.data(), 32);
+			e.add_string(txns_root.data(), 32);
+			e.add_uint(number);
+			e.end_list();
+		});
+		header.assign(header_buf.data(), header_buf.data() + header_buf.size());
+
+		keccak.Update(header.data(), header.size());
+		keccak.TruncatedFinal(hash.data(), 32);
+	}
+
+	// What the delegate gets, the body's list payload
+	Bytes body_payload() const {
+		auto view = RlpView::parse(body.data(), body.size());
+		return Bytes(view->payload(), view->payload() + view->payload_size());
+	}
+};
+
+static Buffer status(uint64_t version) {
+	auto message = RlpEncoder<>::encode([&](auto& e) {
+		e.begin_list();
+		e.add_uint(version);
+		e.add_uint(1);
+		e.end_list();
+	}, 1);
+	message.data()[0] = 0x10;
+	return message;
+}
+
+static Buffer announcement(std::vector<Hash> const& hashes) {
+	// A list per hash
+	auto message = RlpEncoder<FetcherType::MaxFetchesPerPeer + 16>::encode([&](auto& e) {
+		e.begin_list();
+		for(size_t i = 0; i < hashes.size(); i++) {
+			e.begin_list();
+			e.add_string(hashes[i].data(), 32);
+			e.add_uint(i + 1);
+			e.end_list();
+		}
+		e.end_list();
+	}, 1);
+	message.data()[0] = 0x11;
+	return message;
+}
+
+// [id, [item, ...]], or [item, ...] without request id
+static Buffer response(uint8_t type, std::optional<uint64_t> id, std::vector<Bytes const*> const& items) {
+	auto message = RlpEncoder<>::encode([&](auto& e) {
+		if(id.has_value()) {
+			e.begin_list();
+			e.add_uint(*id);
+		}
+		e.begin_list();
+		for(auto* item : items) {
+			e.add_raw(item->data(), item->size());
+		}
+		e.end_list();
+		if(id.has_value()) {
+			e.end_list();
+		}
+	}, 1);
+	message.data()[0] = type;
+	return message;
+}
+
+// The fetcher is created in the first step at tick 0, the test schedules the rest
+class BlockFetcherTest : public ::testing::Test {
+protected:
+	Delegate delegate;
+	std::optional<FetcherType> fetcher;
+
+	void SetUp() override {
+		at(0, [this]() {
+			fetcher.emplace();
+			fetcher->delegate = &delegate;
+		});
+	}
+
+	// Stops the fetcher timer at tick so the simulation drains
+	void run_until(uint64_t tick) {
+		at(tick, [this]() { fetcher.reset(); });
+		Simulator::default_instance.run();
+	}
+
+	void connect(FakeTransport& transport, uint64_t version = 66) {
+		fetcher->add_peer(transport);
+		fetcher->did_recv_status(transport, status(version));
+	}
+
+	std::vector<Request> requests(FakeTransport& transport, uint8_t type, bool has_request_ids = true) {
+		std::vector<Request> out;
+		for(auto& message : transport.sent) {
+			auto request = decode(message, has_request_ids);
+			if(request.type == type) {
+				out.push_back(std::move(request));
+			}
+		}
+		return out;
+	}
+};
+
+TEST_F(BlockFetcherTest, MatchesResponsesByRequestId) {
+	Block b1(1), b2(2);
+	FakeTransport peer;
+	std::vector<Request> headers, bodies;
+
+	at(10, [&]() {
+		connect(peer);
+		fetcher->did_recv_announcement(peer, announcement({b1.hash, b2.hash}));
+
+		headers = requests(peer, 0x13);
+		bodies = requests(peer, 0x15);
+	});
+	at(20, [&]() {
+		// Out of order, with a stray id mixed in
+		fetcher->did_recv_headers(peer, response(0x14, 999, {&b1.header}));
+		fetcher->did_recv_headers(peer, response(0x14, headers[1].id, {&b2.header}));
+		fetcher->did_recv_headers(peer, response(0x14, headers[0].id, {&b1.header}));
+		fetcher->did_recv_bodies(peer, response(0x16, bodies[0].id, {&b1.body, &b2.body}));
+	});
+	run_until(100);
+
+	ASSERT_EQ(headers.size(), 2u);
+	ASSERT_EQ(bodies.size(), 1u);
+	EXPECT_EQ(headers[0].hashes, std::vector<Hash>{b1.hash});
+	EXPECT_EQ(headers[1].hashes, std::vector<Hash>{b2.hash});
+	EXPECT_EQ(bodies[0].hashes, (std::vector<Hash>{b1.hash, b2.hash}));
+	EXPECT_EQ(peer.sent.size(), 3u);
+
+	ASSERT_EQ(delegate.blocks.size(), 2u);
+	EXPECT_EQ(delegate.blocks[0].first, b1.header);
+	EXPECT_EQ(delegate.blocks[0].second, b1.body_payload());
+	EXPECT_EQ(delegate.blocks[1].first, b2.header);
+	EXPECT_EQ(delegate.blocks[1].second, b2.body_payload());
+}
+
+TEST_F(BlockFetcherTest, MatchesPeersWithoutRequestIdsInSendOrder) {
+	Block b1(1), b2(2);
+	FakeTransport peer;
+
+	at(10, [&]() {
+		connect(peer, 65);
+		fetcher->did_recv_announcement(peer, announcement({b1.hash, b2.hash}));
+	});
+	at(20, [&]() {
+		fetcher->did_recv_headers(peer, response(0x14, std::nullopt, {&b1.header}));
+		fetcher->did_recv_headers(peer, response(0x14, std::nullopt, {&b2.header}));
+		fetcher->did_recv_bodies(peer, response(0x16, std::nullopt, {&b1.body, &b2.body}));
+	});
+	run_until(100);
+
+	EXPECT_EQ(requests(peer, 0x13, false).size(), 2u);
+	ASSERT_EQ(delegate.blocks.size(), 2u);
+	EXPECT_EQ(delegate.blocks[0].first, b1.header);
+	EXPECT_EQ(delegate.blocks[1].first, b2.header);
+}
+
+TEST_F(BlockFetcherTest, RetriesOnAnotherPeerAfterTimeout) {
+	Block b1(1);
+	FakeTransport slow, fast;
+	size_t fast_sent_before_timeout = 0;
+
+	at(10, [&]() {
+		connect(slow);
+		connect(fast);
+		fetcher->did_recv_announcement(slow, announcement({b1.hash}));
+		fetcher->did_recv_announcement(fast, announcement({b1.hash}));
+	});
+	at(10 + FetcherType::RequestTimeout - 10, [&]() {
+		fast_sent_before_timeout = fast.sent.size();
+	});
+	at(10 + FetcherType::RequestTimeout + FetcherType::TimerInterval, [&]() {
+		auto headers = requests(fast, 0x13);
+		auto bodies = requests(fast, 0x15);
+		ASSERT_EQ(headers.size(), 1u);
+		ASSERT_EQ(bodies.size(), 1u);
+		fetcher->did_recv_headers(fast, response(0x14, headers[0].id, {&b1.header}));
+		fetcher->did_recv_bodies(fast, response(0x16, bodies[0].id, {&b1.body}));
+	});
+	run_until(5000);
+
+	EXPECT_EQ(slow.sent.size(), 2u);
+	EXPECT_EQ(fast_sent_before_timeout, 0u);
+	ASSERT_EQ(delegate.blocks.size(), 1u);
+	EXPECT_EQ(delegate.blocks[0].first, b1.header);
+}
+
+TEST_F(BlockFetcherTest, GivesUpAfterMaxAttempts) {
+	Block b1(1);
+	FakeTransport p1, p2;
+	size_t in_flight_before = 0, in_flight_after = 0;
+
+	at(10, [&]() {
+		connect(p1);
+		connect(p2);
+		fetcher->did_recv_announcement(p1, announcement({b1.hash}));
+		fetcher->did_recv_announcement(p2, announcement({b1.hash}));
+		in_flight_before = fetcher->in_flight();
+	});
+	at(20000, [&]() {
+		in_flight_after = fetcher->in_flight();
+
+		// Late answers once the fetch is gone go nowhere
+		auto headers = requests(p1, 0x13);
+		auto bodies = requests(p1, 0x15);
+		fetcher->did_recv_headers(p1, response(0x14, headers[0].id, {&b1.header}));
+		fetcher->did_recv_bodies(p1, response(0x16, bodies[0].id, {&b1.body}));
+	});
+	run_until(25000);
+
+	EXPECT_EQ(in_flight_before, 1u);
+	EXPECT_EQ(in_flight_after, 0u);
+	EXPECT_TRUE(delegate.blocks.empty());
+	// Header and body requests each count as an attempt
+	auto attempts = requests(p1, 0x13).size() + requests(p1, 0x15).size()
+		+ requests(p2, 0x13).size() + requests(p2, 0x15).size();
+	EXPECT_GE(attempts, 2u);
+	EXPECT_LE(attempts, FetcherType::MaxAttempts + 1);
+}
+
+TEST_F(BlockFetcherTest, SplitsPartialBodies) {
+	Block b1(1), b2(2), b3(3);
+	FakeTransport peer;
+	size_t fetched_after_partial = 0;
+	std::vector<Request> refetches;
+
+	at(10, [&]() {
+		connect(peer);
+		fetcher->did_recv_announcement(peer, announcement({b1.hash, b2.hash, b3.hash}));
+	});
+	at(20, [&]() {
+		auto headers = requests(peer, 0x13);
+		for(size_t i = 0; i < headers.size(); i++) {
+			Bytes const* header = i == 0 ? &b1.header : i == 1 ? &b2.header : &b3.header;
+			fetcher->did_recv_headers(peer, response(0x14, headers[i].id, {header}));
+		}
+
+		auto bodies = requests(peer, 0x15);
+		fetcher->did_recv_bodies(peer, response(0x16, bodies[0].id, {&b1.body, &b2.body}));
+		fetched_after_partial = delegate.blocks.size();
+
+		refetches = requests(peer, 0x15);
+	});
+	at(30, [&]() {
+		fetcher->did_recv_bodies(peer, response(0x16, refetches.back().id, {&b3.body}));
+	});
+	run_until(100);
+
+	EXPECT_EQ(fetched_after_partial, 2u);
+	ASSERT_EQ(refetches.size(), 2u);
+	EXPECT_EQ(refetches.back().hashes, std::vector<Hash>{b3.hash});
+
+	ASSERT_EQ(delegate.blocks.size(), 3u);
+	EXPECT_EQ(delegate.blocks[0].second, b1.body_payload());
+	EXPECT_EQ(delegate.blocks[1].second, b2.body_payload());
+	EXPECT_EQ(delegate.blocks[2].first, b3.header);
+	EXPECT_EQ(delegate.blocks[2].second, b3.body_payload());
+}
+
+TEST_F(BlockFetcherTest, IgnoresLateResponseAfterFailover) {
+	Block b1(1);
+	FakeTransport slow, fast;
+	size_t fetched_after_late = 0;
+
+	at(10, [&]() {
+		connect(slow);
+		connect(fast);
+		fetcher->did_recv_announcement(slow, announcement({b1.hash}));
+		fetcher->did_recv_announcement(fast, announcement({b1.hash}));
+	});
+	at(3000, [&]() {
+		// Slow peer answers after its requests moved on, the answer is dropped
+		auto slow_headers = requests(slow, 0x13);
+		fetcher->did_recv_headers(slow, response(0x14, slow_headers[0].id, {&b1.header}));
+		fetched_after_late = delegate.blocks.size();
+
+		auto headers = requests(fast, 0x13);
+		auto bodies = requests(fast, 0x15);
+		fetcher->did_recv_headers(fast, response(0x14, headers[0].id, {&b1.header}));
+		fetcher->did_recv_bodies(fast, response(0x16, bodies[0].id, {&b1.body}));
+	});
+	at(3010, [&]() {
+		// Duplicate of a completed block
+		auto bodies = requests(slow, 0x15);
+		fetcher->did_recv_bodies(slow, response(0x16, bodies[0].id, {&b1.body}));
+		fetcher->did_recv_announcement(slow, announcement({b1.hash}));
+	});
+	run_until(5000);
+
+	EXPECT_EQ(fetched_after_late, 0u);
+	EXPECT_EQ(delegate.blocks.size(), 1u);
+	// Completed hashes are not fetched again
+	EXPECT_EQ(requests(slow, 0x13).size(), 1u);
+}
+
+TEST_F(BlockFetcherTest, CapsFetchesPerPeer) {
+	FakeTransport p1, p2;
+	std::vector<Hash> hashes(FetcherType::MaxFetchesPerPeer + 10);
+	for(size_t i = 0; i < hashes.size(); i++) {
+		hashes[i].fill(0);
+		std::memcpy(hashes[i].data(), &i, sizeof(i));
+	}
+	size_t capped = 0, shared = 0;
+
+	at(10, [&]() {
+		connect(p1);
+		connect(p2);
+		fetcher->did_recv_announcement(p1, announcement(hashes));
+		capped = fetcher->in_flight();
+
+		// Hashes over the cap are p2's to start
+		fetcher->did_recv_announcement(p2, announcement(hashes));
+		shared = fetcher->in_flight();
+	});
+	run_until(100);
+
+	EXPECT_EQ(capped, FetcherType::MaxFetchesPerPeer);
+	EXPECT_EQ(shared, hashes.size());
+	EXPECT_EQ(requests(p1, 0x13).size(), FetcherType::MaxFetchesPerPeer);
+}
+
+TEST_F(BlockFetcherTest, CapsFetchesInTotal) {
+	constexpr size_t num_peers = FetcherType::MaxFetches / FetcherType::MaxFetchesPerPeer + 1;
+	std::vector<FakeTransport> peers(num_peers);
+	size_t in_flight = 0;
+
+	at(10, [&]() {
+		uint64_t seq = 0;
+		for(auto& peer : peers) {
+			connect(peer);
+			std::vector<Hash> hashes(FetcherType::MaxFetchesPerPeer);
+			for(auto& hash : hashes) {
+				hash.fill(0xff);
+				seq++;
+				std::memcpy(hash.data(), &seq, sizeof(seq));
+			}
+			fetcher->did_recv_announcement(peer, announcement(hashes));
+		}
+		in_flight = fetcher->in_flight();
+	});
+	run_until(100);
+
+	EXPECT_EQ(in_flight, FetcherType::MaxFetches);
+	EXPECT_TRUE(peers.back().sent.empty());
+}
+
+TEST_F(BlockFetcherTest, RefetchesBodyNotMatchingHeader) {
+	Block b1(1), b2(2);
+	FakeTransport bad, good;
+	size_t fetched_after_bad = 0;
+	std::vector<Request> good_bodies;
+
+	at(10, [&]() {
+		connect(bad);
+		connect(good);
+		fetcher->did_recv_announcement(bad, announcement({b1.hash}));
+		fetcher->did_recv_announcement(good, announcement({b1.hash}));
+	});
+	at(20, [&]() {
+		auto headers = requests(bad, 0x13);
+		auto bodies = requests(bad, 0x15);
+		fetcher->did_recv_headers(bad, response(0x14, headers[0].id, {&b1.header}));
+		// Body of another block
+		fetcher->did_recv_bodies(bad, response(0x16, bodies[0].id, {&b2.body}));
+		fetched_after_bad = delegate.blocks.size();
+
+		good_bodies = requests(good, 0x15);
+		ASSERT_EQ(good_bodies.size(), 1u);
+		fetcher->did_recv_bodies(good, response(0x16, good_bodies[0].id, {&b1.body}));
+	});
+	run_until(100);
+
+	EXPECT_EQ(fetched_after_bad, 0u);
+	EXPECT_EQ(good_bodies[0].hashes, std::vector<Hash>{b1.hash});
+	EXPECT_TRUE(requests(good, 0x13).empty());
+	ASSERT_EQ(delegate.blocks.size(), 1u);
+	EXPECT_EQ(delegate.blocks[0].first, b1.header);
+	EXPECT_EQ(delegate.blocks[0].second, b1.body_payload());
+}
+
+TEST_F(BlockFetcherTest, ForgetsTimedOutRequestsWithoutRequestIds) {
+	Block b1(1);
+	FakeTransport peer;
+	size_t pending_after_timeout = 0, pending_later = 0, in_flight_later = 0;
+
+	at(10, [&]() {
+		connect(peer, 65);
+		fetcher->did_recv_announcement(peer, announcement({b1.hash}));
+	});
+	at(10 + 3 * FetcherType::RequestTimeout, [&]() {
+		// Timed out and retried, the expired requests stay for late responses to line up
+		pending_after_timeout = fetcher->pending(peer);
+	});
+	at(10 + 3 * FetcherType::RequestTimeout + FetcherType::ExpiredTtl + FetcherType::TimerInterval, [&]() {
+		pending_later = fetcher->pending(peer);
+		in_flight_later = fetcher->in_flight();
+	});
+	run_until(10 + 3 * FetcherType::RequestTimeout + FetcherType::ExpiredTtl + 2 * FetcherType::TimerInterval);
+
+	EXPECT_GT(pending_after_timeout, 2u);
+	EXPECT_EQ(pending_later, 0u);
+	EXPECT_EQ(in_flight_later, 0u);
+}
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "marlin/rlpx/EthResponses.hpp"
+
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::rlpx;
+
+using Bytes = std::vector<uint8_t>;
+
+static Bytes bytes(Buffer const& buf) {
+	return Bytes(buf.data(), buf.data() + buf.size());
+}
+
+TEST(EthResponses, EchoesRequestId) {
+	// GetBlockHeaders [0x0457, [block, 1, 0, 0]]
+	Buffer request({0x13, 0xc8, 0x82, 0x04, 0x57, 0xc4, 0x0a, 0x01, 0x80, 0x80}, 10);
+
+	auto response = eth_empty_response(request, 0x14, true);
+	ASSERT_TRUE(response.has_value());
+	EXPECT_EQ(bytes(*response), (Bytes{0x14, 0xc4, 0x82, 0x04, 0x57, 0xc0}));
+}
+
+TEST(EthResponses, EncodesSingleByteIdsAboveStringPrefix) {
+	// Id 0x90 needs a string prefix of its own, the query a long list
+	Buffer request(1 + 2 + 2 + 56);
+	request.data()[0] = 0x15;
+	request.data()[1] = 0xf8;
+	request.data()[2] = 2 + 56;
+	request.data()[3] = 0x81;
+	request.data()[4] = 0x90;
+	request.data()[5] = 0xf7;
+	request.data()[6] = 0xb6;
+	for(size_t i = 7; i < request.size(); i++) {
+		request.data()[i] = 0xaa;
+	}
+
+	auto response = eth_empty_response(request, 0x16, true);
+	ASSERT_TRUE(response.has_value());
+	EXPECT_EQ(bytes(*response), (Bytes{0x16, 0xc3, 0x81, 0x90, 0xc0}));
+}
+
+TEST(EthResponses, BareBeforeEth66) {
+	Buffer request({0x1d, 0xc0}, 2);
+
+	auto response = eth_empty_response(request, 0x1e, false);
+	ASSERT_TRUE(response.has_value());
+	EXPECT_EQ(bytes(*response), (Bytes{0x1e, 0xc0}));
+}
+
+TEST(EthResponses, RejectsRequestWithoutId) {
+	Buffer bare({0x13, 0xc0}, 2);
+	EXPECT_FALSE(eth_empty_response(bare, 0x14, true).has_value());
+
+	Buffer truncated({0x13, 0xc8, 0x82, 0x04}, 4);
+	EXPECT_FALSE(eth_empty_response(truncated, 0x14, true).has_value());
+
+	Buffer string_id({0x13, 0xc3, 0xc1, 0x01, 0xc0}, 5);
+	EXPECT_FALSE(eth_empty_response(string_id, 0x14, true).has_value());
+}
@@ -0,0 +1,276 @@
+#include "gtest/gtest.h"
+#include "marlin/rlpx/Rlp.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace marlin::rlpx;
+
+using Bytes = std::vector<uint8_t>;
+
+template<typename F>
+static Bytes encode(F&& build) {
+	auto buf = RlpEncoder<>::encode(std::forward<F>(build));
+	return Bytes(buf.data(), buf.data() + buf.size());
+}
+
+static Bytes str(std::string const& s) {
+	return Bytes(s.begin(), s.end());
+}
+
+static Bytes concat(Bytes a, Bytes const& b) {
+	a.insert(a.end(), b.begin(), b.end());
+	return a;
+}
+
+// Examples from the RLP spec
+TEST(Rlp, EncodesSpecExamples) {
+	auto dog = str("dog");
+	auto cat = str("cat");
+	auto lorem = str("Lorem ipsum dolor sit amet, consectetur adipisicing elit");
+
+	EXPECT_EQ(encode([&](auto& e) { e.add_string(dog.data(), dog.size()); }), (Bytes{0x83, 'd', 'o', 'g'}));
+	EXPECT_EQ(encode([&](auto& e) {
+		e.begin_list();
+		e.add_string(cat.data(), cat.size());
+		e.add_string(dog.data(), dog.size());
+		e.end_list();
+	}), (Bytes{0xc8, 0x83, 'c', 'a', 't', 0x83, 'd', 'o', 'g'}));
+	EXPECT_EQ(encode([&](auto& e) { e.add_string(nullptr, 0); }), (Bytes{0x80}));
+	EXPECT_EQ(encode([&](auto& e) { e.begin_list(); e.end_list(); }), (Bytes{0xc0}));
+	EXPECT_EQ(encode([&](auto& e) { e.add_uint(0); }), (Bytes{0x80}));
+	EXPECT_EQ(encode([&](auto& e) { e.add_uint(15); }), (Bytes{0x0f}));
+	EXPECT_EQ(encode([&](auto& e) { e.add_uint(1024); }), (Bytes{0x82, 0x04, 0x00}));
+	EXPECT_EQ(encode([&](auto& e) { e.add_string(lorem.data(), lorem.size()); }), concat({0xb8, 0x38}, lorem));
+
+	// [ [], [[]], [ [], [[]] ] ]
+	EXPECT_EQ(encode([&](auto& e) {
+		e.begin_list();
+		e.begin_list(); e.end_list();
+		e.begin_list(); e.begin_list(); e.end_list(); e.end_list();
+		e.begin_list();
+		e.begin_list(); e.end_list();
+		e.begin_list(); e.begin_list(); e.end_list(); e.end_list();
+		e.end_list();
+		e.end_list();
+	}), (Bytes{0xc7, 0xc0, 0xc1, 0xc0, 0xc3, 0xc0, 0xc1, 0xc0}));
+}
+
+TEST(Rlp, RoundTripsStringsUintsAndLists) {
+	std::vector<Bytes> strings = {
+		{}, {0x00}, {0x7f}, {0x80}, {0xff}, Bytes(55, 1), Bytes(56, 2), Bytes(255, 3), Bytes(256, 4), Bytes(70000, 5)
+	};
+	std::vector<uint64_t> uints = {0, 1, 0x7f, 0x80, 0xff, 0x100, 0xffff, 1ull << 32, ~0ull};
+
+	// [[strings...], [uints...], [[strings...]]], big enough for long list prefixes
+	auto encoded = encode([&](auto& e) {
+		e.begin_list();
+		e.begin_list();
+		for(auto& s : strings) {
+			e.add_string(s.data(), s.size());
+		}
+		e.end_list();
+		e.begin_list();
+		for(auto u : uints) {
+			e.add_uint(u);
+		}
+		e.end_list();
+		e.begin_list();
+		e.begin_list();
+		for(auto& s : strings) {
+			e.add_string(s.data(), s.size());
+		}
+		e.end_list();
+		e.end_list();
+		e.end_list();
+	});
+
+	auto outer = RlpView::parse(encoded.data(), encoded.size());
+	ASSERT_TRUE(outer.has_value());
+	ASSERT_TRUE(outer->is_list());
+	EXPECT_EQ(outer->size(), encoded.size());
+
+	auto check_strings = [&](RlpView const& list) {
+		auto items = list.items();
+		for(auto& s : strings) {
+			auto item = items.next(false);
+			ASSERT_TRUE(item.has_value());
+			EXPECT_EQ(Bytes(item->payload(), item->payload() + item->payload_size()), s);
+		}
+		EXPECT_TRUE(items.done());
+		EXPECT_FALSE(items.is_malformed());
+	};
+
+	auto items = outer->items();
+	auto string_list = items.next(true);
+	ASSERT_TRUE(string_list.has_value());
+	check_strings(*string_list);
+
+	auto uint_list = items.next(true);
+	ASSERT_TRUE(uint_list.has_value());
+	auto uint_items = uint_list->items();
+	for(auto u : uints) {
+		auto item = uint_items.next(false);
+		ASSERT_TRUE(item.has_value());
+		EXPECT_EQ(item->as_uint(), u);
+	}
+	EXPECT_TRUE(uint_items.done());
+
+	auto nested = items.next(true);
+	ASSERT_TRUE(nested.has_value());
+	auto nested_items = nested->items();
+	auto inner = nested_items.next(true);
+	ASSERT_TRUE(inner.has_value());
+	check_strings(*inner);
+
+	EXPECT_TRUE(items.done());
+	EXPECT_FALSE(items.is_malformed());
+}
+
+TEST(Rlp, LeavesHeadroom) {
+	auto buf = RlpEncoder<>::encode([&](auto& e) { e.add_uint(1024); }, 3);
+	ASSERT_EQ(buf.size(), 6u);
+	EXPECT_EQ(Bytes(buf.data() + 3, buf.data() + 6), (Bytes{0x82, 0x04, 0x00}));
+}
+
+TEST(Rlp, RejectsTruncatedHeaders) {
+	std::vector<Bytes> truncated = {
+		{},
+		// Long string without its length
+		{0xb8},
+		// Two byte length, one present
+		{0xb9, 0x01},
+		// Eight byte length, seven present
+		{0xbf, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+		// Long list without its length
+		{0xf8},
+		{0xf9, 0x01},
+		// Short string and list with missing payload
+		{0x83, 'd', 'o'},
+		{0xc2, 0x80},
+	};
+	for(auto& data : truncated) {
+		EXPECT_FALSE(rlp_header(data.data(), data.size()).has_value()) << "size " << data.size();
+	}
+
+	// Payload shorter than the long length
+	auto data = concat({0xb8, 0x38}, Bytes(55, 0));
+	EXPECT_FALSE(rlp_header(data.data(), data.size()).has_value());
+	data.push_back(0);
+	EXPECT_TRUE(rlp_header(data.data(), data.size()).has_value());
+
+	// Lengths close to 2^64 must not wrap around
+	Bytes huge = {0xbf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+	EXPECT_FALSE(rlp_header(huge.data(), huge.size()).has_value());
+	Bytes huge_list = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0, 0x00};
+	EXPECT_FALSE(rlp_header(huge_list.data(), huge_list.size()).has_value());
+}
+
+TEST(Rlp, RejectsNonCanonicalLengths) {
+	std::vector<Bytes> non_canonical = {
+		// Single byte below 0x80 with a prefix
+		{0x81, 0x05},
+		{0x81, 0x00},
+		// Long form for short payloads
+		concat({0xb8, 0x05}, Bytes(5, 0)),
+		concat({0xb8, 0x37}, Bytes(55, 0)),
+		concat({0xf8, 0x02}, {0x80, 0x80}),
+		// Leading zeros in the length
+		concat({0xb9, 0x00, 0x38}, Bytes(56, 0)),
+		concat({0xf9, 0x00, 0x38}, Bytes(56, 0x80)),
+	};
+	for(auto& data : non_canonical) {
+		EXPECT_FALSE(rlp_header(data.data(), data.size()).has_value()) << "prefix " << (int)data[0];
+	}
+
+	// Shortest forms of the same
+	std::vector<Bytes> canonical = {
+		{0x05},
+		{0x00},
+		{0x81, 0x80},
+		concat({0x85}, Bytes(5, 0)),
+		concat({0xb7}, Bytes(55, 0)),
+		concat({0xb8, 0x38}, Bytes(56, 0)),
+		concat({0xf8, 0x38}, Bytes(56, 0x80)),
+	};
+	for(auto& data : canonical) {
+		auto header = rlp_header(data.data(), data.size());
+		ASSERT_TRUE(header.has_value()) << "prefix " << (int)data[0];
+		EXPECT_EQ(header->size(), data.size());
+	}
+}
+
+TEST(Rlp, ReaderStopsAtMalformedItems) {
+	// [0x01, truncated long string]
+	Bytes data = {0xc4, 0x01, 0xb8, 0x38, 0x00};
+	auto list = RlpView::parse(data.data(), data.size());
+	ASSERT_TRUE(list.has_value());
+
+	auto items = list->items();
+	auto first = items.next();
+	ASSERT_TRUE(first.has_value());
+	EXPECT_EQ(first->as_uint(), 1u);
+	EXPECT_FALSE(items.next().has_value());
+	EXPECT_TRUE(items.is_malformed());
+	EXPECT_TRUE(items.done());
+	EXPECT_FALSE(items.next().has_value());
+
+	// Wrong kind of item
+	Bytes pair = {0xc2, 0xc0, 0x80};
+	auto reader = RlpView::parse(pair.data(), pair.size())->items();
+	EXPECT_FALSE(reader.next(false).has_value());
+	EXPECT_TRUE(reader.is_malformed());
+
+	// Integers wider than 8 bytes
+	auto wide = concat({0x89}, Bytes(9, 1));
+	EXPECT_FALSE(RlpView::parse(wide.data(), wide.size())->as_uint().has_value());
+}
+
+TEST(Rlp, ThrowsPastMaxLists) {
+	auto nest = [](size_t depth) {
+		return [depth](auto& e) {
+			for(size_t i = 0; i < depth; i++) {
+				e.begin_list();
+			}
+			for(size_t i = 0; i < depth; i++) {
+				e.end_list();
+			}
+		};
+	};
+
+	auto buf = RlpEncoder<4>::encode(nest(4));
+	EXPECT_EQ(Bytes(buf.data(), buf.data() + buf.size()), (Bytes{0xc3, 0xc2, 0xc1, 0xc0}));
+	EXPECT_THROW(RlpEncoder<4>::encode(nest(5)), std::length_error);
+
+	// Sibling lists count too
+	EXPECT_THROW(RlpEncoder<4>::encode([](auto& e) {
+		for(size_t i = 0; i < 5; i++) {
+			e.begin_list();
+			e.end_list();
+		}
+	}), std::length_error);
+}
+
+TEST(Rlp, ThrowsOnUnbalancedLists) {
+	EXPECT_THROW(RlpEncoder<>::encode([](auto& e) { e.end_list(); }), std::logic_error);
+	EXPECT_THROW(RlpEncoder<>::encode([](auto& e) {
+		e.begin_list();
+		e.end_list();
+		e.end_list();
+	}), std::logic_error);
+	EXPECT_THROW(RlpEncoder<>::encode([](auto& e) {
+		e.add_uint(1);
+		e.end_list();
+		e.begin_list();
+	}), std::logic_error);
+
+	// Left open at finish
+	EXPECT_THROW(RlpEncoder<>::encode([](auto& e) { e.begin_list(); }), std::logic_error);
+	EXPECT_THROW(RlpEncoder<>::encode([](auto& e) {
+		e.begin_list();
+		e.begin_list();
+		e.end_list();
+	}), std::logic_error);
+}
@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+#include "marlin/rlpx/RlpxCrypto.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace marlin::rlpx;
+
+// Known answers come from an independent implementation of the frame codec
+// in the devp2p RLPx spec, run on the secrets below.
+struct FrameVector {
+	size_t frame_size;
+	uint8_t fill;
+	uint8_t header[32];
+	uint8_t frame_start[16];
+	uint8_t frame_mac[16];
+};
+
+static FrameVector const vectors[] = {
+	{
+		16, 1,
+		{
+			0xf2, 0x90, 0x10, 0x74, 0xaa, 0xc9, 0x9f, 0xd0, 0xa9, 0xf3, 0x9a, 0x6a, 0xdd, 0x2e, 0x77, 0x80,
+			0xc8, 0xb8, 0x33, 0x6e, 0x11, 0x0b, 0x16, 0xd5, 0x78, 0xfb, 0x43, 0xde, 0x08, 0xc5, 0x46, 0x41
+		},
+		{ 0xf1, 0x5f, 0x75, 0xaa, 0x4f, 0xbf, 0x98, 0xed, 0xaf, 0xfc, 0x90, 0x3d, 0x45, 0xcc, 0x39, 0x2d },
+		{ 0x3f, 0x62, 0x55, 0x02, 0x10, 0xb8, 0x55, 0x80, 0x13, 0x34, 0xb7, 0xc3, 0xeb, 0x09, 0xb0, 0xd7 }
+	},
+	{
+		48, 7,
+		{
+			0x0e, 0xbc, 0x85, 0x1c, 0x35, 0xac, 0x83, 0xbd, 0x08, 0xa8, 0xa9, 0x35, 0x18, 0x2c, 0x91, 0x99,
+			0xd4, 0x36, 0xd8, 0x2e, 0x28, 0x30, 0x6d, 0xf9, 0xb6, 0x77, 0x3c, 0xa7, 0xc8, 0x3d, 0xfa, 0xb6
+		},
+		{ 0xd5, 0x4b, 0x5f, 0x59, 0x23, 0x8d, 0x6d, 0x21, 0x8f, 0x8e, 0xa2, 0x91, 0xd6, 0xeb, 0x48, 0x40 },
+		{ 0xe5, 0x2b, 0x17, 0xc7, 0x48, 0xd3, 0x07, 0xa2, 0x0b, 0xf3, 0xb3, 0x4c, 0x8d, 0x00, 0x08, 0x24 }
+	},
+	{
+		1024, 3,
+		{
+			0xe9, 0x6b, 0x3e, 0xc8, 0x11, 0x51, 0x50, 0xe2, 0xd3, 0x89, 0xd3, 0xc7, 0x16, 0x24, 0x48, 0x99,
+			0x38, 0xb2, 0x1e, 0x58, 0x2f, 0x00, 0x6a, 0xee, 0x15, 0x40, 0xbd, 0x03, 0x88, 0x58, 0xa5, 0xa8
+		},
+		{ 0x5e, 0x11, 0x33, 0x9f, 0x27, 0xa0, 0x4c, 0x4b, 0x3f, 0xaa, 0x19, 0x4d, 0xf1, 0x4f, 0xc0, 0xa2 },
+		{ 0xf5, 0x68, 0xca, 0xdb, 0xd1, 0x88, 0xcf, 0x00, 0x88, 0xf7, 0x0c, 0xfa, 0xea, 0x3a, 0x17, 0xd0 }
+	}
+};
+
+struct Secrets {
+	uint8_t aess[32];
+	uint8_t macs[32];
+	uint8_t nonce_a[32];
+	uint8_t nonce_b[32];
+
+	Secrets() {
+		for(int i = 0; i < 32; i++) {
+			aess[i] = i;
+			macs[i] = 0x80 + i;
+			nonce_a[i] = 0x40 + i;
+			nonce_b[i] = 0xc0 + i;
+		}
+	}
+
+	// Egress of the sender is ingress of the receiver
+	void setup_sender(RlpxCrypto &crypto) const {
+		crypto.set_secrets(aess, macs, nonce_b, nonce_a);
+	}
+
+	void setup_receiver(RlpxCrypto &crypto) const {
+		crypto.set_secrets(aess, macs, nonce_a, nonce_b);
+	}
+};
+
+// Header, header mac, frame and frame mac, as handed to message_encrypt
+static std::vector<uint8_t> plain_message(FrameVector const &vector) {
+	std::vector<uint8_t> message(32 + vector.frame_size + 16, 0);
+	message[0] = (uint8_t)(vector.frame_size >> 16);
+	message[1] = (uint8_t)(vector.frame_size >> 8);
+	message[2] = (uint8_t)(vector.frame_size);
+	message[3] = 0xc2;
+	message[4] = 0x80;
+	message[5] = 0x80;
+	for(size_t i = 0; i < vector.frame_size; i++) {
+		message[32 + i] = (uint8_t)(vector.fill + i);
+	}
+
+	return message;
+}
+
+static void expect_vector(std::vector<uint8_t> const &message, FrameVector const &vector) {
+	EXPECT_EQ(std::memcmp(message.data(), vector.header, 32), 0);
+	EXPECT_EQ(std::memcmp(message.data() + 32, vector.frame_start, 16), 0);
+	EXPECT_EQ(std::memcmp(message.data() + message.size() - 16, vector.frame_mac, 16), 0);
+}
+
+TEST(RlpxCrypto, MessageEncryptMatchesKnownAnswers) {
+	Secrets secrets;
+	RlpxCrypto sender;
+	secrets.setup_sender(sender);
+
+	// One session, so every message also checks the mac and keystream state carried over
+	for(auto const &vector : vectors) {
+		auto message = plain_message(vector);
+		sender.message_encrypt(message.data(), message.size(), message.data());
+		expect_vector(message, vector);
+	}
+}
+
+TEST(RlpxCrypto, HeaderAndFrameEncryptMatchKnownAnswers) {
+	Secrets secrets;
+	RlpxCrypto sender;
+	secrets.setup_sender(sender);
+
+	for(auto const &vector : vectors) {
+		auto message = plain_message(vector);
+		std::vector<uint8_t> out(message.size());
+		sender.header_encrypt(message.data(), 32, out.data());
+		sender.frame_encrypt(message.data() + 32, message.size() - 32, out.data() + 32);
+		expect_vector(out, vector);
+	}
+}
+
+TEST(RlpxCrypto, DecryptsKnownAnswers) {
+	Secrets secrets;
+	RlpxCrypto sender, receiver;
+	secrets.setup_sender(sender);
+	secrets.setup_receiver(receiver);
+
+	for(auto const &vector : vectors) {
+		auto plain = plain_message(vector);
+		auto message = plain;
+		sender.message_encrypt(message.data(), message.size(), message.data());
+
+		std::vector<uint8_t> out(message.size());
+		ASSERT_TRUE(receiver.header_decrypt(message.data(), 32, out.data()));
+		ASSERT_TRUE(receiver.frame_decrypt(message.data() + 32, message.size() - 32, out.data() + 32));
+
+		EXPECT_EQ(std::memcmp(out.data(), plain.data(), 16), 0);
+		EXPECT_EQ(std::memcmp(out.data() + 32, plain.data() + 32, vector.frame_size), 0);
+	}
+}
+
+TEST(RlpxCrypto, RejectsTamperedMacs) {
+	Secrets secrets;
+
+	{
+		RlpxCrypto sender, receiver;
+		secrets.setup_sender(sender);
+		secrets.setup_receiver(receiver);
+
+		auto message = plain_message(vectors[0]);
+		sender.message_encrypt(message.data(), message.size(), message.data());
+		message[5] ^= 1;
+
+		std::vector<uint8_t> out(message.size());
+		EXPECT_FALSE(receiver.header_decrypt(message.data(), 32, out.data()));
+	}
+
+	{
+		RlpxCrypto sender, receiver;
+		secrets.setup_sender(sender);
+		secrets.setup_receiver(receiver);
+
+		auto message = plain_message(vectors[0]);
+		sender.message_encrypt(message.data(), message.size(), message.data());
+		message[40] ^= 1;
+
+		std::vector<uint8_t> out(message.size());
+		EXPECT_TRUE(receiver.header_decrypt(message.data(), 32, out.data()));
+		EXPECT_FALSE(receiver.frame_decrypt(message.data() + 32, message.size() - 32, out.data() + 32));
+	}
+}
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "marlin/rlpx/Trie.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace marlin::rlpx;
+
+using Bytes = std::vector<uint8_t>;
+
+static TrieRoot::Hash from_hex(std::string const& hex) {
+	TrieRoot::Hash hash;
+	for(size_t i = 0; i < 32; i++) {
+		hash[i] = std::stoi(hex.substr(2 * i, 2), nullptr, 16);
+	}
+	return hash;
+}
+
+static TrieRoot::Item item(std::string const& key, std::string const& value) {
+	return TrieRoot::Item{Bytes(key.begin(), key.end()), (uint8_t const*)value.data(), value.size()};
+}
+
+TEST(Trie, MatchesKnownRoots) {
+	EXPECT_EQ(TrieRoot::compute({}), from_hex("56e81f171bcc55a6ff8345e692c0f86e5b48e01b996cadc001622fb5e363b421"));
+
+	// Leaf, extension and a branch holding a value
+	std::string reindeer = "reindeer", puppy = "puppy", cat = "cat";
+	EXPECT_EQ(
+		TrieRoot::compute({item("doe", reindeer), item("dog", puppy), item("dogglesworth", cat)}),
+		from_hex("8aad789dff2f538bca5d8ea56e8abe10f4c7ba3a5dea95fea4cd6e7c3a1168d3")
+	);
+}
+
+TEST(Trie, IgnoresItemOrder) {
+	std::vector<std::string> values;
+	for(size_t i = 0; i < 300; i++) {
+		values.push_back(std::string(i % 50 + 1, 'a' + i % 26));
+	}
+
+	std::vector<TrieRoot::Item> items;
+	for(size_t i = 0; i < values.size(); i++) {
+		items.push_back(item(std::to_string(i * 7919), values[i]));
+	}
+	auto root = TrieRoot::compute(items);
+
+	std::reverse(items.begin(), items.end());
+	EXPECT_EQ(TrieRoot::compute(items), root);
+	std::rotate(items.begin(), items.begin() + 100, items.end());
+	EXPECT_EQ(TrieRoot::compute(items), root);
+}
+
+TEST(Trie, KeysListItemsByIndex) {
+	// A legacy txn as a list, a typed txn as a string of type and payload
+	Bytes legacy = {0xc3, 0x01, 0x02, 0x03};
+	Bytes typed = {0x02, 0xc2, 0x04, 0x05};
+	auto list = RlpEncoder<>::encode([&](auto& e) {
+		e.begin_list();
+		e.add_raw(legacy.data(), legacy.size());
+		e.add_string(typed.data(), typed.size());
+		e.end_list();
+	});
+
+	// Keys are RLP encoded indices, 0 encodes as 0x80
+	auto expected = TrieRoot::compute({
+		TrieRoot::Item{Bytes{0x80}, legacy.data(), legacy.size()},
+		TrieRoot::Item{Bytes{0x01}, typed.data(), typed.size()}
+	});
+	EXPECT_EQ(TrieRoot::ordered(*RlpView::parse(list.data(), list.size())), expected);
+}
@@ -0,0 +1,272 @@
+#define MARLIN_ASYNCIO_SIMULATOR
+
+#include "gtest/gtest.h"
+#include "marlin/rlpx/TxnIngester.hpp"
+#include "SimSteps.hpp"
+
+#include <optional>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::rlpx;
+using marlin::simulator::Simulator;
+
+using Bytes = std::vector<uint8_t>;
+
+struct Delegate;
+using IngesterType = TxnIngester<Delegate>;
+
+struct Delegate {
+	std::vector<uint64_t> published;
+
+	void did_ingest_txn(IngesterType&, uint64_t txn_id, Buffer const&) {
+		published.push_back(txn_id);
+	}
+};
+
+// Legacy txns are RLP lists, the contents do not matter here
+static Bytes make_txn(uint8_t fill, size_t size = 100) {
+	Bytes payload(size, fill);
+	auto txn = RlpEncoder<>::encode([&](auto& e) {
+		e.begin_list();
+		e.add_string(payload.data(), payload.size());
+		e.end_list();
+	});
+	return Bytes(txn.data(), txn.data() + txn.size());
+}
+
+static Bytes encode_string(Bytes const& bytes) {
+	auto item = RlpEncoder<>::encode([&](auto& e) { e.add_string(bytes.data(), bytes.size()); });
+	return Bytes(item.data(), item.data() + item.size());
+}
+
+// EIP-2718 txn as it appears in eth messages, a string holding the type and the payload
+static Bytes concat_typed(uint8_t type, Bytes const& payload) {
+	Bytes inner{type};
+	inner.insert(inner.end(), payload.begin(), payload.end());
+	return encode_string(inner);
+}
+
+static uint64_t txn_id(Bytes const& txn) {
+	CryptoPP::BLAKE2b blake2b((uint)8);
+	blake2b.Update(txn.data(), txn.size());
+	uint64_t id;
+	blake2b.TruncatedFinal((uint8_t*)&id, 8);
+	return id;
+}
+
+// Transactions, or eth/66 PooledTransactions with a request id
+static Buffer txns_message(std::vector<Bytes> const& txns, std::optional<uint64_t> request_id = std::nullopt) {
+	auto message = RlpEncoder<>::encode([&](auto& e) {
+		e.begin_list();
+		if(request_id.has_value()) {
+			e.add_uint(*request_id);
+			e.begin_list();
+		}
+		for(auto& txn : txns) {
+			e.add_raw(txn.data(), txn.size());
+		}
+		if(request_id.has_value()) {
+			e.end_list();
+		}
+		e.end_list();
+	}, 1);
+	message.data()[0] = request_id.has_value() ? 0x18 : 0x12;
+	return message;
+}
+
+// Cached copy of a txn, found by compressing a block that contains it
+static std::optional<WeakBuffer> cached(IngesterType& ingester, Bytes const& txn) {
+	auto compressed = ingester.cache.compress({}, {WeakBuffer((uint8_t*)txn.data(), txn.size())});
+	auto res = ingester.cache.decompress(WeakBuffer(compressed.data(), compressed.size()));
+	if(!res.has_value() || std::get<1>(*res).size() != 1 || std::get<1>(*res)[0].data() == nullptr) {
+		return std::nullopt;
+	}
+	return std::get<1>(*res)[0];
+}
+
+// The ingester is created in the first step at tick 0, the test schedules the rest
+class TxnIngesterTest : public ::testing::Test {
+protected:
+	Delegate delegate;
+	std::optional<IngesterType> ingester;
+
+	void SetUp() override {
+		at(0, [this]() {
+			ingester.emplace();
+			ingester->delegate = &delegate;
+			ingester->set_publish_limit(1e9, 1e9);
+		});
+	}
+
+	// Stops the ingester timer at tick so the simulation drains
+	void run_until(uint64_t tick) {
+		at(tick, [this]() { ingester.reset(); });
+		Simulator::default_instance.run();
+	}
+};
+
+TEST_F(TxnIngesterTest, DedupsTxnsAcrossMessages) {
+	auto t1 = make_txn(1), t2 = make_txn(2), t3 = make_txn(3);
+	size_t num_txns = 0;
+
+	at(10, [&]() {
+		ingester->did_recv_txns(txns_message({t1, t2}));
+		ingester->did_recv_txns(txns_message({t2, t3}));
+		ingester->did_recv_txns(txns_message({t1, t3}, 7));
+		num_txns = ingester->cache.num_txns();
+	});
+	run_until(100);
+
+	EXPECT_EQ(num_txns, 3u);
+	EXPECT_EQ(delegate.published, (std::vector<uint64_t>{txn_id(t1), txn_id(t2), txn_id(t3)}));
+}
+
+TEST_F(TxnIngesterTest, EvictsTxnsAfterTtl) {
+	auto t1 = make_txn(1), t2 = make_txn(2);
+	bool before_ttl = false, t1_after_ttl = true, t2_after_ttl = false;
+
+	at(10, [&]() {
+		ingester->did_recv_txns(txns_message({t1, t2}));
+	});
+	at(IngesterType::TxnTtl / 2, [&]() {
+		// Seen again, keeps t2 around for another ttl
+		ingester->did_recv_txns(txns_message({t2}));
+	});
+	at(IngesterType::TxnTtl, [&]() {
+		before_ttl = ingester->cache.has_txn(txn_id(t1)) && ingester->cache.has_txn(txn_id(t2));
+	});
+	at(IngesterType::TxnTtl + 10 + IngesterType::TimerInterval, [&]() {
+		t1_after_ttl = ingester->cache.has_txn(txn_id(t1));
+		t2_after_ttl = ingester->cache.has_txn(txn_id(t2));
+	});
+	run_until(IngesterType::TxnTtl + 20 + IngesterType::TimerInterval);
+
+	EXPECT_TRUE(before_ttl);
+	EXPECT_FALSE(t1_after_ttl);
+	EXPECT_TRUE(t2_after_ttl);
+	// The repeat is not new
+	EXPECT_EQ(delegate.published.size(), 2u);
+}
+
+TEST_F(TxnIngesterTest, ReusesIdsAfterEvictionAndBlocks) {
+	auto t1 = make_txn(1), t2 = make_txn(2);
+	bool kept_for_block = false, in_block = true, t1_kept = false, reingested = false;
+
+	at(10, [&]() {
+		ingester->did_recv_txns(txns_message({t1, t2}));
+
+		// A block with t2 drops it after a grace period, the body starts with the txns list
+		auto body = txns_message({t2});
+		body.cover_unsafe(1);
+		ingester->did_recv_block(body);
+		// Still there to compress the block with
+		kept_for_block = cached(*ingester, t2).has_value();
+	});
+	at(10 + IngesterType::BlockTxnTtl + IngesterType::TimerInterval, [&]() {
+		in_block = ingester->cache.has_txn(txn_id(t2));
+		t1_kept = ingester->cache.has_txn(txn_id(t1));
+	});
+	at(2 * IngesterType::TxnTtl, [&]() {
+		// t1 has been evicted by now and is new again, as is t2
+		ingester->did_recv_txns(txns_message({t1, t2}));
+		reingested = ingester->cache.has_txn(txn_id(t1)) && ingester->cache.has_txn(txn_id(t2));
+	});
+	run_until(2 * IngesterType::TxnTtl + 10);
+
+	EXPECT_TRUE(kept_for_block);
+	EXPECT_FALSE(in_block);
+	EXPECT_TRUE(t1_kept);
+	EXPECT_TRUE(reingested);
+	EXPECT_EQ(delegate.published, (std::vector<uint64_t>{txn_id(t1), txn_id(t2), txn_id(t1), txn_id(t2)}));
+}
+
+TEST_F(TxnIngesterTest, CopiesSmallTxnsOutOfTheirMessage) {
+	auto small = make_txn(1, 100), other = make_txn(2, 100), large = make_txn(3, 1000);
+	bool small_matches = false, large_matches = false;
+	bool small_in_message = true, large_in_message = false;
+
+	at(10, [&]() {
+		auto in_message = [](WeakBuffer const& txn, Buffer const& message) {
+			return txn.data() >= message.data() && txn.data() < message.data() + message.size();
+		};
+
+		// Shared to keep the messages around for comparing addresses
+		auto small_message = txns_message({small, other, make_txn(4, 100)});
+		ingester->did_recv_txns(small_message.share());
+		auto large_message = txns_message({large, other});
+		ingester->did_recv_txns(large_message.share());
+
+		auto small_cached = cached(*ingester, small);
+		auto large_cached = cached(*ingester, large);
+		ASSERT_TRUE(small_cached.has_value());
+		ASSERT_TRUE(large_cached.has_value());
+
+		small_matches = Bytes(small_cached->data(), small_cached->data() + small_cached->size()) == small;
+		large_matches = Bytes(large_cached->data(), large_cached->data() + large_cached->size()) == large;
+		small_in_message = in_message(*small_cached, small_message);
+		large_in_message = in_message(*large_cached, large_message);
+	});
+	run_until(100);
+
+	EXPECT_TRUE(small_matches);
+	EXPECT_TRUE(large_matches);
+	EXPECT_FALSE(small_in_message);
+	EXPECT_TRUE(large_in_message);
+}
+
+TEST_F(TxnIngesterTest, EvictsOldestTxnsPastCaps) {
+	std::vector<Bytes> txns;
+	for(uint8_t i = 0; i < 10; i++) {
+		txns.push_back(make_txn(i));
+	}
+	size_t num_txns = 0, num_bytes = 0;
+	std::vector<bool> kept;
+	size_t capped_txns = 0;
+
+	at(10, [&]() {
+		ingester->set_cache_limit(4, 1 << 20);
+		ingester->did_recv_txns(txns_message({txns[0], txns[1], txns[2]}));
+	});
+	at(20, [&]() {
+		// Seen again, t0 is now newer than t1 and t2
+		ingester->did_recv_txns(txns_message({txns[0], txns[3], txns[4]}));
+		num_txns = ingester->cache.num_txns();
+		for(size_t i = 0; i < 5; i++) {
+			kept.push_back(ingester->cache.has_txn(txn_id(txns[i])));
+		}
+	});
+	at(30, [&]() {
+		// Room for two txns by size
+		ingester->set_cache_limit(100, 2 * txns[0].size());
+		ingester->did_recv_txns(txns_message({txns[5], txns[6], txns[7], txns[8], txns[9]}));
+		capped_txns = ingester->cache.num_txns();
+		num_bytes = ingester->cache.num_bytes();
+	});
+	run_until(100);
+
+	EXPECT_EQ(num_txns, 4u);
+	EXPECT_EQ(kept, (std::vector<bool>{true, false, true, true, true}));
+	EXPECT_EQ(capped_txns, 2u);
+	EXPECT_EQ(num_bytes, 2 * txns[0].size());
+}
+
+TEST_F(TxnIngesterTest, DropsItemsThatAreNotTxns) {
+	auto legacy = make_txn(1);
+	// Typed txns are a string of the type byte followed by the txn list
+	auto typed = concat_typed(0x02, make_txn(2));
+	auto bad_type = concat_typed(0x00, make_txn(3));
+	auto bad_body = concat_typed(0x02, Bytes{0x83, 1, 2, 3});
+	auto garbage = encode_string(Bytes(20, 4));
+	std::vector<uint64_t> cached_ids;
+	size_t num_txns = 0;
+
+	at(10, [&]() {
+		ingester->did_recv_txns(txns_message({garbage, legacy, bad_type, typed, bad_body}));
+		num_txns = ingester->cache.num_txns();
+	});
+	run_until(100);
+
+	EXPECT_EQ(num_txns, 2u);
+	EXPECT_EQ(delegate.published, (std::vector<uint64_t>{txn_id(legacy), txn_id(typed)}));
+}
@@ -19,9 +19,21 @@ private:
 	> interfaces;
 
 	NetworkConditionerType& conditioner;
+
+	/// Public address of each private address behind a NAT
+	std::unordered_map<core::SocketAddress, core::SocketAddress> nat_out;
+	/// Private address behind each public NAT address
+	std::unordered_map<core::SocketAddress, core::SocketAddress> nat_in;
 public:
 	Network(NetworkConditionerType& conditioner);
 
+	/// Put a NAT in front of the given private address, packets from it appear to come from the public address.
+	/// Setting a new public address for the same private address simulates NAT rebinding
+	void set_nat_mapping(
+		core::SocketAddress const& private_addr,
+		core::SocketAddress const& public_addr
+	);
+
 	NetworkInterface<SelfType>& get_or_create_interface(
 		core::SocketAddress const& addr
 	);
@@ -58,14 +70,34 @@ NetworkInterface<Network<NetworkConditionerType>>& Network<NetworkConditionerTyp
 	).first->second;
 }
 
+template<typename NetworkConditionerType>
+void Network<NetworkConditionerType>::set_nat_mapping(
+	core::SocketAddress const& private_addr,
+	core::SocketAddress const& public_addr
+) {
+	// Packets to the old public address are dropped from now on
+	auto iter = nat_out.find(private_addr);
+	if(iter != nat_out.end()) {
+		nat_in.erase(iter->second);
+	}
+
+	nat_out[private_addr] = public_addr;
+	nat_in[public_addr] = private_addr;
+}
+
 template<typename NetworkConditionerType>
 template<typename EventManager>
 int Network<NetworkConditionerType>::send(
 	EventManager& manager,
-	core::SocketAddress const& src_addr,
-	core::SocketAddress const& dst_addr,
+	core::SocketAddress const& in_src_addr,
+	core::SocketAddress const& in_dst_addr,
 	core::Buffer&& packet
 ) {
+	auto src_iter = nat_out.find(in_src_addr);
+	auto const& src_addr = src_iter != nat_out.end() ? src_iter->second : in_src_addr;
+	auto dst_iter = nat_in.find(in_dst_addr);
+	auto const& dst_addr = dst_iter != nat_in.end() ? dst_iter->second : in_dst_addr;
+
 	core::SocketAddress taddr = dst_addr;
 	taddr.set_port(0);
 
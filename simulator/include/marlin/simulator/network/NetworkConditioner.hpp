@@ -8,6 +8,9 @@ namespace simulator {
 
 class NetworkConditioner {
 public:
+	/// Path MTU, datagrams which do not fit along with IP and UDP headers are dropped
+	uint64_t mtu = -1;
+
 	bool should_drop(
 		uint64_t in_tick,
 		core::SocketAddress const& src,
@@ -28,11 +31,12 @@ public:
 
 bool NetworkConditioner::should_drop(
 	uint64_t,
+	core::SocketAddress const& src,
 	core::SocketAddress const&,
-	core::SocketAddress const&,
-	uint64_t
+	uint64_t size
 ) {
-	return false;
+	uint64_t header_size = src.ss_family == AF_INET6 ? 48 : 28;
+	return size > mtu - header_size;
 }
 
 uint64_t NetworkConditioner::get_out_tick(
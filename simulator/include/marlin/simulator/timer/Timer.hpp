@@ -23,8 +23,17 @@ private:
 	template<typename DelegateType, void (DelegateType::*callback)()>
 	void timer_cb() {
 		next_event = nullptr;
+		// Callback might stop, restart or destroy the timer, do not touch it afterwards if it did
+		auto repeat = this->repeat;
+		bool is_current = true;
+		this->is_current = &is_current;
 		(((DelegateType*)(delegate))->*callback)();
 
+		if(!is_current) {
+			return;
+		}
+		this->is_current = nullptr;
+
 		if(repeat > 0) {
 			start<DelegateType, callback>(repeat, repeat);
 		}
@@ -33,8 +42,17 @@ private:
 	template<typename DelegateType, typename DataType, void (DelegateType::*callback)(DataType&)>
 	void timer_cb() {
 		next_event = nullptr;
+		// Callback might stop, restart or destroy the timer, do not touch it afterwards if it did
+		auto repeat = this->repeat;
+		bool is_current = true;
+		this->is_current = &is_current;
 		(((DelegateType*)(delegate))->*callback)(*(DataType*)data);
 
+		if(!is_current) {
+			return;
+		}
+		this->is_current = nullptr;
+
 		if(repeat > 0) {
 			start<DelegateType, DataType, callback>(repeat, repeat);
 		}
@@ -42,6 +60,8 @@ private:
 
 	uint64_t repeat = 0;
 	Event<Simulator>* next_event = nullptr;
+	/// Set while the callback runs, cleared if the timer is stopped meanwhile
+	bool* is_current = nullptr;
 public:
 	void* delegate;
 
@@ -87,6 +107,10 @@ public:
 
 	void stop() {
 		repeat = 0;
+		if(is_current != nullptr) {
+			*is_current = false;
+			is_current = nullptr;
+		}
 		if(next_event != nullptr){
 			Simulator::default_instance.remove_event(next_event);
 			next_event = nullptr;
@@ -6,7 +6,7 @@
 #include <marlin/core/Buffer.hpp>
 #include <marlin/core/messages/BaseMessage.hpp>
 #include <marlin/core/SocketAddress.hpp>
-#include <marlin/core/CidrBlock.hpp>
+#include <marlin/core/AddressClassifier.hpp>
 #include <marlin/core/TransportManager.hpp>
 
 
@@ -54,6 +54,8 @@ public:
 
 	int send(core::Buffer&& buf);
 	int send(MessageType&& buf);
+	/// Send buf with payload inserted at offset, the network carries the assembled datagram
+	int send(core::Buffer&& buf, core::Buffer&& payload, size_t offset);
 	void did_recv(
 		core::SocketAddress const& addr,
 		core::Buffer&& message
@@ -82,12 +84,7 @@ SimulatedTransport<
 	EventManager& manager
 ) : interface(interface), transport_manager(transport_manager),
 	manager(manager), src_addr(src_addr), dst_addr(dst_addr) {
-	if(
-		core::CidrBlock::from_string("10.0.0.0/8").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("172.16.0.0/12").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("192.168.0.0/16").does_contain_address(dst_addr) ||
-		core::CidrBlock::from_string("127.0.0.0/8").does_contain_address(dst_addr)
-	) {
+	if(core::AddressClassifier::default_instance().classify(dst_addr) == core::AddressClass::Internal) {
 		internal = true;
 	}
 }
@@ -151,6 +148,24 @@ int SimulatedTransport<
 	return send(std::move(buf).payload_buffer());
 }
 
+template<
+	typename EventManager,
+	typename NetworkInterfaceType,
+	typename DelegateType
+>
+int SimulatedTransport<
+	EventManager,
+	NetworkInterfaceType,
+	DelegateType
+>::send(core::Buffer&& buf, core::Buffer&& payload, size_t offset) {
+	core::Buffer datagram(buf.size() + payload.size());
+	datagram.write_unsafe(0, buf.data(), offset);
+	datagram.write_unsafe(offset, payload.data(), payload.size());
+	datagram.write_unsafe(offset + payload.size(), buf.data() + offset, buf.size() - offset);
+
+	return send(std::move(datagram));
+}
+
 template<
 	typename EventManager,
 	typename NetworkInterfaceType,
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "marlin/simulator/timer/Timer.hpp"
+
+#include <memory>
+
+
+using namespace marlin::simulator;
+
+struct Delegate {
+	std::unique_ptr<Timer> timer;
+	size_t calls = 0;
+	size_t stop_after = 0;
+	bool destroy = false;
+
+	Delegate() : timer(new Timer(this)) {}
+
+	void timer_cb() {
+		calls++;
+		if(calls < stop_after) {
+			return;
+		}
+
+		if(destroy) {
+			timer.reset();
+		} else {
+			timer->stop();
+		}
+	}
+};
+
+
+TEST(Timer, Repeats) {
+	Delegate delegate;
+	delegate.stop_after = 5;
+	delegate.timer->start<Delegate, &Delegate::timer_cb>(10, 10);
+
+	Simulator::default_instance.run();
+
+	EXPECT_EQ(delegate.calls, 5u);
+}
+
+TEST(Timer, RepeatingTimerCanBeDestroyedFromCallback) {
+	Delegate delegate;
+	delegate.stop_after = 3;
+	delegate.destroy = true;
+	delegate.timer->start<Delegate, &Delegate::timer_cb>(10, 10);
+
+	Simulator::default_instance.run();
+
+	EXPECT_EQ(delegate.calls, 3u);
+	EXPECT_EQ(delegate.timer, nullptr);
+}
+
+TEST(Timer, CanBeRestartedFromCallback) {
+	struct Restarter {
+		Timer timer;
+		size_t calls = 0;
+
+		Restarter() : timer(this) {}
+
+		void timer_cb() {
+			// Switch from a repeating to a one shot timer
+			if(++calls == 2) {
+				timer.start<Restarter, &Restarter::timer_cb>(100, 0);
+			}
+		}
+	} restarter;
+	restarter.timer.start<Restarter, &Restarter::timer_cb>(10, 10);
+
+	Simulator::default_instance.run();
+
+	EXPECT_EQ(restarter.calls, 3u);
+}
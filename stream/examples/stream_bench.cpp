@@ -0,0 +1,133 @@
+// Loopback StreamTransport throughput, built against both the libuv and the io_uring backend
+
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+#include <spdlog/spdlog.h>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, UdpTransport>;
+
+#define MSG_SIZE 1000000
+#define TOTAL_MSGS 1000
+
+uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+struct Delegate {
+	uint64_t sent = 0;
+	uint64_t recv_bytes = 0;
+	uint64_t last_recv_bytes = 0;
+	uint64_t start_time = 0;
+	Timer timer;
+
+	Delegate() : timer(this) {}
+
+	int did_recv(
+		TransportType &,
+		Buffer &&packet,
+		uint8_t
+	) {
+		if(start_time == 0) {
+			start_time = EventLoop::now();
+			timer.start<Delegate, &Delegate::timer_cb>(1000, 1000);
+		}
+		recv_bytes += packet.size();
+
+		if(recv_bytes >= (uint64_t)MSG_SIZE * TOTAL_MSGS) {
+			auto elapsed = EventLoop::now() - start_time;
+			SPDLOG_INFO(
+				"Done: {} MB in {} ms, {} MB/s",
+				recv_bytes / 1000000,
+				elapsed,
+				elapsed == 0 ? 0 : recv_bytes / elapsed / 1000
+			);
+			timer.stop();
+			uv_stop(uv_default_loop());
+		}
+		return 0;
+	}
+
+	void timer_cb() {
+		SPDLOG_INFO("Throughput: {} MB/s", (recv_bytes - last_recv_bytes) / 1000000);
+		last_recv_bytes = recv_bytes;
+	}
+
+	void did_send(TransportType &transport, Buffer &&) {
+		if(sent < TOTAL_MSGS) {
+			send_one(transport);
+		}
+	}
+
+	void did_dial(TransportType &transport) {
+		// Keep a few messages in flight
+		for(int i = 0; i < 4 && sent < TOTAL_MSGS; i++) {
+			send_one(transport);
+		}
+	}
+
+	void send_one(TransportType &transport) {
+		auto buf = Buffer(MSG_SIZE);
+		std::memset(buf.data(), 0, MSG_SIZE);
+		sent++;
+
+		transport.send(std::move(buf));
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+	}
+
+	void did_recv_flush_stream(
+		TransportType &transport [[maybe_unused]],
+		uint16_t stream_id [[maybe_unused]],
+		uint64_t offset [[maybe_unused]],
+		uint64_t old_offset [[maybe_unused]]
+	) {}
+
+	void did_recv_skip_stream(
+		TransportType &transport [[maybe_unused]],
+		uint16_t stream_id [[maybe_unused]]
+	) {}
+
+	void did_recv_flush_conf(
+		TransportType &transport [[maybe_unused]],
+		uint16_t stream_id [[maybe_unused]]
+	) {}
+};
+
+int main() {
+	crypto_box_keypair(static_pk, static_sk);
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	SPDLOG_INFO("Backend: io_uring");
+#else
+	SPDLOG_INFO("Backend: libuv");
+#endif
+
+	StreamTransportFactory<
+		Delegate,
+		Delegate,
+		UdpTransportFactory,
+		UdpTransport
+	> s, c;
+	Delegate sd, cd;
+
+	s.bind(SocketAddress::loopback_ipv4(8000));
+	s.listen(sd);
+	c.bind(SocketAddress::loopback_ipv4(0));
+	c.dial(SocketAddress::loopback_ipv4(8000), cd, static_pk);
+
+	return EventLoop::run();
+}
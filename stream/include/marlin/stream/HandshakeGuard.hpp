@@ -0,0 +1,109 @@
+/*! \file HandshakeGuard.hpp
+	\brief Stateless DIAL cookies, keeps handshake crypto away from spoofed sources
+*/
+
+#ifndef MARLIN_STREAM_HANDSHAKEGUARD_HPP
+#define MARLIN_STREAM_HANDSHAKEGUARD_HPP
+
+#include <marlin/core/SocketAddress.hpp>
+
+#include <sodium.h>
+
+#include <cstring>
+
+namespace marlin {
+namespace stream {
+
+/// @brief Issues and checks the cookies a DIAL has to carry when cookies are required
+///
+/// A cookie is a keyed BLAKE2b MAC over the peer address, the peer's connection id and
+/// the current epoch, so it can be verified without keeping any per peer state. Only a
+/// peer that can receive packets at its source address learns a valid cookie.
+/// Cookies from the current and the previous epoch are accepted.
+///
+/// Cookies are off by default since peers that predate them ignore RETRY.
+class HandshakeGuard {
+public:
+	/// Epoch bytes followed by the MAC
+	static constexpr size_t cookie_size = 4 + 16;
+	/// Lifetime of an epoch in milliseconds
+	static constexpr uint64_t epoch_length = 30000;
+
+	/// Handshake packets dropped by the stream layer
+	struct DropStats {
+		/// DIALs answered with a RETRY since they had no cookie
+		uint64_t cookie_missing = 0;
+		/// DIALs with an expired or forged cookie
+		uint64_t cookie_invalid = 0;
+		/// DIALs that failed to unseal
+		uint64_t unseal_failed = 0;
+	};
+
+	DropStats drop_stats;
+
+private:
+	uint8_t key[crypto_generichash_KEYBYTES];
+	bool required = false;
+
+	void mac(uint8_t* out, uint32_t epoch, core::SocketAddress const& addr, uint32_t conn_id) const {
+		auto addr_key = addr.key();
+
+		uint8_t in[4 + 16 + 2 + 2 + 4];
+		std::memcpy(in, &epoch, 4);
+		std::memcpy(in + 4, addr_key.ip.data(), 16);
+		std::memcpy(in + 20, &addr_key.port, 2);
+		std::memcpy(in + 22, &addr_key.family, 2);
+		std::memcpy(in + 24, &conn_id, 4);
+
+		crypto_generichash(out, 16, in, sizeof(in), key, sizeof(key));
+	}
+
+public:
+	HandshakeGuard() {
+		randombytes_buf(key, sizeof(key));
+	}
+
+	HandshakeGuard(HandshakeGuard const&) = delete;
+
+	static HandshakeGuard& default_instance() {
+		static HandshakeGuard guard;
+		return guard;
+	}
+
+	/// Require a valid cookie before any DIAL is unsealed
+	void set_required(bool required) {
+		this->required = required;
+	}
+
+	bool is_required() const {
+		return required;
+	}
+
+	/// Write a cookie of cookie_size bytes for the given peer into out
+	void generate(uint8_t* out, core::SocketAddress const& addr, uint32_t conn_id, uint64_t now) const {
+		uint32_t epoch = now / epoch_length;
+		std::memcpy(out, &epoch, 4);
+		mac(out + 4, epoch, addr, conn_id);
+	}
+
+	/// Check a cookie of cookie_size bytes from the given peer
+	bool verify(uint8_t const* in, core::SocketAddress const& addr, uint32_t conn_id, uint64_t now) const {
+		uint32_t epoch;
+		std::memcpy(&epoch, in, 4);
+
+		uint32_t current = now / epoch_length;
+		if(epoch != current && epoch + 1 != current) {
+			return false;
+		}
+
+		uint8_t expected[16];
+		mac(expected, epoch, addr, conn_id);
+
+		return sodium_memcmp(expected, in + 4, 16) == 0;
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_HANDSHAKEGUARD_HPP
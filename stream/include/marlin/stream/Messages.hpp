@@ -2,11 +2,18 @@
 #define MARLIN_STREAM_MESSAGES_HPP
 
 #include <marlin/core/Buffer.hpp>
+#include <marlin/core/messages/Schema.hpp>
+
+#include <cstring>
 
 
 namespace marlin {
 namespace stream {
 
+/// Header field of a stream message, multi byte fields are little endian
+template<typename T, size_t Offset>
+using HeaderField = core::UintField<T, Offset, core::FieldEndian::Le>;
+
 #define MARLIN_MESSAGES_BASE(Derived) \
 	/** @brief Message type */ \
 	using SelfType = Derived<BaseMessageType>; \
@@ -25,7 +32,7 @@ namespace stream {
 #define MARLIN_MESSAGES_UINT_FIELD_MULTIPLE_OFFSET(size, name, read_offset, write_offset) \
 	/** @brief Set name */ \
 	SelfType& set_##name(uint##size##_t name) & { \
-		base.payload_buffer().write_uint##size##_le_unsafe(write_offset, name); \
+		HeaderField<uint##size##_t, write_offset>::write(base.payload(), name); \
  \
 		return *this; \
 	} \
@@ -37,7 +44,7 @@ namespace stream {
  \
 	/** @brief Get name */ \
 	uint##size##_t name() const { \
-		return base.payload_buffer().read_uint##size##_le_unsafe(read_offset); \
+		return HeaderField<uint##size##_t, read_offset>::read(base.payload()); \
 	}
 
 #define MARLIN_MESSAGES_UINT_FIELD_SINGLE_OFFSET(size, name, offset) MARLIN_MESSAGES_UINT_FIELD_MULTIPLE_OFFSET(size, name, offset, offset)
@@ -88,6 +95,31 @@ namespace stream {
 		return base.payload_buffer().data() + offset; \
 	}
 
+#define MARLIN_MESSAGES_SCHEMA(...) \
+	/** @brief Layout of the fixed size header */ \
+	using Schema = core::MessageSchema<__VA_ARGS__>; \
+ \
+	/** @brief Read the header fields at the given indices, all of them if none are given */ \
+	/** Message has to be validated first */ \
+	template<size_t... Idx> \
+	auto read_header() const { \
+		return Schema::template read_unsafe<Idx...>(base.payload()); \
+	} \
+ \
+	/** @brief Set every header field with a single copy */ \
+	template<typename... Args> \
+	SelfType& set_header(Args&&... args) & { \
+		Schema::write_unsafe(base.payload(), std::forward<Args>(args)...); \
+ \
+		return *this; \
+	} \
+ \
+	/** @brief Set every header field with a single copy */ \
+	template<typename... Args> \
+	SelfType&& set_header(Args&&... args) && { \
+		return std::move(set_header(std::forward<Args>(args)...)); \
+	}
+
 #define MARLIN_MESSAGES_ARRAY_FIELD(type, begin_offset, end_offset) \
 private: \
 	template<typename type> \
@@ -165,15 +197,25 @@ struct DATAWrapper {
 	MARLIN_MESSAGES_UINT64_FIELD(offset, 20);
 	MARLIN_MESSAGES_UINT16_FIELD(length, 28);
 	MARLIN_MESSAGES_PAYLOAD_FIELD(30);
+	MARLIN_MESSAGES_SCHEMA(
+		HeaderField<uint8_t, 0>,    // Version
+		HeaderField<uint8_t, 1>,    // Type, 1 if FIN
+		HeaderField<uint32_t, 2>,   // Sender connection id
+		HeaderField<uint32_t, 6>,   // Receiver connection id
+		HeaderField<uint64_t, 10>,  // Packet number
+		HeaderField<uint16_t, 18>,  // Stream id
+		HeaderField<uint64_t, 20>,  // Offset
+		HeaderField<uint16_t, 28>   // Length
+	)
 
 	/// Construct a DATA/FIN message with a given payload size
-	DATAWrapper(size_t payload_size, bool is_fin) : base(30 + payload_size) {
+	DATAWrapper(size_t payload_size, bool is_fin) : base(Schema::size + payload_size) {
 		base.set_payload({0, static_cast<uint8_t>(is_fin)});
 	}
 
 	/// Validate the DATA/FIN message
 	[[nodiscard]] bool validate(size_t payload_size) const {
-		return base.payload_buffer().size() >= 30 + payload_size;
+		return base.payload_buffer().size() >= Schema::size + payload_size;
 	}
 
 	/// Check if the FIN bit is set
@@ -190,6 +232,14 @@ struct ACKWrapper {
 	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
 	MARLIN_MESSAGES_UINT16_FIELD(size, 10);
 	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 12);
+	MARLIN_MESSAGES_SCHEMA(
+		HeaderField<uint8_t, 0>,    // Version
+		HeaderField<uint8_t, 1>,    // Type
+		HeaderField<uint32_t, 2>,   // Sender connection id
+		HeaderField<uint32_t, 6>,   // Receiver connection id
+		HeaderField<uint16_t, 10>,  // Number of ranges
+		HeaderField<uint64_t, 12>   // Largest packet number
+	)
 
 private:
 	struct range {
@@ -213,16 +263,17 @@ private:
 		}
 	};
 public:
-	MARLIN_MESSAGES_ARRAY_FIELD(range, 20, 20 + 8*size())
+	MARLIN_MESSAGES_ARRAY_FIELD(range, Schema::size, Schema::size + 8*size())
 
 	/// Construct an ACK message to hold a given number of ack ranges
-	ACKWrapper(size_t num_ranges) : base(20 + 8*num_ranges) {
+	ACKWrapper(size_t num_ranges) : base(Schema::size + 8*num_ranges) {
 		base.set_payload({0, 2});
 	}
 
 	/// Validate the ACK message
 	[[nodiscard]] bool validate() const {
-		if(base.payload_buffer().size() < 20 || base.payload_buffer().size() != 20 + (size_t)size()*8) {
+		auto buf_size = base.payload_buffer().size();
+		if(!Schema::validate(buf_size) || buf_size != Schema::size + (size_t)size()*8) {
 			return false;
 		}
 		return true;
@@ -265,6 +316,13 @@ struct DIALCONFWrapper {
 	[[nodiscard]] bool validate(size_t payload_size) const {
 		return base.payload_buffer().size() >= 10 + payload_size;
 	}
+
+	/// Highest wire version the sender accepts, sent after a payload of the given size
+	/// 0 from peers which do not negotiate versions
+	uint8_t max_version(size_t payload_size) const {
+		auto buf = base.payload_buffer();
+		return buf.size() > 10 + payload_size ? buf.read_uint8_unsafe(10 + payload_size) : 0;
+	}
 };
 
 /// CONF message template
@@ -274,15 +332,22 @@ struct CONFWrapper {
 	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
 	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
 
-	/// Construct a CONF message
-	CONFWrapper() : base(10) {
+	/// Construct a CONF message advertising the highest wire version the sender accepts
+	CONFWrapper(uint8_t max_version) : base(11) {
 		base.set_payload({0, 5});
+		base.payload_buffer().write_uint8_unsafe(10, max_version);
 	}
 
 	/// Validate the CONF message
 	[[nodiscard]] bool validate() const {
 		return base.payload_buffer().size() >= 10;
 	}
+
+	/// Highest wire version the sender accepts, 0 from peers which do not negotiate versions
+	uint8_t max_version() const {
+		auto buf = base.payload_buffer();
+		return buf.size() > 10 ? buf.read_uint8_unsafe(10) : 0;
+	}
 };
 
 /// RST message template
@@ -362,6 +427,25 @@ struct FLUSHCONFWrapper {
 	}
 };
 
+/// RETRY message template, sent in response to a DIAL without a valid cookie
+template<typename BaseMessageType>
+struct RETRYWrapper {
+	MARLIN_MESSAGES_BASE(RETRYWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_PAYLOAD_FIELD(10)
+
+	/// Construct a RETRY message to hold the given cookie size
+	RETRYWrapper(size_t payload_size) : base(10 + payload_size) {
+		base.set_payload({0, 10});
+	}
+
+	/// Validate the RETRY message
+	[[nodiscard]] bool validate(size_t payload_size) const {
+		return base.payload_buffer().size() >= 10 + payload_size;
+	}
+};
+
 /// CLOSE message template
 template<typename BaseMessageType>
 struct CLOSEWrapper {
@@ -399,10 +483,138 @@ struct CLOSECONFWrapper {
 	}
 };
 
+/// PROBE message template, padded to the datagram size being probed for path MTU discovery
+template<typename BaseMessageType>
+struct PROBEWrapper {
+	MARLIN_MESSAGES_BASE(PROBEWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 10);
+
+	/// Construct a PROBE message of the given total size, at least 18 bytes
+	PROBEWrapper(size_t size) : base(size) {
+		base.set_payload({0, 13});
+		std::memset(base.payload() + 18, 0, size - 18);
+	}
+
+	/// Validate the PROBE message
+	[[nodiscard]] bool validate() const {
+		return base.payload_buffer().size() >= 18;
+	}
+};
+
+/// FRAMES message template, wire version 1
+///
+/// Bundles small stream data and an ack into a single packet. Frames follow the header back to back:
+/// \li ACK frame: type 2, number of ranges (u16), largest packet number (u64), ranges (u64 each)
+/// \li Stream frame: type 0, 1 if FIN, stream id (u16), offset (u64), length (u16), data
+///
+/// Stream frames take consecutive packet numbers starting from the one in the header
+/// and are acked like DATA packets.
+template<typename BaseMessageType>
+struct FRAMESWrapper {
+	MARLIN_MESSAGES_BASE(FRAMESWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 10);
+	MARLIN_MESSAGES_PAYLOAD_FIELD(18);
+
+	/// Bytes before the first frame
+	static constexpr size_t header_size = 18;
+	/// Bytes before the ranges of an ACK frame
+	static constexpr size_t ack_frame_header_size = 11;
+	/// Bytes before the data of a stream frame
+	static constexpr size_t stream_frame_header_size = 13;
+
+	/// Iterator over the ranges of an ACK frame
+	struct ack_range_iterator {
+	private:
+		core::WeakBuffer buf;
+		size_t offset = 0;
+	public:
+		using difference_type = int32_t;
+		using value_type = uint64_t;
+		using pointer = value_type const*;
+		using reference = value_type const&;
+		using iterator_category = std::input_iterator_tag;
+
+		ack_range_iterator(core::WeakBuffer buf, size_t offset = 0) : buf(buf), offset(offset) {}
+
+		value_type operator*() const {
+			return buf.read_uint64_le_unsafe(offset);
+		}
+
+		ack_range_iterator& operator++() {
+			offset += 8;
+
+			return *this;
+		}
+
+		bool operator==(ack_range_iterator const& other) const {
+			return offset == other.offset;
+		}
+
+		bool operator!=(ack_range_iterator const& other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// Construct a FRAMES message to hold frames of the given total size
+	FRAMESWrapper(size_t frames_size) : base(header_size + frames_size) {
+		base.set_payload({1, 14});
+	}
+
+	/// Validate the FRAMES message, frames are checked while reading them
+	[[nodiscard]] bool validate() const {
+		auto buf = base.payload_buffer();
+		return buf.size() >= header_size && buf.read_uint8_unsafe(0) == 1;
+	}
+};
+
+/// PATHCHALLENGE message template, wire version 2
+/// Sent to a new address of the peer, which has to echo the token from there before the connection moves over
+template<typename BaseMessageType>
+struct PATHCHALLENGEWrapper {
+	MARLIN_MESSAGES_BASE(PATHCHALLENGEWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_UINT64_FIELD(token, 10);
+
+	/// Construct a PATHCHALLENGE message
+	PATHCHALLENGEWrapper() : base(18) {
+		base.set_payload({2, 15});
+	}
+
+	/// Validate the PATHCHALLENGE message
+	[[nodiscard]] bool validate() const {
+		return base.payload_buffer().size() >= 18;
+	}
+};
+
+/// PATHRESPONSE message template, wire version 2
+template<typename BaseMessageType>
+struct PATHRESPONSEWrapper {
+	MARLIN_MESSAGES_BASE(PATHRESPONSEWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_UINT64_FIELD(token, 10);
+
+	/// Construct a PATHRESPONSE message
+	PATHRESPONSEWrapper() : base(18) {
+		base.set_payload({2, 16});
+	}
+
+	/// Validate the PATHRESPONSE message
+	[[nodiscard]] bool validate() const {
+		return base.payload_buffer().size() >= 18;
+	}
+};
+
 #undef MARLIN_MESSAGES_UINT16_FIELD
 #undef MARLIN_MESSAGES_UINT32_FIELD
 #undef MARLIN_MESSAGES_UINT64_FIELD
 #undef MARLIN_MESSAGES_PAYLOAD_FIELD
+#undef MARLIN_MESSAGES_SCHEMA
 #undef MARLIN_MESSAGES_UINT_FIELD
 #undef MARLIN_MESSAGES_GET_4
 #undef MARLIN_MESSAGES_UINT_FIELD_SINGLE_OFFSET
@@ -7,6 +7,9 @@
 #include <unordered_map>
 #include <random>
 #include <utility>
+#include <vector>
+#include <array>
+#include <algorithm>
 
 #include <sodium.h>
 
@@ -20,6 +23,7 @@
 #include "protocol/RecvStream.hpp"
 #include "protocol/AckRanges.hpp"
 #include "Messages.hpp"
+#include "HandshakeGuard.hpp"
 
 namespace marlin {
 namespace stream {
@@ -29,7 +33,22 @@ namespace stream {
 /// Bytes that can be sent in a given batch, used by the packet pacing mechanism
 #define DEFAULT_PACING_LIMIT 400000
 /// Bytes that can be sent in a single packet to prevent fragmentation, accounts for header overheads
+/// Used until path MTU discovery confirms a larger datagram size
 #define DEFAULT_FRAGMENT_SIZE 1350
+/// Bytes a DATA packet adds to its payload, header, tag and nonce
+#define DEFAULT_DATA_OVERHEAD 58
+/// Probes of a datagram size lost before path MTU discovery gives up on it
+#define DEFAULT_MAX_PROBES 3
+/// Losses of packets above DEFAULT_FRAGMENT_SIZE, with none acked in between, before checking for a black hole
+#define DEFAULT_BLACK_HOLE_LOSSES 8
+/// Time after which datagram sizes that failed are probed again
+#define DEFAULT_PMTU_RAISE_INTERVAL 600000
+/// Challenges sent to a new address of the peer before giving up on it
+#define DEFAULT_MAX_PATH_CHALLENGES 3
+/// Stream data chunks smaller than this are bundled into FRAMES packets instead of getting a DATA packet each
+#define DEFAULT_COALESCE_LIMIT 512
+/// Paths a connection can spread its data over in multipath mode, including the one it was set up on
+#define DEFAULT_MAX_PATHS 4
 
 /// @brief Transport class which provides stream semantics.
 ///
@@ -42,6 +61,10 @@ namespace stream {
 /// \li Transport layer encryption (disabled by default)
 /// \li Stream multiplexing
 /// \li No head-of-line blocking
+/// \li Path MTU discovery, uses jumbo frames where the path carries them
+/// \li Small messages and acks bundled into shared packets with peers which support it
+/// \li Connections survive the peer changing address, the new address is validated before moving over
+/// \li Optional multipath, data is spread over subflows from several local addresses with per path congestion control
 template<typename DelegateType, template<typename> class DatagramTransport>
 class StreamTransport {
 private:
@@ -66,6 +89,10 @@ private:
 	using CONF = CONFWrapper<BaseMessageType>;
 	/// RST message type
 	using RST = RSTWrapper<BaseMessageType>;
+	/// Whether the base transport can send a packet with a payload inserted without copying
+	static constexpr bool has_gather_send = requires(BaseTransport &t, core::Buffer &&b, size_t o) {
+		t.send(std::move(b), std::move(b), o);
+	};
 	/// SKIPSTREAM message type
 	using SKIPSTREAM = SKIPSTREAMWrapper<BaseMessageType>;
 	/// FLUSHSTREAM message type
@@ -76,9 +103,23 @@ private:
 	using CLOSE = CLOSEWrapper<BaseMessageType>;
 	/// CLOSECONF message type
 	using CLOSECONF = CLOSECONFWrapper<BaseMessageType>;
-
-	/// Base transport instance
-	BaseTransport &transport;
+	/// RETRY message type
+	using RETRY = RETRYWrapper<BaseMessageType>;
+	/// PROBE message type
+	using PROBE = PROBEWrapper<BaseMessageType>;
+	/// Whether the base transport can send datagrams which must not be fragmented
+	static constexpr bool has_dont_fragment = requires(BaseTransport &t, BaseMessageType &&m) {
+		t.send_dont_fragment(std::move(m));
+	};
+	/// FRAMES message type
+	using FRAMES = FRAMESWrapper<BaseMessageType>;
+	/// PATHCHALLENGE message type
+	using PATHCHALLENGE = PATHCHALLENGEWrapper<BaseMessageType>;
+	/// PATHRESPONSE message type
+	using PATHRESPONSE = PATHRESPONSEWrapper<BaseMessageType>;
+
+	/// Base transport instance, replaced when the peer migrates to a new address
+	BaseTransport *transport;
 	/// Transport manager of self
 	core::TransportManager<Self> &transport_manager;
 
@@ -107,8 +148,14 @@ private:
 
 	/// Did we initiate the connection by dialling?
 	bool dialled = false;
+	/// Cookie from the last RETRY, echoed in DIALs
+	uint8_t dial_cookie[HandshakeGuard::cookie_size];
+	/// Do we have a cookie to echo?
+	bool has_dial_cookie = false;
 	/// Timer callback for handling DIAL timeouts
 	void dial_timer_cb();
+	/// Pick a random source connection id no other transport uses and register it
+	void new_src_conn_id();
 
 	// Streams
 	/// List of streams on which we send data
@@ -133,19 +180,42 @@ private:
 	/// Can happen if an ack is not received for a long time.
 	std::map<uint64_t, SentPacketInfo> lost_packets;
 
-	// RTT estimate
-	/// RTT estimate of connection
-	double rtt = -1;
-
-	// Congestion control
+	// Paths
+	/// Route to the peer, with its own RTT estimate and congestion control
+	struct Path {
+		/// Fresh transport whose base transport carries the path, nullptr for the connection's own
+		Self *subflow = nullptr;
+		/// Has the peer answered a challenge over the path? Data is only sent over validated paths
+		bool is_validated = true;
+
+		// RTT estimate
+		/// RTT estimate of path
+		double rtt = -1;
+
+		// Congestion control
+		uint64_t bytes_in_flight = 0;
+		uint64_t k = 0;
+		uint64_t w_max = 0;
+		uint64_t congestion_window = 100000;
+		uint64_t ssthresh = -1;
+		uint64_t congestion_start = 0;
+		uint64_t largest_acked = 0;
+		uint64_t largest_sent_time = 0;
+	};
+	/// Paths to the peer, the first one goes over the connection's own base transport
+	std::vector<Path> paths = std::vector<Path>(1);
+	/// Bytes in flight over all paths, used for pacing
 	uint64_t bytes_in_flight = 0;
-	uint64_t k = 0;
-	uint64_t w_max = 0;
-	uint64_t congestion_window = 100000;
-	uint64_t ssthresh = -1;
-	uint64_t congestion_start = 0;
-	uint64_t largest_acked = 0;
-	uint64_t largest_sent_time = 0;
+
+	/// Base transport of the given path
+	BaseTransport &path_transport(size_t path);
+	/// Bytes of data sent in a single packet over the given path
+	uint16_t fragment_size(size_t path);
+	/// Pick the path for the next packet with at most the given bytes of data.
+	/// Lowest RTT first among validated paths with room in their congestion window, -1 if there is none
+	int select_path(uint64_t length);
+	/// Helper function to cut the congestion window of a path on loss, once for all packets sent before the last cut
+	void congestion_event(Path &path, uint64_t sent_time);
 
 	// Send
 	/// List of stream ids with data ready to be sent
@@ -165,6 +235,14 @@ private:
 	int send_lost_data(uint64_t initial_bytes_in_flight);
 	/// Send any new data if possible
 	int send_new_data(SendStream &stream, uint64_t initial_bytes_in_flight);
+	/// Send a chunk of stream data over the given path, in a DATA packet or bundled with other small chunks
+	void send_stream_data(
+		SendStream &stream,
+		DataItem &data_item,
+		uint64_t offset,
+		uint16_t length,
+		uint8_t path
+	);
 
 	// Pacing
 	/// Timer to enforce packet pacing
@@ -189,9 +267,88 @@ private:
 	asyncio::Timer ack_timer;
 	/// Is the ack timer active?
 	bool ack_timer_active = false;
+	/// Path acks go back over, the one a packet last came in on
+	uint8_t ack_path = 0;
 	/// Timer callback for sending an ack
 	void ack_timer_cb();
 
+	// Path MTU discovery
+	/// Datagram sizes probed for, largest first.
+	/// 9000 byte jumbo frames, 4470 byte links and 1500 byte ethernet, less IPv6 and UDP headers
+	static constexpr uint16_t probe_sizes[] = {8952, 4052, 1452};
+	/// Bytes of data sent in a single packet, DEFAULT_FRAGMENT_SIZE until a larger datagram is confirmed
+	uint16_t max_fragment_size = DEFAULT_FRAGMENT_SIZE;
+	/// Largest datagram size which can still be probed for
+	uint16_t probe_ceiling = probe_sizes[0];
+	/// Datagram size being probed for, 0 if none
+	uint16_t probe_size = 0;
+	/// Packet number of the last probe sent
+	uint64_t probe_packet = 0;
+	/// Number of probes sent for the current probe size
+	uint8_t probe_count = 0;
+	/// Has path MTU discovery been started on the connection?
+	bool is_probing_started = false;
+	/// Losses of packets above DEFAULT_FRAGMENT_SIZE since one was last acked
+	uint8_t large_packets_lost = 0;
+	/// Timer to send probes and detect lost probes
+	asyncio::Timer probe_timer;
+	/// Timer callback for sending the next probe
+	void probe_timer_cb();
+	/// Start looking for a larger datagram size
+	void start_probing();
+	/// Helper function to account for a lost DATA packet, probes the datagram size in use again on repeated losses
+	void did_lose_packet(SentPacketInfo const& sent_packet);
+
+	// Frames
+	/// Highest wire version we accept, version 1 adds FRAMES, version 2 adds path validation, version 3 adds subflows.
+	/// FRAMES are not encrypted, so newer versions are only offered without encryption
+	static constexpr uint8_t max_version = is_encrypted ? 0 : 3;
+	/// Highest wire version the peer accepts, learnt during the handshake
+	uint8_t peer_version = 0;
+	/// Small stream data chunks waiting to be bundled into a FRAMES packet.
+	/// Filled and flushed within a single run of the pacing timer
+	std::vector<SentPacketInfo> pending_frames;
+	/// Bytes the pending chunks take up in a FRAMES packet
+	size_t pending_frames_size = 0;
+	/// Path the pending chunks go over
+	uint8_t pending_frames_path = 0;
+
+	// Migration
+	/// Is a new address of the peer being validated?
+	bool is_validating_path = false;
+	/// New address of the peer being validated
+	core::SocketAddress path_addr;
+	/// Token the peer has to echo from the new address
+	uint64_t path_challenge = 0;
+	/// Number of challenges sent to the new address
+	uint8_t path_challenge_count = 0;
+	/// Timer to resend challenges and give up on the new address
+	asyncio::Timer path_timer;
+	/// Timer callback for sending the next challenge
+	void path_timer_cb();
+	/// Stop validating the new address of the peer, closing the fresh transport created for it
+	void abandon_path();
+	/// Handle a packet received by a fresh transport created for a new address of the peer.
+	/// Returns false if the packet does not belong to this connection
+	bool did_recv_on_new_path(Self &path, BaseMessageType &&packet);
+	/// Move the connection over to the address of the given fresh transport, which goes away with the old address
+	void migrate(Self &path);
+
+	// Multipath
+	/// Paths the connection can use at once, 1 while multipath is off
+	uint8_t max_paths = 1;
+	/// Connection this transport carries a subflow of, nullptr if it is not a subflow.
+	/// Subflows pass everything they receive on to their connection
+	Self *subflow_of = nullptr;
+	/// Timer callback for sending the next challenge over a subflow, runs on the subflow
+	void subflow_timer_cb();
+	/// Path whose base transport is the given one, the first path if there is none
+	size_t path_of(BaseTransport &transport);
+	/// Helper function to drop the path of a closed subflow, data in flight over it is sent again over the others
+	void did_close_path(Self &subflow);
+	/// Close the subflows of all paths but the first
+	void close_paths();
+
 	// Protocol
 	void send_DIAL();
 	void did_recv_DIAL(DIAL &&packet);
@@ -209,12 +366,24 @@ private:
 		SendStream &stream,
 		DataItem &data_item,
 		uint64_t offset,
-		uint16_t length
+		uint16_t length,
+		uint8_t path
 	);
 	void did_recv_DATA(DATA &&packet);
+	/// Helper function to process stream data from a DATA packet or a stream frame
+	void did_recv_stream_data(
+		uint64_t packet_number,
+		uint16_t stream_id,
+		uint64_t offset,
+		bool is_fin,
+		core::Buffer &&data
+	);
 
 	void send_ACK();
 	void did_recv_ACK(ACK &&packet);
+	/// Helper function to process the ranges of an ACK packet or an ack frame
+	template<typename RangeIterator>
+	void did_recv_ack_ranges(uint64_t largest, RangeIterator begin, RangeIterator end);
 
 	void send_SKIPSTREAM(uint16_t stream_id, uint64_t offset);
 	void did_recv_SKIPSTREAM(SKIPSTREAM &&packet);
@@ -231,6 +400,21 @@ private:
 	void send_CLOSECONF(uint32_t src_conn_id, uint32_t dst_conn_id);
 	void did_recv_CLOSECONF(CLOSECONF &&packet);
 
+	void send_RETRY(uint32_t dst_conn_id);
+	void did_recv_RETRY(RETRY &&packet);
+
+	void send_PROBE(uint16_t size);
+	void did_recv_PROBE(PROBE &&packet);
+
+	void send_FRAMES();
+	void did_recv_FRAMES(FRAMES &&packet);
+
+	void send_PATHCHALLENGE(Self &path, uint64_t token);
+	void did_recv_PATHCHALLENGE(Self &path, PATHCHALLENGE &&packet);
+
+	void send_PATHRESPONSE(Self &path, uint64_t token);
+	void did_recv_PATHRESPONSE(Self &path, PATHRESPONSE &&packet);
+
 public:
 	/// Delegate calls from base transport
 	void did_dial(BaseTransport &transport, uint8_t const* remote_static_pk);
@@ -271,9 +455,18 @@ public:
 
 	/// Is the transport ready to send data?
 	bool is_active();
-	/// Get the RTT estimate of the connection
+	/// Get the RTT estimate of the connection, over the path it was set up on
 	double get_rtt();
 
+	/// Let the connection spread its data over up to the given number of paths, subflows the peer opens are accepted too.
+	/// Needs a peer which supports subflows to have any effect
+	void enable_multipath(uint8_t max_paths = DEFAULT_MAX_PATHS);
+	/// Can another path be added to the connection?
+	bool can_add_path();
+	/// Use the given fresh transport, going to another address of the peer or from another local address, as another path.
+	/// The path is validated before any data is sent over it, see StreamTransportFactory::add_path
+	bool add_path(Self &subflow);
+
 	/// Timer callback for SKIPSTREAM timeout
 	void skip_timer_cb(RecvStream& stream);
 	/// Ask the sender to skip to the end of the current transmission
@@ -321,9 +514,11 @@ template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	// Reset transport
 	conn_state = ConnectionState::Listen;
+	transport_manager.erase_conn_id(src_conn_id, this);
 	src_conn_id = 0;
 	dst_conn_id = 0;
 	dialled = false;
+	has_dial_cookie = false;
 	state_timer.stop();
 	state_timer_interval = 0;
 
@@ -342,16 +537,9 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	sent_packets.clear();
 	lost_packets.clear();
 
-	rtt = -1;
-
+	close_paths();
+	paths[0] = Path();
 	bytes_in_flight = 0;
-	k = 0;
-	w_max = 0;
-	congestion_window = 100000;
-	ssthresh = -1;
-	congestion_start = 0;
-	largest_acked = 0;
-	largest_sent_time = 0;
 
 	send_queue_ids.clear();
 	send_queue.clear();
@@ -365,6 +553,25 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	ack_ranges = AckRanges();
 	ack_timer.stop();
 	ack_timer_active = false;
+	ack_path = 0;
+
+	max_fragment_size = DEFAULT_FRAGMENT_SIZE;
+	probe_ceiling = probe_sizes[0];
+	probe_size = 0;
+	probe_count = 0;
+	is_probing_started = false;
+	large_packets_lost = 0;
+	probe_timer.stop();
+
+	peer_version = 0;
+	pending_frames.clear();
+	pending_frames_size = 0;
+	pending_frames_path = 0;
+
+	abandon_path();
+	is_validating_path = false;
+	path_challenge_count = 0;
+	path_timer.stop();
 }
 
 // Impl
@@ -379,7 +586,7 @@ void StreamTransport<DelegateType, DatagramTransport>::dial_timer_cb() {
 			this->dst_addr.to_string()
 		);
 		reset();
-		transport.close();
+		transport->close();
 		return;
 	}
 
@@ -391,6 +598,14 @@ void StreamTransport<DelegateType, DatagramTransport>::dial_timer_cb() {
 	);
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::new_src_conn_id() {
+	// Ids are shared by every connection of the factory, 0 is left for no connection
+	do {
+		src_conn_id = (uint32_t)std::random_device()();
+	} while(src_conn_id == 0 || !transport_manager.set_conn_id(src_conn_id, this));
+}
+
 //---------------- Stream functions begin ----------------//
 
 
@@ -456,7 +671,7 @@ int StreamTransport<DelegateType, DatagramTransport>::send_lost_data(
 	for(
 		auto iter = lost_packets.begin();
 		iter != lost_packets.end();
-		iter = lost_packets.erase(iter)
+		// Empty
 	) {
 		if(bytes_in_flight - initial_bytes_in_flight >= DEFAULT_PACING_LIMIT) {
 			// Pacing limit hit, reschedule timer
@@ -466,21 +681,34 @@ int StreamTransport<DelegateType, DatagramTransport>::send_lost_data(
 		}
 
 		auto &sent_packet = iter->second;
-		if(bytes_in_flight > congestion_window - sent_packet.length) {
+		auto path = select_path(sent_packet.length);
+		if(path < 0) {
 			return -2;
 		}
 
-		send_DATA(
+		// Packet might be larger than the path allows now, resend in pieces which fit
+		uint16_t length = std::min(sent_packet.length, fragment_size(path));
+
+		send_stream_data(
 			*sent_packet.stream,
 			*sent_packet.data_item,
 			sent_packet.offset,
-			sent_packet.length
+			length,
+			path
 		);
 
-		sent_packet.stream->bytes_in_flight += sent_packet.length;
-		bytes_in_flight += sent_packet.length;
+		sent_packet.stream->bytes_in_flight += length;
+		bytes_in_flight += length;
+		paths[path].bytes_in_flight += length;
 
 		SPDLOG_DEBUG("Lost packet sent: {}, {}", sent_packet.offset, last_sent_packet);
+
+		if(length < sent_packet.length) {
+			sent_packet.offset += length;
+			sent_packet.length -= length;
+		} else {
+			iter = lost_packets.erase(iter);
+		}
 	}
 
 	return 0;
@@ -498,26 +726,25 @@ int StreamTransport<DelegateType, DatagramTransport>::send_new_data(
 	) {
 		auto &data_item = *stream.next_item_iterator;
 
-		for(
-			uint64_t i = data_item.sent_offset;
-			i < data_item.data.size();
-			i+=DEFAULT_FRAGMENT_SIZE
-		) {
+		while(data_item.sent_offset < data_item.data.size()) {
 			auto remaining_bytes = data_item.data.size() - data_item.sent_offset;
-			uint16_t dsize = remaining_bytes > DEFAULT_FRAGMENT_SIZE ? DEFAULT_FRAGMENT_SIZE : remaining_bytes;
 
-			if(this->bytes_in_flight > this->congestion_window - dsize)
+			auto path = select_path(remaining_bytes);
+			if(path < 0)
 				return -2;
 
+			uint16_t dsize = std::min<uint64_t>(remaining_bytes, fragment_size(path));
+
 			if(this->bytes_in_flight - initial_bytes_in_flight > DEFAULT_PACING_LIMIT) {
 				return -1;
 			}
 
-			send_DATA(stream, data_item, i, dsize);
+			send_stream_data(stream, data_item, data_item.sent_offset, dsize, path);
 
 			stream.bytes_in_flight += dsize;
 			stream.sent_offset += dsize;
 			this->bytes_in_flight += dsize;
+			paths[path].bytes_in_flight += dsize;
 			data_item.sent_offset += dsize;
 		}
 	}
@@ -525,9 +752,115 @@ int StreamTransport<DelegateType, DatagramTransport>::send_new_data(
 	return 0;
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_stream_data(
+	SendStream &stream,
+	DataItem &data_item,
+	uint64_t offset,
+	uint16_t length,
+	uint8_t path
+) {
+	if(peer_version < 1 || length >= DEFAULT_COALESCE_LIMIT) {
+		send_DATA(stream, data_item, offset, length, path);
+		return;
+	}
+
+	// Flush first if the chunk goes over another path or does not fit in the same datagram
+	size_t frame_size = FRAMES::stream_frame_header_size + length;
+	if(path != pending_frames_path ||
+		pending_frames_size + frame_size > fragment_size(path) + DEFAULT_DATA_OVERHEAD - FRAMES::header_size) {
+		send_FRAMES();
+	}
+
+	// Packet number and send time are assigned when the FRAMES packet goes out
+	pending_frames.emplace_back(0, &stream, &data_item, offset, length, path);
+	pending_frames_size += frame_size;
+	pending_frames_path = path;
+}
+
 //---------------- Send functions end ----------------//
 
 
+//---------------- Path functions begin ----------------//
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+typename StreamTransport<DelegateType, DatagramTransport>::BaseTransport &StreamTransport<DelegateType, DatagramTransport>::path_transport(
+	size_t path
+) {
+	if(paths[path].subflow != nullptr) {
+		return *paths[path].subflow->transport;
+	}
+
+	return *transport;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint16_t StreamTransport<DelegateType, DatagramTransport>::fragment_size(
+	size_t path
+) {
+	// Path MTU discovery only runs on the first path
+	return path == 0 ? max_fragment_size : DEFAULT_FRAGMENT_SIZE;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::select_path(
+	uint64_t length
+) {
+	int selected = -1;
+	for(size_t i = 0; i < paths.size(); i++) {
+		auto &path = paths[i];
+		uint64_t size = std::min<uint64_t>(length, fragment_size(i));
+		if(!path.is_validated || path.bytes_in_flight + size > path.congestion_window) {
+			continue;
+		}
+
+		// Paths without an estimate yet come first so they get one
+		if(selected < 0 || path.rtt < paths[selected].rtt) {
+			selected = i;
+		}
+	}
+
+	return selected;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::congestion_event(
+	Path &path,
+	uint64_t sent_time
+) {
+	if(sent_time <= path.congestion_start) {
+		// Sent before the last cut, already accounted for
+		return;
+	}
+
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: Congestion event: {}",
+		src_addr.to_string(),
+		dst_addr.to_string(),
+		path.congestion_window
+	);
+	path.congestion_start = asyncio::EventLoop::now();
+
+	if(path.congestion_window < path.w_max) {
+		// Fast convergence
+		path.w_max = path.congestion_window;
+		path.congestion_window *= 0.6;
+	} else {
+		path.w_max = path.congestion_window;
+		path.congestion_window *= 0.75;
+	}
+
+	if(path.congestion_window < 10000) {
+		path.congestion_window = 10000;
+	}
+
+	path.ssthresh = path.congestion_window;
+	path.k = std::cbrt(path.w_max / 16)*1000;
+}
+
+//---------------- Path functions end ----------------//
+
+
 //---------------- Pacing functions begin ----------------//
 
 template<typename DelegateType, template<typename> class DatagramTransport>
@@ -538,6 +871,7 @@ void StreamTransport<DelegateType, DatagramTransport>::pacing_timer_cb() {
 
 	auto res = this->send_lost_data(initial_bytes_in_flight);
 	if(res < 0) {
+		send_FRAMES();
 		return;
 	}
 
@@ -557,11 +891,14 @@ void StreamTransport<DelegateType, DatagramTransport>::pacing_timer_cb() {
 			// Pacing limit hit, reschedule timer
 			this->is_pacing_timer_active = true;
 			pacing_timer.template start<Self, &Self::pacing_timer_cb>(1, 0);
-			return;
+			break;
 		} else { // Congestion window exhausted, break
-			return;
+			break;
 		}
 	}
+
+	// Chunks only point into the data items, which can go away once the batch is done
+	send_FRAMES();
 }
 
 //---------------- Pacing functions end ----------------//
@@ -580,72 +917,405 @@ void StreamTransport<DelegateType, DatagramTransport>::tlp_timer_cb() {
 
 	SPDLOG_DEBUG("TLP timer: {}, {}, {}", this->sent_packets.size(), this->lost_packets.size(), this->send_queue.size() == 0);
 
-	auto sent_iter = this->sent_packets.cbegin();
-
 	// Retry lost packets
 	// No condition necessary, all are considered lost if tail probe fails
-	while(sent_iter != this->sent_packets.cend()) {
-		this->bytes_in_flight -= sent_iter->second.length;
-		sent_iter->second.stream->bytes_in_flight -= sent_iter->second.length;
-		this->lost_packets[sent_iter->first] = sent_iter->second;
+	for(auto &[packet_number, sent_packet] : this->sent_packets) {
+		auto &path = this->paths[sent_packet.path];
+		this->bytes_in_flight -= sent_packet.length;
+		path.bytes_in_flight -= sent_packet.length;
+		sent_packet.stream->bytes_in_flight -= sent_packet.length;
+		this->lost_packets[packet_number] = sent_packet;
+		did_lose_packet(sent_packet);
 
-		sent_iter++;
+		// Lost packets, congestion event on each path they were sent over
+		congestion_event(path, sent_packet.sent_time);
 	}
 
-	if(sent_iter == this->sent_packets.cbegin()) {
-		// No lost packets, ignore
+	// Pop lost packets from sent
+	this->sent_packets.clear();
+
+	// New packets
+	this->send_pending_data();
+
+	// Next timer interval
+	if(this->tlp_interval < 25000) {
+		this->tlp_interval *= 2;
+		this->tlp_timer.template start<Self, &Self::tlp_timer_cb>(this->tlp_interval, 0);
 	} else {
-		// Lost packets, congestion event
-		auto last_iter = std::prev(sent_iter);
-		auto &sent_packet = last_iter->second;
-		if(sent_packet.sent_time > this->congestion_start) {
-			// New congestion event
+		// Abort on too many retries
+		SPDLOG_DEBUG("Lost peer: {}", this->dst_addr.to_string());
+		reset();
+		transport->close();
+	}
+}
+
+//---------------- TLP functions end ----------------//
+
+
+//---------------- Path MTU discovery functions begin ----------------//
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::start_probing() {
+	is_probing_started = true;
+
+	probe_size = 0;
+	probe_timer.template start<Self, &Self::probe_timer_cb>(0, 0);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::probe_timer_cb() {
+	if(probe_size != 0 && probe_count >= DEFAULT_MAX_PROBES) {
+		// Lost every probe, size does not fit the path
+		if(probe_size == max_fragment_size + DEFAULT_DATA_OVERHEAD) {
+			// Size in use stopped getting through, fall back and search below it
 			SPDLOG_DEBUG(
-				"Stream transport {{ Src: {}, Dst: {} }}: Timer congestion event: {}",
-				this->src_addr.to_string(),
-				this->dst_addr.to_string(),
-				this->congestion_window
+				"Stream transport {{ Src: {}, Dst: {} }}: Black hole detected at datagram size: {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				probe_size
 			);
-			this->congestion_start = asyncio::EventLoop::now();
+			max_fragment_size = DEFAULT_FRAGMENT_SIZE;
+		} else {
+			SPDLOG_DEBUG(
+				"Stream transport {{ Src: {}, Dst: {} }}: Datagram size failed: {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				probe_size
+			);
+		}
+		probe_ceiling = probe_size - 1;
+		probe_size = 0;
+	}
 
-			if(this->congestion_window < this->w_max) {
-				// Fast convergence
-				this->w_max = this->congestion_window;
-				this->congestion_window *= 0.6;
-			} else {
-				this->w_max = this->congestion_window;
-				this->congestion_window *= 0.75;
+	if(probe_size == 0) {
+		// Largest size which is still allowed and improves on the current one
+		for(auto size : probe_sizes) {
+			if(size <= probe_ceiling && size > max_fragment_size + DEFAULT_DATA_OVERHEAD) {
+				probe_size = size;
+				break;
 			}
+		}
+		probe_count = 0;
 
-			if(this->congestion_window < 10000) {
-				this->congestion_window = 10000;
+		if(probe_size == 0) {
+			// Search done, try sizes which failed again later in case the path changes
+			if(probe_ceiling < probe_sizes[0]) {
+				probe_ceiling = probe_sizes[0];
+				probe_timer.template start<Self, &Self::probe_timer_cb>(DEFAULT_PMTU_RAISE_INTERVAL, 0);
 			}
+			return;
+		}
+	}
+
+	send_PROBE(probe_size);
+	probe_count++;
 
-			this->ssthresh = this->congestion_window;
+	auto rtt = paths[0].rtt;
+	uint64_t probe_timeout = rtt < 0 ? 1000 : std::max<uint64_t>(3 * rtt, 100);
+	probe_timer.template start<Self, &Self::probe_timer_cb>(probe_timeout, 0);
+}
 
-			this->k = std::cbrt(this->w_max / 16)*1000;
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_lose_packet(
+	SentPacketInfo const& sent_packet
+) {
+	// Only packets of the size currently in use count, larger ones are from before a fall back
+	if(sent_packet.length <= DEFAULT_FRAGMENT_SIZE || sent_packet.length > max_fragment_size) {
+		return;
+	}
+
+	if(++large_packets_lost < DEFAULT_BLACK_HOLE_LOSSES) {
+		return;
+	}
+	large_packets_lost = 0;
+
+	uint16_t size = max_fragment_size + DEFAULT_DATA_OVERHEAD;
+	if(probe_size == size) {
+		// Already being checked
+		return;
+	}
+
+	// Could just be congestion, only fall back if probes of the size in use stop getting through too
+	probe_size = size;
+	probe_count = 0;
+	probe_timer.template start<Self, &Self::probe_timer_cb>(0, 0);
+}
+
+//---------------- Path MTU discovery functions end ----------------//
+
+
+//---------------- Migration functions begin ----------------//
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+bool StreamTransport<DelegateType, DatagramTransport>::did_recv_on_new_path(
+	Self &path,
+	BaseMessageType &&packet
+) {
+	// Older peers do not answer challenges
+	if(conn_state != ConnectionState::Established || peer_version < 2) {
+		return false;
+	}
+
+	if(packet.payload_buffer().read_uint32_le_unsafe(2) != dst_conn_id) {
+		return false;
+	}
+
+	auto type = packet.payload_buffer().read_uint8_unsafe(1);
+	if(type == 16) {
+		did_recv_PATHRESPONSE(path, std::move(packet));
+		return true;
+	}
+
+	// Challenges only come from a new address when the peer opens a subflow, it is not moving
+	if(type == 15) {
+		if(add_path(path)) {
+			did_recv(*path.transport, std::move(packet));
 		}
+		return true;
+	}
 
-		// Pop lost packets from sent
-		this->sent_packets.erase(this->sent_packets.cbegin(), sent_iter);
+	// Can only move over to a transport of the same factory
+	if(&path.transport_manager != &transport_manager) {
+		return false;
 	}
 
-	// New packets
-	this->send_pending_data();
+	if(!is_validating_path || !(path_addr == path.dst_addr)) {
+		// Only the latest address of the peer is validated
+		abandon_path();
 
-	// Next timer interval
-	if(this->tlp_interval < 25000) {
-		this->tlp_interval *= 2;
-		this->tlp_timer.template start<Self, &Self::tlp_timer_cb>(this->tlp_interval, 0);
-	} else {
-		// Abort on too many retries
-		SPDLOG_DEBUG("Lost peer: {}", this->dst_addr.to_string());
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: Peer seen at new address: {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			path.dst_addr.to_string()
+		);
+
+		is_validating_path = true;
+		path_addr = path.dst_addr;
+		randombytes_buf(&path_challenge, sizeof(path_challenge));
+		path_challenge_count = 0;
+		path_timer.template start<Self, &Self::path_timer_cb>(0, 0);
+	}
+
+	// Keep going while the address is validated, replies go to the old address until then
+	did_recv(*transport, std::move(packet));
+
+	return true;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::path_timer_cb() {
+	auto *path = transport_manager.get(path_addr);
+	bool is_path_fresh = path != nullptr && path->conn_state == ConnectionState::Listen;
+	if(!is_path_fresh || path_challenge_count >= DEFAULT_MAX_PATH_CHALLENGES) {
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: Path validation failed: {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			path_addr.to_string()
+		);
+		abandon_path();
+		return;
+	}
+
+	send_PATHCHALLENGE(*path, path_challenge);
+	path_challenge_count++;
+
+	auto rtt = paths[0].rtt;
+	uint64_t path_timeout = rtt < 0 ? 1000 : std::max<uint64_t>(3 * rtt, 100);
+	path_timer.template start<Self, &Self::path_timer_cb>(path_timeout, 0);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::abandon_path() {
+	if(!is_validating_path || subflow_of != nullptr) {
+		return;
+	}
+
+	is_validating_path = false;
+	path_timer.stop();
+
+	auto *path = transport_manager.get(path_addr);
+	if(path != nullptr && path != this && path->conn_state == ConnectionState::Listen && path->subflow_of == nullptr) {
+		path->reset();
+		path->transport->close();
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::migrate(
+	Self &path
+) {
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: Migrating to: {}",
+		src_addr.to_string(),
+		dst_addr.to_string(),
+		path.dst_addr.to_string()
+	);
+
+	is_validating_path = false;
+	path_timer.stop();
+
+	// Connection takes over the base transport of the new address, streams, packets
+	// in flight and congestion state stay as they are
+	std::swap(transport, path.transport);
+	transport->setup(this);
+	path.transport->setup(&path);
+
+	transport_manager.swap(dst_addr, path.dst_addr);
+	std::swap(dst_addr, path.dst_addr);
+
+	// Old address goes away with the fresh transport
+	path.reset();
+	path.transport->close();
+}
+
+//---------------- Migration functions end ----------------//
+
+
+//---------------- Multipath functions begin ----------------//
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::enable_multipath(
+	uint8_t max_paths
+) {
+	this->max_paths = std::clamp<uint8_t>(max_paths, 1, DEFAULT_MAX_PATHS);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+bool StreamTransport<DelegateType, DatagramTransport>::can_add_path() {
+	// Older peers would take a subflow for the connection moving
+	return conn_state == ConnectionState::Established && peer_version >= 3 && paths.size() < max_paths;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+bool StreamTransport<DelegateType, DatagramTransport>::add_path(
+	Self &subflow
+) {
+	if(!can_add_path() || subflow.conn_state != ConnectionState::Listen || subflow.subflow_of != nullptr) {
+		return false;
+	}
+
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: Adding path: {} -> {}",
+		src_addr.to_string(),
+		dst_addr.to_string(),
+		subflow.src_addr.to_string(),
+		subflow.dst_addr.to_string()
+	);
+
+	subflow.subflow_of = this;
+	subflow.transport->setup(&subflow);
+
+	auto &path = paths.emplace_back();
+	path.subflow = &subflow;
+	path.is_validated = false;
+
+	// Both sides challenge the peer over the path before sending data over it
+	subflow.is_validating_path = true;
+	randombytes_buf(&subflow.path_challenge, sizeof(subflow.path_challenge));
+	subflow.path_challenge_count = 0;
+	subflow.path_timer.template start<Self, &Self::subflow_timer_cb>(0, 0);
+
+	return true;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::subflow_timer_cb() {
+	if(path_challenge_count >= DEFAULT_MAX_PATH_CHALLENGES) {
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: Subflow validation failed",
+			src_addr.to_string(),
+			dst_addr.to_string()
+		);
+		// Connection drops the path once the subflow is closed
 		reset();
-		transport.close();
+		transport->close();
+		return;
 	}
+
+	subflow_of->send_PATHCHALLENGE(*this, path_challenge);
+	path_challenge_count++;
+
+	auto rtt = subflow_of->paths[0].rtt;
+	uint64_t path_timeout = rtt < 0 ? 1000 : std::max<uint64_t>(3 * rtt, 100);
+	path_timer.template start<Self, &Self::subflow_timer_cb>(path_timeout, 0);
 }
 
-//---------------- TLP functions end ----------------//
+template<typename DelegateType, template<typename> class DatagramTransport>
+size_t StreamTransport<DelegateType, DatagramTransport>::path_of(
+	BaseTransport &transport
+) {
+	for(size_t i = 1; i < paths.size(); i++) {
+		if(paths[i].subflow->transport == &transport) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_close_path(
+	Self &subflow
+) {
+	size_t index = 1;
+	while(index < paths.size() && paths[index].subflow != &subflow) {
+		index++;
+	}
+	if(index == paths.size()) {
+		return;
+	}
+
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: Path closed: {} -> {}",
+		src_addr.to_string(),
+		dst_addr.to_string(),
+		subflow.src_addr.to_string(),
+		subflow.dst_addr.to_string()
+	);
+
+	// Data in flight over the path is sent again over the others, later paths move down a place
+	for(auto iter = sent_packets.begin(); iter != sent_packets.end(); /* Empty */) {
+		auto &sent_packet = iter->second;
+		if(sent_packet.path == index) {
+			bytes_in_flight -= sent_packet.length;
+			sent_packet.stream->bytes_in_flight -= sent_packet.length;
+			lost_packets[iter->first] = sent_packet;
+			iter = sent_packets.erase(iter);
+			continue;
+		}
+
+		if(sent_packet.path > index) {
+			sent_packet.path--;
+		}
+		iter++;
+	}
+
+	paths.erase(paths.begin() + index);
+	if(ack_path == index) {
+		ack_path = 0;
+	} else if(ack_path > index) {
+		ack_path--;
+	}
+
+	send_pending_data();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::close_paths() {
+	for(size_t i = 1; i < paths.size(); i++) {
+		auto *subflow = paths[i].subflow;
+		// Connection is going away with its paths, no need to hear back
+		subflow->subflow_of = nullptr;
+		subflow->reset();
+		subflow->transport->close();
+	}
+
+	paths.resize(1);
+}
+
+//---------------- Multipath functions end ----------------//
 
 
 //---------------- ACK functions begin ----------------//
@@ -674,16 +1344,23 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DIAL() {
 	constexpr size_t pt_len = crypto_box_PUBLICKEYBYTES + crypto_kx_PUBLICKEYBYTES;
 	constexpr size_t ct_len = pt_len + crypto_box_SEALBYTES;
 
-	uint8_t buf[ct_len];
+	// Cookie goes after the sealed box, peers without cookie support ignore it
+	uint8_t buf[ct_len + HandshakeGuard::cookie_size];
 	std::memcpy(buf, static_pk, crypto_box_PUBLICKEYBYTES);
 	std::memcpy(buf + crypto_box_PUBLICKEYBYTES, ephemeral_pk, crypto_kx_PUBLICKEYBYTES);
 	crypto_box_seal(buf, buf, pt_len, remote_static_pk);
 
-	transport.send(
-		DIAL(ct_len)
+	size_t len = ct_len;
+	if(has_dial_cookie) {
+		std::memcpy(buf + ct_len, dial_cookie, HandshakeGuard::cookie_size);
+		len += HandshakeGuard::cookie_size;
+	}
+
+	transport->send(
+		DIAL(len)
 		.set_src_conn_id(this->src_conn_id)
 		.set_dst_conn_id(this->dst_conn_id)
-		.set_payload(buf, ct_len)
+		.set_payload(buf, len)
 	);
 }
 
@@ -717,9 +1394,34 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIAL(
 			spdlog::to_hex(static_pk, static_pk+crypto_box_PUBLICKEYBYTES)
 		);
 
+		auto& guard = HandshakeGuard::default_instance();
+		if(guard.is_required()) {
+			// Prove the source is return routable before doing any public key crypto
+			if(!packet.validate(ct_len + HandshakeGuard::cookie_size)) {
+				guard.drop_stats.cookie_missing++;
+				send_RETRY(packet.dst_conn_id());
+				// Keep no state for the peer until it echoes the cookie
+				transport->close();
+				return;
+			}
+
+			if(!guard.verify(packet.payload() + ct_len, dst_addr, packet.dst_conn_id(), asyncio::EventLoop::now())) {
+				SPDLOG_DEBUG(
+					"Stream transport {{ Src: {}, Dst: {} }}: DIAL: Invalid cookie",
+					src_addr.to_string(),
+					dst_addr.to_string()
+				);
+				guard.drop_stats.cookie_invalid++;
+				send_RETRY(packet.dst_conn_id());
+				transport->close();
+				return;
+			}
+		}
+
 		uint8_t pt[pt_len];
 		auto res = crypto_box_seal_open(pt, packet.payload(), ct_len, static_pk, static_sk);
 		if (res < 0) {
+			guard.drop_stats.unseal_failed++;
 			SPDLOG_DEBUG(
 				"Stream transport {{ Src: {}, Dst: {} }}: DIAL: Unseal failure: {}",
 				src_addr.to_string(),
@@ -748,7 +1450,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIAL(
 		crypto_aead_aes256gcm_beforenm(&tx_ctx, tx);
 
 		this->dst_conn_id = packet.dst_conn_id();
-		this->src_conn_id = (uint32_t)std::random_device()();
+		new_src_conn_id();
 
 		send_DIALCONF();
 
@@ -826,19 +1528,63 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIAL(
 	}
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_RETRY(
+	uint32_t dst_conn_id
+) {
+	uint8_t cookie[HandshakeGuard::cookie_size];
+	HandshakeGuard::default_instance().generate(cookie, dst_addr, dst_conn_id, asyncio::EventLoop::now());
+
+	// No src id, nothing is allocated for the peer yet
+	transport->send(
+		RETRY(HandshakeGuard::cookie_size)
+		.set_src_conn_id(0)
+		.set_dst_conn_id(dst_conn_id)
+		.set_payload(cookie, HandshakeGuard::cookie_size)
+	);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_RETRY(
+	RETRY &&packet
+) {
+	if(!packet.validate(HandshakeGuard::cookie_size)) {
+		return;
+	}
+
+	if(conn_state != ConnectionState::DialSent || packet.src_conn_id() != this->src_conn_id) {
+		// Not answering our DIAL
+		return;
+	}
+
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: RETRY <<<<",
+		src_addr.to_string(),
+		dst_addr.to_string()
+	);
+
+	std::memcpy(dial_cookie, packet.payload(), HandshakeGuard::cookie_size);
+	has_dial_cookie = true;
+
+	// Dial timer keeps running and bounds the handshake as before
+	send_DIAL();
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_DIALCONF() {
 	constexpr size_t pt_len = crypto_kx_PUBLICKEYBYTES;
 	constexpr size_t ct_len = pt_len + crypto_box_SEALBYTES;
 
-	uint8_t buf[ct_len];
+	// Highest wire version goes after the sealed box, peers without versioning ignore it
+	uint8_t buf[ct_len + 1];
 	crypto_box_seal(buf, ephemeral_pk, pt_len, remote_static_pk);
+	buf[ct_len] = max_version;
 
-	transport.send(
-		DIALCONF(ct_len)
+	transport->send(
+		DIALCONF(ct_len + 1)
 		.set_src_conn_id(this->src_conn_id)
 		.set_dst_conn_id(this->dst_conn_id)
-		.set_payload(buf, ct_len)
+		.set_payload(buf, ct_len + 1)
 	);
 }
 
@@ -899,6 +1645,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIALCONF(
 		state_timer_interval = 0;
 
 		this->dst_conn_id = packet.dst_conn_id();
+		peer_version = packet.max_version(ct_len);
 
 		send_CONF();
 
@@ -935,6 +1682,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIALCONF(
 		state_timer.stop();
 		state_timer_interval = 0;
 
+		peer_version = packet.max_version(ct_len);
+
 		send_CONF();
 
 		conn_state = ConnectionState::Established;
@@ -989,8 +1738,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIALCONF(
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_CONF() {
-	transport.send(
-		CONF()
+	transport->send(
+		CONF(max_version)
 		.set_src_conn_id(this->src_conn_id)
 		.set_dst_conn_id(this->dst_conn_id)
 	);
@@ -1023,6 +1772,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CONF(
 			return;
 		}
 
+		peer_version = packet.max_version();
 		conn_state = ConnectionState::Established;
 
 		if(dialled) {
@@ -1050,6 +1800,9 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CONF(
 			return;
 		}
 
+		// Connection can be established by DATA before CONF arrives
+		peer_version = packet.max_version();
+
 		break;
 	}
 
@@ -1078,7 +1831,7 @@ void StreamTransport<DelegateType, DatagramTransport>::send_RST(
 	uint32_t src_conn_id,
 	uint32_t dst_conn_id
 ) {
-	transport.send(
+	transport->send(
 		RST()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1102,11 +1855,11 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_RST(
 			dst_addr.to_string()
 		);
 		reset();
-		transport.close();
+		transport->close();
 	} else if (conn_state == ConnectionState::Listen) {
 		// Remove idle connection, usually happens if multiple RST are sent
 		reset();
-		transport.close();
+		transport->close();
 	}
 }
 
@@ -1115,26 +1868,39 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DATA(
 	SendStream &stream,
 	DataItem &data_item,
 	uint64_t offset,
-	uint16_t length
+	uint16_t length,
+	uint8_t path
 ) {
 	this->last_sent_packet++;
 
 	bool is_fin = (stream.done_queueing &&
 		data_item.stream_offset + offset + length >= stream.queue_offset);
 
-	auto packet = DATA(12 + length + crypto_aead_aes256gcm_ABYTES, is_fin)
-					.set_src_conn_id(src_conn_id)
-					.set_dst_conn_id(dst_conn_id)
-					.set_packet_number(this->last_sent_packet)
-					.set_stream_id(stream.stream_id)
-					.set_offset(data_item.stream_offset + offset)
-					.set_length(length)
+	// Without encryption the payload is never touched, send a reference to the
+	// data item slice along with header and trailer instead of copying it
+	constexpr bool is_gather = !is_encrypted && has_gather_send;
+
+	auto packet = DATA(12 + (is_gather ? 0 : length) + crypto_aead_aes256gcm_ABYTES, is_fin)
+					.set_header(
+						0,
+						is_fin,
+						src_conn_id,
+						dst_conn_id,
+						this->last_sent_packet,
+						stream.stream_id,
+						data_item.stream_offset + offset,
+						length
+					)
 					.payload_buffer();
 
 	// Figure out better way
 	packet.uncover_unsafe(30);
-	packet.write_unsafe(30, data_item.data.data()+offset, length);
-	packet.write_unsafe(30 + length + crypto_aead_aes256gcm_ABYTES, nonce, 12);
+	if constexpr (is_gather) {
+		packet.write_unsafe(30 + crypto_aead_aes256gcm_ABYTES, nonce, 12);
+	} else {
+		packet.write_unsafe(30, data_item.data.data()+offset, length);
+		packet.write_unsafe(30 + length + crypto_aead_aes256gcm_ABYTES, nonce, 12);
+	}
 
 	if constexpr (is_encrypted) {
 		crypto_aead_aes256gcm_encrypt_afternm(
@@ -1159,11 +1925,20 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DATA(
 			&stream,
 			&data_item,
 			offset,
-			length
+			length,
+			path
 		)
 	);
 
-	transport.send(std::move(packet));
+	if constexpr (is_gather) {
+		// Shared so the slice outlives the data item if the stream goes away mid send
+		auto payload = data_item.data.share();
+		payload.cover_unsafe(offset);
+		payload.truncate_unsafe(payload.size() - length);
+		path_transport(path).send(std::move(packet), std::move(payload), 30);
+	} else {
+		path_transport(path).send(std::move(packet));
+	}
 
 	if(is_fin && stream.state != SendStream::State::Acked) {
 		stream.state = SendStream::State::Sent;
@@ -1220,7 +1995,33 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 		}
 	}
 
-	SPDLOG_TRACE("DATA <<< {}: {}, {}", dst_addr.to_string(), packet.offset(), packet.length());
+	// Rest of the header is only readable after decryption
+	auto [packet_number, stream_id, offset, length] = packet.template read_header<4, 5, 6, 7>();
+
+	SPDLOG_TRACE("DATA <<< {}: {}, {}", dst_addr.to_string(), offset, length);
+
+	bool is_fin = packet.is_fin_set();
+	auto p = std::move(packet).payload_buffer();
+	p.truncate_unsafe(crypto_aead_aes256gcm_ABYTES + 12);
+
+	// Check if length matches packet
+	// FIXME: Why even have length? Can just set from the packet
+	if(p.size() != length) {
+		return;
+	}
+
+	did_recv_stream_data(packet_number, stream_id, offset, is_fin, std::move(p));
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_stream_data(
+	uint64_t packet_number,
+	uint16_t stream_id,
+	uint64_t offset,
+	bool is_fin,
+	core::Buffer &&p
+) {
+	uint64_t length = p.size();
 
 	if(conn_state == ConnectionState::DialRcvd) {
 		conn_state = ConnectionState::Established;
@@ -1232,11 +2033,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 		return;
 	}
 
-	auto offset = packet.offset();
-	auto length = packet.length();
-	auto packet_number = packet.packet_number();
-
-	auto &stream = get_or_create_recv_stream(packet.stream_id());
+	auto &stream = get_or_create_recv_stream(stream_id);
 
 	// Short circuit once stream has been received fully.
 	if(stream.state == RecvStream::State::AllRecv ||
@@ -1250,20 +2047,11 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	}
 
 	// Set stream size if fin bit set
-	if(packet.is_fin_set() && stream.state == RecvStream::State::Recv) {
+	if(is_fin && stream.state == RecvStream::State::Recv) {
 		stream.size = offset + length;
 		stream.state = RecvStream::State::SizeKnown;
 	}
 
-	auto p = std::move(packet).payload_buffer();
-	p.truncate_unsafe(crypto_aead_aes256gcm_ABYTES + 12);
-
-	// Check if length matches packet
-	// FIXME: Why even have length? Can just set from the packet
-	if(p.size() != length) {
-		return;
-	}
-
 	// Add to ack range
 	ack_ranges.add_packet_number(packet_number);
 
@@ -1347,12 +2135,9 @@ template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_ACK() {
 	size_t size = ack_ranges.ranges.size() > 171 ? 171 : ack_ranges.ranges.size();
 
-	transport.send(
+	path_transport(ack_path).send(
 		ACK(size)
-		.set_src_conn_id(src_conn_id)
-		.set_dst_conn_id(dst_conn_id)
-		.set_packet_number(ack_ranges.largest)
-		.set_size(size)
+		.set_header(0, 2, src_conn_id, dst_conn_id, size, ack_ranges.largest)
 		.set_ranges(ack_ranges.ranges.begin(), ack_ranges.ranges.end())
 	);
 }
@@ -1369,8 +2154,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		return;
 	}
 
-	auto src_conn_id = packet.src_conn_id();
-	auto dst_conn_id = packet.dst_conn_id();
+	auto [dst_conn_id, src_conn_id, largest] = packet.template read_header<2, 3, 5>();
 	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id, send RST
 		SPDLOG_DEBUG(
 			"Stream transport {{ Src: {}, Dst: {} }}: ACK: Connection id mismatch: {}, {}, {}, {}",
@@ -1385,33 +2169,37 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		return;
 	}
 
-	auto now = asyncio::EventLoop::now();
-
-	uint64_t largest = packet.packet_number();
+	did_recv_ack_ranges(largest, packet.ranges_begin(), packet.ranges_end());
+}
 
-	// New largest acked packet
-	if(largest > largest_acked && sent_packets.find(largest) != sent_packets.end()) {
-		auto &sent_packet = sent_packets[largest];
+template<typename DelegateType, template<typename> class DatagramTransport>
+template<typename RangeIterator>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_ack_ranges(
+	uint64_t largest,
+	RangeIterator begin,
+	RangeIterator end
+) {
+	auto now = asyncio::EventLoop::now();
 
-		// Update largest packet details
-		largest_acked = largest;
-		largest_sent_time = sent_packet.sent_time;
+	// Look for a larger datagram size once data is flowing and probes can be timed
+	if(!is_probing_started && paths[0].rtt >= 0) {
+		start_probing();
+	}
 
-		// Update RTT estimate
-		if(rtt < 0) {
-			rtt = now - sent_packet.sent_time;
-		} else {
-			rtt = 0.875 * rtt + 0.125 * (now - sent_packet.sent_time);
-		}
+	// State of each path before the ack, the RTT estimate takes one sample per path and ack
+	std::array<double, DEFAULT_MAX_PATHS> initial_rtt;
+	std::array<bool, DEFAULT_MAX_PATHS> is_app_limited;
+	for(size_t i = 0; i < paths.size(); i++) {
+		initial_rtt[i] = paths[i].rtt;
+		is_app_limited[i] = (paths[i].bytes_in_flight < 0.8 * paths[i].congestion_window);
 	}
 
 	uint64_t high = largest;
 	bool gap = false;
-	bool is_app_limited = (bytes_in_flight < 0.8 * congestion_window);
 
 	for(
-		auto iter = packet.ranges_begin();
-		iter != packet.ranges_end();
+		auto iter = begin;
+		iter != end;
 		++iter, gap = !gap
 	) {
 		uint64_t range = *iter;
@@ -1424,6 +2212,20 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 			continue;
 		}
 
+		// Probe got through, datagrams of its size fit the path
+		if(probe_size != 0 && probe_packet >= low + 1 && probe_packet <= high) {
+			SPDLOG_DEBUG(
+				"Stream transport {{ Src: {}, Dst: {} }}: Datagram size confirmed: {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				probe_size
+			);
+			max_fragment_size = probe_size - DEFAULT_DATA_OVERHEAD;
+			large_packets_lost = 0;
+			probe_size = 0;
+			probe_timer.template start<Self, &Self::probe_timer_cb>(0, 0);
+		}
+
 		// Get packets within range [low+1, high]
 		auto low_iter = sent_packets.lower_bound(low + 1);
 		auto high_iter = sent_packets.upper_bound(high);
@@ -1436,6 +2238,22 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		) {
 			auto &sent_packet = low_iter->second;
 			auto &stream = *sent_packet.stream;
+			auto &path = paths[sent_packet.path];
+
+			// New largest acked packet of its path
+			if(low_iter->first > path.largest_acked) {
+				// Update largest packet details
+				path.largest_acked = low_iter->first;
+				path.largest_sent_time = sent_packet.sent_time;
+
+				// Update RTT estimate, replacing any sample from a smaller packet of this ack
+				auto initial = initial_rtt[sent_packet.path];
+				if(initial < 0) {
+					path.rtt = now - sent_packet.sent_time;
+				} else {
+					path.rtt = 0.875 * initial + 0.125 * (now - sent_packet.sent_time);
+				}
+			}
 
 			auto sent_offset = sent_packet.data_item->stream_offset + sent_packet.offset;
 
@@ -1492,27 +2310,31 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 			// Cleanup
 			stream.bytes_in_flight -= sent_packet.length;
 			bytes_in_flight -= sent_packet.length;
+			path.bytes_in_flight -= sent_packet.length;
+			if(sent_packet.length > DEFAULT_FRAGMENT_SIZE) {
+				large_packets_lost = 0;
+			}
 
-			SPDLOG_TRACE("Times: {}, {}", sent_packet.sent_time, congestion_start);
+			SPDLOG_TRACE("Times: {}, {}", sent_packet.sent_time, path.congestion_start);
 
 			// Congestion control
 			// Check if not in congestion recovery and not application limited
-			if(sent_packet.sent_time > congestion_start && !is_app_limited) {
-				if(congestion_window < ssthresh) {
+			if(sent_packet.sent_time > path.congestion_start && !is_app_limited[sent_packet.path]) {
+				if(path.congestion_window < path.ssthresh) {
 					// Slow start, exponential increase
-					congestion_window += sent_packet.length;
+					path.congestion_window += sent_packet.length;
 				} else {
 					// Congestion avoidance, CUBIC
-					// auto k = k;
-					// auto t = now - congestion_start;
-					// congestion_window = w_max + 4 * std::pow(0.001 * (t - k), 3);
+					// auto k = path.k;
+					// auto t = now - path.congestion_start;
+					// path.congestion_window = path.w_max + 4 * std::pow(0.001 * (t - k), 3);
 
-					// if(congestion_window < 10000) {
-					// 	congestion_window = 10000;
+					// if(path.congestion_window < 10000) {
+					// 	path.congestion_window = 10000;
 					// }
 
 					// Congestion avoidance, NEW RENO
-					congestion_window += 1500 * sent_packet.length / congestion_window;
+					path.congestion_window += 1500 * sent_packet.length / path.congestion_window;
 				}
 			}
 
@@ -1534,70 +2356,52 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		high = low;
 	}
 
-	auto sent_iter = sent_packets.begin();
+	// Packets go out in order of send time, nothing sent after this can be lost yet
+	uint64_t largest_sent_time = 0;
+	for(auto &path : paths) {
+		largest_sent_time = std::max(largest_sent_time, path.largest_sent_time);
+	}
 
-	// Determine lost packets
+	// Determine lost packets, each path on its own as paths deliver in order only within themselves
+	auto sent_iter = sent_packets.begin();
 	while(sent_iter != sent_packets.end()) {
+		auto &sent_packet = sent_iter->second;
+		bool is_timed_out = now > sent_packet.sent_time + DEFAULT_TLP_INTERVAL;
+		if(largest_sent_time <= sent_packet.sent_time + 50 && !is_timed_out) {
+			break;
+		}
+
+		auto &path = paths[sent_packet.path];
+
 		// Condition for packet in flight to be considered lost
 		// 1. more than 20 packets before largest acked - disabled for now
-		// 2. more than 25ms before before largest acked
+		// 2. more than 25ms before before largest acked on its path
+		// 3. not acked for a tlp interval while acks keep coming, its path might have stopped delivering
 		if (/*sent_iter->first + 20 < largest_acked ||*/
-			largest_sent_time > sent_iter->second.sent_time + 50) {
+			path.largest_sent_time > sent_packet.sent_time + 50 || is_timed_out) {
 			SPDLOG_TRACE(
 				"Stream transport {{ Src: {}, Dst: {} }}: Lost packet: {}, {}, {}",
-				transport.src_addr.to_string(),
-				transport.dst_addr.to_string(),
+				path_transport(sent_packet.path).src_addr.to_string(),
+				path_transport(sent_packet.path).dst_addr.to_string(),
 				sent_iter->first,
-				largest_sent_time,
-				sent_iter->second.sent_time
+				path.largest_sent_time,
+				sent_packet.sent_time
 			);
 
-			bytes_in_flight -= sent_iter->second.length;
-			sent_iter->second.stream->bytes_in_flight -= sent_iter->second.length;
-			lost_packets[sent_iter->first] = sent_iter->second;
-
-			sent_iter++;
-		} else {
-			break;
-		}
-	}
-
-	if(sent_iter == sent_packets.begin()) {
-		// No lost packets, ignore
-	} else {
-		// Lost packets, congestion event
-		auto last_iter = std::prev(sent_iter);
-		auto &sent_packet = last_iter->second;
-
-		if(sent_packet.sent_time > congestion_start) {
-			// New congestion event
-			SPDLOG_DEBUG(
-				"Stream transport {{ Src: {}, Dst: {} }}: Congestion event: {}, {}",
-				transport.src_addr.to_string(),
-				transport.dst_addr.to_string(),
-				congestion_window,
-				last_iter->first
-			);
-			congestion_start = now;
+			bytes_in_flight -= sent_packet.length;
+			path.bytes_in_flight -= sent_packet.length;
+			sent_packet.stream->bytes_in_flight -= sent_packet.length;
+			lost_packets[sent_iter->first] = sent_packet;
+			did_lose_packet(sent_packet);
 
-			if(congestion_window < w_max) {
-				// Fast convergence
-				w_max = congestion_window;
-				congestion_window *= 0.6;
-			} else {
-				w_max = congestion_window;
-				congestion_window *= 0.75;
-			}
+			// Lost packets, congestion event
+			congestion_event(path, sent_packet.sent_time);
 
-			if(congestion_window < 10000) {
-				congestion_window = 10000;
-			}
-			ssthresh = congestion_window;
-			k = std::cbrt(w_max / 16)*1000;
+			// Pop lost packets from sent
+			sent_iter = sent_packets.erase(sent_iter);
+		} else {
+			sent_iter++;
 		}
-
-		// Pop lost packets from sent
-		sent_packets.erase(sent_packets.begin(), sent_iter);
 	}
 
 	// New packets
@@ -1612,7 +2416,7 @@ void StreamTransport<DelegateType, DatagramTransport>::send_SKIPSTREAM(
 	uint16_t stream_id,
 	uint64_t offset
 ) {
-	transport.send(
+	transport->send(
 		SKIPSTREAM()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1671,7 +2475,7 @@ void StreamTransport<DelegateType, DatagramTransport>::send_FLUSHSTREAM(
 	uint16_t stream_id,
 	uint64_t offset
 ) {
-	transport.send(
+	transport->send(
 		FLUSHSTREAM()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1741,7 +2545,7 @@ template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_FLUSHCONF(
 	uint16_t stream_id
 ) {
-	transport.send(
+	transport->send(
 		FLUSHCONF()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1789,7 +2593,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_FLUSHCONF(
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_CLOSE(uint16_t reason) {
-	transport.send(
+	transport->send(
 		CLOSE()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1825,7 +2629,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CLOSE(
 		if(conn_state == ConnectionState::Listen) {
 			// Close idle connections
 			reset();
-			transport.close();
+			transport->close();
 		}
 		return;
 	}
@@ -1835,11 +2639,11 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CLOSE(
 	if(conn_state == ConnectionState::Established || conn_state == ConnectionState::Closing) {
 		send_CLOSECONF(src_conn_id, dst_conn_id);
 		reset();
-		transport.close(packet.reason());
+		transport->close(packet.reason());
 	} else if(conn_state == ConnectionState::Listen) {
 		// Close idle connections
 		reset();
-		transport.close();
+		transport->close();
 	} else {
 		// Ignore in other states
 	}
@@ -1850,7 +2654,7 @@ void StreamTransport<DelegateType, DatagramTransport>::send_CLOSECONF(
 	uint32_t src_conn_id,
 	uint32_t dst_conn_id
 ) {
-	transport.send(
+	transport->send(
 		CLOSECONF()
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
@@ -1886,7 +2690,331 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CLOSECONF(
 	}
 
 	reset();
-	transport.close();
+	transport->close();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_PROBE(
+	uint16_t size
+) {
+	// Shares the packet number space with DATA so it is acked like one, but is not tracked for loss
+	probe_packet = ++last_sent_packet;
+
+	auto probe = PROBE(size)
+		.set_src_conn_id(src_conn_id)
+		.set_dst_conn_id(dst_conn_id)
+		.set_packet_number(probe_packet);
+
+	// Oversized probes have to be dropped instead of fragmented to mean anything
+	// Only probes are sent like that, DATA still gets fragmented if the path shrinks
+	if constexpr (has_dont_fragment) {
+		transport->send_dont_fragment(std::move(probe));
+	} else {
+		transport->send(std::move(probe));
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_PROBE(
+	PROBE &&packet
+) {
+	if(!packet.validate()) {
+		return;
+	}
+
+	if(conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	auto src_conn_id = packet.src_conn_id();
+	auto dst_conn_id = packet.dst_conn_id();
+	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: PROBE: Connection id mismatch: {}, {}, {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			src_conn_id,
+			this->src_conn_id,
+			dst_conn_id,
+			this->dst_conn_id
+		);
+		return;
+	}
+
+	ack_ranges.add_packet_number(packet.packet_number());
+
+	// Start ack delay timer if not already active
+	if(!ack_timer_active) {
+		ack_timer_active = true;
+		ack_timer.template start<Self, &Self::ack_timer_cb>(25, 0);
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_FRAMES() {
+	if(pending_frames.empty()) {
+		return;
+	}
+
+	// Pending ack rides along in whatever space is left
+	size_t space = fragment_size(pending_frames_path) + DEFAULT_DATA_OVERHEAD - FRAMES::header_size - pending_frames_size;
+	size_t num_ranges = 0;
+	if(ack_timer_active && space >= FRAMES::ack_frame_header_size + 8) {
+		num_ranges = std::min<size_t>({
+			ack_ranges.ranges.size(),
+			171,
+			(space - FRAMES::ack_frame_header_size) / 8
+		});
+	}
+	size_t ack_frame_size = num_ranges > 0 ? FRAMES::ack_frame_header_size + 8*num_ranges : 0;
+
+	auto packet = FRAMES(ack_frame_size + pending_frames_size)
+		.set_src_conn_id(src_conn_id)
+		.set_dst_conn_id(dst_conn_id)
+		.set_packet_number(last_sent_packet + 1);
+	auto frames = packet.payload_buffer();
+
+	size_t pos = 0;
+	if(num_ranges > 0) {
+		frames.write_uint8_unsafe(0, 2);
+		frames.write_uint16_le_unsafe(1, num_ranges);
+		frames.write_uint64_le_unsafe(3, ack_ranges.largest);
+		pos = FRAMES::ack_frame_header_size;
+
+		auto iter = ack_ranges.ranges.begin();
+		for(size_t i = 0; i < num_ranges; i++, iter++, pos += 8) {
+			frames.write_uint64_le_unsafe(pos, *iter);
+		}
+
+		ack_timer.stop();
+		ack_timer_active = false;
+	}
+
+	auto now = asyncio::EventLoop::now();
+	for(auto &frame : pending_frames) {
+		auto &stream = *frame.stream;
+		auto &data_item = *frame.data_item;
+
+		bool is_fin = (stream.done_queueing &&
+			data_item.stream_offset + frame.offset + frame.length >= stream.queue_offset);
+
+		frames.write_uint8_unsafe(pos, is_fin);
+		frames.write_uint16_le_unsafe(pos + 1, stream.stream_id);
+		frames.write_uint64_le_unsafe(pos + 3, data_item.stream_offset + frame.offset);
+		frames.write_uint16_le_unsafe(pos + 11, frame.length);
+		frames.write_unsafe(pos + FRAMES::stream_frame_header_size, data_item.data.data() + frame.offset, frame.length);
+		pos += FRAMES::stream_frame_header_size + frame.length;
+
+		// Each chunk is tracked and acked like a DATA packet of its own
+		frame.sent_time = now;
+		this->sent_packets.emplace(++this->last_sent_packet, frame);
+
+		if(is_fin && stream.state != SendStream::State::Acked) {
+			stream.state = SendStream::State::Sent;
+		}
+	}
+
+	pending_frames.clear();
+	pending_frames_size = 0;
+
+	path_transport(pending_frames_path).send(std::move(packet));
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_FRAMES(
+	FRAMES &&packet
+) {
+	// Not offered to the peer, do not let it in either
+	if constexpr (max_version < 1) {
+		return;
+	}
+
+	if(!packet.validate()) {
+		return;
+	}
+
+	auto src_conn_id = packet.src_conn_id();
+	auto dst_conn_id = packet.dst_conn_id();
+	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id, send RST
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: FRAMES: Connection id mismatch: {}, {}, {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			src_conn_id,
+			this->src_conn_id,
+			dst_conn_id,
+			this->dst_conn_id
+		);
+		send_RST(src_conn_id, dst_conn_id);
+		return;
+	}
+
+	if(conn_state != ConnectionState::DialRcvd && conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	auto packet_number = packet.packet_number();
+	auto frames = std::move(packet).payload_buffer();
+
+	size_t pos = 0;
+	while(pos < frames.size()) {
+		auto type = frames.read_uint8_unsafe(pos);
+		auto remaining = frames.size() - pos;
+
+		if(type == 2) {
+			if(remaining < FRAMES::ack_frame_header_size) {
+				return;
+			}
+
+			size_t num_ranges = frames.read_uint16_le_unsafe(pos + 1);
+			auto largest = frames.read_uint64_le_unsafe(pos + 3);
+			size_t ack_frame_size = FRAMES::ack_frame_header_size + 8*num_ranges;
+			if(remaining < ack_frame_size) {
+				return;
+			}
+
+			// Acks only make sense once our side of the handshake is done too
+			if(conn_state == ConnectionState::Established) {
+				did_recv_ack_ranges(
+					largest,
+					typename FRAMES::ack_range_iterator(frames, pos + FRAMES::ack_frame_header_size),
+					typename FRAMES::ack_range_iterator(frames, pos + ack_frame_size)
+				);
+			}
+			pos += ack_frame_size;
+		} else if(type == 0 || type == 1) {
+			if(remaining < FRAMES::stream_frame_header_size) {
+				return;
+			}
+
+			auto stream_id = frames.read_uint16_le_unsafe(pos + 1);
+			auto offset = frames.read_uint64_le_unsafe(pos + 3);
+			size_t length = frames.read_uint16_le_unsafe(pos + 11);
+			if(remaining - FRAMES::stream_frame_header_size < length) {
+				return;
+			}
+
+			// Slice of the packet, kept alive by any out of order chunk still referencing it
+			auto data = frames.share();
+			data.cover_unsafe(pos + FRAMES::stream_frame_header_size);
+			data.truncate_unsafe(data.size() - length);
+
+			did_recv_stream_data(packet_number++, stream_id, offset, type == 1, std::move(data));
+			pos += FRAMES::stream_frame_header_size + length;
+		} else {
+			// Unknown frame, its size is unknown too so the rest can not be read
+			SPDLOG_DEBUG(
+				"Stream transport {{ Src: {}, Dst: {} }}: FRAMES: Unknown frame: {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				type
+			);
+			return;
+		}
+
+		// Delegate might have closed the transport while handling the frame
+		if(conn_state != ConnectionState::DialRcvd && conn_state != ConnectionState::Established) {
+			return;
+		}
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_PATHCHALLENGE(
+	Self &path,
+	uint64_t token
+) {
+	// Goes out through the transport of the new address
+	path.transport->send(
+		PATHCHALLENGE()
+		.set_src_conn_id(src_conn_id)
+		.set_dst_conn_id(dst_conn_id)
+		.set_token(token)
+	);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_PATHCHALLENGE(
+	Self &path,
+	PATHCHALLENGE &&packet
+) {
+	if(!packet.validate()) {
+		return;
+	}
+
+	if(conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	auto src_conn_id = packet.src_conn_id();
+	auto dst_conn_id = packet.dst_conn_id();
+	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: PATHCHALLENGE: Connection id mismatch: {}, {}, {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			src_conn_id,
+			this->src_conn_id,
+			dst_conn_id,
+			this->dst_conn_id
+		);
+		return;
+	}
+
+	// Answered over the path it came in on
+	send_PATHRESPONSE(path, packet.token());
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_PATHRESPONSE(
+	Self &path,
+	uint64_t token
+) {
+	path.transport->send(
+		PATHRESPONSE()
+		.set_src_conn_id(src_conn_id)
+		.set_dst_conn_id(dst_conn_id)
+		.set_token(token)
+	);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_PATHRESPONSE(
+	Self &path,
+	PATHRESPONSE &&packet
+) {
+	if(!packet.validate()) {
+		return;
+	}
+
+	// Answer over a subflow of ours
+	if(path.subflow_of == this) {
+		if(!path.is_validating_path || packet.token() != path.path_challenge) {
+			return;
+		}
+
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: Path validated: {} -> {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			path.src_addr.to_string(),
+			path.dst_addr.to_string()
+		);
+
+		path.is_validating_path = false;
+		path.path_timer.stop();
+		paths[path_of(*path.transport)].is_validated = true;
+
+		send_pending_data();
+		return;
+	}
+
+	// Only proves the peer is reachable at the address it came from
+	if(!is_validating_path || !(path.dst_addr == path_addr) || packet.token() != path_challenge) {
+		return;
+	}
+
+	migrate(path);
 }
 
 //---------------- Protocol functions end ----------------//
@@ -1900,7 +3028,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_dial(
 	BaseTransport &,
 	uint8_t const* remote_static_pk
 ) {
-	if(conn_state != ConnectionState::Listen) {
+	// Subflows are set up by their connection instead of a handshake
+	if(conn_state != ConnectionState::Listen || subflow_of != nullptr) {
 		return;
 	}
 
@@ -1914,7 +3043,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_dial(
 	state_timer_interval = 1000;
 	state_timer.template start<Self, &Self::dial_timer_cb>(state_timer_interval, 0);
 
-	src_conn_id = (uint32_t)std::random_device()();
+	new_src_conn_id();
 	send_DIAL();
 	conn_state = ConnectionState::DialSent;
 }
@@ -1924,7 +3053,17 @@ void StreamTransport<DelegateType, DatagramTransport>::did_close(
 	BaseTransport &,
 	uint16_t reason
 ) {
-	delegate->did_close(*this, reason);
+	if(subflow_of != nullptr) {
+		subflow_of->did_close_path(*this);
+	} else {
+		close_paths();
+	}
+
+	// Subflows opened by us were never handed to the delegate
+	if(delegate != nullptr) {
+		delegate->did_close(*this, reason);
+	}
+	transport_manager.erase_conn_id(src_conn_id, this);
 	transport_manager.erase(dst_addr);
 }
 
@@ -1940,17 +3079,62 @@ void StreamTransport<DelegateType, DatagramTransport>::did_close(
 	\li 4		:	DIALCONF
 	\li 5		:	CONF
 	\li 6		:	RST
+	\li 10		:	RETRY
+	\li 13		:	PROBE
+	\li 14		:	FRAMES, version 1
+	\li 15		:	PATHCHALLENGE, version 2
+	\li 16		:	PATHRESPONSE, version 2
+
+	Packets with a version above the highest one we accept are dropped.
+	Packets received by a subflow are handled by its connection.
 */
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::did_recv(
-	BaseTransport &,
+	BaseTransport &transport,
 	BaseMessageType &&packet
 ) {
+	if(subflow_of != nullptr) {
+		subflow_of->did_recv(transport, std::move(packet));
+		return;
+	}
+
 	auto type = packet.payload_buffer().read_uint8(1);
-	if(type == std::nullopt || packet.payload_buffer().read_uint8_unsafe(0) != 0) {
+	if(type == std::nullopt || packet.payload_buffer().read_uint8_unsafe(0) > max_version) {
 		return;
 	}
 
+	// Fresh transport getting packets of an existing connection, the peer changed address
+	if(conn_state == ConnectionState::Listen && packet.payload_buffer().size() >= 10) {
+		switch(type.value()) {
+			// Handshake and reset are left to this transport
+			case 3: case 4: case 5: case 6: case 10:
+			break;
+			default: {
+				auto *conn = transport_manager.get_by_conn_id(packet.payload_buffer().read_uint32_le_unsafe(6));
+				if(conn == nullptr || conn == this) {
+					break;
+				}
+
+				if(!conn->did_recv_on_new_path(*this, std::move(packet))) {
+					// Not taken up as a path, nothing would ever be sent or received here.
+					// Closed without a RST since the connection is still alive at its own address
+					reset();
+					this->transport->close();
+				}
+				// Self might be gone if the connection moved over
+				return;
+			}
+			break;
+		}
+	}
+
+	// Path the packet came in on, acks go back the same way once it is validated
+	auto path = path_of(transport);
+	auto &from = path == 0 ? *this : *paths[path].subflow;
+	if(paths[path].is_validated) {
+		ack_path = path;
+	}
+
 	switch(type.value()) {
 		// DATA
 		case 0:
@@ -1981,6 +3165,21 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv(
 		// FLUSHCONF
 		case 9: did_recv_FLUSHCONF(std::move(packet));
 		break;
+		// RETRY
+		case 10: did_recv_RETRY(std::move(packet));
+		break;
+		// PROBE
+		case 13: did_recv_PROBE(std::move(packet));
+		break;
+		// FRAMES
+		case 14: did_recv_FRAMES(std::move(packet));
+		break;
+		// PATHCHALLENGE
+		case 15: did_recv_PATHCHALLENGE(from, std::move(packet));
+		break;
+		// PATHRESPONSE, only counts when received from the address or subflow being validated
+		case 16: did_recv_PATHRESPONSE(from, std::move(packet));
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN <<< {}", dst_addr.to_string());
 		break;
@@ -2028,6 +3227,20 @@ void StreamTransport<DelegateType, DatagramTransport>::did_send(
 		// FLUSHCONF
 		case 9: SPDLOG_TRACE("FLUSHCONF >>> {}", dst_addr.to_string());
 		break;
+		case 10: SPDLOG_TRACE("RETRY >>> {}", dst_addr.to_string());
+		break;
+		// PROBE
+		case 13: SPDLOG_TRACE("PROBE >>> {}", dst_addr.to_string());
+		break;
+		// FRAMES
+		case 14: SPDLOG_TRACE("FRAMES >>> {}", dst_addr.to_string());
+		break;
+		// PATHCHALLENGE
+		case 15: SPDLOG_TRACE("PATHCHALLENGE >>> {}", dst_addr.to_string());
+		break;
+		// PATHRESPONSE
+		case 16: SPDLOG_TRACE("PATHRESPONSE >>> {}", dst_addr.to_string());
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN >>> {}", dst_addr.to_string());
 		break;
@@ -2042,12 +3255,14 @@ StreamTransport<DelegateType, DatagramTransport>::StreamTransport(
 	core::SocketAddress const &dst_addr,
 	BaseTransport &transport,
 	core::TransportManager<StreamTransport<DelegateType, DatagramTransport>> &transport_manager
-) : transport(transport),
+) : transport(&transport),
 	transport_manager(transport_manager),
 	state_timer(this),
 	pacing_timer(this),
 	tlp_timer(this),
 	ack_timer(this),
+	probe_timer(this),
+	path_timer(this),
 	src_addr(src_addr),
 	dst_addr(dst_addr),
 	delegate(nullptr) {
@@ -2069,7 +3284,7 @@ void StreamTransport<DelegateType, DatagramTransport>::setup(
 
 	crypto_kx_keypair(this->ephemeral_pk, this->ephemeral_sk);
 
-	transport.setup(this);
+	transport->setup(this);
 }
 
 
@@ -2081,6 +3296,7 @@ int StreamTransport<DelegateType, DatagramTransport>::send(
 	if (conn_state != ConnectionState::Established) {
 		return -2;
 	}
+
 	auto &stream = get_or_create_send_stream(stream_id);
 
 	if(stream.state == SendStream::State::Ready) {
@@ -2149,7 +3365,7 @@ void StreamTransport<DelegateType, DatagramTransport>::close_timer_cb() {
 			this->dst_addr.to_string()
 		);
 		reset();
-		transport.close();
+		transport->close();
 		return;
 	}
 
@@ -2170,7 +3386,7 @@ bool StreamTransport<DelegateType, DatagramTransport>::is_active() {
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 double StreamTransport<DelegateType, DatagramTransport>::get_rtt() {
-	return rtt;
+	return paths[0].rtt;
 }
 
 template<typename DelegateType, template<typename> class DatagramTransport>
@@ -2184,7 +3400,7 @@ void StreamTransport<DelegateType, DatagramTransport>::skip_timer_cb(RecvStream&
 			stream.stream_id
 		);
 		reset();
-		transport.close();
+		transport->close();
 		return;
 	}
 
@@ -2236,7 +3452,7 @@ void StreamTransport<DelegateType, DatagramTransport>::flush_timer_cb(SendStream
 			stream.stream_id
 		);
 		reset();
-		transport.close();
+		transport->close();
 		return;
 	}
 
@@ -2261,6 +3477,7 @@ void StreamTransport<DelegateType, DatagramTransport>::flush_stream(
 		}
 
 		bytes_in_flight -= sent_iter->second.length;
+		paths[sent_iter->second.path].bytes_in_flight -= sent_iter->second.length;
 		sent_iter = sent_packets.erase(sent_iter);
 	}
 
@@ -2291,7 +3508,7 @@ void StreamTransport<DelegateType, DatagramTransport>::flush_stream(
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 bool StreamTransport<DelegateType, DatagramTransport>::is_internal() {
-	return transport.is_internal();
+	return transport->is_internal();
 }
 
 template<typename DelegateType, template<typename> class DatagramTransport>
@@ -34,10 +34,15 @@ public:
 		StreamTransportFactory,
 		StreamTransport
 	>;
+	using TransportType = StreamTransport<TransportDelegate, DatagramTransport>;
+	using BaseTransportType = DatagramTransport<TransportType>;
 private:
 	using TransportFactoryScaffoldType::base_factory;
 	using TransportFactoryScaffoldType::transport_manager;
 
+	/// Connection the transport being dialled by add_path is a subflow of
+	TransportType *path_conn = nullptr;
+
 public:
 	using TransportFactoryScaffoldType::addr;
 
@@ -48,8 +53,87 @@ public:
 	using TransportFactoryScaffoldType::dial;
 
 	using TransportFactoryScaffoldType::get_transport;
+
+	/// Delegate calls from base factory, transports dialled by add_path become subflows instead of connections
+	void did_create_transport(BaseTransportType &base_transport);
+
+	/// Open another path of the given connection, from the bound address to the given address of the peer.
+	/// The connection needs multipath enabled, returns a negative value if it can not take another path
+	int add_path(core::SocketAddress const &addr, ListenDelegate &delegate, TransportType &conn);
+
+	/// Let connections of either factory be reached through both, for factories bound to different local addresses
+	void share_conn_ids(StreamTransportFactory &other);
 };
 
+
+// Impl
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+void StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::did_create_transport(BaseTransportType &base_transport) {
+	if(path_conn == nullptr) {
+		TransportFactoryScaffoldType::did_create_transport(base_transport);
+		return;
+	}
+
+	auto *transport = transport_manager.get_or_create(
+		base_transport.dst_addr,
+		base_transport.src_addr,
+		base_transport.dst_addr,
+		base_transport,
+		transport_manager
+	).first;
+	path_conn->add_path(*transport);
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::add_path(core::SocketAddress const &addr, ListenDelegate &delegate, TransportType &conn) {
+	// Existing transport to the address would be reused instead of a fresh one
+	if(!conn.can_add_path() || get_transport(addr) != nullptr) {
+		return -1;
+	}
+
+	path_conn = &conn;
+	auto res = dial(addr, delegate, conn.get_remote_static_pk());
+	path_conn = nullptr;
+
+	return res;
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+void StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::share_conn_ids(StreamTransportFactory &other) {
+	transport_manager.share_conn_ids(other.transport_manager);
+}
+
 } // namespace stream
 } // namespace marlin
 
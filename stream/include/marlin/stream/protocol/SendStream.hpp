@@ -44,6 +44,8 @@ struct SentPacketInfo {
 	uint64_t offset;
 	/// Length of the data sent
 	uint16_t length;
+	/// Path it was sent on, index into the paths of the connection
+	uint8_t path = 0;
 
 	/// Constructor
 	SentPacketInfo(
@@ -51,13 +53,15 @@ struct SentPacketInfo {
 		SendStream *stream,
 		DataItem *data_item,
 		uint64_t offset,
-		uint64_t length
+		uint64_t length,
+		uint8_t path = 0
 	) {
 		this->sent_time = sent_time;
 		this->stream = stream;
 		this->data_item = data_item;
 		this->offset = offset;
 		this->length = length;
+		this->path = path;
 	}
 
 	/// Default constructor
@@ -0,0 +1,153 @@
+#ifndef MARLIN_STREAM_TEST_SIMSTREAMHARNESS_HPP
+#define MARLIN_STREAM_TEST_SIMSTREAMHARNESS_HPP
+
+// Include first, timers and event loop have to be the simulated ones
+#ifndef MARLIN_ASYNCIO_SIMULATOR
+#define MARLIN_ASYNCIO_SIMULATOR
+#endif
+
+#include <marlin/simulator/core/Simulator.hpp>
+#include <marlin/simulator/transport/SimulatedTransportFactory.hpp>
+#include <marlin/simulator/network/Network.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+#include <marlin/asyncio/core/Timer.hpp>
+
+// Streams over a simulated network with the given conditioner, delegate handles both ends
+template<typename ConditionerType, typename DelegateType>
+struct SimStreamTypes {
+	using NetworkType = marlin::simulator::Network<ConditionerType>;
+	using NetworkInterfaceType = marlin::simulator::NetworkInterface<NetworkType>;
+
+	template<typename Delegate>
+	using SimTransportType = marlin::simulator::SimulatedTransport<
+		marlin::simulator::Simulator,
+		NetworkInterfaceType,
+		Delegate
+	>;
+	template<typename ListenDelegate, typename TransportDelegate>
+	using SimTransportFactoryType = marlin::simulator::SimulatedTransportFactory<
+		marlin::simulator::Simulator,
+		NetworkInterfaceType,
+		ListenDelegate,
+		TransportDelegate
+	>;
+
+	using TransportType = marlin::stream::StreamTransport<DelegateType, SimTransportType>;
+	using TransportFactoryType = marlin::stream::StreamTransportFactory<
+		DelegateType,
+		DelegateType,
+		SimTransportFactoryType,
+		SimTransportType
+	>;
+};
+
+inline uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+inline uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+// Item index of size bytes, items laid end to end count up mod 251 so loss, reordering and duplication show
+inline marlin::core::Buffer make_item(size_t index, size_t size) {
+	auto buf = marlin::core::Buffer(size);
+	for(size_t i = 0; i < size; i++) {
+		buf.data()[i] = (index * size + i) % 251;
+	}
+	return buf;
+}
+
+// Whether bytes continue the items at offset into the stream
+inline bool is_intact(marlin::core::Buffer const& bytes, size_t offset) {
+	for(size_t i = 0; i < bytes.size(); i++) {
+		if(bytes.data()[i] != (uint8_t)((offset + i) % 251)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Sends num_items items of item_size once started, checks what it receives and closes once everything is acked.
+// Tests derive from it and hide the callbacks they need to extend.
+template<typename DelegateType, typename TransportType>
+struct SimStreamDelegate {
+	size_t item_size;
+	size_t num_items;
+	// Items sent at once and ticks between sends, all in one go by default
+	size_t burst_size;
+	uint64_t send_interval = 0;
+	bool should_close = true;
+
+	size_t recv_bytes = 0;
+	bool is_corrupt = false;
+	size_t sent_items = 0;
+	size_t acked_items = 0;
+
+	// Closing from inside did_send would pull the stream out from under the transport
+	TransportType* sender = nullptr;
+	marlin::asyncio::Timer send_timer;
+	marlin::asyncio::Timer close_timer;
+
+	void send_timer_cb() {
+		for(size_t i = 0; i < burst_size && sent_items < num_items; i++, sent_items++) {
+			sender->send(make_item(sent_items, item_size));
+		}
+
+		if(sent_items == num_items) {
+			send_timer.stop();
+		}
+	}
+
+	void close_timer_cb() {
+		sender->close();
+	}
+
+	SimStreamDelegate(size_t item_size, size_t num_items) :
+		item_size(item_size),
+		num_items(num_items),
+		burst_size(num_items),
+		send_timer(this),
+		close_timer(this) {}
+
+	void start(TransportType &transport) {
+		sender = &transport;
+		send_timer.template start<SimStreamDelegate, &SimStreamDelegate::send_timer_cb>(0, send_interval);
+	}
+
+	int did_recv(
+		TransportType &,
+		marlin::core::Buffer &&packet,
+		uint8_t
+	) {
+		if(!is_intact(packet, recv_bytes)) {
+			is_corrupt = true;
+		}
+		recv_bytes += packet.size();
+
+		return 0;
+	}
+
+	void did_send(TransportType &, marlin::core::Buffer &&) {
+		if(++acked_items == num_items && should_close) {
+			close_timer.template start<SimStreamDelegate, &SimStreamDelegate::close_timer_cb>(0, 0);
+		}
+	}
+
+	void did_dial(TransportType &transport) {
+		start(transport);
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(marlin::core::SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(static_cast<DelegateType*>(this), static_sk);
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+#endif // MARLIN_STREAM_TEST_SIMSTREAMHARNESS_HPP
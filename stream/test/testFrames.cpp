@@ -0,0 +1,118 @@
+#include "SimStreamHarness.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace marlin::core;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+
+// Counts delivered datagrams, optionally dropping some of the first ones
+struct CountingConditioner : public NetworkConditioner {
+	uint64_t seen = 0;
+	uint64_t delivered = 0;
+	// Drop every nth datagram among the first drop_window, 0 to drop none
+	uint64_t drop_every = 0;
+	uint64_t drop_window = 0;
+
+	bool should_drop(
+		uint64_t in_tick,
+		SocketAddress const& src,
+		SocketAddress const& dst,
+		uint64_t size
+	) {
+		if(NetworkConditioner::should_drop(in_tick, src, dst, size)) {
+			return true;
+		}
+
+		seen++;
+		if(drop_every != 0 && seen <= drop_window && seen % drop_every == 0) {
+			return true;
+		}
+
+		delivered++;
+		return false;
+	}
+};
+
+struct Delegate;
+
+using SimStream = SimStreamTypes<CountingConditioner, Delegate>;
+using NetworkType = SimStream::NetworkType;
+using TransportType = SimStream::TransportType;
+using TransportFactoryType = SimStream::TransportFactoryType;
+
+#define MESSAGE_SIZE 40
+#define BURST_SIZE 10
+#define NUM_BURSTS 50
+#define BURST_INTERVAL 5
+#define NUM_MESSAGES (BURST_SIZE * NUM_BURSTS)
+
+// Sends bursts of small messages to the other side, like pubsub control messages
+// Dialer starts on dial, listener once it hears from the dialer
+struct Delegate : public SimStreamDelegate<Delegate, TransportType> {
+	Delegate() : SimStreamDelegate(MESSAGE_SIZE, NUM_MESSAGES) {
+		burst_size = BURST_SIZE;
+		send_interval = BURST_INTERVAL;
+		should_close = false;
+	}
+
+	int did_recv(
+		TransportType &transport,
+		Buffer &&packet,
+		uint8_t stream_id
+	) {
+		SimStreamDelegate::did_recv(transport, std::move(packet), stream_id);
+
+		if(sender == nullptr) {
+			start(transport);
+		}
+
+		return 0;
+	}
+};
+
+void exchange(CountingConditioner& nc, Delegate& server, Delegate& client) {
+	NetworkType network(nc);
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i2 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.2:0"));
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	TransportFactoryType s(i1, Simulator::default_instance), c(i2, Simulator::default_instance);
+	s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s.listen(server);
+	c.bind(SocketAddress::from_string("192.168.0.2:8000"));
+	c.dial(SocketAddress::from_string("192.168.0.1:8000"), client, static_pk);
+
+	Simulator::default_instance.run();
+}
+
+TEST(Frames, BundlesSmallMessages) {
+	CountingConditioner nc;
+	Delegate server, client;
+	exchange(nc, server, client);
+
+	EXPECT_EQ(server.recv_bytes, MESSAGE_SIZE * NUM_MESSAGES);
+	EXPECT_EQ(client.recv_bytes, MESSAGE_SIZE * NUM_MESSAGES);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_FALSE(client.is_corrupt);
+	EXPECT_EQ(server.acked_items, NUM_MESSAGES);
+	EXPECT_EQ(client.acked_items, NUM_MESSAGES);
+	// A packet per burst and side with acks riding along, instead of a packet per message plus acks
+	EXPECT_LT(nc.delivered, 2 * NUM_BURSTS * 2);
+}
+
+TEST(Frames, RecoversLostFrames) {
+	CountingConditioner nc;
+	nc.drop_every = 7;
+	nc.drop_window = 100;
+	Delegate server, client;
+	exchange(nc, server, client);
+
+	EXPECT_EQ(server.recv_bytes, MESSAGE_SIZE * NUM_MESSAGES);
+	EXPECT_EQ(client.recv_bytes, MESSAGE_SIZE * NUM_MESSAGES);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_FALSE(client.is_corrupt);
+	EXPECT_EQ(server.acked_items, NUM_MESSAGES);
+	EXPECT_EQ(client.acked_items, NUM_MESSAGES);
+}
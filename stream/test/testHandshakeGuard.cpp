@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <marlin/stream/HandshakeGuard.hpp>
+
+using namespace marlin::core;
+using namespace marlin::stream;
+
+TEST(HandshakeGuard, AcceptsOwnCookie) {
+	HandshakeGuard guard;
+	auto addr = SocketAddress::from_string("1.2.3.4:8000");
+	uint8_t cookie[HandshakeGuard::cookie_size];
+
+	guard.generate(cookie, addr, 42, 100000);
+	EXPECT_TRUE(guard.verify(cookie, addr, 42, 100000));
+	// Previous epoch is still fine
+	EXPECT_TRUE(guard.verify(cookie, addr, 42, 100000 + HandshakeGuard::epoch_length));
+}
+
+TEST(HandshakeGuard, RejectsExpiredCookie) {
+	HandshakeGuard guard;
+	auto addr = SocketAddress::from_string("1.2.3.4:8000");
+	uint8_t cookie[HandshakeGuard::cookie_size];
+
+	guard.generate(cookie, addr, 42, 100000);
+	EXPECT_FALSE(guard.verify(cookie, addr, 42, 100000 + 2 * HandshakeGuard::epoch_length));
+}
+
+TEST(HandshakeGuard, BoundToPeer) {
+	HandshakeGuard guard;
+	auto addr = SocketAddress::from_string("1.2.3.4:8000");
+	uint8_t cookie[HandshakeGuard::cookie_size];
+
+	guard.generate(cookie, addr, 42, 100000);
+	EXPECT_FALSE(guard.verify(cookie, SocketAddress::from_string("1.2.3.4:8001"), 42, 100000));
+	EXPECT_FALSE(guard.verify(cookie, SocketAddress::from_string("1.2.3.5:8000"), 42, 100000));
+	EXPECT_FALSE(guard.verify(cookie, addr, 43, 100000));
+
+	// Other instances have other keys
+	HandshakeGuard other;
+	EXPECT_FALSE(other.verify(cookie, addr, 42, 100000));
+}
+
+TEST(HandshakeGuard, RejectsTamperedCookie) {
+	HandshakeGuard guard;
+	auto addr = SocketAddress::from_string("1.2.3.4:8000");
+	uint8_t cookie[HandshakeGuard::cookie_size];
+
+	guard.generate(cookie, addr, 42, 100000);
+	cookie[HandshakeGuard::cookie_size - 1] ^= 1;
+	EXPECT_FALSE(guard.verify(cookie, addr, 42, 100000));
+}
@@ -0,0 +1,146 @@
+#include "SimStreamHarness.hpp"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <unordered_set>
+
+using namespace marlin::core;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using SimStream = SimStreamTypes<NetworkConditioner, Delegate>;
+using NetworkType = SimStream::NetworkType;
+using TransportType = SimStream::TransportType;
+using TransportFactoryType = SimStream::TransportFactoryType;
+
+#define ITEM_SIZE 10000
+#define NUM_ITEMS 100
+#define ITEM_INTERVAL 10
+
+// Client behind a NAT sends NUM_ITEMS items after dialling, server receives and checks them
+struct Delegate : public SimStreamDelegate<Delegate, TransportType> {
+	NetworkType* network = nullptr;
+	// NAT mapping switched to once half the data is received, by the server
+	SocketAddress private_addr;
+	SocketAddress later_public_addr;
+	bool is_rebound = false;
+	// Mapping switched to as soon as the first packet from later_public_addr arrives, if set.
+	// Challenges to later_public_addr get dropped, so it is never validated
+	std::optional<SocketAddress> final_public_addr;
+
+	// Transports data was received on, should stay a single one through rebinding
+	std::unordered_set<TransportType*> recv_transports;
+	SocketAddress last_recv_addr;
+
+	size_t num_dials = 0;
+	size_t num_closes = 0;
+
+	Delegate() : SimStreamDelegate(ITEM_SIZE, NUM_ITEMS) {
+		burst_size = 1;
+		send_interval = ITEM_INTERVAL;
+	}
+
+	int did_recv(
+		TransportType &transport,
+		Buffer &&packet,
+		uint8_t stream_id
+	) {
+		SimStreamDelegate::did_recv(transport, std::move(packet), stream_id);
+		recv_transports.insert(&transport);
+		last_recv_addr = transport.dst_addr;
+
+		if(network != nullptr && !is_rebound && recv_bytes >= ITEM_SIZE * NUM_ITEMS / 2) {
+			is_rebound = true;
+			network->set_nat_mapping(private_addr, later_public_addr);
+		}
+
+		return 0;
+	}
+
+	void did_dial(TransportType &transport) {
+		num_dials++;
+		SimStreamDelegate::did_dial(transport);
+	}
+
+	void did_close(TransportType &, uint16_t) {
+		num_closes++;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		SimStreamDelegate::did_create_transport(transport);
+
+		if(final_public_addr.has_value() && transport.dst_addr == later_public_addr) {
+			network->set_nat_mapping(private_addr, *final_public_addr);
+		}
+	}
+};
+
+TEST(Migration, SurvivesNatRebinding) {
+	NetworkConditioner nc;
+	NetworkType network(nc);
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i2 = network.get_or_create_interface(SocketAddress::from_string("10.0.0.2:0"));
+
+	auto client_addr = SocketAddress::from_string("10.0.0.2:8000");
+	network.set_nat_mapping(client_addr, SocketAddress::from_string("192.168.0.2:40000"));
+
+	Delegate server, client;
+	server.network = &network;
+	server.private_addr = client_addr;
+	server.later_public_addr = SocketAddress::from_string("192.168.0.2:40001");
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	TransportFactoryType s(i1, Simulator::default_instance), c(i2, Simulator::default_instance);
+	s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s.listen(server);
+	c.bind(client_addr);
+	c.dial(SocketAddress::from_string("192.168.0.1:8000"), client, static_pk);
+
+	Simulator::default_instance.run();
+
+	EXPECT_TRUE(server.is_rebound);
+	EXPECT_EQ(server.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_EQ(client.acked_items, NUM_ITEMS);
+	// No new handshake, the same connection kept receiving at the new address
+	EXPECT_EQ(client.num_dials, 1u);
+	EXPECT_EQ(server.recv_transports.size(), 1u);
+	EXPECT_EQ(server.last_recv_addr.to_string(), "192.168.0.2:40001");
+}
+
+TEST(Migration, ClosesAbandonedAddress) {
+	NetworkConditioner nc;
+	NetworkType network(nc);
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i2 = network.get_or_create_interface(SocketAddress::from_string("10.0.0.2:0"));
+
+	auto client_addr = SocketAddress::from_string("10.0.0.2:8000");
+	network.set_nat_mapping(client_addr, SocketAddress::from_string("192.168.0.2:40000"));
+
+	Delegate server, client;
+	server.network = &network;
+	server.private_addr = client_addr;
+	server.later_public_addr = SocketAddress::from_string("192.168.0.2:40001");
+	server.final_public_addr = SocketAddress::from_string("192.168.0.2:40002");
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	TransportFactoryType s(i1, Simulator::default_instance), c(i2, Simulator::default_instance);
+	s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s.listen(server);
+	c.bind(client_addr);
+	c.dial(SocketAddress::from_string("192.168.0.1:8000"), client, static_pk);
+
+	Simulator::default_instance.run();
+
+	EXPECT_EQ(server.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_EQ(server.recv_transports.size(), 1u);
+	EXPECT_EQ(server.last_recv_addr.to_string(), "192.168.0.2:40002");
+	// Fresh transport of the address given up on does not linger
+	EXPECT_EQ(s.get_transport(server.later_public_addr), nullptr);
+}
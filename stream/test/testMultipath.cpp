@@ -0,0 +1,222 @@
+#include "SimStreamHarness.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace marlin::core;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+
+// Every address is an uplink of its own, with its own delay, bandwidth and queue
+struct UplinkConditioner : public NetworkConditioner {
+	struct Uplink {
+		// Ticks a datagram takes to arrive once it is on the wire
+		uint64_t delay = 1;
+		// Bytes put on the wire per tick
+		double rate = 1000;
+		// Ticks worth of datagrams queued before dropping
+		double queue = 50;
+
+		// Tick the uplink is done with everything queued so far
+		double busy_until = 0;
+		uint64_t delivered = 0;
+	};
+	std::unordered_map<SocketAddress, Uplink> uplinks;
+
+	Uplink& uplink(SocketAddress const& addr) {
+		auto host = addr;
+		host.set_port(0);
+		return uplinks[host];
+	}
+
+	bool should_drop(
+		uint64_t in_tick,
+		SocketAddress const& src,
+		SocketAddress const& dst,
+		uint64_t size
+	) {
+		if(NetworkConditioner::should_drop(in_tick, src, dst, size)) {
+			return true;
+		}
+
+		auto& link = uplink(src);
+		auto start = std::max<double>(in_tick, link.busy_until);
+		if(start - in_tick > link.queue) {
+			return true;
+		}
+
+		// Queued behind whatever is still being sent
+		link.busy_until = start + size / link.rate;
+		link.delivered += size;
+		return false;
+	}
+
+	uint64_t get_out_tick(
+		uint64_t,
+		SocketAddress const& src,
+		SocketAddress const&,
+		uint64_t
+	) {
+		auto& link = uplink(src);
+		return std::ceil(link.busy_until) + link.delay;
+	}
+};
+
+struct Delegate;
+
+using SimStream = SimStreamTypes<UplinkConditioner, Delegate>;
+using NetworkType = SimStream::NetworkType;
+using TransportType = SimStream::TransportType;
+using TransportFactoryType = SimStream::TransportFactoryType;
+
+#define ITEM_SIZE 100000
+#define NUM_ITEMS 40
+
+// Client sends NUM_ITEMS items at once after dialling, over a second uplink too in multipath mode
+struct Delegate : public SimStreamDelegate<Delegate, TransportType> {
+	bool is_multipath = false;
+	// Factory and server address of the second path
+	TransportFactoryType* second_factory = nullptr;
+	SocketAddress second_addr;
+
+	// Uplink which degrades once half the data is received, by the server
+	UplinkConditioner::Uplink* degraded_uplink = nullptr;
+	double degraded_rate = 0;
+
+	uint64_t start_tick = 0;
+	uint64_t done_tick = 0;
+
+	std::unordered_set<TransportType*> recv_transports;
+
+	Delegate() : SimStreamDelegate(ITEM_SIZE, NUM_ITEMS) {}
+
+	int did_recv(
+		TransportType &transport,
+		Buffer &&packet,
+		uint8_t stream_id
+	) {
+		SimStreamDelegate::did_recv(transport, std::move(packet), stream_id);
+		recv_transports.insert(&transport);
+
+		if(degraded_uplink != nullptr && recv_bytes >= ITEM_SIZE * NUM_ITEMS / 2) {
+			degraded_uplink->rate = degraded_rate;
+			degraded_uplink = nullptr;
+		}
+
+		if(recv_bytes == ITEM_SIZE * NUM_ITEMS) {
+			done_tick = Simulator::default_instance.current_tick();
+		}
+
+		return 0;
+	}
+
+	void did_dial(TransportType &transport) {
+		start_tick = Simulator::default_instance.current_tick();
+
+		if(is_multipath) {
+			transport.enable_multipath();
+			EXPECT_GE(second_factory->add_path(second_addr, *this, transport), 0);
+		}
+
+		SimStreamDelegate::did_dial(transport);
+	}
+
+	void did_create_transport(TransportType &transport) {
+		SimStreamDelegate::did_create_transport(transport);
+		if(is_multipath) {
+			transport.enable_multipath();
+		}
+	}
+};
+
+// Two uplinks on each side, a fast and short one and a slower and longer one
+void transfer(UplinkConditioner& nc, Delegate& server, Delegate& client, bool is_multipath) {
+	NetworkType network(nc);
+	auto& ci1 = network.get_or_create_interface(SocketAddress::from_string("10.0.0.2:0"));
+	auto& ci2 = network.get_or_create_interface(SocketAddress::from_string("10.0.1.2:0"));
+	auto& si1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& si2 = network.get_or_create_interface(SocketAddress::from_string("192.168.1.1:0"));
+
+	for(auto addr : {"10.0.0.2:0", "192.168.0.1:0"}) {
+		nc.uplink(SocketAddress::from_string(addr)).delay = 5;
+		nc.uplink(SocketAddress::from_string(addr)).rate = 1000;
+	}
+	for(auto addr : {"10.0.1.2:0", "192.168.1.1:0"}) {
+		nc.uplink(SocketAddress::from_string(addr)).delay = 20;
+		nc.uplink(SocketAddress::from_string(addr)).rate = 500;
+	}
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	TransportFactoryType s1(si1, Simulator::default_instance), s2(si2, Simulator::default_instance);
+	TransportFactoryType c1(ci1, Simulator::default_instance), c2(ci2, Simulator::default_instance);
+	s2.share_conn_ids(s1);
+
+	server.is_multipath = is_multipath;
+	client.is_multipath = is_multipath;
+	client.second_factory = &c2;
+	client.second_addr = SocketAddress::from_string("192.168.1.1:8000");
+
+	s1.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s1.listen(server);
+	s2.bind(SocketAddress::from_string("192.168.1.1:8000"));
+	s2.listen(server);
+	c1.bind(SocketAddress::from_string("10.0.0.2:8000"));
+	c2.bind(SocketAddress::from_string("10.0.1.2:8000"));
+	c1.dial(SocketAddress::from_string("192.168.0.1:8000"), client, static_pk);
+
+	Simulator::default_instance.run();
+}
+
+void expect_intact(Delegate& server, Delegate& client) {
+	EXPECT_EQ(server.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_EQ(client.acked_items, NUM_ITEMS);
+	// A single connection, subflows only carry its data
+	EXPECT_EQ(server.recv_transports.size(), 1u);
+}
+
+TEST(Multipath, AggregatesUplinks) {
+	UplinkConditioner single_nc;
+	Delegate single_server, single_client;
+	transfer(single_nc, single_server, single_client, false);
+	expect_intact(single_server, single_client);
+	EXPECT_EQ(single_nc.uplink(SocketAddress::from_string("10.0.1.2:0")).delivered, 0u);
+
+	UplinkConditioner nc;
+	Delegate server, client;
+	transfer(nc, server, client, true);
+	expect_intact(server, client);
+
+	// Slower uplink carries a good share of the data and the transfer is done sooner
+	EXPECT_GT(nc.uplink(SocketAddress::from_string("10.0.1.2:0")).delivered, ITEM_SIZE * NUM_ITEMS / 5);
+	EXPECT_LT(
+		(server.done_tick - client.start_tick) * 5,
+		(single_server.done_tick - single_client.start_tick) * 4
+	);
+}
+
+TEST(Multipath, SurvivesDegradedUplink) {
+	UplinkConditioner single_nc;
+	Delegate single_server, single_client;
+	single_server.degraded_uplink = &single_nc.uplink(SocketAddress::from_string("10.0.0.2:0"));
+	single_server.degraded_rate = 100;
+	transfer(single_nc, single_server, single_client, false);
+	expect_intact(single_server, single_client);
+
+	UplinkConditioner nc;
+	Delegate server, client;
+	server.degraded_uplink = &nc.uplink(SocketAddress::from_string("10.0.0.2:0"));
+	server.degraded_rate = 100;
+	transfer(nc, server, client, true);
+	expect_intact(server, client);
+
+	// Rest of the data moves over to the uplink which still works
+	EXPECT_LT(
+		(server.done_tick - client.start_tick) * 2,
+		single_server.done_tick - single_client.start_tick
+	);
+}
@@ -0,0 +1,126 @@
+#include "SimStreamHarness.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using namespace marlin::core;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+
+// Counts delivered datagrams by size
+struct CountingConditioner : public NetworkConditioner {
+	std::map<uint64_t, uint64_t> delivered;
+
+	bool should_drop(
+		uint64_t in_tick,
+		SocketAddress const& src,
+		SocketAddress const& dst,
+		uint64_t size
+	) {
+		if(NetworkConditioner::should_drop(in_tick, src, dst, size)) {
+			return true;
+		}
+
+		delivered[size]++;
+		return false;
+	}
+};
+
+struct Delegate;
+
+using SimStream = SimStreamTypes<CountingConditioner, Delegate>;
+using NetworkType = SimStream::NetworkType;
+using TransportType = SimStream::TransportType;
+using TransportFactoryType = SimStream::TransportFactoryType;
+
+#define ITEM_SIZE 100000
+#define NUM_ITEMS 200
+// Ticks between items, spreads the transfer out well past the probing
+#define ITEM_INTERVAL 10
+
+// Sends NUM_ITEMS items after dialling, receives and checks them on the other side
+struct Delegate : public SimStreamDelegate<Delegate, TransportType> {
+	CountingConditioner& nc;
+	// Path MTU to switch to once half the data is received, 0 to keep it
+	uint64_t later_mtu = 0;
+
+	Delegate(CountingConditioner& nc) : SimStreamDelegate(ITEM_SIZE, NUM_ITEMS), nc(nc) {
+		burst_size = 1;
+		send_interval = ITEM_INTERVAL;
+	}
+
+	int did_recv(
+		TransportType &transport,
+		Buffer &&packet,
+		uint8_t stream_id
+	) {
+		SimStreamDelegate::did_recv(transport, std::move(packet), stream_id);
+
+		if(later_mtu != 0 && recv_bytes >= ITEM_SIZE * NUM_ITEMS / 2) {
+			nc.mtu = later_mtu;
+		}
+
+		return 0;
+	}
+};
+
+// Transfers everything over a path with the given MTU
+void transfer(CountingConditioner& nc, Delegate& d) {
+	NetworkType network(nc);
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i2 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.2:0"));
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	TransportFactoryType s(i1, Simulator::default_instance), c(i2, Simulator::default_instance);
+	s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s.listen(d);
+	c.bind(SocketAddress::from_string("192.168.0.2:8000"));
+	c.dial(SocketAddress::from_string("192.168.0.1:8000"), d, static_pk);
+
+	Simulator::default_instance.run();
+}
+
+TEST(Pmtud, UsesJumboFrames) {
+	CountingConditioner nc;
+	nc.mtu = 9000;
+	Delegate d(nc);
+	transfer(nc, d);
+
+	EXPECT_EQ(d.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(d.is_corrupt);
+	EXPECT_EQ(d.acked_items, NUM_ITEMS);
+	// Most of it goes in the largest datagrams
+	EXPECT_GT(nc.delivered[8952], ITEM_SIZE * NUM_ITEMS / 8952 / 2);
+}
+
+TEST(Pmtud, SettlesOnEthernet) {
+	CountingConditioner nc;
+	nc.mtu = 1500;
+	Delegate d(nc);
+	transfer(nc, d);
+
+	EXPECT_EQ(d.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(d.is_corrupt);
+	EXPECT_EQ(d.acked_items, NUM_ITEMS);
+	EXPECT_GT(nc.delivered[1452], ITEM_SIZE * NUM_ITEMS / 1452 / 2);
+	EXPECT_EQ(nc.delivered[8952], 0u);
+	EXPECT_EQ(nc.delivered[4052], 0u);
+}
+
+TEST(Pmtud, FallsBackOnBlackHole) {
+	CountingConditioner nc;
+	nc.mtu = 9000;
+	Delegate d(nc);
+	// Path shrinks mid transfer without telling anyone
+	d.later_mtu = 1500;
+	transfer(nc, d);
+
+	EXPECT_EQ(d.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(d.is_corrupt);
+	EXPECT_EQ(d.acked_items, NUM_ITEMS);
+	EXPECT_GT(nc.delivered[8952], 0u);
+	// Found its way back up after falling back
+	EXPECT_GT(nc.delivered[1452], 0u);
+}
@@ -0,0 +1,259 @@
+#include "SimStreamHarness.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+
+#define DIAL_SIZE (10 + crypto_box_PUBLICKEYBYTES + crypto_kx_PUBLICKEYBYTES + crypto_box_SEALBYTES)
+
+// Counts DIALs from the client and can hold back the ones carrying a cookie until it expired
+struct RetryConditioner : public NetworkConditioner {
+	SocketAddress client;
+	uint64_t plain_dials = 0;
+	uint64_t cookie_dials = 0;
+	// Cookie DIALs sent before this tick arrive two epochs late, 0 to deliver all on time
+	uint64_t stale_until = 0;
+
+	bool is_cookie_dial(SocketAddress const& src, uint64_t size) {
+		return src == client && size == DIAL_SIZE + HandshakeGuard::cookie_size;
+	}
+
+	bool should_drop(
+		uint64_t in_tick,
+		SocketAddress const& src,
+		SocketAddress const& dst,
+		uint64_t size
+	) {
+		if(NetworkConditioner::should_drop(in_tick, src, dst, size)) {
+			return true;
+		}
+
+		if(src == client && size == DIAL_SIZE) {
+			plain_dials++;
+		} else if(is_cookie_dial(src, size)) {
+			cookie_dials++;
+		}
+
+		return false;
+	}
+
+	uint64_t get_out_tick(
+		uint64_t in_tick,
+		SocketAddress const& src,
+		SocketAddress const& dst,
+		uint64_t size
+	) {
+		if(is_cookie_dial(src, size) && in_tick < stale_until) {
+			return in_tick + 2 * HandshakeGuard::epoch_length + 1;
+		}
+
+		return NetworkConditioner::get_out_tick(in_tick, src, dst, size);
+	}
+};
+
+struct Delegate;
+
+using SimStream = SimStreamTypes<RetryConditioner, Delegate>;
+using NetworkType = SimStream::NetworkType;
+using TransportType = SimStream::TransportType;
+using TransportFactoryType = SimStream::TransportFactoryType;
+
+#define ITEM_SIZE 1000
+#define NUM_ITEMS 10
+
+// Client sends NUM_ITEMS items once the handshake completes, server receives and checks them
+struct Delegate : public SimStreamDelegate<Delegate, TransportType> {
+	size_t num_dials = 0;
+
+	Delegate() : SimStreamDelegate(ITEM_SIZE, NUM_ITEMS) {}
+
+	void did_dial(TransportType &transport) {
+		num_dials++;
+		SimStreamDelegate::did_dial(transport);
+	}
+};
+
+// Speaks raw datagrams to the listener, DIALs with a garbage sealed box and whatever cookie the test picks
+struct Spoofer {
+	using TransportType = SimStream::SimTransportType<Spoofer>;
+	using DIAL = DIALWrapper<BaseMessage>;
+	using RETRY = RETRYWrapper<BaseMessage>;
+
+	static constexpr uint32_t conn_id = 1234;
+	static constexpr uint32_t other_conn_id = 5678;
+
+	TransportType* transport = nullptr;
+	uint8_t cookie[HandshakeGuard::cookie_size];
+	size_t num_retries = 0;
+	// Connection id each RETRY was addressed to
+	std::vector<uint32_t> retry_conn_ids;
+
+	void send_DIAL(uint32_t src_conn_id, uint8_t const* echoed) {
+		constexpr size_t ct_len = DIAL_SIZE - 10;
+
+		uint8_t buf[ct_len + HandshakeGuard::cookie_size] = {};
+		size_t len = ct_len;
+		if(echoed != nullptr) {
+			std::memcpy(buf + ct_len, echoed, HandshakeGuard::cookie_size);
+			len += HandshakeGuard::cookie_size;
+		}
+
+		transport->send(
+			DIAL(len)
+			.set_src_conn_id(src_conn_id)
+			.set_dst_conn_id(0)
+			.set_payload(buf, len)
+		);
+	}
+
+	void did_dial(TransportType &transport) {
+		this->transport = &transport;
+		send_DIAL(conn_id, nullptr);
+	}
+
+	void did_recv(TransportType &, BaseMessage &&message) {
+		if(message.payload_buffer().size() < 2 || message.payload_buffer().data()[1] != 10) {
+			return;
+		}
+
+		RETRY packet(std::move(message));
+		if(!packet.validate(HandshakeGuard::cookie_size)) {
+			return;
+		}
+		retry_conn_ids.push_back(packet.src_conn_id());
+
+		switch(++num_retries) {
+		case 1: {
+			// Genuine cookie, echoed under a connection id it was not issued for
+			std::memcpy(cookie, packet.payload(), HandshakeGuard::cookie_size);
+			send_DIAL(other_conn_id, cookie);
+			break;
+		}
+		case 2: {
+			// Right connection id, tampered MAC
+			uint8_t forged[HandshakeGuard::cookie_size];
+			std::memcpy(forged, cookie, HandshakeGuard::cookie_size);
+			forged[HandshakeGuard::cookie_size - 1] ^= 1;
+			send_DIAL(conn_id, forged);
+			break;
+		}
+		case 3: {
+			// Genuine cookie, gets the DIAL as far as unsealing
+			send_DIAL(conn_id, cookie);
+			break;
+		}
+		}
+	}
+
+	void did_send(TransportType &, Buffer &&) {}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this);
+	}
+};
+
+class Retry : public ::testing::Test {
+protected:
+	RetryConditioner nc;
+	Delegate server, client;
+	HandshakeGuard& guard = HandshakeGuard::default_instance();
+
+	void SetUp() override {
+		nc.client = SocketAddress::from_string("192.168.0.2:8000");
+		guard.set_required(true);
+		guard.drop_stats = {};
+	}
+
+	void TearDown() override {
+		guard.set_required(false);
+	}
+
+	void exchange() {
+		NetworkType network(nc);
+		auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+		auto& i2 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.2:0"));
+
+		crypto_box_keypair(static_pk, static_sk);
+
+		TransportFactoryType s(i1, Simulator::default_instance), c(i2, Simulator::default_instance);
+		s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+		s.listen(server);
+		c.bind(nc.client);
+		c.dial(SocketAddress::from_string("192.168.0.1:8000"), client, static_pk);
+
+		Simulator::default_instance.run();
+	}
+};
+
+TEST_F(Retry, EchoesCookieToGuardedListener) {
+	exchange();
+
+	// DIAL -> RETRY -> DIAL with cookie -> DIALCONF
+	EXPECT_EQ(nc.plain_dials, 1u);
+	EXPECT_EQ(nc.cookie_dials, 1u);
+	EXPECT_EQ(guard.drop_stats.cookie_missing, 1u);
+	EXPECT_EQ(guard.drop_stats.cookie_invalid, 0u);
+	EXPECT_EQ(guard.drop_stats.unseal_failed, 0u);
+
+	EXPECT_EQ(client.num_dials, 1u);
+	EXPECT_EQ(server.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_EQ(client.acked_items, NUM_ITEMS);
+}
+
+TEST_F(Retry, DropsStaleCookie) {
+	// Every DIAL echoing the first cookie, retransmissions included, is two epochs old on arrival
+	nc.stale_until = Simulator::default_instance.current_tick() + 2 * HandshakeGuard::epoch_length;
+	exchange();
+
+	EXPECT_EQ(nc.plain_dials, 1u);
+	EXPECT_EQ(guard.drop_stats.cookie_missing, 1u);
+	EXPECT_GE(guard.drop_stats.cookie_invalid, 1u);
+	EXPECT_EQ(guard.drop_stats.unseal_failed, 0u);
+
+	// The RETRY answering the stale DIAL carries a fresh cookie that gets through
+	EXPECT_EQ(client.num_dials, 1u);
+	EXPECT_EQ(server.recv_bytes, ITEM_SIZE * NUM_ITEMS);
+	EXPECT_FALSE(server.is_corrupt);
+	EXPECT_EQ(client.acked_items, NUM_ITEMS);
+}
+
+TEST_F(Retry, DropsForgedCookie) {
+	NetworkType network(nc);
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i3 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.3:0"));
+
+	crypto_box_keypair(static_pk, static_sk);
+
+	Spoofer spoofer;
+	TransportFactoryType s(i1, Simulator::default_instance);
+	SimStream::SimTransportFactoryType<Spoofer, Spoofer> a(i3, Simulator::default_instance);
+	s.bind(SocketAddress::from_string("192.168.0.1:8000"));
+	s.listen(server);
+	a.bind(SocketAddress::from_string("192.168.0.3:8000"));
+	a.dial(SocketAddress::from_string("192.168.0.1:8000"), spoofer);
+
+	Simulator::default_instance.run();
+
+	// Missing cookie, cookie of another connection id and tampered cookie are each answered with a RETRY
+	ASSERT_EQ(spoofer.num_retries, 3u);
+	EXPECT_EQ(spoofer.retry_conn_ids[0], Spoofer::conn_id);
+	EXPECT_EQ(spoofer.retry_conn_ids[1], Spoofer::other_conn_id);
+	EXPECT_EQ(spoofer.retry_conn_ids[2], Spoofer::conn_id);
+	EXPECT_EQ(guard.drop_stats.cookie_missing, 1u);
+	EXPECT_EQ(guard.drop_stats.cookie_invalid, 2u);
+	// Only the genuine cookie let the DIAL reach public key crypto
+	EXPECT_EQ(guard.drop_stats.unseal_failed, 1u);
+	EXPECT_EQ(server.recv_bytes, 0u);
+}